@@ -8,8 +8,10 @@ function sendMQTT(){
     .catch(e=>alert('Erreur de requête MQTT: '+e));
 }
 
-let labels=[], measData=[], estData=[], durData=[];
+let labels=[], measData=[], estData=[], durData=[], minData=[], maxData=[];
 let cuveInitDone = false;
+let liveView = true;
+let channel = 0; // capteur affiché (plusieurs capteurs : sélecteur "Capteur")
 
 const ctx=document.getElementById('chart').getContext('2d');
 const chart=new Chart(ctx,{
@@ -19,7 +21,9 @@ const chart=new Chart(ctx,{
     datasets:[
       {label:'Mes (cm)',data:measData,borderColor:'blue',fill:false,yAxisID:'y1'},
       {label:'Est (cm)',data:estData,borderColor:'green',fill:false,yAxisID:'y1'},
-      {label:'Dur (us)',data:durData,borderColor:'red',fill:false,yAxisID:'y2'}
+      {label:'Dur (us)',data:durData,borderColor:'red',fill:false,yAxisID:'y2'},
+      {label:'Min (cm)',data:minData,borderColor:'lightblue',borderDash:[4,4],fill:false,yAxisID:'y1'},
+      {label:'Max (cm)',data:maxData,borderColor:'navy',borderDash:[4,4],fill:false,yAxisID:'y1'}
     ]
   },
   options:{
@@ -33,53 +37,140 @@ const chart=new Chart(ctx,{
   }
 });
 
-function refreshDistance(){
-  fetch('/distance')
-    .then(r=>r.json())
-    .then(j=>{
-      const m = (j.measured_cm===null)?null:j.measured_cm;
-      const e = (j.estimated_cm===null)?null:j.estimated_cm;
-      const d = (j.measured_cm===null)?null:j.duration_us;
+// Plusieurs capteurs : /distance porte un tableau "channels", les événements
+// SSE un champ "ch" ; seul le capteur choisi est affiché
+function setupChannels(list){
+  const sel = document.getElementById('channel');
+  if (sel.options.length === list.length) return;
+  sel.innerHTML = '';
+  list.forEach(function(c){
+    const o = document.createElement('option');
+    o.value = String(c.ch);
+    o.textContent = 'C' + c.ch;
+    sel.appendChild(o);
+  });
+  sel.value = String(channel);
+  document.getElementById('channelBox').style.display = '';
+  document.getElementById('histNote').style.display = '';
+}
 
-      document.getElementById('meas').innerText = (m!==null)?m.toFixed(1):'--';
-      document.getElementById('est').innerText  = (e!==null && e>-0.5)?e.toFixed(1):'--';
-      document.getElementById('dur').innerText  = (d!==null)?d:'--';
+function changeChannel(){
+  channel = parseInt(document.getElementById('channel').value, 10) || 0;
+  cuveInitDone = false;
+  clearChart();
+  chart.update();
+  refreshDistance();
+  refreshCalibs();
+}
 
-      if (!cuveInitDone && typeof j.cuveVide === 'number' && typeof j.cuvePleine === 'number') {
-        document.getElementById('v').value = j.cuveVide.toFixed(0);
-        document.getElementById('p').value = j.cuvePleine.toFixed(0);
-        cuveInitDone = true;
-      }
+// Valeurs affichées et niveaux de cuve ; null si l'objet vise un autre capteur
+function showValues(j){
+  if (Array.isArray(j.channels)) {
+    setupChannels(j.channels);
+    j = j.channels[channel] || j;
+  } else if (typeof j.ch === 'number' && j.ch !== channel) {
+    return null;
+  }
+  const m = (j.measured_cm===null)?null:j.measured_cm;
+  const e = (j.estimated_cm===null)?null:j.estimated_cm;
+  const d = (j.measured_cm===null)?null:j.duration_us;
 
-      const t=new Date().toLocaleTimeString();
-      labels.push(t);
-      if(labels.length>60){labels.shift();measData.shift();estData.shift();durData.shift();}
+  document.getElementById('meas').innerText = (m!==null)?m.toFixed(1):'--';
+  document.getElementById('est').innerText  = (e!==null && e>-0.5)?e.toFixed(1):'--';
+  document.getElementById('dur').innerText  = (d!==null)?d:'--';
+  document.getElementById('vol').innerText  = (typeof j.volume_l === 'number')?j.volume_l.toFixed(0):'--';
+  document.getElementById('pct').innerText  = (typeof j.percent === 'number')?j.percent.toFixed(1):'--';
+  document.getElementById('free').innerText = (typeof j.free_l === 'number')?j.free_l.toFixed(0):'--';
 
-      measData.push(m !== null ? m : null);
-      estData.push(e !== null ? e : null);
-      durData.push(d !== null ? d : null);
+  if (!cuveInitDone && typeof j.cuveVide === 'number' && typeof j.cuvePleine === 'number') {
+    document.getElementById('v').value = j.cuveVide.toFixed(0);
+    document.getElementById('p').value = j.cuvePleine.toFixed(0);
+    cuveInitDone = true;
+  }
+  return j;
+}
 
-      chart.update();
-    });
+function showDistance(j){
+  j = showValues(j);
+  if (!j || !liveView) return;
+  const m = (j.measured_cm===null)?null:j.measured_cm;
+  const e = (j.estimated_cm===null)?null:j.estimated_cm;
+  const d = (j.measured_cm===null)?null:j.duration_us;
+
+  const t=new Date().toLocaleTimeString();
+  labels.push(t);
+  if(labels.length>60){labels.shift();measData.shift();estData.shift();durData.shift();}
+
+  measData.push(m !== null ? m : null);
+  estData.push(e !== null ? e : null);
+  durData.push(d !== null ? d : null);
+
+  chart.update();
 }
 
-function refreshCalibs(){
-  fetch('/calibs')
+function refreshDistance(){
+  fetch('/distance')
+    .then(r=>r.json())
+    .then(showDistance);
+}
+
+function clearChart(){
+  [labels, measData, estData, durData, minData, maxData].forEach(a => a.length = 0);
+}
+
+// Historique stocké sur l'appareil ; les dates sont recalées sur l'horloge du
+// navigateur (l'appareil n'est pas forcément synchronisé NTP).
+function loadHistory(tier, n){
+  return fetch('/api/history?tier='+tier+'&n='+n)
     .then(r=>r.json())
     .then(j=>{
-      let html='';
-      j.calibs.forEach(function(c){
-        html += 'C'+(c.index+1)+': Mesuré='+ (c.measured>0?c.measured.toFixed(1):'--') +
-                ' Hauteur:<input id="h'+c.index+'" value="'+c.height+'"> ' +
-                '<button onclick="save('+c.index+')">Save</button><br>';
+      clearChart();
+      const nowMs = Date.now();
+      j.records.forEach(function(r){
+        const d = new Date(nowMs - (j.now - r[0]) * 1000);
+        labels.push(tier === 'hour' ? d.toLocaleString() : d.toLocaleTimeString());
+        measData.push(r[3]);
+        estData.push(null);
+        durData.push(null);
+        if (tier !== 'raw') { minData.push(r[1]); maxData.push(r[2]); }
       });
-      document.getElementById('calibs').innerHTML = html;
+      chart.update();
     });
 }
 
+function changeView(){
+  const v = document.getElementById('view').value;
+  liveView = (v === 'live');
+  if (liveView) loadHistory('raw', 60);
+  else loadHistory(v, v === 'raw' ? 360 : 240);
+}
+
+function showCalibs(j){
+  if (typeof j.ch === 'number' && j.ch !== channel) return;
+  let html='';
+  j.calibs.forEach(function(c){
+    html += 'C'+(c.index+1)+': Mesuré='+ (c.measured>0?c.measured.toFixed(1):'--') +
+            ' Hauteur:<input id="h'+c.index+'" value="'+c.height+'"> ' +
+            '<button onclick="save('+c.index+')">Save</button> ' +
+            '<button onclick="delCalib('+c.index+')">Suppr</button><br>';
+  });
+  document.getElementById('calibs').innerHTML = html;
+  document.getElementById('calibModel').value = j.model;
+  document.getElementById('calibDegree').value = String(j.degree);
+  document.getElementById('calibDegree').disabled = (j.model !== 'poly');
+  document.getElementById('calibState').textContent =
+    (j.valid ? 'OK' : 'non calibré') + ' (' + j.calibs.length + '/' + j.max + ' points)';
+}
+
+function refreshCalibs(){
+  fetch('/calibs?ch='+channel)
+    .then(r=>r.json())
+    .then(showCalibs);
+}
+
 function save(id){
-  const val = document.getElementById('h'+id).value;
-  const body = new URLSearchParams({ id: String(id), height: String(val) });
+  const val = document.getElementById(id < 0 ? 'hNew' : 'h'+id).value;
+  const body = new URLSearchParams({ id: String(id), height: String(val), ch: String(channel) });
   fetch('/save_calib', {
       method:'POST',
       headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
@@ -94,16 +185,33 @@ function save(id){
     .catch(e=>alert('Erreur save_calib: '+e));
 }
 
+function delCalib(id){
+  fetch('/delete_calib', { method:'POST', body: new URLSearchParams({ id: String(id), ch: String(channel) }) })
+    .then(r=>r.json())
+    .then(refreshCalibs);
+}
+
+function saveModel(){
+  const body = new URLSearchParams({
+    model: document.getElementById('calibModel').value,
+    degree: document.getElementById('calibDegree').value,
+    ch: String(channel)
+  });
+  fetch('/calib_model', { method:'POST', body })
+    .then(r=>r.json())
+    .then(refreshCalibs);
+}
+
 function saveCuve(){
   const v=document.getElementById('v').value;
   const p=document.getElementById('p').value;
-  fetch('/setCuve?vide='+v+'&pleine='+p,{method:'POST'})
+  fetch('/setCuve?vide='+v+'&pleine='+p+'&ch='+channel,{method:'POST'})
     .then(r=>r.json())
     .then(j=>{ if(j.ok) alert('Saved cuve');});
 }
 
 function clearCalib(){
-  fetch('/clear_calib',{method:'POST'})
+  fetch('/clear_calib',{method:'POST', body: new URLSearchParams({ ch: String(channel) })})
     .then(r=>r.json())
     .then(j=>{ alert('Cleared'); refreshCalibs();});
 }
@@ -115,8 +223,24 @@ function sendPing() {
   });
 }
 
-setInterval(sendPing, 10000);
-setInterval(refreshDistance,800);
-setInterval(refreshCalibs,5000);
-refreshDistance();
-refreshCalibs();
+loadHistory('raw', 60).catch(()=>{});
+refreshDistance(); // découvre les capteurs (tableau "channels")
+
+// Push serveur (SSE) : une mesure arrive dès qu'elle est produite et la
+// connexion ouverte sert de keepalive. Repli sur le polling sinon.
+if (window.EventSource) {
+  const es = new EventSource('/events');
+  es.addEventListener('measure', e => showDistance(JSON.parse(e.data)));
+  // Niveaux de cuve modifiés (/setCuve) : valeurs à jour, pas de point de graphe
+  es.addEventListener('cuve', e => {
+    const j = JSON.parse(e.data);
+    if (typeof j.ch !== 'number' || j.ch === channel) cuveInitDone = false;
+    showValues(j);
+  });
+  es.addEventListener('calibs', e => showCalibs(JSON.parse(e.data)));
+} else {
+  setInterval(sendPing, 10000);
+  setInterval(refreshDistance,800);
+  setInterval(refreshCalibs,5000);
+  refreshCalibs();
+}
@@ -18,22 +18,36 @@ async function fetchConfig() {
     document.getElementById('mqtt_user').value = json.mqtt_user || '';
     // mqtt_pass masqué côté serveur; on laisse vide pour saisie manuelle si besoin
     document.getElementById('mqtt_topic').value = json.mqtt_topic || '';
+    document.getElementById('mqtt_diag_s').value = json.mqtt_diag_s || 0;
 
     // Mesure
     document.getElementById('measure_interval_ms').value = json.measure_interval_ms || 1000;
+    document.getElementById('measure_interval_max_ms').value = json.measure_interval_max_ms || 1500;
+    document.getElementById('adaptive_rate_cm_min').value = (typeof json.adaptive_rate_cm_min === 'number') ? json.adaptive_rate_cm_min : 1.0;
     document.getElementById('measure_offset_cm').value = json.measure_offset_cm || 0;
 
     // Stabilisation / filtre bruit
-    document.getElementById('avg_alpha').value = (typeof json.avg_alpha === 'number') ? json.avg_alpha : 0.25;
+    document.getElementById('kalman_q').value = (typeof json.kalman_q === 'number') ? json.kalman_q : 1e-9;
+    document.getElementById('kalman_r_cm').value = (typeof json.kalman_r_cm === 'number') ? json.kalman_r_cm : 0.5;
     document.getElementById('median_n').value = json.median_n || 5;
     document.getElementById('median_delay_ms').value = json.median_delay_ms || 50;
     document.getElementById('filter_min_cm').value = (typeof json.filter_min_cm === 'number') ? json.filter_min_cm : 2.0;
     document.getElementById('filter_max_cm').value = (typeof json.filter_max_cm === 'number') ? json.filter_max_cm : 400.0;
 
+    // Cuve
+    document.getElementById('tank_shape').value = json.tank_shape || 'vcyl';
+    document.getElementById('tank_diameter_cm').value = json.tank_diameter_cm || 100;
+    document.getElementById('tank_length_cm').value = json.tank_length_cm || 200;
+    document.getElementById('tank_width_cm').value = json.tank_width_cm || 100;
+    document.getElementById('tank_profile').value = json.tank_profile || '';
+    renderChannelTanks(json);
+
     // Divers
     document.getElementById('device_name').value = json.device_name || '';
     document.getElementById('interactive_timeout_ms').value = json.interactive_timeout_ms || 600000; // 10 min aligné
     document.getElementById('deepsleep_interval_s').value = json.deepsleep_interval_s || 30;
+    document.getElementById('batch_upload_every').value = json.batch_upload_every || 10;
+    document.getElementById('batch_threshold_cm').value = (typeof json.batch_threshold_cm === 'number') ? json.batch_threshold_cm : 5.0;
 
     document.getElementById('admin_user').value = json.admin_user || '';
     // admin_pass masqué; laissé vide
@@ -43,6 +57,29 @@ async function fetchConfig() {
   }
 }
 
+// Capteurs supplémentaires (firmware multi-capteurs) : clés "chN_tank_*"
+// présentes dans la config ; formes analytiques seulement (pas de profil)
+function renderChannelTanks(json) {
+  const box = document.getElementById('ch_tanks');
+  box.innerHTML = '';
+  Object.keys(json).forEach(function(k){
+    const m = /^ch(\d+)_tank_shape$/.exec(k);
+    if (!m) return;
+    const p = 'ch' + m[1] + '_tank_';
+    const shapes = {vcyl: 'Cylindre vertical', hcyl: 'Cylindre horizontal', rect: 'Rectangulaire'};
+    let html = '<h4>Capteur C' + m[1] + '</h4>Forme: <select data-key="' + p + 'shape">';
+    Object.keys(shapes).forEach(function(s){
+      html += '<option value="' + s + '"' + (json[k] === s ? ' selected' : '') + '>' + shapes[s] + '</option>';
+    });
+    html += '</select><br>';
+    [['diameter_cm', 'Diamètre'], ['length_cm', 'Longueur'], ['width_cm', 'Largeur']].forEach(function(f){
+      html += f[1] + ' (cm): <input data-key="' + p + f[0] + '" type="number" step="0.1" min="0" value="' +
+              (json[p + f[0]] || 100) + '"><br>';
+    });
+    box.insertAdjacentHTML('beforeend', html);
+  });
+}
+
 function gatherConfig() {
   const obj = {};
 
@@ -59,22 +96,38 @@ function gatherConfig() {
   const mp = document.getElementById('mqtt_pass').value;
   if (mp && mp.length > 0) obj.mqtt_pass = mp;
   obj.mqtt_topic = document.getElementById('mqtt_topic').value;
+  obj.mqtt_diag_s = parseInt(document.getElementById('mqtt_diag_s').value) || 0;
 
   // Mesure
   obj.measure_interval_ms = parseInt(document.getElementById('measure_interval_ms').value) || 1000;
+  obj.measure_interval_max_ms = parseInt(document.getElementById('measure_interval_max_ms').value) || 1500;
+  obj.adaptive_rate_cm_min = parseFloat(document.getElementById('adaptive_rate_cm_min').value) || 1.0;
   obj.measure_offset_cm = parseFloat(document.getElementById('measure_offset_cm').value) || 0.0;
 
   // Stabilisation / filtre bruit
-  obj.avg_alpha = Math.max(0, Math.min(1, parseFloat(document.getElementById('avg_alpha').value)));
+  obj.kalman_q = parseFloat(document.getElementById('kalman_q').value) || 1e-9;
+  obj.kalman_r_cm = parseFloat(document.getElementById('kalman_r_cm').value) || 0.5;
   obj.median_n = Math.max(1, Math.min(15, parseInt(document.getElementById('median_n').value) || 5));
   obj.median_delay_ms = Math.max(0, Math.min(1000, parseInt(document.getElementById('median_delay_ms').value) || 50));
   obj.filter_min_cm = parseFloat(document.getElementById('filter_min_cm').value);
   obj.filter_max_cm = parseFloat(document.getElementById('filter_max_cm').value);
 
+  // Cuve
+  obj.tank_shape = document.getElementById('tank_shape').value;
+  obj.tank_diameter_cm = parseFloat(document.getElementById('tank_diameter_cm').value) || 100;
+  obj.tank_length_cm = parseFloat(document.getElementById('tank_length_cm').value) || 200;
+  obj.tank_width_cm = parseFloat(document.getElementById('tank_width_cm').value) || 100;
+  obj.tank_profile = document.getElementById('tank_profile').value || '';
+  document.querySelectorAll('#ch_tanks [data-key]').forEach(function(el){
+    obj[el.dataset.key] = (el.tagName === 'SELECT') ? el.value : (parseFloat(el.value) || 100);
+  });
+
   // Divers
   obj.device_name = document.getElementById('device_name').value || '';
   obj.interactive_timeout_ms = parseInt(document.getElementById('interactive_timeout_ms').value) || 600000;
   obj.deepsleep_interval_s = parseInt(document.getElementById('deepsleep_interval_s').value) || 30;
+  obj.batch_upload_every = Math.max(1, Math.min(48, parseInt(document.getElementById('batch_upload_every').value) || 10));
+  obj.batch_threshold_cm = Math.max(0, parseFloat(document.getElementById('batch_threshold_cm').value) || 0);
 
   obj.admin_user = document.getElementById('admin_user').value || '';
   const ap = document.getElementById('admin_pass').value;
@@ -93,19 +146,38 @@ async function saveConfig() {
     });
     const j = await res.json();
     if (res.ok && j.ok) {
-      showStatus('Config sauvegardée', false);
+      showStatus('Config appliquée, écriture en flash…', false);
+      waitCommitted(j.pending);
       // Clear password fields après sauvegarde
       document.getElementById('admin_pass').value = '';
       document.getElementById('wifi_pass').value = '';
       document.getElementById('mqtt_pass').value = '';
     } else {
-      showStatus('Erreur sauvegarde', true);
+      // Le serveur nomme la règle violée et le champ fautif
+      const detail = j.err ? ' : ' + j.err + (j.field ? ' (' + j.field + ')' : '') : '';
+      showStatus('Erreur sauvegarde' + detail, true);
     }
   } catch (e) {
     showStatus('Erreur POST: ' + e, true);
   }
 }
 
+// Écriture différée : attend que la génération écrite rattrape celle de la requête
+async function waitCommitted(pending, tries = 20) {
+  try {
+    const res = await fetch('/api/config/state', {cache: 'no-store'});
+    const st = await res.json();
+    if (st.committed >= pending) {
+      showStatus('Config sauvegardée', false);
+      return;
+    }
+  } catch (e) {
+    // réessai au prochain tour
+  }
+  if (tries > 1) setTimeout(() => waitCommitted(pending, tries - 1), 1000);
+  else showStatus('Config appliquée (écriture en flash en attente)', true);
+}
+
 function showStatus(msg, isError) {
   const el = document.getElementById('status');
   el.innerText = msg;
@@ -0,0 +1,97 @@
+# Pré-build PlatformIO : compresse data/* en gzip et génère src/web_assets_gen.h
+# (tableaux en flash + ETag = hash du contenu). Les références CSS/JS des pages
+# HTML sont suffixées par ?v=<hash> pour pouvoir être mises en cache longtemps.
+#
+# Utilisable aussi hors PlatformIO : python scripts/embed_web_assets.py
+import gzip
+import hashlib
+import os
+import re
+
+try:
+    Import("env")  # noqa: F821 (fourni par SCons)
+    PROJECT_DIR = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+DATA_DIR = os.path.join(PROJECT_DIR, "data")
+OUT_FILE = os.path.join(PROJECT_DIR, "src", "web_assets_gen.h")
+
+MIME = {
+    ".html": "text/html; charset=utf-8",
+    ".css": "text/css; charset=utf-8",
+    ".js": "application/javascript; charset=utf-8",
+}
+
+
+def content_hash(data):
+    return hashlib.sha1(data).hexdigest()[:16]
+
+
+def c_ident(name):
+    return "asset_" + re.sub(r"[^0-9a-zA-Z]", "_", name)
+
+
+def c_bytes(data):
+    lines = []
+    for i in range(0, len(data), 20):
+        lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 20]) + ",")
+    return "\n".join(lines)
+
+
+def main():
+    names = sorted(n for n in os.listdir(DATA_DIR) if os.path.splitext(n)[1] in MIME)
+    raw = {}
+    for n in names:
+        with open(os.path.join(DATA_DIR, n), "rb") as f:
+            raw[n] = f.read()
+
+    # CSS/JS d'abord : leur hash versionne les URLs dans les pages HTML
+    hashes = {n: content_hash(raw[n]) for n in names if not n.endswith(".html")}
+    for n in names:
+        if n.endswith(".html"):
+            html = raw[n].decode("utf-8")
+            for dep, h in hashes.items():
+                html = html.replace('"/%s"' % dep, '"/%s?v=%s"' % (dep, h))
+            raw[n] = html.encode("utf-8")
+            hashes[n] = content_hash(raw[n])
+
+    out = [
+        "// Fichier généré par scripts/embed_web_assets.py - ne pas modifier.",
+        "#pragma once",
+        "#include <Arduino.h>",
+        "",
+    ]
+    entries = []
+    total_raw = total_gz = 0
+    for n in names:
+        gz = gzip.compress(raw[n], compresslevel=9, mtime=0)
+        total_raw += len(raw[n])
+        total_gz += len(gz)
+        ident = c_ident(n)
+        out.append("static const uint8_t %s[] PROGMEM = {" % ident)
+        out.append(c_bytes(gz))
+        out.append("};")
+        out.append("")
+        immutable = "false" if n.endswith(".html") else "true"
+        entries.append('    {"/%s", "%s", %s, sizeof(%s), %d, "\\"%s\\"", %s},'
+                       % (n, MIME[os.path.splitext(n)[1]], ident, ident, len(raw[n]), hashes[n], immutable))
+
+    out.append("static const WebAsset WEB_ASSETS[] = {")
+    out.extend(entries)
+    out.append("};")
+    out.append("static const size_t WEB_ASSET_COUNT = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);")
+    out.append("")
+    text = "\n".join(out)
+
+    old = None
+    if os.path.exists(OUT_FILE):
+        with open(OUT_FILE, "r", encoding="utf-8") as f:
+            old = f.read()
+    if old != text:
+        with open(OUT_FILE, "w", encoding="utf-8") as f:
+            f.write(text)
+    print("web assets: %d fichiers, %d -> %d octets (gzip)" % (len(names), total_raw, total_gz))
+
+
+main()
@@ -0,0 +1,328 @@
+#include "calibration.h"
+#include <math.h>
+#include <string.h>
+
+#define CALIB_POLY_MAX_DEGREE 3
+
+void CalibrationTable::clear()
+{
+    count_ = 0;
+    valid_ = false;
+}
+
+bool CalibrationTable::setPoint(size_t idx, float measuredCm, float heightCm)
+{
+    if (idx > count_ || idx >= CALIB_MAX_POINTS)
+        return false;
+    if (!isfinite(measuredCm) || !isfinite(heightCm) || measuredCm <= 0.0f)
+        return false;
+    points_[idx].measuredCm = measuredCm;
+    points_[idx].heightCm = heightCm;
+    if (idx == count_)
+        count_++;
+    valid_ = false;
+    return true;
+}
+
+bool CalibrationTable::removePoint(size_t idx)
+{
+    if (idx >= count_)
+        return false;
+    memmove(&points_[idx], &points_[idx + 1], (count_ - idx - 1) * sizeof(CalibPoint));
+    count_--;
+    valid_ = false;
+    return true;
+}
+
+void CalibrationTable::setModel(CalibModel model, uint8_t polyDegree)
+{
+    model_ = model;
+    if (polyDegree < 1)
+        polyDegree = 1;
+    if (polyDegree > CALIB_POLY_MAX_DEGREE)
+        polyDegree = CALIB_POLY_MAX_DEGREE;
+    polyDegree_ = polyDegree;
+    valid_ = false;
+}
+
+bool CalibrationTable::build(float minCm, float maxCm)
+{
+    valid_ = false;
+    knots_ = 0;
+
+    // Noeuds triés par distance mesurée (tri par insertion, N <= 16)
+    for (uint8_t i = 0; i < count_; ++i)
+    {
+        const float x = points_[i].measuredCm;
+        const float y = points_[i].heightCm;
+        uint8_t j = knots_;
+        while (j > 0 && knotX_[j - 1] > x)
+        {
+            knotX_[j] = knotX_[j - 1];
+            knotY_[j] = knotY_[j - 1];
+            slope_[j] = slope_[j - 1];
+            --j;
+        }
+        knotX_[j] = x;
+        knotY_[j] = y;
+        slope_[j] = 1.0f; // poids (nombre de points fusionnés) le temps de la fusion
+        knots_++;
+    }
+
+    // Même distance saisie deux fois : moyenne des hauteurs
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < knots_; ++i)
+    {
+        if (n > 0 && fabsf(knotX_[i] - knotX_[n - 1]) < 1e-3f)
+        {
+            const float w = slope_[n - 1];
+            knotY_[n - 1] = (knotY_[n - 1] * w + knotY_[i]) / (w + 1.0f);
+            slope_[n - 1] = w + 1.0f;
+            continue;
+        }
+        knotX_[n] = knotX_[i];
+        knotY_[n] = knotY_[i];
+        slope_[n] = slope_[i];
+        n++;
+    }
+    knots_ = n;
+
+    if (knots_ < 2)
+        return false;
+
+    const bool ok = (model_ == CalibModel::Poly) ? fitPoly() : fitLinearOrSpline();
+    if (!ok)
+        return false;
+
+    // Échantillonnage du modèle sur la plage de mesure acceptée
+    lutMin_ = minCm;
+    lutMax_ = maxCm;
+    lutInvStep_ = 0.0f;
+    valid_ = true;
+    if (isfinite(minCm) && isfinite(maxCm) && maxCm > minCm)
+    {
+        const float step = (maxCm - minCm) / (CALIB_LUT_SIZE - 1);
+        for (int i = 0; i < CALIB_LUT_SIZE; ++i)
+            lut_[i] = evaluateModel(minCm + step * i);
+        lutInvStep_ = 1.0f / step;
+    }
+    return true;
+}
+
+bool CalibrationTable::fitLinearOrSpline()
+{
+    // Pentes des segments
+    float delta[CALIB_MAX_POINTS] = {};
+    for (uint8_t k = 0; k + 1 < knots_; ++k)
+        delta[k] = (knotY_[k + 1] - knotY_[k]) / (knotX_[k + 1] - knotX_[k]);
+
+    if (model_ == CalibModel::Linear)
+    {
+        for (uint8_t k = 0; k + 1 < knots_; ++k)
+            slope_[k] = delta[k];
+        slope_[knots_ - 1] = delta[knots_ - 2];
+        return true;
+    }
+
+    // Fritsch–Carlson : tangentes initiales puis limitation pour rester monotone
+    slope_[0] = delta[0];
+    slope_[knots_ - 1] = delta[knots_ - 2];
+    for (uint8_t k = 1; k + 1 < knots_; ++k)
+        slope_[k] = (delta[k - 1] * delta[k] <= 0.0f) ? 0.0f : (delta[k - 1] + delta[k]) * 0.5f;
+
+    for (uint8_t k = 0; k + 1 < knots_; ++k)
+    {
+        if (delta[k] == 0.0f)
+        {
+            slope_[k] = 0.0f;
+            slope_[k + 1] = 0.0f;
+            continue;
+        }
+        const float a = slope_[k] / delta[k];
+        const float b = slope_[k + 1] / delta[k];
+        const float s = a * a + b * b;
+        if (s > 9.0f)
+        {
+            const float t = 3.0f / sqrtf(s);
+            slope_[k] = t * a * delta[k];
+            slope_[k + 1] = t * b * delta[k];
+        }
+    }
+    return true;
+}
+
+bool CalibrationTable::fitPoly()
+{
+    degree_ = polyDegree_;
+    if (degree_ > knots_ - 1)
+        degree_ = knots_ - 1;
+
+    // Variable réduite u = x / max|x| : équations normales bien conditionnées
+    double maxAbs = 0.0;
+    for (uint8_t i = 0; i < knots_; ++i)
+        maxAbs = fmax(maxAbs, fabs((double)knotX_[i]));
+    polyScale_ = (maxAbs > 0.0) ? 1.0 / maxAbs : 1.0;
+
+    // Moindres carrés pondérés : slope_ porte encore le nombre de points
+    // fusionnés par noeud, même ajustement que sur les points saisis
+    const int m = degree_ + 1;
+    double a[CALIB_POLY_MAX_DEGREE + 1][CALIB_POLY_MAX_DEGREE + 2] = {};
+    for (uint8_t i = 0; i < knots_; ++i)
+    {
+        const double u = knotX_[i] * polyScale_;
+        double pw[2 * CALIB_POLY_MAX_DEGREE + 1];
+        pw[0] = slope_[i];
+        for (int k = 1; k <= 2 * degree_; ++k)
+            pw[k] = pw[k - 1] * u;
+        for (int r = 0; r < m; ++r)
+        {
+            for (int c = 0; c < m; ++c)
+                a[r][c] += pw[r + c];
+            a[r][m] += pw[r] * knotY_[i];
+        }
+    }
+
+    // Élimination de Gauss avec pivot partiel
+    for (int col = 0; col < m; ++col)
+    {
+        int piv = col;
+        for (int r = col + 1; r < m; ++r)
+            if (fabs(a[r][col]) > fabs(a[piv][col]))
+                piv = r;
+        if (fabs(a[piv][col]) < 1e-12)
+            return false;
+        if (piv != col)
+            for (int c = 0; c <= m; ++c)
+            {
+                const double t = a[col][c];
+                a[col][c] = a[piv][c];
+                a[piv][c] = t;
+            }
+        for (int r = col + 1; r < m; ++r)
+        {
+            const double f = a[r][col] / a[col][col];
+            for (int c = col; c <= m; ++c)
+                a[r][c] -= f * a[col][c];
+        }
+    }
+    for (int r = m - 1; r >= 0; --r)
+    {
+        double s = a[r][m];
+        for (int c = r + 1; c < m; ++c)
+            s -= a[r][c] * coef_[c];
+        coef_[r] = s / a[r][r];
+    }
+    for (int r = m; r <= CALIB_POLY_MAX_DEGREE; ++r)
+        coef_[r] = 0.0;
+    return true;
+}
+
+float CalibrationTable::evaluateModel(float x) const
+{
+    if (knots_ < 2)
+        return NAN;
+
+    if (model_ == CalibModel::Poly)
+    {
+        const double u = x * polyScale_;
+        double y = 0.0;
+        for (int k = degree_; k >= 0; --k)
+            y = y * u + coef_[k];
+        return (float)y;
+    }
+
+    // Hors des points extrêmes : prolongement linéaire par la pente d'extrémité
+    if (x <= knotX_[0])
+        return knotY_[0] + slope_[0] * (x - knotX_[0]);
+    const uint8_t last = knots_ - 1;
+    if (x >= knotX_[last])
+        return knotY_[last] + slope_[last] * (x - knotX_[last]);
+
+    uint8_t k = 0;
+    while (k + 1 < last && x >= knotX_[k + 1])
+        ++k;
+
+    const float h = knotX_[k + 1] - knotX_[k];
+    if (model_ == CalibModel::Linear)
+        return knotY_[k] + slope_[k] * (x - knotX_[k]);
+
+    // Hermite cubique
+    const float t = (x - knotX_[k]) / h;
+    const float t2 = t * t, t3 = t2 * t;
+    return (2 * t3 - 3 * t2 + 1) * knotY_[k] + (t3 - 2 * t2 + t) * h * slope_[k] +
+           (-2 * t3 + 3 * t2) * knotY_[k + 1] + (t3 - t2) * h * slope_[k + 1];
+}
+
+float CalibrationTable::evaluate(float x) const
+{
+    if (!valid_)
+        return NAN;
+    if (lutInvStep_ <= 0.0f || !(x >= lutMin_ && x <= lutMax_))
+        return evaluateModel(x);
+
+    const float f = (x - lutMin_) * lutInvStep_;
+    int i = (int)f;
+    if (i >= CALIB_LUT_SIZE - 1)
+        return lut_[CALIB_LUT_SIZE - 1];
+    const float frac = f - i;
+    return lut_[i] + (lut_[i + 1] - lut_[i]) * frac;
+}
+
+size_t CalibrationTable::serialize(uint8_t *buf, size_t len) const
+{
+    const size_t need = blobSize(count_);
+    if (len < need)
+        return 0;
+    buf[0] = CALIB_BLOB_VERSION;
+    buf[1] = (uint8_t)model_;
+    buf[2] = polyDegree_;
+    buf[3] = count_;
+    memcpy(buf + 4, points_, count_ * sizeof(CalibPoint));
+    return need;
+}
+
+bool CalibrationTable::deserialize(const uint8_t *buf, size_t len)
+{
+    if (len < 4 || buf[0] != CALIB_BLOB_VERSION)
+        return false;
+    if (buf[1] > (uint8_t)CalibModel::Poly || buf[3] > CALIB_MAX_POINTS)
+        return false;
+    if (len < blobSize(buf[3]))
+        return false;
+
+    clear();
+    setModel((CalibModel)buf[1], buf[2]);
+    CalibPoint p;
+    for (uint8_t i = 0; i < buf[3]; ++i)
+    {
+        memcpy(&p, buf + 4 + i * sizeof(CalibPoint), sizeof(CalibPoint));
+        setPoint(count_, p.measuredCm, p.heightCm); // points invalides ignorés
+    }
+    return true;
+}
+
+const char *CalibrationTable::modelName(CalibModel model)
+{
+    switch (model)
+    {
+    case CalibModel::Linear:
+        return "linear";
+    case CalibModel::Spline:
+        return "spline";
+    default:
+        return "poly";
+    }
+}
+
+bool CalibrationTable::parseModel(const char *name, CalibModel &out)
+{
+    if (strcmp(name, "linear") == 0)
+        out = CalibModel::Linear;
+    else if (strcmp(name, "spline") == 0)
+        out = CalibModel::Spline;
+    else if (strcmp(name, "poly") == 0)
+        out = CalibModel::Poly;
+    else
+        return false;
+    return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+
+#define CALIB_MAX_POINTS 16
+#define CALIB_LUT_SIZE 512
+#define CALIB_BLOB_VERSION 1
+
+/**
+ * Modèle de conversion distance mesurée -> hauteur d'eau.
+ * - Linear : segments entre points consécutifs.
+ * - Spline : cubique d'Hermite monotone (Fritsch–Carlson), sans dépassement
+ *   entre les points.
+ * - Poly   : polynôme des moindres carrés (degré <= points - 1). Avec 3 points
+ *   et le degré 2, c'est la parabole exacte de l'ancienne calibration.
+ */
+enum class CalibModel : uint8_t
+{
+    Linear = 0,
+    Spline = 1,
+    Poly = 2
+};
+
+struct CalibPoint
+{
+    float measuredCm;
+    float heightCm;
+};
+
+/**
+ * Table de calibration à N points + table de conversion précalculée.
+ * - Les points sont conservés dans l'ordre de saisie (index stables pour l'UI).
+ * - build() ajuste le modèle puis échantillonne CALIB_LUT_SIZE valeurs sur
+ *   [minCm, maxCm] : evaluate() n'est plus qu'une lecture + interpolation.
+ * - Indépendant du matériel (testable hors cible).
+ */
+class CalibrationTable
+{
+public:
+    void clear();
+    bool setPoint(size_t idx, float measuredCm, float heightCm); // idx == count() : ajout
+    bool removePoint(size_t idx);
+    size_t count() const { return count_; }
+    const CalibPoint &point(size_t idx) const { return points_[idx]; }
+
+    void setModel(CalibModel model, uint8_t polyDegree);
+    CalibModel model() const { return model_; }
+    uint8_t polyDegree() const { return polyDegree_; }
+
+    bool build(float minCm, float maxCm);
+    bool valid() const { return valid_; }
+    float lutMinCm() const { return lutMin_; }
+    float lutMaxCm() const { return lutMax_; }
+
+    // Conversion rapide (LUT), repli sur le modèle hors plage. NAN si invalide.
+    float evaluate(float x) const;
+    // Évaluation directe du modèle ajusté (construction de la LUT, tests)
+    float evaluateModel(float x) const;
+
+    // Blob NVS compact : [version, modèle, degré, n] + n x (mesuré, hauteur)
+    size_t serialize(uint8_t *buf, size_t len) const;
+    bool deserialize(const uint8_t *buf, size_t len);
+    static constexpr size_t blobSize(size_t points) { return 4 + points * sizeof(CalibPoint); }
+
+    static const char *modelName(CalibModel model);
+    static bool parseModel(const char *name, CalibModel &out);
+
+private:
+    bool fitLinearOrSpline();
+    bool fitPoly();
+
+    CalibPoint points_[CALIB_MAX_POINTS] = {};
+    uint8_t count_ = 0;
+    CalibModel model_ = CalibModel::Poly;
+    uint8_t polyDegree_ = 2;
+
+    // Ajustement : noeuds triés (doublons de mesure fusionnés) et pentes
+    float knotX_[CALIB_MAX_POINTS] = {};
+    float knotY_[CALIB_MAX_POINTS] = {};
+    float slope_[CALIB_MAX_POINTS] = {};
+    uint8_t knots_ = 0;
+    double coef_[4] = {}; // Poly : c0 + c1 u + c2 u^2 + c3 u^3, u = x * polyScale_
+    double polyScale_ = 1.0;
+    uint8_t degree_ = 0;
+
+    float lut_[CALIB_LUT_SIZE] = {};
+    float lutMin_ = 0.0f, lutMax_ = 0.0f, lutInvStep_ = 0.0f;
+    bool valid_ = false;
+};
+
+using CalibrationPtr = std::shared_ptr<const CalibrationTable>;
@@ -3,6 +3,5 @@
 
 std::atomic<uint32_t> interactiveLastTouchMs;
 
-std::mutex distMutex;
 std::mutex mqttMutex;
 std::mutex displayMutex;
@@ -3,38 +3,39 @@
 #include <mutex>
 #include <atomic>
 
-// ---------- DEBUG ----------
-#define DEBUG true
-#define DEBUG_PRINT(x)     \
-    if (DEBUG)             \
-    {                      \
-        Serial.println(x); \
-    }
-#define DEBUG_PRINTF(...)           \
-    if (DEBUG)                      \
-    {                               \
-        Serial.printf(__VA_ARGS__); \
-    }
-
-extern std::mutex distMutex;
 extern std::mutex mqttMutex;
 extern std::mutex displayMutex;
 
-// ---------- Pins ----------
-const int trigPin = 9;
-const int echoPin = 8;
+// ---------- Capteurs ----------
+// Nombre de JSN-SR04T câblés (option de compilation, 1..SENSOR_CHANNELS_MAX)
+#ifndef SENSOR_CHANNELS
+#define SENSOR_CHANNELS 1
+#endif
+#define SENSOR_CHANNELS_MAX 3
+static_assert(SENSOR_CHANNELS >= 1 && SENSOR_CHANNELS <= SENSOR_CHANNELS_MAX, "SENSOR_CHANNELS : 1..3");
+
+// Broches par canal : port B (câblage historique), port C, port A
+struct SensorPins
+{
+    int trig;
+    int echo;
+};
+const SensorPins sensorPins[SENSOR_CHANNELS_MAX] = {{9, 8}, {17, 18}, {2, 1}};
 
 // ---------- Timing ----------
 const int SENSOR_PERIOD_MS = 200;
-const int DISPLAY_PERIOD_MS = 300;
+const int DISPLAY_STATUS_PERIOD_MS = 2000; // ligne de statut Wi-Fi, hors nouvelles mesures
+const uint32_t DISPLAY_CHANNEL_PERIOD_MS = 4000; // rotation du canal affiché (SENSOR_CHANNELS > 1)
+const uint32_t ECHO_TIMEOUT_US = 30000;
+// Écart minimal entre les déclenchements de deux capteurs différents :
+// fenêtre d'écho complète + extinction des réflexions multiples
+const uint32_t SENSOR_STAGGER_US = ECHO_TIMEOUT_US + 3000;
 extern std::atomic<uint32_t> interactiveLastTouchMs;
 
-extern float lastMeasuredCm;
-extern float lastEstimatedHeight;
-extern unsigned long lastDurationUs;
-
-extern float cuveVide;
-extern float cuvePleine;
+// Niveaux de cuve par canal : écrits par le web, lus par l'affichage / JSON
+extern std::atomic<float> cuveVideCh[SENSOR_CHANNELS];
+extern std::atomic<float> cuvePleineCh[SENSOR_CHANNELS];
+// Canal 0
+extern std::atomic<float> &cuveVide;
+extern std::atomic<float> &cuvePleine;
 
-extern float calib_m[3];
-extern float calib_h[3];
@@ -1,434 +1,1225 @@
 #include "config_manager.h"
-#include <Preferences.h>
-#include <ArduinoJson.h>
+#include <math.h>
+#include <stddef.h>
+#include "tank_geometry.h"
+#include "crc32.h"
+#include "json_writer.h"
+#include "logger.h"
+#include "hal/hal_kv.h"
+#include "hal/hal_time.h"
+#include "rtc_config_cache.h"
 
-ConfigManager &ConfigManager::instance()
+/**
+ * Stockage : un seul blob NVS "cfg_blob" dans l'espace "config".
+ *   en-tête { magic "CFG1", version, longueur, CRC32 } + champs sérialisés
+ *   dans l'ordre de kFields (chaînes : longueur u8 + octets, sans NUL).
+ * Ajouter un champ EN FIN de table ne change pas la version : un blob plus
+ * court charge son préfixe, les nouveaux champs gardent leur défaut. Un
+ * changement incompatible (type, ordre) incrémente CONFIG_BLOB_VERSION.
+ * L'ancien format (une clé NVS par champ) est migré au premier démarrage.
+ */
+#define CONFIG_NS "config"
+#define CONFIG_BLOB_KEY "cfg_blob"
+#define CONFIG_BLOB_MAGIC 0x31474643UL // "CFG1"
+#define CONFIG_BLOB_VERSION 1
+
+// Écriture différée : attente de calme après la dernière modification,
+// bornée depuis la première pour qu'une rafale continue finisse écrite
+#define CONFIG_SAVE_DEBOUNCE_MS 2000
+#define CONFIG_SAVE_MAX_DELAY_MS 10000
+#define CONFIG_SAVE_POLL_MS 200
+
+struct ConfigBlobHeader
 {
-    static ConfigManager mgr;
-    return mgr;
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length; // octets de charge utile après l'en-tête
+    uint32_t crc;    // CRC32 de la charge utile
+};
+
+// Borne haute : une chaîne encodée (1 + strlen) tient dans son tableau
+#define CONFIG_BLOB_MAX (sizeof(ConfigBlobHeader) + sizeof(AppConfig))
+
+enum class FieldType : uint8_t
+{
+    Str,
+    Bool,
+    U8,
+    U16,
+    U32,
+    F32,
+    Shape // uint8_t, exposé en JSON par son nom ("vcyl", ...)
+};
+
+#define FIELD_SECRET 0x01   // masqué dans le JSON, ignoré si vide ou "*****"
+#define FIELD_READONLY 0x02 // exporté mais non modifiable par l'API
+#define FIELD_NO_PROFILE 0x04 // forme "profile" refusée (canal sans table de profil)
+
+struct ConfigField
+{
+    const char *key;    // clé JSON (/api/config)
+    const char *legacy; // clé NVS de l'ancien format par champ
+    FieldType type;
+    uint8_t flags;
+    uint16_t offset;
+    uint16_t size;
+    float def; // valeur par défaut des champs numériques
+};
+
+#define CFG_FIELD(member, legacy, type, flags, def) \
+    {#member, legacy, FieldType::type, flags, offsetof(AppConfig, member), sizeof(((AppConfig *)0)->member), def}
+#define CFG_FIELD_AT(key, member, legacy, type, flags, def) \
+    {key, legacy, FieldType::type, flags, offsetof(AppConfig, member), sizeof(((AppConfig *)0)->member), def}
+
+// Géométrie du canal n >= 1 : clés "chN_tank_*"
+#define CFG_CHANNEL_FIELDS(n)                                                                           \
+    CFG_FIELD_AT("ch" #n "_tank_shape", ch_tank[n - 1].shape, "c" #n "_shape", Shape, FIELD_NO_PROFILE, 0), \
+    CFG_FIELD_AT("ch" #n "_tank_diameter_cm", ch_tank[n - 1].diameter_cm, "c" #n "_diam", F32, 0, 100.0f), \
+    CFG_FIELD_AT("ch" #n "_tank_length_cm", ch_tank[n - 1].length_cm, "c" #n "_len", F32, 0, 200.0f),      \
+    CFG_FIELD_AT("ch" #n "_tank_width_cm", ch_tank[n - 1].width_cm, "c" #n "_wid", F32, 0, 100.0f)
+
+// Liste unique des champs : chargement, sauvegarde, migration et JSON
+static const ConfigField kFields[] = {
+    // Wi-Fi
+    CFG_FIELD(wifi_ssid, "wifi_ssid", Str, 0, 0),
+    CFG_FIELD(wifi_pass, "wifi_pass", Str, FIELD_SECRET, 0),
+
+    // MQTT
+    CFG_FIELD(mqtt_enabled, "mqtt_en", Bool, 0, 0),
+    CFG_FIELD(mqtt_host, "mqtt_host", Str, 0, 0),
+    CFG_FIELD(mqtt_port, "mqtt_port", U16, 0, 1883),
+    CFG_FIELD(mqtt_user, "mqtt_user", Str, 0, 0),
+    CFG_FIELD(mqtt_pass, "mqtt_pass", Str, FIELD_SECRET, 0),
+    CFG_FIELD(mqtt_topic, "mqtt_topic", Str, 0, 0),
+    CFG_FIELD(mqtt_diag_s, "mqtt_diag_s", U32, 0, 0),
+
+    // Mesure
+    CFG_FIELD(measure_interval_ms, "meas_int_ms", U32, 0, 1000),
+    CFG_FIELD(measure_interval_max_ms, "meas_max_ms", U32, 0, 1500),
+    CFG_FIELD(adaptive_rate_cm_min, "adapt_rate", F32, 0, 1.0f),
+    CFG_FIELD(measure_offset_cm, "meas_off_cm", F32, 0, 0.0f),
+
+    // Stabilisation / filtre
+    CFG_FIELD(kalman_q, "kf_q", F32, 0, 1e-9f),
+    CFG_FIELD(kalman_r_cm, "kf_r_cm", F32, 0, 0.5f),
+    CFG_FIELD(median_n, "median_n", U16, 0, 5),
+    CFG_FIELD(median_delay_ms, "median_delay_ms", U16, 0, 50),
+    CFG_FIELD(filter_min_cm, "f_min_cm", F32, 0, 2.0f),
+    CFG_FIELD(filter_max_cm, "f_max_cm", F32, 0, 400.0f),
+
+    // Divers
+    CFG_FIELD(device_name, "dev_name", Str, 0, 0),
+    CFG_FIELD(interactive_timeout_ms, "int_to_ms", U32, 0, 600000),
+    CFG_FIELD(deepsleep_interval_s, "deep_int_s", U32, 0, 30),
+
+    // Envoi groupé
+    CFG_FIELD(batch_upload_every, "batch_every", U16, 0, 10),
+    CFG_FIELD(batch_threshold_cm, "batch_thr_cm", F32, 0, 5.0f),
+
+    // Géométrie de cuve
+    CFG_FIELD(tank_shape, "tank_shape", Shape, 0, 0),
+    CFG_FIELD(tank_diameter_cm, "tank_diam_cm", F32, 0, 100.0f),
+    CFG_FIELD(tank_length_cm, "tank_len_cm", F32, 0, 200.0f),
+    CFG_FIELD(tank_width_cm, "tank_wid_cm", F32, 0, 100.0f),
+    CFG_FIELD(tank_profile, "tank_profile", Str, 0, 0),
+
+    CFG_FIELD(admin_user, "adm_user", Str, 0, 0),
+    CFG_FIELD(admin_pass, "adm_pass", Str, FIELD_SECRET, 0),
+    CFG_FIELD(app_version, "app_ver", Str, FIELD_READONLY, 0),
+
+    // ---- Canaux supplémentaires (en fin de table : un blob d'un build à
+    // moins de canaux se charge tel quel) ----
+#if SENSOR_CHANNELS > 1
+    CFG_CHANNEL_FIELDS(1),
+#endif
+#if SENSOR_CHANNELS > 2
+    CFG_CHANNEL_FIELDS(2),
+#endif
+};
+
+static const size_t kFieldCount = sizeof(kFields) / sizeof(kFields[0]);
+
+static inline uint8_t *fieldPtr(AppConfig &c, const ConfigField &f)
+{
+    return reinterpret_cast<uint8_t *>(&c) + f.offset;
 }
 
-bool ConfigManager::begin()
+static inline const uint8_t *fieldPtr(const AppConfig &c, const ConfigField &f)
+{
+    return reinterpret_cast<const uint8_t *>(&c) + f.offset;
+}
+
+static void setFieldDefault(AppConfig &c, const ConfigField &f)
 {
-    Serial.println("[ConfigManager] Initialisation...");
+    uint8_t *p = fieldPtr(c, f);
+    switch (f.type)
+    {
+    case FieldType::Str:
+        memset(p, 0, f.size);
+        break;
+    case FieldType::Bool:
+        *reinterpret_cast<bool *>(p) = f.def != 0.0f;
+        break;
+    case FieldType::U8:
+    case FieldType::Shape:
+        *p = (uint8_t)f.def;
+        break;
+    case FieldType::U16:
+        *reinterpret_cast<uint16_t *>(p) = (uint16_t)f.def;
+        break;
+    case FieldType::U32:
+        *reinterpret_cast<uint32_t *>(p) = (uint32_t)f.def;
+        break;
+    case FieldType::F32:
+        *reinterpret_cast<float *>(p) = f.def;
+        break;
+    }
+}
+
+static void setDefaults(AppConfig &c)
+{
+    memset(&c, 0, sizeof(c));
+    for (size_t i = 0; i < kFieldCount; i++)
+        setFieldDefault(c, kFields[i]);
+}
 
-    Preferences prefs;
-    if (!prefs.begin("config", true))
+static bool fieldEquals(const AppConfig &a, const AppConfig &b, const ConfigField &f)
+{
+    if (f.type == FieldType::Str) // octets après le NUL sans importance
+        return strncmp((const char *)fieldPtr(a, f), (const char *)fieldPtr(b, f), f.size) == 0;
+    return memcmp(fieldPtr(a, f), fieldPtr(b, f), f.size) == 0;
+}
+
+// Sérialise les champs dans out ; retourne la longueur totale (en-tête compris)
+static size_t encodeBlob(const AppConfig &c, uint8_t *out, size_t cap)
+{
+    size_t n = sizeof(ConfigBlobHeader);
+    for (size_t i = 0; i < kFieldCount; i++)
     {
-        Serial.println("[ConfigManager] Erreur: impossible d’ouvrir les preferences en lecture.");
+        const ConfigField &f = kFields[i];
+        const uint8_t *p = fieldPtr(c, f);
+        if (f.type == FieldType::Str)
+        {
+            const size_t len = strnlen((const char *)p, f.size - 1);
+            if (n + 1 + len > cap)
+                return 0;
+            out[n++] = (uint8_t)len;
+            memcpy(out + n, p, len);
+            n += len;
+        }
+        else
+        {
+            if (n + f.size > cap)
+                return 0;
+            memcpy(out + n, p, f.size);
+            n += f.size;
+        }
+    }
+
+    ConfigBlobHeader h;
+    h.magic = CONFIG_BLOB_MAGIC;
+    h.version = CONFIG_BLOB_VERSION;
+    h.length = (uint16_t)(n - sizeof(ConfigBlobHeader));
+    h.crc = crc32Update(0, out + sizeof(ConfigBlobHeader), h.length);
+    memcpy(out, &h, sizeof(h));
+    return n;
+}
+
+// Relit un blob validé (magic, version, CRC) ; les champs absents d'un
+// blob plus court conservent la valeur déjà présente dans c.
+static bool decodeBlob(const uint8_t *in, size_t len, AppConfig &c)
+{
+    ConfigBlobHeader h;
+    if (len < sizeof(h))
+        return false;
+    memcpy(&h, in, sizeof(h));
+    if (h.magic != CONFIG_BLOB_MAGIC || h.version != CONFIG_BLOB_VERSION ||
+        sizeof(h) + h.length != len)
         return false;
+    const uint8_t *p = in + sizeof(h);
+    if (crc32Update(0, p, h.length) != h.crc)
+        return false;
+
+    AppConfig tmp = c;
+    size_t pos = 0;
+    for (size_t i = 0; i < kFieldCount && pos < h.length; i++)
+    {
+        const ConfigField &f = kFields[i];
+        uint8_t *dst = fieldPtr(tmp, f);
+        if (f.type == FieldType::Str)
+        {
+            const size_t sl = p[pos++];
+            if (sl >= f.size || pos + sl > h.length)
+                return false;
+            memcpy(dst, p + pos, sl);
+            memset(dst + sl, 0, f.size - sl);
+            pos += sl;
+        }
+        else
+        {
+            if (pos + f.size > h.length)
+                return false;
+            memcpy(dst, p + pos, f.size);
+            pos += f.size;
+        }
     }
+    c = tmp;
+    return true;
+}
 
-    bool exists = prefs.isKey("mqtt_host") || prefs.isKey("device_name") || prefs.isKey("wifi_ssid");
-    prefs.end();
+// Lecture d'un champ dans l'ancien format (une clé NVS par champ)
+static void readLegacyField(KvStore &prefs, AppConfig &c, const ConfigField &f)
+{
+    if (!prefs.isKey(f.legacy))
+        return; // garde la valeur par défaut, comme l'ancien chargement
+    uint8_t *p = fieldPtr(c, f);
+    switch (f.type)
+    {
+    case FieldType::Str:
+        prefs.getString(f.legacy, (char *)p, f.size);
+        p[f.size - 1] = 0;
+        break;
+    case FieldType::Bool:
+        *reinterpret_cast<bool *>(p) = prefs.getBool(f.legacy, false);
+        break;
+    case FieldType::U8:
+    case FieldType::Shape:
+        *p = prefs.getUChar(f.legacy, *p);
+        break;
+    case FieldType::U16:
+        *reinterpret_cast<uint16_t *>(p) = prefs.getUShort(f.legacy, *reinterpret_cast<uint16_t *>(p));
+        break;
+    case FieldType::U32:
+        *reinterpret_cast<uint32_t *>(p) = prefs.getUInt(f.legacy, *reinterpret_cast<uint32_t *>(p));
+        break;
+    case FieldType::F32:
+        *reinterpret_cast<float *>(p) = prefs.getFloat(f.legacy, *reinterpret_cast<float *>(p));
+        break;
+    }
+}
 
-    if (!exists)
+static void fieldToJson(JsonWriter &w, const AppConfig &c, const ConfigField &f)
+{
+    w.key(f.key);
+    if (f.flags & FIELD_SECRET)
+    {
+        w.value("*****"); // masqué
+        return;
+    }
+    const uint8_t *p = fieldPtr(c, f);
+    switch (f.type)
     {
-        Serial.println("[ConfigManager] Aucune configuration trouvée. Application des valeurs par défaut...");
-        applyDefaultsIfNeeded();
-        save();
+    case FieldType::Str:
+        w.value((const char *)p);
+        break;
+    case FieldType::Bool:
+        w.value(*reinterpret_cast<const bool *>(p));
+        break;
+    case FieldType::U8:
+        w.value(*p);
+        break;
+    case FieldType::Shape:
+        w.value(TankModel::shapeName((TankShape)*p));
+        break;
+    case FieldType::U16:
+        w.value(*reinterpret_cast<const uint16_t *>(p));
+        break;
+    case FieldType::U32:
+        w.value(*reinterpret_cast<const uint32_t *>(p));
+        break;
+    case FieldType::F32:
+        w.value(*reinterpret_cast<const float *>(p));
+        break;
+    }
+}
+
+// ---- Analyse incrémentale de POST /api/config ----
+static_assert(sizeof(kFields) / sizeof(kFields[0]) <= 64, "touched_ : un bit par champ");
+
+#define CONFIG_NUMBER_MAX 32 // caractères d'un nombre JSON
+
+static bool isJsonSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+ConfigUpdate::ConfigUpdate()
+    : touched_(0), bytes_(0), err_(nullptr), errField_(nullptr), field_(-1),
+      state_(State::Start), keyLen_(0), keyOverflow_(false), tokLen_(0),
+      uni_(0), uniDigits_(0), highSurrogate_(0)
+{
+    staged_ = *ConfigManager::instance().snapshot();
+    key_[0] = '\0';
+    tok_[0] = '\0';
+}
+
+bool ConfigUpdate::fail(const char *msg)
+{
+    if (state_ != State::Error)
+    {
+        err_ = msg;
+        state_ = State::Error;
+    }
+    return false;
+}
+
+bool ConfigUpdate::feed(const uint8_t *data, size_t len)
+{
+    if (state_ == State::Error)
+        return false;
+    bytes_ += len;
+    if (bytes_ > CONFIG_BODY_MAX)
+        return fail("payload too large");
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!step((char)data[i]))
+            return false;
+    }
+    return true;
+}
+
+// Fin de clé : résout le champ une seule fois (lecture seule = ignoré)
+bool ConfigUpdate::endKey()
+{
+    key_[keyLen_] = '\0';
+    field_ = -1;
+    tokLen_ = 0;
+    if (keyOverflow_)
+        return true;
+    for (size_t i = 0; i < kFieldCount; i++)
+    {
+        if (strcmp(kFields[i].key, key_) == 0)
+        {
+            if (!(kFields[i].flags & FIELD_READONLY))
+                field_ = (int8_t)i;
+            break;
+        }
+    }
+    return true;
+}
+
+// Octet d'une valeur chaîne : borné par la taille du champ visé
+bool ConfigUpdate::putChar(char c)
+{
+    if (field_ < 0)
+        return true; // valeur ignorée : ni copiée ni bornée
+    const ConfigField &f = kFields[field_];
+    const size_t cap = f.type == FieldType::Str ? f.size - 1 : CONFIG_TOKEN_MAX;
+    if (tokLen_ >= cap)
+    {
+        errField_ = f.key;
+        return fail("string too long");
+    }
+    tok_[tokLen_++] = c;
+    return true;
+}
+
+bool ConfigUpdate::putCodePoint(uint32_t cp)
+{
+    if (cp < 0x80)
+        return putChar((char)cp);
+    if (cp < 0x800)
+        return putChar((char)(0xC0 | (cp >> 6))) && putChar((char)(0x80 | (cp & 0x3F)));
+    if (cp < 0x10000)
+        return putChar((char)(0xE0 | (cp >> 12))) && putChar((char)(0x80 | ((cp >> 6) & 0x3F))) &&
+               putChar((char)(0x80 | (cp & 0x3F)));
+    return putChar((char)(0xF0 | (cp >> 18))) && putChar((char)(0x80 | ((cp >> 12) & 0x3F))) &&
+           putChar((char)(0x80 | ((cp >> 6) & 0x3F))) && putChar((char)(0x80 | (cp & 0x3F)));
+}
+
+// Valeur complète : contrôle du type et des bornes, puis copie dans staged_
+bool ConfigUpdate::commitValue(Kind kind)
+{
+    tok_[tokLen_] = '\0';
+    const int idx = field_;
+    field_ = -1;
+    if (idx < 0 || kind == Kind::Null)
+        return true;
+
+    const ConfigField &f = kFields[idx];
+    uint8_t *p = fieldPtr(staged_, f);
+    errField_ = f.key;
+    double d = 0.0;
+    if (kind == Kind::Number)
+    {
+        char *end = nullptr;
+        d = strtod(tok_, &end);
+        if (tokLen_ == 0 || *end != '\0' || !isfinite(d))
+            return fail("invalid number");
+    }
+
+    switch (f.type)
+    {
+    case FieldType::Str:
+        if (kind != Kind::String)
+            return fail("string expected");
+        if ((f.flags & FIELD_SECRET) && (tokLen_ == 0 || strcmp(tok_, "*****") == 0))
+            break; // secret masqué renvoyé tel quel : on garde l'actuel
+        memcpy(p, tok_, tokLen_ + 1);
+        touched_ |= 1ULL << idx;
+        break;
+    case FieldType::Bool:
+        if (kind != Kind::Bool)
+            return fail("boolean expected");
+        *reinterpret_cast<bool *>(p) = tok_[0] == 't';
+        touched_ |= 1ULL << idx;
+        break;
+    case FieldType::Shape:
+    {
+        TankShape shape;
+        if (kind != Kind::String || !TankModel::parseShape(tok_, shape))
+            return fail("unknown tank shape");
+        if ((f.flags & FIELD_NO_PROFILE) && shape == TankShape::Profile)
+            return fail("profile shape not supported");
+        *p = (uint8_t)shape;
+        touched_ |= 1ULL << idx;
+        break;
+    }
+    case FieldType::U8:
+    case FieldType::U16:
+    case FieldType::U32:
+    {
+        if (kind != Kind::Number)
+            return fail("integer expected");
+        const double max = f.type == FieldType::U8 ? 255.0 : f.type == FieldType::U16 ? 65535.0 : 4294967295.0;
+        if (d != floor(d) || d < 0.0 || d > max)
+            return fail("integer out of range");
+        if (f.type == FieldType::U8)
+            *p = (uint8_t)d;
+        else if (f.type == FieldType::U16)
+            *reinterpret_cast<uint16_t *>(p) = (uint16_t)d;
+        else
+            *reinterpret_cast<uint32_t *>(p) = (uint32_t)d;
+        touched_ |= 1ULL << idx;
+        break;
+    }
+    case FieldType::F32:
+        if (kind != Kind::Number)
+            return fail("number expected");
+        *reinterpret_cast<float *>(p) = (float)d;
+        touched_ |= 1ULL << idx;
+        break;
+    }
+    errField_ = nullptr;
+    return true;
+}
+
+bool ConfigUpdate::step(char c)
+{
+    switch (state_)
+    {
+    case State::Start:
+        if (isJsonSpace(c))
+            return true;
+        if (c != '{')
+            return fail("object expected");
+        state_ = State::KeyOrEnd;
+        return true;
+
+    case State::KeyOrEnd:
+    case State::NextKey:
+        if (isJsonSpace(c))
+            return true;
+        if (c == '}' && state_ == State::KeyOrEnd)
+        {
+            state_ = State::Done;
+            return true;
+        }
+        if (c != '"')
+            return fail("key expected");
+        keyLen_ = 0;
+        keyOverflow_ = false;
+        state_ = State::Key;
+        return true;
+
+    case State::Key:
+    case State::KeyEsc:
+        if ((unsigned char)c < 0x20)
+            return fail("control character in key");
+        if (state_ == State::Key && c == '\\')
+        {
+            keyOverflow_ = true; // aucune clé connue n'est échappée
+            state_ = State::KeyEsc;
+            return true;
+        }
+        if (state_ == State::Key && c == '"')
+        {
+            state_ = State::Colon;
+            return endKey();
+        }
+        state_ = State::Key;
+        if (keyLen_ < CONFIG_KEY_MAX)
+            key_[keyLen_++] = c;
+        else
+            keyOverflow_ = true;
         return true;
+
+    case State::Colon:
+        if (isJsonSpace(c))
+            return true;
+        if (c != ':')
+            return fail("':' expected");
+        state_ = State::Value;
+        return true;
+
+    case State::Value:
+        if (isJsonSpace(c))
+            return true;
+        tokLen_ = 0;
+        if (c == '"')
+        {
+            highSurrogate_ = 0;
+            state_ = State::Str;
+            return true;
+        }
+        if (c == '-' || (c >= '0' && c <= '9'))
+        {
+            state_ = State::Number;
+            tok_[tokLen_++] = c;
+            return true;
+        }
+        if (c >= 'a' && c <= 'z')
+        {
+            state_ = State::Literal;
+            tok_[tokLen_++] = c;
+            return true;
+        }
+        if (c == '{' || c == '[')
+        {
+            if (field_ >= 0)
+                errField_ = kFields[field_].key;
+            return fail("nested value not supported");
+        }
+        return fail("value expected");
+
+    case State::Str:
+        if (highSurrogate_ && c != '\\')
+            return fail("unpaired surrogate");
+        if (c == '\\')
+        {
+            state_ = State::StrEsc;
+            return true;
+        }
+        if (c == '"')
+        {
+            state_ = State::AfterValue;
+            return commitValue(Kind::String);
+        }
+        if ((unsigned char)c < 0x20)
+            return fail("control character in string");
+        return putChar(c);
+
+    case State::StrEsc:
+        if (highSurrogate_ && c != 'u')
+            return fail("unpaired surrogate");
+        state_ = State::Str;
+        switch (c)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            return putChar(c);
+        case 'b':
+            return putChar('\b');
+        case 'f':
+            return putChar('\f');
+        case 'n':
+            return putChar('\n');
+        case 'r':
+            return putChar('\r');
+        case 't':
+            return putChar('\t');
+        case 'u':
+            uni_ = 0;
+            uniDigits_ = 0;
+            state_ = State::StrUni;
+            return true;
+        default:
+            return fail("invalid escape");
+        }
+
+    case State::StrUni:
+    {
+        const int h = hexDigit(c);
+        if (h < 0)
+            return fail("invalid escape");
+        uni_ = (uint16_t)((uni_ << 4) | h);
+        if (++uniDigits_ < 4)
+            return true;
+        state_ = State::Str;
+        if (highSurrogate_)
+        {
+            if (uni_ < 0xDC00 || uni_ > 0xDFFF)
+                return fail("unpaired surrogate");
+            const uint32_t cp = 0x10000 + (((uint32_t)highSurrogate_ - 0xD800) << 10) + (uni_ - 0xDC00);
+            highSurrogate_ = 0;
+            return putCodePoint(cp);
+        }
+        if (uni_ >= 0xD800 && uni_ <= 0xDBFF)
+        {
+            highSurrogate_ = uni_;
+            return true;
+        }
+        if (uni_ >= 0xDC00 && uni_ <= 0xDFFF)
+            return fail("unpaired surrogate");
+        return putCodePoint(uni_);
+    }
+
+    case State::Number:
+        if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+        {
+            if (tokLen_ >= CONFIG_NUMBER_MAX)
+                return fail("invalid number");
+            tok_[tokLen_++] = c;
+            return true;
+        }
+        state_ = State::AfterValue;
+        return commitValue(Kind::Number) && step(c);
+
+    case State::Literal:
+        if (c >= 'a' && c <= 'z')
+        {
+            if (tokLen_ >= 5)
+                return fail("invalid literal");
+            tok_[tokLen_++] = c;
+            return true;
+        }
+        tok_[tokLen_] = '\0';
+        state_ = State::AfterValue;
+        if (strcmp(tok_, "null") == 0)
+            return commitValue(Kind::Null) && step(c);
+        if (strcmp(tok_, "true") == 0 || strcmp(tok_, "false") == 0)
+            return commitValue(Kind::Bool) && step(c);
+        return fail("invalid literal");
+
+    case State::AfterValue:
+        if (isJsonSpace(c))
+            return true;
+        if (c == ',')
+        {
+            state_ = State::NextKey;
+            return true;
+        }
+        if (c == '}')
+        {
+            state_ = State::Done;
+            return true;
+        }
+        return fail("',' or '}' expected");
+
+    case State::Done:
+        if (isJsonSpace(c))
+            return true;
+        return fail("trailing data");
+
+    case State::Error:
+        return false;
+    }
+    return false;
+}
+
+ConfigManager &ConfigManager::instance()
+{
+    static ConfigManager mgr;
+    return mgr;
+}
+
+bool ConfigManager::begin()
+{
+    LOG_I(Config, "Initialisation...");
+
+    const bool loaded = loadBlob();
+    const bool migrated = !loaded && migrateLegacy();
+    if (!loaded && !migrated)
+    {
+        LOG_I(Config, "Aucune configuration trouvée. Application des valeurs par défaut...");
+        std::lock_guard<std::mutex> lk(mutex_);
+        setDefaults(config_);
     }
 
-    bool ok = loadFromPreferences();
     applyDefaultsIfNeeded();
-    Serial.printf("[ConfigManager] Chargement %s\n", ok ? "réussi" : "échoué");
-    return ok;
+    // Premier démarrage, migration, ou valeurs corrigées par applyDefaultsIfNeeded
+    if (save() && migrated)
+        removeLegacyKeys(); // le blob fait foi dès qu'il est écrit
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        logSummaryLocked();
+    }
+    return true;
 }
 
 void ConfigManager::applyDefaultsIfNeeded()
 {
     std::lock_guard<std::mutex> lk(mutex_);
-    Serial.println("[ConfigManager] Vérification des valeurs par défaut...");
+    LOG_D(Config, "Vérification des valeurs par défaut...");
 
     // --- Divers ---
     if (config_.interactive_timeout_ms == 0)
     {
         config_.interactive_timeout_ms = 600000; // 10 min
-        Serial.println("  -> interactive_timeout_ms défini à 600000");
+        LOG_I(Config, "  -> interactive_timeout_ms défini à 600000");
     }
     if (config_.deepsleep_interval_s == 0)
     {
         config_.deepsleep_interval_s = 30;
-        Serial.println("  -> deepsleep_interval_s défini à 30");
+        LOG_I(Config, "  -> deepsleep_interval_s défini à 30");
     }
     if (config_.measure_interval_ms < 50)
     {
         config_.measure_interval_ms = 1000;
-        Serial.println("  -> measure_interval_ms défini à 1000");
+        LOG_I(Config, "  -> measure_interval_ms défini à 1000");
     }
     if (config_.mqtt_port == 0)
     {
         config_.mqtt_port = 1883;
-        Serial.println("  -> mqtt_port défini à 1883");
+        LOG_I(Config, "  -> mqtt_port défini à 1883");
     }
     if (strlen(config_.mqtt_host) == 0)
     {
         strcpy(config_.mqtt_host, "broker.local");
-        Serial.println("  -> mqtt_host défini à broker.local");
+        LOG_I(Config, "  -> mqtt_host défini à broker.local");
     }
     if (strlen(config_.device_name) == 0)
     {
         strcpy(config_.device_name, "ESP32-Device");
-        Serial.println("  -> device_name défini à ESP32-Device");
+        LOG_I(Config, "  -> device_name défini à ESP32-Device");
     }
     if (strlen(config_.app_version) == 0)
     {
         strcpy(config_.app_version, "1.0.0");
-        Serial.println("  -> app_version défini à 1.0.0");
+        LOG_I(Config, "  -> app_version défini à 1.0.0");
     }
     if (strlen(config_.admin_user) == 0)
     {
         strcpy(config_.admin_user, "admin");
-        Serial.println("  -> admin_user défini à 'admin' (à changer !)");
+        LOG_I(Config, "  -> admin_user défini à 'admin' (à changer !)");
     }
     if (strlen(config_.admin_pass) == 0)
     {
         strcpy(config_.admin_pass, "admin");
-        Serial.println("  -> admin_pass défini à 'admin' (à changer !)");
+        LOG_I(Config, "  -> admin_pass défini à 'admin' (à changer !)");
+    }
+
+    if (config_.measure_interval_max_ms == 0)
+    {
+        config_.measure_interval_max_ms = 1500;
+        LOG_I(Config, "  -> measure_interval_max_ms défini à 1500");
+    }
+    if (config_.measure_interval_max_ms < config_.measure_interval_ms)
+    {
+        config_.measure_interval_max_ms = config_.measure_interval_ms;
+        LOG_I(Config, "  -> measure_interval_max_ms aligné sur measure_interval_ms");
+    }
+    if (config_.adaptive_rate_cm_min <= 0.0f)
+    {
+        config_.adaptive_rate_cm_min = 1.0f;
+        LOG_I(Config, "  -> adaptive_rate_cm_min défini à 1.0");
     }
 
-    // NEW defaults (filtres / moyenne)
-    if (config_.avg_alpha <= 0.0f || config_.avg_alpha > 1.0f)
+    // NEW defaults (filtres)
+    if (config_.kalman_q <= 0.0f)
     {
-        config_.avg_alpha = 0.25f;
-        Serial.println("  -> avg_alpha défini à 0.25");
+        config_.kalman_q = 1e-9f;
+        LOG_I(Config, "  -> kalman_q défini à 1e-9");
+    }
+    if (config_.kalman_r_cm <= 0.0f)
+    {
+        config_.kalman_r_cm = 0.5f;
+        LOG_I(Config, "  -> kalman_r_cm défini à 0.5");
     }
     if (config_.median_n == 0 || config_.median_n > 15)
     {
         config_.median_n = 5;
-        Serial.println("  -> median_n défini à 5");
+        LOG_I(Config, "  -> median_n défini à 5");
     }
     if (config_.median_delay_ms > 1000)
     {
         config_.median_delay_ms = 50;
-        Serial.println("  -> median_delay_ms défini à 50");
+        LOG_I(Config, "  -> median_delay_ms défini à 50");
     }
     if (config_.filter_min_cm <= 0.0f)
     {
         config_.filter_min_cm = 2.0f;
-        Serial.println("  -> filter_min_cm défini à 2.0");
+        LOG_I(Config, "  -> filter_min_cm défini à 2.0");
     }
     if (config_.filter_max_cm < config_.filter_min_cm)
     {
         config_.filter_max_cm = 400.0f;
-        Serial.println("  -> filter_max_cm défini à 400.0");
+        LOG_I(Config, "  -> filter_max_cm défini à 400.0");
     }
 
+    // Envoi groupé
+    if (config_.batch_upload_every == 0 || config_.batch_upload_every > 48)
+    {
+        config_.batch_upload_every = 10;
+        LOG_I(Config, "  -> batch_upload_every défini à 10");
+    }
+    if (config_.batch_threshold_cm < 0.0f)
+    {
+        config_.batch_threshold_cm = 5.0f;
+        LOG_I(Config, "  -> batch_threshold_cm défini à 5.0");
+    }
+
+    // Géométrie de cuve
+    if (config_.tank_shape > (uint8_t)TankShape::Profile)
+    {
+        config_.tank_shape = (uint8_t)TankShape::VerticalCylinder;
+        LOG_I(Config, "  -> tank_shape défini à vcyl");
+    }
+    if (config_.tank_diameter_cm <= 0.0f)
+    {
+        config_.tank_diameter_cm = 100.0f;
+        LOG_I(Config, "  -> tank_diameter_cm défini à 100.0");
+    }
+    if (config_.tank_length_cm <= 0.0f)
+    {
+        config_.tank_length_cm = 200.0f;
+        LOG_I(Config, "  -> tank_length_cm défini à 200.0");
+    }
+    if (config_.tank_width_cm <= 0.0f)
+    {
+        config_.tank_width_cm = 100.0f;
+        LOG_I(Config, "  -> tank_width_cm défini à 100.0");
+    }
+#if SENSOR_CHANNELS > 1
+    for (size_t i = 0; i < SENSOR_CHANNELS - 1; i++)
+    {
+        ChannelTankConfig &t = config_.ch_tank[i];
+        if (t.shape >= (uint8_t)TankShape::Profile)
+        {
+            t.shape = (uint8_t)TankShape::VerticalCylinder;
+            LOG_I(Config, "  -> ch%u_tank_shape défini à vcyl", (unsigned)(i + 1));
+        }
+        if (t.diameter_cm <= 0.0f)
+            t.diameter_cm = 100.0f;
+        if (t.length_cm <= 0.0f)
+            t.length_cm = 200.0f;
+        if (t.width_cm <= 0.0f)
+            t.width_cm = 100.0f;
+    }
+#endif
+
     // Wi-Fi: par défaut, laissé vide => AP fallback dans le serveur web
     // (pas de SSID/PASS hardcodés)
+
+    publishLocked();
+}
+
+void ConfigManager::publishLocked()
+{
+    // RCU : nouvel instantané immuable, l'ancien vit tant qu'un lecteur le tient
+    ConfigPtr next = std::make_shared<AppConfig>(config_);
+    std::atomic_store(&current_, next);
+    generation_.fetch_add(1, std::memory_order_release);
+}
+
+ConfigPtr ConfigManager::snapshot() const
+{
+    return std::atomic_load(&current_);
 }
 
-bool ConfigManager::loadFromPreferences()
+
+bool ConfigManager::loadBlob()
 {
     std::lock_guard<std::mutex> lk(mutex_);
-    Serial.println("[ConfigManager] Chargement depuis Preferences...");
 
-    Preferences prefs;
-    if (!prefs.begin("config", true))
+    KvStore prefs;
+    if (!prefs.begin(CONFIG_NS, true))
     {
-        Serial.println("  -> Erreur: impossible d’ouvrir les preferences en lecture.");
+        LOG_E(Config, "Impossible d’ouvrir les preferences en lecture.");
         return false;
     }
+    uint8_t blob[CONFIG_BLOB_MAX];
+    const size_t len = prefs.getBytesLength(CONFIG_BLOB_KEY);
+    const bool read = len > 0 && len <= sizeof(blob) && prefs.getBytes(CONFIG_BLOB_KEY, blob, len) == len;
+    prefs.end();
+    if (!read)
+        return false;
 
-    // Wi-Fi
-    prefs.getString("wifi_ssid", config_.wifi_ssid, sizeof(config_.wifi_ssid));
-    prefs.getString("wifi_pass", config_.wifi_pass, sizeof(config_.wifi_pass));
-
-    // MQTT
-    config_.mqtt_enabled = prefs.getBool("mqtt_en", false);
-    prefs.getString("mqtt_host", config_.mqtt_host, sizeof(config_.mqtt_host));
-    config_.mqtt_port = prefs.getUShort("mqtt_port", 1883);
-    prefs.getString("mqtt_user", config_.mqtt_user, sizeof(config_.mqtt_user));
-    prefs.getString("mqtt_pass", config_.mqtt_pass, sizeof(config_.mqtt_pass));
-    prefs.getString("mqtt_topic", config_.mqtt_topic, sizeof(config_.mqtt_topic));
+    setDefaults(config_);
+    if (!decodeBlob(blob, len, config_))
+    {
+        LOG_W(Config, "Blob de configuration invalide (%u octets), ignoré.", (unsigned)len);
+        return false;
+    }
+    committed_ = config_;
+    committedValid_ = true;
+    LOG_I(Config, "Configuration chargée (blob v%d, %u octets)", CONFIG_BLOB_VERSION, (unsigned)len);
+    return true;
+}
 
-    // Mesure
-    config_.measure_interval_ms = prefs.getUInt("meas_int_ms", 1000);
-    config_.measure_offset_cm = prefs.getFloat("meas_off_cm", 0.0f);
+bool ConfigManager::migrateLegacy()
+{
+    std::lock_guard<std::mutex> lk(mutex_);
 
-    // NEW filtres
-    config_.avg_alpha = prefs.getFloat("avg_alpha", 0.25f);
-    config_.median_n = prefs.getUShort("median_n", 5);
-    config_.median_delay_ms = prefs.getUShort("median_delay_ms", 50);
-    config_.filter_min_cm = prefs.getFloat("f_min_cm", 2.0f);
-    config_.filter_max_cm = prefs.getFloat("f_max_cm", 400.0f);
+    KvStore prefs;
+    if (!prefs.begin(CONFIG_NS, true))
+        return false;
 
-    // Divers
-    prefs.getString("dev_name", config_.device_name, sizeof(config_.device_name));
-    config_.interactive_timeout_ms = prefs.getUInt("int_to_ms", 600000);
-    config_.deepsleep_interval_s = prefs.getUInt("deep_int_s", 30);
+    size_t found = 0;
+    setDefaults(config_);
+    for (size_t i = 0; i < kFieldCount; i++)
+    {
+        if (prefs.isKey(kFields[i].legacy))
+            found++;
+        readLegacyField(prefs, config_, kFields[i]);
+    }
+    prefs.end();
+    if (found == 0)
+        return false;
 
-    prefs.getString("adm_user", config_.admin_user, sizeof(config_.admin_user));
-    prefs.getString("adm_pass", config_.admin_pass, sizeof(config_.admin_pass));
-    prefs.getString("app_ver", config_.app_version, sizeof(config_.app_version));
+    LOG_I(Config, "Migration de l'ancien format (%u clés) vers le blob...", (unsigned)found);
+    committedValid_ = false; // force l'écriture du blob
+    return true;
+}
 
+void ConfigManager::removeLegacyKeys()
+{
+    KvStore prefs;
+    if (!prefs.begin(CONFIG_NS, false))
+        return;
+    for (size_t i = 0; i < kFieldCount; i++)
+        prefs.remove(kFields[i].legacy);
     prefs.end();
+}
 
-    Serial.printf("  -> WiFi SSID: %s (%s)\n",
+void ConfigManager::logSummaryLocked()
+{
+    LOG_I(Config, "  -> WiFi SSID: %s (%s)",
                   (strlen(config_.wifi_ssid) ? config_.wifi_ssid : "<non configuré>"),
                   (strlen(config_.wifi_pass) ? "pass défini" : "pass non défini"));
-    Serial.printf("  -> MQTT %s @ %s:%d (user=%s)\n",
+    LOG_I(Config, "  -> MQTT %s @ %s:%d (user=%s)",
                   config_.mqtt_enabled ? "activé" : "désactivé",
                   config_.mqtt_host, config_.mqtt_port, config_.mqtt_user);
-    Serial.printf("  -> Device: %s, Intervalle mesure: %lu ms, Offset: %.2f cm\n",
-                  config_.device_name, config_.measure_interval_ms, config_.measure_offset_cm);
-    Serial.printf("  -> Filtre: alpha=%.2f, N=%u, delay=%u ms, min=%.1f cm, max=%.1f cm\n",
-                  config_.avg_alpha, config_.median_n, config_.median_delay_ms,
+    LOG_I(Config, "  -> Device: %s, Intervalle mesure: %lu ms, Offset: %.2f cm",
+                  config_.device_name, (unsigned long)config_.measure_interval_ms, config_.measure_offset_cm);
+    LOG_I(Config, "  -> Période adaptative: %lu..%lu ms (seuil %.2f cm/min)",
+                  (unsigned long)config_.measure_interval_ms, (unsigned long)config_.measure_interval_max_ms,
+                  config_.adaptive_rate_cm_min);
+    LOG_I(Config, "  -> Filtre: Kalman q=%g r=%.2f cm, N=%u, delay=%u ms, min=%.1f cm, max=%.1f cm",
+                  config_.kalman_q, config_.kalman_r_cm, config_.median_n, config_.median_delay_ms,
                   config_.filter_min_cm, config_.filter_max_cm);
-    Serial.printf("  -> DeepSleep: %lu s, Timeout interactif: %lu ms\n",
+    LOG_I(Config, "  -> DeepSleep: %lu s, Timeout interactif: %lu ms",
                   (unsigned long)config_.deepsleep_interval_s,
                   (unsigned long)config_.interactive_timeout_ms);
-    return true;
+    LOG_I(Config, "  -> Envoi groupé: tous les %u réveils, seuil %.1f cm",
+                  config_.batch_upload_every, config_.batch_threshold_cm);
+    LOG_I(Config, "  -> Cuve: %s, D=%.1f L=%.1f l=%.1f cm",
+                  TankModel::shapeName((TankShape)config_.tank_shape),
+                  config_.tank_diameter_cm, config_.tank_length_cm, config_.tank_width_cm);
+#if SENSOR_CHANNELS > 1
+    for (size_t i = 0; i < SENSOR_CHANNELS - 1; i++)
+        LOG_I(Config, "  -> Cuve canal %u: %s, D=%.1f L=%.1f l=%.1f cm", (unsigned)(i + 1),
+                      TankModel::shapeName((TankShape)config_.ch_tank[i].shape), config_.ch_tank[i].diameter_cm,
+                      config_.ch_tank[i].length_cm, config_.ch_tank[i].width_cm);
+#endif
 }
 
-bool ConfigManager::save()
+void ConfigManager::restore(const AppConfig &cfg)
 {
     std::lock_guard<std::mutex> lk(mutex_);
-    Preferences prefs;
-    if (!prefs.begin("config", false))
-        return false;
-
-    Serial.println("[ConfigManager] Sauvegarde dans Preferences...");
-
-    // Wi-Fi
-    prefs.putString("wifi_ssid", config_.wifi_ssid);
-    prefs.putString("wifi_pass", config_.wifi_pass);
-
-    // MQTT
-    prefs.putBool("mqtt_en", config_.mqtt_enabled);
-    prefs.putString("mqtt_host", config_.mqtt_host);
-    prefs.putUShort("mqtt_port", config_.mqtt_port);
-    prefs.putString("mqtt_user", config_.mqtt_user);
-    prefs.putString("mqtt_pass", config_.mqtt_pass);
-    prefs.putString("mqtt_topic", config_.mqtt_topic);
+    config_ = cfg;
+    // Le cache RTC reflète la dernière version persistée
+    committed_ = cfg;
+    committedValid_ = true;
+    publishLocked();
+}
 
-    // Mesure
-    prefs.putUInt("meas_int_ms", config_.measure_interval_ms);
-    prefs.putFloat("meas_off_cm", config_.measure_offset_cm);
+int ConfigManager::countChangedFields(const AppConfig &a, const AppConfig &b)
+{
+    int n = 0;
+    for (size_t i = 0; i < kFieldCount; i++)
+    {
+        if (!fieldEquals(a, b, kFields[i]))
+            n++;
+    }
+    return n;
+}
 
-    // NEW
-    prefs.putFloat("avg_alpha", config_.avg_alpha);
-    prefs.putUShort("median_n", config_.median_n);
-    prefs.putUShort("median_delay_ms", config_.median_delay_ms);
-    prefs.putFloat("f_min_cm", config_.filter_min_cm);
-    prefs.putFloat("f_max_cm", config_.filter_max_cm);
+bool ConfigManager::save()
+{
+    // Un seul écrivain NVS ; mutex_ n'est tenu que pour la copie, les
+    // lecteurs et updateFromJson() ne sont pas bloqués pendant l'écriture
+    std::lock_guard<std::mutex> commitLk(commitMutex_);
 
-    // Divers
-    prefs.putString("dev_name", config_.device_name);
-    prefs.putUInt("int_to_ms", config_.interactive_timeout_ms);
-    prefs.putUInt("deep_int_s", config_.deepsleep_interval_s);
+    AppConfig cfg;
+    uint32_t gen;
+    int changed;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        cfg = config_;
+        gen = pendingGen_.load(std::memory_order_relaxed);
+        changed = committedValid_ ? countChangedFields(cfg, committed_) : (int)kFieldCount;
+    }
+    if (changed == 0)
+    {
+        committedGen_.store(gen, std::memory_order_release);
+        return true; // rien à écrire : pas d'usure flash
+    }
 
-    prefs.putString("adm_user", config_.admin_user);
-    prefs.putString("adm_pass", config_.admin_pass);
-    prefs.putString("app_ver", config_.app_version);
+    uint8_t blob[CONFIG_BLOB_MAX];
+    const size_t len = encodeBlob(cfg, blob, sizeof(blob));
+    if (len == 0)
+        return false;
 
+    KvStore prefs;
+    if (!prefs.begin(CONFIG_NS, false))
+        return false;
+    // Tout ou rien : un seul putBytes, NVS écrit le nouveau blob avant
+    // d'effacer l'ancien (une coupure laisse l'une ou l'autre version)
+    const bool ok = prefs.putBytes(CONFIG_BLOB_KEY, blob, len) == len;
     prefs.end();
-    Serial.println(" Configuration sauvegardée avec succès !");
+    if (!ok)
+    {
+        LOG_E(Config, "Écriture du blob de configuration échouée !");
+        return false;
+    }
+
+    rtcCacheInvalidate(); // la NVS devient la référence jusqu'à la prochaine capture
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        committed_ = cfg;
+        committedValid_ = true;
+    }
+    committedGen_.store(gen, std::memory_order_release);
+    LOG_I(Config, "Configuration sauvegardée (%d champ(s) modifié(s), %u octets)",
+                  changed, (unsigned)len);
     return true;
 }
 
-String ConfigManager::toJsonString()
+void ConfigManager::writeJson(JsonWriter &w)
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    JsonDocument doc;
-
-    // Wi-Fi
-    doc["wifi_ssid"] = config_.wifi_ssid;
-    doc["wifi_pass"] = "*****"; // masqué
-
-    // MQTT
-    doc["mqtt_enabled"] = config_.mqtt_enabled;
-    doc["mqtt_host"] = config_.mqtt_host;
-    doc["mqtt_port"] = config_.mqtt_port;
-    doc["mqtt_user"] = config_.mqtt_user;
-    doc["mqtt_pass"] = "*****"; // masqué
-    doc["mqtt_topic"] = config_.mqtt_topic;
-
-    // Mesure
-    doc["measure_interval_ms"] = config_.measure_interval_ms;
-    doc["measure_offset_cm"] = config_.measure_offset_cm;
-
-    // NEW
-    doc["avg_alpha"] = config_.avg_alpha;
-    doc["median_n"] = config_.median_n;
-    doc["median_delay_ms"] = config_.median_delay_ms;
-    doc["filter_min_cm"] = config_.filter_min_cm;
-    doc["filter_max_cm"] = config_.filter_max_cm;
-
-    // Divers
-    doc["device_name"] = config_.device_name;
-    doc["interactive_timeout_ms"] = config_.interactive_timeout_ms;
-    doc["deepsleep_interval_s"] = config_.deepsleep_interval_s;
-
-    doc["admin_user"] = config_.admin_user;
-    doc["admin_pass"] = "*****"; // masqué
-    doc["app_version"] = config_.app_version;
-
-    String s;
-    serializeJson(doc, s);
-    Serial.println("[ConfigManager] Conversion en JSON effectuée.");
-    return s;
+    const ConfigPtr cfg = snapshot();
+    w.beginObject();
+    for (size_t i = 0; i < kFieldCount; i++)
+        fieldToJson(w, *cfg, kFields[i]);
+    w.endObject();
 }
 
-bool ConfigManager::updateFromJson(const String &json)
+bool ConfigManager::updateFromJson(const char *json)
 {
-    Serial.println("[ConfigManager] Mise à jour depuis JSON...");
+    ConfigUpdate update;
+    update.feed((const uint8_t *)json, strlen(json));
+    return applyUpdate(update);
+}
 
-    JsonDocument doc;
-    auto err = deserializeJson(doc, json);
-    if (err)
+bool ConfigManager::applyUpdate(const ConfigUpdate &update)
+{
+    if (update.error() || !update.done())
     {
-        Serial.println("[ConfigManager][ERR] JSON invalide !");
+        LOG_W(Config, "JSON refusé : %s%s%s",
+                      update.error() ? update.error() : "incomplete body",
+                      update.errorField() ? " / " : "",
+                      update.errorField() ? update.errorField() : "");
         return false;
     }
 
+    // Seuls les champs reçus sont recopiés : une modification concurrente
+    // des autres champs (calibration, cuve) n'est pas écrasée
+    int applied = 0;
     {
         std::lock_guard<std::mutex> lk(mutex_);
-
-        // Wi-Fi
-        if (doc["wifi_ssid"].is<const char *>())
-            strlcpy(config_.wifi_ssid, doc["wifi_ssid"], sizeof(config_.wifi_ssid));
-        if (doc["wifi_pass"].is<const char *>())
-        {
-            const char *wp = doc["wifi_pass"];
-            if (wp && strcmp(wp, "*****") != 0 && strlen(wp) > 0)
-                strlcpy(config_.wifi_pass, wp, sizeof(config_.wifi_pass));
-        }
-
-        // MQTT
-        if (doc["mqtt_enabled"].is<bool>())
-            config_.mqtt_enabled = doc["mqtt_enabled"].as<bool>();
-        if (doc["mqtt_host"].is<const char *>())
-            strlcpy(config_.mqtt_host, doc["mqtt_host"], sizeof(config_.mqtt_host));
-        if (doc["mqtt_port"].is<uint16_t>())
-            config_.mqtt_port = doc["mqtt_port"];
-        if (doc["mqtt_user"].is<const char *>())
-            strlcpy(config_.mqtt_user, doc["mqtt_user"], sizeof(config_.mqtt_user));
-        if (doc["mqtt_pass"].is<const char *>())
-        {
-            const char *mp = doc["mqtt_pass"];
-            if (mp && strcmp(mp, "*****") != 0 && strlen(mp) > 0)
-                strlcpy(config_.mqtt_pass, mp, sizeof(config_.mqtt_pass));
-        }
-        if (doc["mqtt_topic"].is<const char *>())
-            strlcpy(config_.mqtt_topic, doc["mqtt_topic"], sizeof(config_.mqtt_topic));
-
-        // Mesure
-        if (doc["measure_interval_ms"].is<uint32_t>())
-            config_.measure_interval_ms = doc["measure_interval_ms"];
-        if (doc["measure_offset_cm"].is<float>())
-            config_.measure_offset_cm = doc["measure_offset_cm"];
-
-        // NEW filtres
-        if (doc["avg_alpha"].is<float>())
-            config_.avg_alpha = doc["avg_alpha"];
-        if (doc["median_n"].is<uint16_t>())
-            config_.median_n = doc["median_n"];
-        if (doc["median_delay_ms"].is<uint16_t>())
-            config_.median_delay_ms = doc["median_delay_ms"];
-        if (doc["filter_min_cm"].is<float>())
-            config_.filter_min_cm = doc["filter_min_cm"];
-        if (doc["filter_max_cm"].is<float>())
-            config_.filter_max_cm = doc["filter_max_cm"];
-
-        // Divers
-        if (doc["device_name"].is<const char *>())
-            strlcpy(config_.device_name, doc["device_name"], sizeof(config_.device_name));
-        if (doc["interactive_timeout_ms"].is<uint32_t>())
-            config_.interactive_timeout_ms = doc["interactive_timeout_ms"];
-        if (doc["deepsleep_interval_s"].is<uint32_t>())
-            config_.deepsleep_interval_s = doc["deepsleep_interval_s"];
-
-        if (doc["admin_user"].is<const char *>())
-            strlcpy(config_.admin_user, doc["admin_user"], sizeof(config_.admin_user));
-        if (doc["admin_pass"].is<const char *>())
+        for (size_t i = 0; i < kFieldCount; i++)
         {
-            const char *ap = doc["admin_pass"];
-            if (ap && strcmp(ap, "*****") != 0 && strlen(ap) > 0)
-                strlcpy(config_.admin_pass, ap, sizeof(config_.admin_pass));
+            if (!(update.touched_ & (1ULL << i)))
+                continue;
+            memcpy(fieldPtr(config_, kFields[i]), fieldPtr(update.staged_, kFields[i]), kFields[i].size);
+            applied++;
         }
     }
 
-    Serial.println("  -> Mise à jour de la configuration en mémoire OK.");
+    LOG_I(Config, "  -> Mise à jour de la configuration en mémoire OK (%d champ(s)).", applied);
 
     applyDefaultsIfNeeded();
 
-    // Sauvegarde asynchrone
-    xTaskCreate([](void *)
-                {
-        Serial.println("[ConfigManager][Task] Sauvegarde asynchrone en cours...");
-        ConfigManager::instance().save();
-        Serial.println("[ConfigManager][Task] Sauvegarde terminée !");
-        vTaskDelete(NULL); },
-                "saveConfigAsync", 4096, NULL, 1, NULL);
+    // Appliquée en RAM (instantané publié) ; écriture NVS différée et groupée
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        const uint32_t now = halMillis();
+        if (pendingGen_.load(std::memory_order_relaxed) == committedGen_.load(std::memory_order_acquire))
+            firstDirtyMs_ = now;
+        lastDirtyMs_ = now;
+        pendingGen_.fetch_add(1, std::memory_order_release);
+    }
 
     return true;
 }
 
-AppConfig ConfigManager::getConfig()
+bool ConfigManager::flushIfDue(uint32_t nowMs)
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return config_;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (!savePending())
+            return false;
+        if ((uint32_t)(nowMs - lastDirtyMs_) < CONFIG_SAVE_DEBOUNCE_MS &&
+            (uint32_t)(nowMs - firstDirtyMs_) < CONFIG_SAVE_MAX_DELAY_MS)
+            return false;
+    }
+    return save();
 }
 
-uint32_t ConfigManager::getMeasureIntervalMs()
+static void configSaveTask(void *)
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return config_.measure_interval_ms;
+    for (;;)
+    {
+        halDelayMs(CONFIG_SAVE_POLL_MS);
+        ConfigManager::instance().flushIfDue(halMillis());
+    }
 }
 
-float ConfigManager::getMeasureOffsetCm()
+void ConfigManager::startWriteBehind()
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return config_.measure_offset_cm;
+    xTaskCreate(configSaveTask, "cfgSave", 4096, NULL, 1, NULL);
 }
 
-// NEW getters
-float ConfigManager::getRunningAverageAlpha()
+AppConfig ConfigManager::getConfig()
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return config_.avg_alpha;
+    return *snapshot();
 }
 
-uint16_t ConfigManager::getMedianSamples()
+uint32_t ConfigManager::getMeasureIntervalMs()
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return config_.median_n;
+    return snapshot()->measure_interval_ms;
 }
 
-uint16_t ConfigManager::getMedianSampleDelayMs()
+float ConfigManager::getMeasureOffsetCm()
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return config_.median_delay_ms;
+    return snapshot()->measure_offset_cm;
 }
 
-float ConfigManager::getFilterMinCm()
+// NEW getters
+uint16_t ConfigManager::getMedianSamples()
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return config_.filter_min_cm;
+    return snapshot()->median_n;
 }
 
-float ConfigManager::getFilterMaxCm()
+uint16_t ConfigManager::getMedianSampleDelayMs()
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return config_.filter_max_cm;
+    return snapshot()->median_delay_ms;
 }
 
-bool ConfigManager::isMQTTEnabled()
+float ConfigManager::getFilterMinCm()
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return config_.mqtt_enabled;
+    return snapshot()->filter_min_cm;
 }
 
-const char *ConfigManager::getAdminUser()
+float ConfigManager::getFilterMaxCm()
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return config_.admin_user;
+    return snapshot()->filter_max_cm;
 }
 
-const char *ConfigManager::getAdminPass()
+bool ConfigManager::isMQTTEnabled()
 {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return config_.admin_pass;
+    return snapshot()->mqtt_enabled;
 }
@@ -1,7 +1,12 @@
 #pragma once
 #include <Arduino.h>
-#include <ArduinoJson.h>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <type_traits>
+#include "config.h"
+
+class JsonWriter;
 
 #define WIFI_SSID_LEN 32
 #define WIFI_PASS_LEN 64
@@ -14,6 +19,16 @@
 #define ADMIN_USER_LEN 16
 #define ADMIN_PASS_LEN 16
 #define APP_VERSION_LEN 16
+#define TANK_PROFILE_LEN 256
+
+// Géométrie de cuve d'un canal supplémentaire (formes analytiques seulement)
+struct ChannelTankConfig
+{
+    uint8_t shape; // TankShape, sauf profil
+    float diameter_cm;
+    float length_cm;
+    float width_cm;
+};
 
 struct AppConfig
 {
@@ -28,13 +43,17 @@ struct AppConfig
     char mqtt_user[MQTT_USER_LEN];
     char mqtt_pass[MQTT_PASS_LEN];
     char mqtt_topic[MQTT_TOPIC_LEN];
+    uint32_t mqtt_diag_s;             // période du message <topic>/diag (0 = désactivé)
 
     // ---- Mesure ----
-    uint32_t measure_interval_ms;
+    uint32_t measure_interval_ms;     // niveau en mouvement : median_n pings par période
+    uint32_t measure_interval_max_ms; // période au repos : plus longue = moins de pings, estimation plus bruitée
+    float adaptive_rate_cm_min;       // vitesse au-delà de laquelle on mesure vite
     float measure_offset_cm;
 
     // ---- Stabilisation / filtre ----
-    float avg_alpha;          // 0..1
+    float kalman_q;           // bruit de processus (accélération, cm²/s³) ; faible = lissage long au repos
+    float kalman_r_cm;        // écart-type du bruit de mesure (cm)
     uint16_t median_n;        // 1..15
     uint16_t median_delay_ms; // 0..1000
     float filter_min_cm;      // e.g. 2.0
@@ -45,35 +64,159 @@ struct AppConfig
     uint32_t interactive_timeout_ms;
     uint32_t deepsleep_interval_s;
 
+    // ---- Envoi groupé (réveils timer) ----
+    uint16_t batch_upload_every; // 1 = envoi à chaque réveil
+    float batch_threshold_cm;    // 0 = désactivé
+
+    // ---- Géométrie de cuve (volume) ----
+    uint8_t tank_shape;       // TankShape : 0 cyl. vertical, 1 cyl. horizontal, 2 rectangulaire, 3 profil
+    float tank_diameter_cm;   // cylindres
+    float tank_length_cm;     // cylindre horizontal, rectangulaire
+    float tank_width_cm;      // rectangulaire
+    char tank_profile[TANK_PROFILE_LEN]; // "h_cm:litres,..." (forme profil)
+#if SENSOR_CHANNELS > 1
+    ChannelTankConfig ch_tank[SENSOR_CHANNELS - 1]; // canaux 1.. (le canal 0 utilise tank_*)
+#endif
+
     char admin_user[ADMIN_USER_LEN];
     char admin_pass[ADMIN_PASS_LEN];
 
     char app_version[APP_VERSION_LEN];
 };
 
+// Instantané immuable de la configuration (partagé, compté par référence)
+using ConfigPtr = std::shared_ptr<const AppConfig>;
+
+#define CONFIG_BODY_MAX 4096               // corps POST /api/config accepté
+#define CONFIG_KEY_MAX 32                  // clé JSON la plus longue retenue
+#define CONFIG_TOKEN_MAX TANK_PROFILE_LEN  // valeur chaîne ou nombre la plus longue
+
+/**
+ * Analyseur incrémental du corps POST /api/config (objet JSON plat).
+ * Alimenté bloc par bloc (feed) sans jamais rassembler le corps : chaque
+ * valeur est validée dès qu'elle est complète et écrite dans une copie de
+ * travail de la configuration ; rien n'est appliqué tant que l'objet n'est
+ * pas entier et valide. Taille fixe, aucune allocation : l'objet vit dans
+ * request->_tempObject (libéré par free()), d'où la destruction triviale.
+ * Clés inconnues, champs en lecture seule et null sont ignorés ; un type
+ * incorrect, une valeur hors bornes ou une chaîne trop longue rejettent
+ * toute la requête.
+ */
+class ConfigUpdate
+{
+public:
+    ConfigUpdate(); // part de l'instantané courant
+
+    // false dès la première erreur (les appels suivants sont ignorés)
+    bool feed(const uint8_t *data, size_t len);
+    bool done() const { return state_ == State::Done; }
+    // Message d'erreur (nullptr si aucune) et clé fautive éventuelle
+    const char *error() const { return err_; }
+    const char *errorField() const { return errField_; }
+    size_t bytes() const { return bytes_; }
+
+private:
+    friend class ConfigManager;
+
+    enum class State : uint8_t
+    {
+        Start,      // avant '{'
+        KeyOrEnd,   // après '{' : clé ou '}'
+        Key,        // dans la clé
+        KeyEsc,     // '\' dans la clé
+        Colon,      // après la clé
+        Value,      // après ':'
+        Str,        // dans une valeur chaîne
+        StrEsc,     // '\' dans une valeur chaîne
+        StrUni,     // 4 chiffres hexa de \uXXXX
+        Number,     // nombre en cours
+        Literal,    // true / false / null en cours
+        AfterValue, // ',' ou '}'
+        NextKey,    // après ',' : clé obligatoire
+        Done,       // '}' final reçu, seuls des blancs peuvent suivre
+        Error
+    };
+    enum class Kind : uint8_t
+    {
+        Null,
+        Bool,
+        Number,
+        String
+    };
+
+    bool step(char c);
+    bool fail(const char *msg);
+    bool endKey();
+    bool putChar(char c);
+    bool putCodePoint(uint32_t cp);
+    bool commitValue(Kind kind);
+
+    AppConfig staged_;    // configuration de travail (snapshot + champs reçus)
+    uint64_t touched_;    // bit i : kFields[i] reçu et valide
+    size_t bytes_;
+    const char *err_;
+    const char *errField_;
+    int8_t field_;        // champ de la clé courante, -1 si ignorée
+    State state_;
+    uint8_t keyLen_;
+    bool keyOverflow_;
+    uint16_t tokLen_;
+    uint16_t uni_;        // \uXXXX en cours
+    uint8_t uniDigits_;
+    uint16_t highSurrogate_;
+    char key_[CONFIG_KEY_MAX + 1];
+    char tok_[CONFIG_TOKEN_MAX + 1];
+};
+static_assert(std::is_trivially_destructible<ConfigUpdate>::value,
+              "ConfigUpdate est libéré par free() avec la requête HTTP");
+
 class ConfigManager
 {
 public:
     static ConfigManager &instance();
+    // Charge le blob NVS (une lecture) ; migre l'ancien format par clés si besoin
     bool begin();
+    // Écriture immédiate des modifications en attente (avant deep sleep) ;
+    // le blob n'est écrit que si au moins un champ diffère de la version persistée
     bool save();
-    String toJsonString();
-    bool updateFromJson(const String &json);
+    // Adopte une configuration effective déjà validée (cache RTC du réveil timer)
+    void restore(const AppConfig &cfg);
+    // Objet JSON de /api/config (mots de passe masqués)
+    void writeJson(JsonWriter &w);
+    // Applique en RAM tout de suite les champs reçus ; la NVS suit via flushIfDue()
+    bool applyUpdate(const ConfigUpdate &update);
+    // Raccourci : analyse un corps complet puis applyUpdate()
+    bool updateFromJson(const char *json);
+
+    // Écriture différée : la tâche cfgSave appelle flushIfDue(), qui écrit
+    // 2 s après la dernière modification (au plus 10 s après la première).
+    void startWriteBehind();
+    bool flushIfDue(uint32_t nowMs);
+
+    // Génération des modifications acceptées / de la dernière écrite en NVS
+    uint32_t pendingGeneration() const { return pendingGen_.load(std::memory_order_acquire); }
+    uint32_t committedGeneration() const { return committedGen_.load(std::memory_order_acquire); }
+    bool savePending() const { return pendingGeneration() != committedGeneration(); }
+
+    // Nombre de champs qui diffèrent entre deux configurations
+    static int countChangedFields(const AppConfig &a, const AppConfig &b);
+
+    // Lecture sans verrou du gestionnaire : chaque écriture publie un
+    // nouvel instantané et incrémente la génération.
+    ConfigPtr snapshot() const;
+    uint32_t generation() const { return generation_.load(std::memory_order_acquire); }
 
     AppConfig getConfig();
     uint32_t getMeasureIntervalMs();
     float getMeasureOffsetCm();
 
     // NEW getters
-    float getRunningAverageAlpha();
     uint16_t getMedianSamples();
     uint16_t getMedianSampleDelayMs();
     float getFilterMinCm();
     float getFilterMaxCm();
 
     bool isMQTTEnabled();
-    const char *getAdminUser();
-    const char *getAdminPass();
 
 private:
     ConfigManager() = default;
@@ -82,8 +225,56 @@ private:
     ConfigManager &operator=(const ConfigManager &) = delete;
 
     void applyDefaultsIfNeeded();
-    bool loadFromPreferences();
+    bool loadBlob();
+    bool migrateLegacy();
+    void removeLegacyKeys();
+    // Appelés avec mutex_ tenu
+    void logSummaryLocked();
+    void publishLocked();
 
-    AppConfig config_{};
+    AppConfig config_{}; // copie de travail des écrivains (protégée par mutex_)
     std::mutex mutex_;
+    AppConfig committed_{};      // dernière version écrite en NVS (base du diff)
+    bool committedValid_ = false;
+    uint32_t firstDirtyMs_ = 0;  // première / dernière modification non écrite
+    uint32_t lastDirtyMs_ = 0;
+    std::mutex commitMutex_;     // sérialise les écritures NVS
+
+    std::atomic<uint32_t> pendingGen_{0};
+    std::atomic<uint32_t> committedGen_{0};
+
+    ConfigPtr current_ = std::make_shared<AppConfig>();
+    std::atomic<uint32_t> generation_{0};
+};
+
+/**
+ * Cache d'instantané pour les chemins chauds : ne recharge l'instantané
+ * que lorsque la génération change (une lecture atomique par appel sinon).
+ */
+class ConfigView
+{
+public:
+    const AppConfig &get()
+    {
+        refresh();
+        return *cfg_;
+    }
+    const AppConfig *operator->() { return &get(); }
+
+    // Retourne true si un nouvel instantané a été chargé.
+    bool refresh()
+    {
+        const uint32_t g = ConfigManager::instance().generation();
+        if (cfg_ && g == gen_)
+            return false;
+        cfg_ = ConfigManager::instance().snapshot();
+        gen_ = g;
+        return true;
+    }
+
+    uint32_t generation() const { return gen_; }
+
+private:
+    ConfigPtr cfg_;
+    uint32_t gen_ = 0;
 };
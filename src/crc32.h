@@ -0,0 +1,6 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, polynôme réfléchi 0xEDB88320). crc = 0 pour démarrer.
+uint32_t crc32Update(uint32_t crc, const void *data, size_t len);
@@ -3,41 +3,229 @@
 #include <WiFi.h>
 #include "display.h"
 #include "config.h"
+#include "measurement_store.h"
+#include "metrics.h"
+#include "logger.h"
 
 // Gauge parameters
 const int gaugeX = 250, gaugeY = 30, gaugeW = 60, gaugeH = 180;
 
-float prevMeasured = NAN, prevEstimated = NAN;
-unsigned long prevDuration = ULONG_MAX;
-float prevCuveVide = NAN, prevCuvePleine = NAN;
+// Zones écran composées hors écran (RAM/PSRAM) puis poussées par rectangles modifiés
+static const int TEXT_W = gaugeX - 8, TEXT_H = 120;
+static const int STATUS_H = 24;
+static const int TEXT_LINES = 6;
+static const int LINE_LEN = 32;
+
+static M5Canvas textCanvas(&M5.Display);
+static M5Canvas gaugeCanvas(&M5.Display);
+static M5Canvas statusCanvas(&M5.Display);
+
 int prevPercent = -1;
 
-// --- Helpers Wi-Fi display ---
-static void drawWifiStatusLine()
+// Tâche d'affichage, réveillée par notification à chaque nouvelle mesure
+static TaskHandle_t displayTaskHandle = nullptr;
+
+// Contenu déjà affiché : une ligne n'est redessinée que si son texte change
+static char prevLines[TEXT_LINES][LINE_LEN];
+static char prevStatus[48];
+static uint32_t lastRssiReadMs = 0;
+static int lastRssi = 0;
+
+static DisplayStats stats;
+
+static uint32_t pushRegion(M5Canvas &canvas, int dstX, int dstY, int y, int h)
 {
-  // Zone de statut Wi-Fi en bas de l’écran
-  M5.Display.fillRect(0, M5.Display.height() - 24, M5.Display.width(), 24, TFT_BLACK);
-  M5.Display.setTextSize(2);
-  M5.Display.setCursor(8, M5.Display.height() - 22);
+  // Clip sur la bande modifiée : seuls ses pixels partent sur le bus SPI
+  M5.Display.setClipRect(dstX, dstY + y, canvas.width(), h);
+  canvas.pushSprite(dstX, dstY);
+  M5.Display.clearClipRect();
+  return (uint32_t)canvas.width() * h * 2; // RGB565
+}
+
+static void initCanvases()
+{
+  // Tampons en PSRAM si disponible (~96 Ko au total)
+  for (M5Canvas *c : {&textCanvas, &gaugeCanvas, &statusCanvas})
+  {
+    c->setColorDepth(16);
+    c->setPsram(true);
+  }
+  textCanvas.createSprite(TEXT_W, TEXT_H);
+  gaugeCanvas.createSprite(gaugeW, gaugeH);
+  statusCanvas.createSprite(M5.Display.width(), STATUS_H);
+  textCanvas.fillSprite(TFT_BLACK);
+  gaugeCanvas.fillSprite(TFT_BLACK);
+  statusCanvas.fillSprite(TFT_BLACK);
+}
+
+static int computePercent(const MeasurementRecord &rec, float cuveVide, float cuvePleine)
+{
+  // Remplissage en volume si la géométrie de cuve est connue
+  if (rec.percent >= 0.0f)
+    return (int)round(constrain(rec.percent, 0.0f, 100.0f));
+
+  const float measured = rec.measuredCm;
+  if (measured <= 0)
+    return 0;
+  float denom = (cuveVide - cuvePleine);
+  if (fabs(denom) < 1e-3)
+    return 0;
+  float ratio = (cuveVide - measured) / denom;
+  ratio = constrain(ratio, 0.0f, 1.0f);
+  return (int)round(ratio * 100.0f);
+}
+
+// Bloc texte gauche : une bande par ligne, poussée seulement si le texte a changé
+static uint32_t renderTextBlock(const MeasurementRecord &rec, float cuveVide, float cuvePleine)
+{
+  static const int lineY[TEXT_LINES] = {8, 32, 48, 64, 80, 96};
+  static const int lineH[TEXT_LINES] = {24, 16, 16, 16, 16, 16};
+  char lines[TEXT_LINES][LINE_LEN];
+  const float measured = rec.measuredCm;
+  const float estimated = rec.estimatedCm;
+  const unsigned long duration = rec.durationUs;
+
+  // Plusieurs capteurs : le numéro de canal remplace "Mes:"
+  if (SENSOR_CHANNELS > 1 && measured > 0)
+    snprintf(lines[0], LINE_LEN, "C%u %.1f cm", (unsigned)rec.channel, measured);
+  else if (SENSOR_CHANNELS > 1)
+    snprintf(lines[0], LINE_LEN, "C%u --", (unsigned)rec.channel);
+  else if (measured > 0)
+    snprintf(lines[0], LINE_LEN, "Mes: %.1f cm", measured);
+  else
+    snprintf(lines[0], LINE_LEN, "Mes: --");
+  if (estimated > -0.5f)
+    snprintf(lines[1], LINE_LEN, "Ht: %.1f cm", estimated);
+  else
+    snprintf(lines[1], LINE_LEN, "Ht: --");
+  snprintf(lines[2], LINE_LEN, "Dur: %lu us", duration);
+  snprintf(lines[3], LINE_LEN, "Vide: %.1f", cuveVide);
+  snprintf(lines[4], LINE_LEN, "Pleine: %.1f", cuvePleine);
+  if (rec.volumeL >= 0.0f)
+    snprintf(lines[5], LINE_LEN, "Vol: %.0f L", rec.volumeL);
+  else
+    snprintf(lines[5], LINE_LEN, "Vol: --");
+
+  uint32_t pushed = 0;
+  for (int i = 0; i < TEXT_LINES; ++i)
+  {
+    if (strcmp(lines[i], prevLines[i]) == 0)
+      continue;
+    textCanvas.fillRect(0, lineY[i], TEXT_W, lineH[i], TFT_BLACK);
+    textCanvas.setTextSize(i == 0 ? 3 : 2);
+    textCanvas.setTextColor(TFT_WHITE);
+    textCanvas.setCursor(8, lineY[i]);
+    textCanvas.print(lines[i]);
+    pushed += pushRegion(textCanvas, 0, 0, lineY[i], lineH[i]);
+    strlcpy(prevLines[i], lines[i], LINE_LEN);
+  }
+  return pushed;
+}
+
+static int gaugeFillTop(int percent)
+{
+  int fillH = (int)((percent / 100.0f) * (gaugeH - 4));
+  return gaugeH - 2 - fillH;
+}
 
+// Jauge : seule la bande entre l'ancien et le nouveau niveau (et le libellé %) est poussée
+static uint32_t renderGauge(int percent)
+{
+  if (percent == prevPercent)
+    return 0;
+
+  const int labelY = (gaugeH / 2) - 8, labelH = 16;
+  int top = labelY, bottom = labelY + labelH;
+  const int newTop = gaugeFillTop(percent);
+  if (prevPercent < 0)
+  {
+    top = 0;
+    bottom = gaugeH;
+  }
+  else
+  {
+    const int oldTop = gaugeFillTop(prevPercent);
+    top = min(top, min(oldTop, newTop));
+    bottom = max(bottom, max(oldTop, newTop));
+  }
+
+  gaugeCanvas.fillRect(1, 1, gaugeW - 2, gaugeH - 2, TFT_BLACK);
+  if (newTop < gaugeH - 2)
+    gaugeCanvas.fillRect(2, newTop, gaugeW - 4, gaugeH - 2 - newTop, TFT_BLUE);
+  gaugeCanvas.drawRect(0, 0, gaugeW, gaugeH, TFT_WHITE);
+
+  char buf[8];
+  snprintf(buf, sizeof(buf), "%d%%", percent);
+  gaugeCanvas.setTextSize(2);
+  gaugeCanvas.setTextColor(TFT_WHITE, TFT_BLACK);
+  gaugeCanvas.setCursor((gaugeW / 2) - 12, labelY);
+  gaugeCanvas.print(buf);
+
+  prevPercent = percent;
+  top = max(top, 0);
+  bottom = min(bottom, gaugeH);
+  return pushRegion(gaugeCanvas, gaugeX, gaugeY, top, bottom - top);
+}
+
+// --- Helpers Wi-Fi display ---
+static void formatWifiStatus(char *buf, size_t len)
+{
   // Priorité : si STA connecté -> afficher STA + RSSI, sinon si AP actif -> afficher AP, sinon OFF
   if (WiFi.status() == WL_CONNECTED)
   {
-    String ip = WiFi.localIP().toString();
-    int rssi = WiFi.RSSI(); // dBm
-    M5.Display.printf("STA: %s (%d dBm)", ip.c_str(), rssi);
+    // RSSI relu au plus toutes les 2 s (appel driver Wi-Fi)
+    if (lastRssiReadMs == 0 || millis() - lastRssiReadMs >= 2000)
+    {
+      lastRssi = WiFi.RSSI(); // dBm
+      lastRssiReadMs = millis();
+    }
+    snprintf(buf, len, "STA: %s (%d dBm)", WiFi.localIP().toString().c_str(), lastRssi);
     return;
   }
 
   wifi_mode_t mode = WiFi.getMode();
   if (mode == WIFI_MODE_AP || mode == WIFI_MODE_APSTA)
   {
-    String ip = WiFi.softAPIP().toString();
-    M5.Display.printf("AP: %s", ip.c_str());
+    snprintf(buf, len, "AP: %s", WiFi.softAPIP().toString().c_str());
     return;
   }
 
-  M5.Display.print("WiFi: OFF");
+  snprintf(buf, len, "WiFi: OFF");
+}
+
+// Ligne de statut Wi-Fi en bas de l'écran, poussée seulement si elle change
+static uint32_t renderStatusLine()
+{
+  char buf[sizeof(prevStatus)];
+  formatWifiStatus(buf, sizeof(buf));
+  if (strcmp(buf, prevStatus) == 0)
+    return 0;
+
+  statusCanvas.fillSprite(TFT_BLACK);
+  statusCanvas.setTextSize(2);
+  statusCanvas.setTextColor(TFT_WHITE);
+  statusCanvas.setCursor(8, 2);
+  statusCanvas.print(buf);
+  strlcpy(prevStatus, buf, sizeof(prevStatus));
+  return pushRegion(statusCanvas, 0, M5.Display.height() - STATUS_H, 0, STATUS_H);
+}
+
+static void recordFrame(uint32_t renderUs, uint32_t bytesPushed)
+{
+  metricsRecordUs(MetricStage::DisplayFrame, renderUs);
+  stats.frames++;
+  stats.lastRenderUs = renderUs;
+  if (renderUs > stats.maxRenderUs)
+    stats.maxRenderUs = renderUs;
+  stats.lastBytesPushed = bytesPushed;
+  stats.totalBytesPushed += bytesPushed;
+  if (bytesPushed == 0)
+    stats.idleFrames++;
+
+  if (stats.frames % 100 == 0)
+    LOG_D(Display, "%lu frames (%lu sans envoi), rendu max %lu us, %llu octets poussés",
+                   (unsigned long)stats.frames, (unsigned long)stats.idleFrames,
+                   (unsigned long)stats.maxRenderUs, (unsigned long long)stats.totalBytesPushed);
 }
 
 void initDisplay()
@@ -62,89 +250,6 @@ void drawGaugeBackground()
   M5.Display.print("Vide");
 }
 
-void drawGaugeFill(int percent)
-{
-  M5.Display.fillRect(gaugeX + 1, gaugeY + 1, gaugeW - 2, gaugeH - 2, TFT_BLACK);
-  int fillH = (int)((percent / 100.0f) * (gaugeH - 4));
-  if (fillH > 0)
-  {
-    int yFill = gaugeY + gaugeH - 2 - fillH;
-    M5.Display.fillRect(gaugeX + 2, yFill, gaugeW - 4, fillH, TFT_BLUE);
-  }
-  M5.Display.drawRect(gaugeX, gaugeY, gaugeW, gaugeH, TFT_WHITE);
-  char buf[8];
-  snprintf(buf, sizeof(buf), "%d%%", percent);
-  int tx = gaugeX + (gaugeW / 2) - 12;
-  int ty = gaugeY + (gaugeH / 2) - 8;
-  M5.Display.setTextSize(2);
-  M5.Display.setTextColor(TFT_WHITE, TFT_BLACK);
-  M5.Display.setCursor(tx, ty);
-  M5.Display.print(buf);
-}
-
-void updateDisplay(float measured, float estimated, unsigned long duration, float cuveVide, float cuvePleine)
-{
-  bool needText = false;
-  if (isnan(prevMeasured) || (measured >= 0 && fabs(measured - prevMeasured) > 0.2f))
-    needText = true;
-  if (isnan(prevEstimated) || (estimated >= 0 && fabs(estimated - prevEstimated) > 0.2f))
-    needText = true;
-  if (duration != prevDuration)
-    needText = true;
-  if (cuveVide != prevCuveVide || cuvePleine != prevCuvePleine)
-    needText = true;
-
-  if (needText)
-  {
-    M5.Display.fillRect(0, 0, gaugeX - 8, 120, TFT_BLACK);
-    M5.Display.setTextSize(3);
-    M5.Display.setTextColor(TFT_WHITE);
-    M5.Display.setCursor(8, 8);
-    if (measured > 0)
-      M5.Display.printf("Mes: %.1f cm\n", measured);
-    else
-      M5.Display.printf("Mes: --\n");
-    M5.Display.setTextSize(2);
-    if (estimated > -0.5f)
-      M5.Display.printf("Ht: %.1f cm\n", estimated);
-    else
-      M5.Display.printf("Ht: --\n");
-    M5.Display.setTextSize(2);
-    M5.Display.printf("Dur: %lu us\n", duration);
-    M5.Display.setTextSize(2);
-    M5.Display.printf("Vide: %.1f\n", cuveVide);
-    M5.Display.printf("Pleine: %.1f\n", cuvePleine);
-
-    prevMeasured = measured;
-    prevEstimated = estimated;
-    prevDuration = duration;
-    prevCuveVide = cuveVide;
-    prevCuvePleine = cuvePleine;
-  }
-
-  // compute percent for gauge
-  int percent = 0;
-  if (measured > 0)
-  {
-    float denom = (cuveVide - cuvePleine);
-    if (fabs(denom) >= 1e-3)
-    {
-      float ratio = (cuveVide - measured) / denom;
-      ratio = constrain(ratio, 0.0f, 1.0f);
-      percent = (int)round(ratio * 100.0f);
-    }
-  }
-
-  if (percent != prevPercent)
-  {
-    drawGaugeFill(percent);
-    prevPercent = percent;
-  }
-
-  // Wi-Fi status line (STA/AP + IP [+ RSSI])
-  drawWifiStatusLine();
-}
-
 void displayTask(void *pv)
 {
   // initial draw
@@ -153,96 +258,61 @@ void displayTask(void *pv)
   {
     std::lock_guard<std::mutex> lk(displayMutex);
     M5.Display.fillScreen(TFT_BLACK);
+    initCanvases();
     drawGaugeBackground();
   }
   prevPercent = -1;
-  prevMeasured = NAN;
-  prevEstimated = NAN;
-  prevDuration = ULONG_MAX;
-  prevCuveVide = cuveVide;
-  prevCuvePleine = cuvePleine;
+  for (auto &line : prevLines)
+    line[0] = '\0';
+  prevStatus[0] = '\0';
+
+  displayTaskHandle = xTaskGetCurrentTaskHandle();
+  uint32_t lastSeq = 0;
+  uint8_t lastCh = 0;
+  float lastVide = NAN, lastPleine = NAN;
 
   for (;;)
   {
-    float measured, estimated;
-    unsigned long duration;
-    {
-      std::lock_guard<std::mutex> lock(distMutex);
-      measured = lastMeasuredCm;
-      estimated = lastEstimatedHeight;
-      duration = lastDurationUs;
-    }
-    // left text zone update?
-    bool needText = false;
-    if (isnan(prevMeasured) || (measured >= 0 && fabs(measured - prevMeasured) > 0.2f))
-      needText = true;
-    if (isnan(prevEstimated) || (estimated >= 0 && fabs(estimated - prevEstimated) > 0.2f))
-      needText = true;
-    if (duration != prevDuration)
-      needText = true;
-    if (cuveVide != prevCuveVide || cuvePleine != prevCuvePleine)
-      needText = true;
-
-    if (needText)
-    {
-      std::lock_guard<std::mutex> lk(displayMutex);
-      M5.Display.fillRect(0, 0, gaugeX - 8, 120, TFT_BLACK);
-      M5.Display.setTextSize(3);
-      M5.Display.setTextColor(TFT_WHITE);
-      M5.Display.setCursor(8, 8);
-      if (measured > 0)
-        M5.Display.printf("Mes: %.1f cm\n", measured);
-      else
-        M5.Display.printf("Mes: --\n");
-      M5.Display.setTextSize(2);
-      if (estimated > -0.5f)
-        M5.Display.printf("Ht: %.1f cm\n", estimated);
-      else
-        M5.Display.printf("Ht: --\n");
-      M5.Display.setTextSize(2);
-      M5.Display.printf("Dur: %lu us\n", duration);
-      M5.Display.setTextSize(2);
-      M5.Display.printf("Vide: %.1f\n", cuveVide);
-      M5.Display.printf("Pleine: %.1f\n", cuvePleine);
-      prevMeasured = measured;
-      prevEstimated = estimated;
-      prevDuration = duration;
-      prevCuveVide = cuveVide;
-      prevCuvePleine = cuvePleine;
-    }
+    // Bloquée jusqu'à une nouvelle mesure ; le timeout sert de tick lent à la ligne de statut
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DISPLAY_STATUS_PERIOD_MS));
 
-    // gauge percent computation
-    int percent = 0;
-    if (measured > 0)
-    {
-      float denom = (cuveVide - cuvePleine);
-      if (fabs(denom) < 1e-3)
-        percent = 0;
-      else
-      {
-        float ratio = (cuveVide - measured) / denom;
-        ratio = constrain(ratio, 0.0f, 1.0f);
-        percent = (int)round(ratio * 100.0f);
-      }
-    }
-    else
-      percent = 0;
+    // Un canal à la fois, en rotation lente quand il y a plusieurs capteurs
+    const uint8_t ch = (uint8_t)((millis() / DISPLAY_CHANNEL_PERIOD_MS) % SENSOR_CHANNELS);
+    MeasurementRecord rec;
+    const uint32_t seq = readMeasurement(rec, ch);
+    const float vide = cuveVideCh[ch].load();
+    const float pleine = cuvePleineCh[ch].load();
+    const bool newData = (ch != lastCh || seq != lastSeq || vide != lastVide || pleine != lastPleine);
 
-    if (percent != prevPercent)
+    const uint32_t t0 = micros();
+    uint32_t pushed = 0;
     {
       std::lock_guard<std::mutex> lk(displayMutex);
-      drawGaugeFill(percent);
-      prevPercent = percent;
-    }
-
-    // Wi-Fi status line (STA/AP + IP [+ RSSI]), toujours mise à jour
-    {
-      std::lock_guard<std::mutex> lk(displayMutex);
-      drawWifiStatusLine();
+      if (newData)
+      {
+        pushed += renderTextBlock(rec, vide, pleine);
+        pushed += renderGauge(computePercent(rec, vide, pleine));
+      }
+      pushed += renderStatusLine();
     }
+    recordFrame(micros() - t0, pushed);
+    lastSeq = seq;
+    lastCh = ch;
+    lastVide = vide;
+    lastPleine = pleine;
 
     M5.update();
-
-    vTaskDelay(pdMS_TO_TICKS(DISPLAY_PERIOD_MS));
   }
 }
+
+void displayNotify()
+{
+  TaskHandle_t h = displayTaskHandle;
+  if (h)
+    xTaskNotifyGive(h);
+}
+
+void getDisplayStats(DisplayStats &out)
+{
+  out = stats;
+}
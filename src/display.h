@@ -1,8 +1,21 @@
 #pragma once
 #include <Arduino.h>
 
+// Compteurs de rendu (mesure du gain des rectangles modifiés)
+struct DisplayStats
+{
+    uint32_t frames;
+    uint32_t idleFrames; // images sans aucun envoi vers l'écran
+    uint32_t lastRenderUs;
+    uint32_t maxRenderUs;
+    uint32_t lastBytesPushed;
+    uint64_t totalBytesPushed;
+};
+
 void displayTask(void *pv);
+void getDisplayStats(DisplayStats &out);
 void initDisplay();
 void drawGaugeBackground();
-void drawGaugeFill(int percent);
-void updateDisplay(float measured, float estimated, unsigned long duration, float cuveVide, float cuvePleine);
+
+// Réveille la tâche d'affichage (nouvelle mesure ou niveaux de cuve modifiés)
+void displayNotify();
@@ -0,0 +1,96 @@
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <soc/soc.h>
+#include "echo_gpio.h"
+#include "config.h"
+
+#define ECHO_SOURCE(ch) {sensorPins[ch].trig, sensorPins[ch].echo, ch}
+#define ECHO_TICKS_PER_US (APB_CLK_FREQ / 1000000) // compteur de capture MCPWM
+
+static const mcpwm_io_signals_t ECHO_CAP_SIGNALS[SENSOR_CHANNELS_MAX] = {MCPWM_CAP_0, MCPWM_CAP_1, MCPWM_CAP_2};
+static const mcpwm_capture_channel_id_t ECHO_CAP_CHANNELS[SENSOR_CHANNELS_MAX] = {
+    MCPWM_SELECT_CAP0, MCPWM_SELECT_CAP1, MCPWM_SELECT_CAP2};
+
+EchoSource &sensorEchoSource(uint8_t ch)
+{
+    // Une capture par capteur : un front sur une broche non armée est ignoré
+    static GpioEchoSource sources[SENSOR_CHANNELS] = {
+        ECHO_SOURCE(0),
+#if SENSOR_CHANNELS > 1
+        ECHO_SOURCE(1),
+#endif
+#if SENSOR_CHANNELS > 2
+        ECHO_SOURCE(2),
+#endif
+    };
+    return sources[ch];
+}
+
+GpioEchoSource::GpioEchoSource(int trigPin, int echoPin, uint8_t capChannel)
+    : trigPin_(trigPin), echoPin_(echoPin), capChannel_(capChannel)
+{
+}
+
+bool GpioEchoSource::begin()
+{
+    pinMode(trigPin_, OUTPUT);
+    digitalWrite(trigPin_, LOW);
+    pinMode(echoPin_, INPUT);
+    if (mcpwm_gpio_init(MCPWM_UNIT_0, ECHO_CAP_SIGNALS[capChannel_], echoPin_) != ESP_OK)
+        return false;
+
+    mcpwm_capture_config_t conf = {};
+    conf.cap_edge = MCPWM_BOTH_EDGE;
+    conf.cap_prescale = 1;
+    conf.capture_cb = onCapture;
+    conf.user_data = this;
+    return mcpwm_capture_enable_channel(MCPWM_UNIT_0, ECHO_CAP_CHANNELS[capChannel_], &conf) == ESP_OK;
+}
+
+// Horodatage déjà figé par le périphérique : pas de lecture d'horloge ni de
+// broche ici, et aucun appel en flash (EchoCapture::onEdge est forcé inline)
+bool IRAM_ATTR GpioEchoSource::onCapture(mcpwm_unit_t, mcpwm_capture_channel_id_t,
+                                         const cap_event_data_t *edata, void *arg)
+{
+    GpioEchoSource *self = static_cast<GpioEchoSource *>(arg);
+    const bool rising = edata->cap_edge == MCPWM_POS_EDGE;
+
+    BaseType_t woken = pdFALSE;
+    if (self->capture_.onEdge(rising, edata->cap_value) && self->waiter_)
+        vTaskNotifyGiveFromISR(self->waiter_, &woken);
+    return woken == pdTRUE; // le pilote fait portYIELD_FROM_ISR()
+}
+
+void GpioEchoSource::startPing()
+{
+    waiter_ = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0); // purge d'une notification résiduelle
+
+    digitalWrite(trigPin_, LOW);
+    delayMicroseconds(4);
+    capture_.arm(esp_timer_get_time());
+    digitalWrite(trigPin_, HIGH);
+    delayMicroseconds(10);
+    digitalWrite(trigPin_, LOW);
+}
+
+uint32_t GpioEchoSource::waitPulseUs(uint32_t timeoutUs)
+{
+    // +1 tick : la granularité FreeRTOS ne doit pas raccourcir la fenêtre
+    const TickType_t ticks = pdMS_TO_TICKS((timeoutUs + 999) / 1000) + 1;
+    for (;;)
+    {
+        EchoCapture::State st = capture_.poll(esp_timer_get_time(), timeoutUs);
+        if (st != EchoCapture::State::Armed && st != EchoCapture::State::High)
+            break;
+        ulTaskNotifyTake(pdTRUE, ticks);
+    }
+
+    uint32_t pulse = 0;
+    if (capture_.state() == EchoCapture::State::Done)
+        pulse = capture_.pulseUs() / ECHO_TICKS_PER_US;
+
+    capture_.reset();
+    waiter_ = nullptr;
+    return pulse;
+}
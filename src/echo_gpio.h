@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+#include <driver/mcpwm.h>
+#include "echo_source.h"
+
+/**
+ * Capture d'écho matérielle : la broche echo alimente un canal de capture
+ * MCPWM (unité 0, un canal par capteur, 3 = SENSOR_CHANNELS_MAX) qui
+ * horodate les fronts montant et descendant sur l'horloge APB. La latence
+ * de l'interruption (cache coupé pendant une écriture flash, autre ISR)
+ * retarde la notification, pas la mesure. Le callback, en IRAM, transmet
+ * les horodatages à EchoCapture et réveille la tâche appelante par
+ * notification FreeRTOS : la tâche reste bloquée (CPU libre) pendant le
+ * temps de vol.
+ */
+class GpioEchoSource : public EchoSource
+{
+public:
+    GpioEchoSource(int trigPin, int echoPin, uint8_t capChannel);
+
+    bool begin() override;
+    void startPing() override;
+    uint32_t waitPulseUs(uint32_t timeoutUs) override;
+
+private:
+    static bool onCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t cap,
+                          const cap_event_data_t *edata, void *arg);
+
+    const int trigPin_;
+    const int echoPin_;
+    const uint8_t capChannel_;
+    EchoCapture capture_; // fronts en ticks APB
+    volatile TaskHandle_t waiter_ = nullptr;
+};
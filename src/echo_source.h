@@ -0,0 +1,97 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * Source d'écho ultrason abstraite.
+ * - startPing() déclenche une impulsion trig et arme la capture.
+ * - waitPulseUs() bloque la tâche appelante (sans attente active) jusqu'au
+ *   front descendant de l'écho ou jusqu'au timeout. Retourne la largeur de
+ *   l'impulsion en µs, 0 si pas d'écho.
+ */
+class EchoSource
+{
+public:
+    virtual ~EchoSource() = default;
+    virtual bool begin() = 0;
+    virtual void startPing() = 0;
+    virtual uint32_t waitPulseUs(uint32_t timeoutUs) = 0;
+
+    uint32_t pingUs(uint32_t timeoutUs)
+    {
+        startPing();
+        return waitPulseUs(timeoutUs);
+    }
+};
+
+// Source du canal ch (< SENSOR_CHANNELS) : capture GPIO sur cible,
+// simulation en natif
+EchoSource &sensorEchoSource(uint8_t ch);
+
+/**
+ * Machine d'états de capture d'écho, indépendante du matériel.
+ * Alimentée par des fronts horodatés (ISR GPIO, périphérique de capture ou
+ * simulation), elle peut être testée hors cible.
+ * Horodatages tronqués à 32 bits : l'ESP32 n'a pas d'accès 64 bits atomique
+ * et l'ISR écrit pendant que la tâche lit. Les écarts sont calculés modulo
+ * 2^32 (rebouclage toutes les ~71 min, sans effet sur des fenêtres de 30 ms).
+ * Les fronts peuvent être dans une autre base que arm()/poll() (ticks du
+ * compteur de capture sur cible) : seul leur écart est retenu, pulseUs()
+ * est alors dans cette unité.
+ */
+class EchoCapture
+{
+public:
+    enum class State : uint8_t
+    {
+        Idle,
+        Armed, // attente du front montant
+        High,  // écho en cours
+        Done,
+        Timeout
+    };
+
+    void arm(uint64_t nowUs)
+    {
+        armUs_ = (uint32_t)nowUs;
+        riseUs_ = 0;
+        pulseUs_ = 0;
+        state_ = State::Armed;
+    }
+
+    // Retourne true si ce front termine la mesure. Appelé depuis l'ISR :
+    // toujours inline dans l'appelant (en IRAM sur cible).
+    __attribute__((always_inline)) bool onEdge(bool level, uint64_t tUs)
+    {
+        if (state_ == State::Armed && level)
+        {
+            riseUs_ = (uint32_t)tUs;
+            state_ = State::High;
+        }
+        else if (state_ == State::High && !level)
+        {
+            pulseUs_ = (uint32_t)tUs - riseUs_;
+            state_ = State::Done;
+            return true;
+        }
+        return false;
+    }
+
+    // Bascule en Timeout si la mesure n'est pas terminée dans la fenêtre.
+    State poll(uint64_t nowUs, uint32_t timeoutUs)
+    {
+        if ((state_ == State::Armed || state_ == State::High) && (uint32_t)((uint32_t)nowUs - armUs_) >= timeoutUs)
+            state_ = State::Timeout;
+        return state_;
+    }
+
+    void reset() { state_ = State::Idle; }
+
+    State state() const { return state_; }
+    uint32_t pulseUs() const { return pulseUs_; }
+
+private:
+    volatile State state_ = State::Idle;
+    volatile uint32_t armUs_ = 0;
+    volatile uint32_t riseUs_ = 0;
+    volatile uint32_t pulseUs_ = 0;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+/**
+ * HAL système de fichiers.
+ * Les modules de stockage (historique) n'utilisent que stdio/POSIX sous
+ * HAL_FS_ROOT ; seul le montage dépend de la plateforme.
+ * - Cible : VFS LittleFS monté sur /littlefs (formaté si besoin).
+ * - NATIVE_BUILD : répertoire hôte relatif au répertoire courant.
+ */
+#ifndef NATIVE_BUILD
+#include <LittleFS.h>
+#define HAL_FS_ROOT "/littlefs"
+
+inline bool halFsBegin() { return LittleFS.begin(true); }
+#else
+#include <errno.h>
+#include <sys/stat.h>
+#define HAL_FS_ROOT ".native_fs"
+
+inline bool halFsBegin() { return mkdir(HAL_FS_ROOT, 0755) == 0 || errno == EEXIST; }
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+/**
+ * HAL stockage clé-valeur (NVS).
+ * - Cible : Preferences d'arduino-esp32, utilisée telle quelle.
+ * - NATIVE_BUILD : KvStore en mémoire (hal/native/kv_native.cpp) exposant le
+ *   sous-ensemble de l'API Preferences utilisé par le projet, avec les mêmes
+ *   espaces de noms et la même sémantique (valeur par défaut si clé absente).
+ */
+#ifndef NATIVE_BUILD
+#include <Preferences.h>
+using KvStore = Preferences;
+#else
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+class KvStore
+{
+public:
+    bool begin(const char *name, bool readOnly = false);
+    void end();
+
+    bool isKey(const char *key);
+    bool remove(const char *key);
+    bool clear();
+
+    size_t putBool(const char *key, bool value);
+    size_t putUChar(const char *key, uint8_t value);
+    size_t putUShort(const char *key, uint16_t value);
+    size_t putUInt(const char *key, uint32_t value);
+    size_t putFloat(const char *key, float value);
+    size_t putString(const char *key, const char *value);
+    size_t putBytes(const char *key, const void *value, size_t len);
+
+    bool getBool(const char *key, bool defaultValue = false);
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0);
+    uint16_t getUShort(const char *key, uint16_t defaultValue = 0);
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0);
+    float getFloat(const char *key, float defaultValue = NAN);
+    size_t getString(const char *key, char *value, size_t maxLen);
+    size_t getBytesLength(const char *key);
+    size_t getBytes(const char *key, void *buf, size_t maxLen);
+
+private:
+    size_t put(const char *key, const void *value, size_t len);
+    bool get(const char *key, void *value, size_t len);
+
+    char ns_[16] = {};
+    bool open_ = false;
+    bool readOnly_ = false;
+};
+
+// Natif uniquement : efface tous les espaces de noms (premier démarrage)
+void kvStoreNativeReset();
+// Natif uniquement : nombre d'écritures depuis le lancement (usure flash)
+uint32_t kvStoreNativeWrites();
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * HAL horloge / ordonnancement.
+ * - Cible : fonctions inline sur millis(), esp_timer, FreeRTOS et
+ *   gettimeofday() (l'horloge murale continue pendant le deep sleep).
+ * - NATIVE_BUILD : horloge virtuelle (hal/native/time_native.cpp) ; les
+ *   attentes font avancer le temps sans dormir, une simulation d'une journée
+ *   tourne en quelques secondes et de façon reproductible.
+ */
+#ifndef NATIVE_BUILD
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+
+inline uint32_t halMillis() { return millis(); }
+inline uint64_t halMicros() { return (uint64_t)esp_timer_get_time(); }
+inline void halDelayMs(uint32_t ms) { vTaskDelay(pdMS_TO_TICKS(ms)); }
+// Compteur de cycles du cœur courant (CCOUNT) et sa fréquence
+inline uint32_t halCycles() { return ESP.getCycleCount(); }
+inline uint32_t halCyclesPerUs() { return getCpuFrequencyMhz(); }
+
+inline int64_t halWallClockMs()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+// Section sans préemption sur ce cœur (copie d'un enregistrement partagé)
+inline void halSchedulerLock() { vTaskSuspendAll(); }
+inline void halSchedulerUnlock() { xTaskResumeAll(); }
+#else
+uint32_t halMillis();
+uint64_t halMicros();
+void halDelayMs(uint32_t ms);
+uint32_t halCycles(); // horloge monotone réelle de l'hôte, en ns
+uint32_t halCyclesPerUs();
+int64_t halWallClockMs();
+void halSchedulerLock();
+void halSchedulerUnlock();
+
+// Natif uniquement : pilotage de l'horloge virtuelle
+void halClockAdvanceUs(uint64_t us);
+void halClockSetWallMs(int64_t epochMs);
+#endif
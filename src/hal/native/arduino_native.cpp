@@ -0,0 +1,33 @@
+#include <Arduino.h>
+#include <thread>
+
+NativeSerial Serial;
+
+size_t NativeSerial::printf(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vprintf(fmt, ap);
+    va_end(ap);
+    return n > 0 ? (size_t)n : 0;
+}
+
+size_t halStrlcpy(char *dst, const char *src, size_t size)
+{
+    const size_t len = strlen(src);
+    if (size > 0)
+    {
+        const size_t n = (len >= size) ? size - 1 : len;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *, uint32_t, void *arg, UBaseType_t, TaskHandle_t *handle)
+{
+    std::thread(fn, arg).detach();
+    if (handle)
+        *handle = nullptr;
+    return pdPASS;
+}
@@ -0,0 +1,283 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "broker_native.h"
+
+uint64_t brokerNowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static bool readAll(int fd, uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        const ssize_t n = recv(fd, buf, len, 0);
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        const ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// En-tête fixe : type + longueur restante (entier variable, 4 octets max)
+static size_t putHeader(uint8_t *out, uint8_t type, size_t remaining)
+{
+    size_t n = 0;
+    out[n++] = type;
+    do
+    {
+        uint8_t b = remaining % 128;
+        remaining /= 128;
+        if (remaining)
+            b |= 0x80;
+        out[n++] = b;
+    } while (remaining);
+    return n;
+}
+
+static bool readPacket(int fd, uint8_t &type, uint8_t *body, size_t cap, size_t &len)
+{
+    if (!readAll(fd, &type, 1))
+        return false;
+    len = 0;
+    for (int shift = 0; shift < 28; shift += 7)
+    {
+        uint8_t b;
+        if (!readAll(fd, &b, 1))
+            return false;
+        len |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return len <= cap && readAll(fd, body, len);
+    }
+    return false;
+}
+
+static size_t putString(uint8_t *out, const char *s)
+{
+    const size_t n = strlen(s);
+    out[0] = (uint8_t)(n >> 8);
+    out[1] = (uint8_t)n;
+    memcpy(out + 2, s, n);
+    return n + 2;
+}
+
+bool NativeBroker::start(uint16_t port)
+{
+    clear();
+    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd_ < 0)
+        return false;
+    // Relance sur le port précédent malgré les sessions fermées en TIME_WAIT
+    const int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    socklen_t alen = sizeof(addr);
+    if (bind(listenFd_, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd_, 16) != 0 ||
+        getsockname(listenFd_, (sockaddr *)&addr, &alen) != 0)
+    {
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+    running_ = true;
+    acceptThread_ = std::thread([this]()
+                                { acceptLoop(); });
+    return true;
+}
+
+void NativeBroker::stop()
+{
+    running_ = false;
+    if (listenFd_ >= 0)
+    {
+        // accept() rend la main, puis le descripteur peut être fermé
+        shutdown(listenFd_, SHUT_RDWR);
+        if (acceptThread_.joinable())
+            acceptThread_.join();
+        close(listenFd_);
+        listenFd_ = -1;
+    }
+    // Chaque serve() voit la fin de flux, ferme son socket et se retire
+    std::lock_guard<std::mutex> lk(clientsMutex_);
+    for (const int fd : clients_)
+        shutdown(fd, SHUT_RDWR);
+}
+
+void NativeBroker::clear()
+{
+    published_ = 0;
+    connects_ = 0;
+    for (auto &t : receivedNs_)
+        t.store(0, std::memory_order_relaxed);
+}
+
+void NativeBroker::acceptLoop()
+{
+    while (running_)
+    {
+        const int fd = accept(listenFd_, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINVAL || errno == EBADF)
+                break;
+            continue;
+        }
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        {
+            std::lock_guard<std::mutex> lk(clientsMutex_);
+            if (!running_)
+            {
+                close(fd);
+                break;
+            }
+            clients_.insert(fd);
+        }
+        std::thread([this, fd]()
+                    { serve(fd); })
+            .detach();
+    }
+}
+
+void NativeBroker::serve(int fd)
+{
+    static const uint8_t CONNACK[] = {0x20, 0x02, 0x00, 0x00};
+    static const uint8_t PINGRESP[] = {0xD0, 0x00};
+    uint8_t body[4096];
+    uint8_t type;
+    size_t len;
+    while (readPacket(fd, type, body, sizeof(body), len))
+    {
+        const uint8_t kind = type >> 4;
+        if (kind == 1)
+        {
+            connects_++;
+            if (!writeAll(fd, CONNACK, sizeof(CONNACK)))
+                break;
+        }
+        else if (kind == 3 && len >= 2)
+        {
+            // QoS 0 : sujet puis charge, sans identifiant de paquet
+            const size_t topicLen = ((size_t)body[0] << 8) | body[1];
+            if (2 + topicLen > len)
+                break;
+            const uint64_t now = brokerNowNs();
+            body[len < sizeof(body) ? len : sizeof(body) - 1] = '\0';
+            const uint32_t n = (uint32_t)strtoul((const char *)body + 2 + topicLen, nullptr, 10);
+            if (n < MAX_TRACKED)
+                receivedNs_[n].store(now, std::memory_order_relaxed);
+            published_.fetch_add(1, std::memory_order_release);
+        }
+        else if (kind == 12)
+        {
+            if (!writeAll(fd, PINGRESP, sizeof(PINGRESP)))
+                break;
+        }
+        else if (kind == 14)
+        {
+            break;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lk(clientsMutex_);
+        clients_.erase(fd);
+    }
+    close(fd);
+}
+
+int mqttHostConnect(uint16_t port, const char *clientId)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    // CONNECT 3.1.1, session propre, keep-alive 15 s (valeur de PubSubClient)
+    uint8_t vh[256];
+    size_t n = putString(vh, "MQTT");
+    vh[n++] = 4;
+    vh[n++] = 0x02;
+    vh[n++] = 0;
+    vh[n++] = 15;
+    n += putString(vh + n, clientId);
+    uint8_t pkt[264];
+    const size_t h = putHeader(pkt, 0x10, n);
+    memcpy(pkt + h, vh, n);
+
+    uint8_t ack[4];
+    if (!writeAll(fd, pkt, h + n) || !readAll(fd, ack, sizeof(ack)) || ack[0] != 0x20 || ack[3] != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool mqttHostPublish(int fd, const char *topic, const char *payload)
+{
+    uint8_t pkt[4096];
+    const size_t tlen = strlen(topic), plen = strlen(payload);
+    const size_t remaining = 2 + tlen + plen;
+    if (remaining + 5 > sizeof(pkt))
+        return false;
+    size_t n = putHeader(pkt, 0x30, remaining);
+    n += putString(pkt + n, topic);
+    memcpy(pkt + n, payload, plen);
+    return writeAll(fd, pkt, n + plen);
+}
+
+void mqttHostDisconnect(int fd)
+{
+    static const uint8_t DISCONNECT[] = {0xE0, 0x00};
+    writeAll(fd, DISCONNECT, sizeof(DISCONNECT));
+    close(fd);
+}
+
+bool mqttHostPoll(int fd)
+{
+    uint8_t buf[64];
+    for (;;)
+    {
+        const ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0)
+            continue;
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+
+/**
+ * Broker MQTT 3.1.1 minimal sur la boucle locale, pour le banc de
+ * publication de [env:native] : CONNECT -> CONNACK, PINGREQ -> PINGRESP,
+ * PUBLISH QoS 0 compté et horodaté à réception, DISCONNECT. Un thread par
+ * connexion ; les charges commencent par "<numéro>|" pour que le banc
+ * retrouve l'instant d'envoi de chaque message. stop() coupe aussi les
+ * sessions ouvertes et start(port) peut relancer sur le même port, pour
+ * simuler une panne du broker.
+ */
+class NativeBroker
+{
+public:
+    static const uint32_t MAX_TRACKED = 65536;
+
+    bool start(uint16_t port = 0); // 0 : port éphémère sur 127.0.0.1
+    void stop();                   // ferme l'écoute et les sessions clientes
+    uint16_t port() const { return port_; }
+
+    uint32_t published() const { return published_.load(std::memory_order_acquire); }
+    uint32_t connects() const { return connects_.load(std::memory_order_acquire); }
+    // Instant de réception (ns, horloge monotone) du message n, 0 si absent
+    uint64_t receivedNs(uint32_t n) const { return n < MAX_TRACKED ? receivedNs_[n].load() : 0; }
+    void clear();
+
+private:
+    void acceptLoop();
+    void serve(int fd);
+
+    int listenFd_ = -1;
+    uint16_t port_ = 0;
+    std::thread acceptThread_;
+    std::mutex clientsMutex_;
+    std::set<int> clients_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint32_t> published_{0};
+    std::atomic<uint32_t> connects_{0};
+    std::atomic<uint64_t> receivedNs_[MAX_TRACKED];
+};
+
+// Côté client : les échanges que PubSubClient fait sur le socket
+uint64_t brokerNowNs();
+int mqttHostConnect(uint16_t port, const char *clientId); // socket prêt (CONNACK reçu), -1 si échec
+bool mqttHostPublish(int fd, const char *topic, const char *payload);
+void mqttHostDisconnect(int fd);
+// Vide ce que le broker a envoyé (PINGRESP) ; false si la connexion est fermée
+bool mqttHostPoll(int fd);
@@ -0,0 +1,98 @@
+#include <math.h>
+#include "echo_sim.h"
+#include "../hal_time.h"
+#include "../../config.h"
+
+static const uint32_t SIM_TRIGGER_LATENCY_US = 450; // burst 40 kHz avant le front montant
+static const float SIM_US_PER_CM = 1.0f / 0.01715f;  // aller-retour à 343 m/s
+
+uint64_t SimEchoSource::lastArmUs_ = 0;
+const SimEchoSource *SimEchoSource::lastArmed_ = nullptr;
+uint64_t SimEchoSource::minCrossGapUs_ = UINT64_MAX;
+uint32_t SimEchoSource::inFlight_ = 0;
+
+SimEchoSource &simEchoSource(uint8_t ch)
+{
+    static SimEchoSource sources[SENSOR_CHANNELS];
+    return sources[ch];
+}
+
+EchoSource &sensorEchoSource(uint8_t ch)
+{
+    return simEchoSource(ch);
+}
+
+void SimEchoSource::setNoise(float sigmaCm, float dropoutRate, float spikeRate)
+{
+    sigmaCm_ = sigmaCm;
+    dropoutRate_ = dropoutRate;
+    spikeRate_ = spikeRate;
+}
+
+float SimEchoSource::uniform()
+{
+    // xorshift32
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    return (rng_ >> 8) * (1.0f / 16777216.0f);
+}
+
+float SimEchoSource::gaussian()
+{
+    // Box-Muller
+    const float u1 = uniform() + 1e-7f;
+    const float u2 = uniform();
+    return sqrtf(-2.0f * logf(u1)) * cosf(6.2831853f * u2);
+}
+
+void SimEchoSource::startPing()
+{
+    armUs_ = halMicros();
+    if (lastArmed_ && lastArmed_ != this && armUs_ - lastArmUs_ < minCrossGapUs_)
+        minCrossGapUs_ = armUs_ - lastArmUs_;
+    lastArmed_ = this;
+    lastArmUs_ = armUs_;
+    capture_.arm(armUs_);
+    pings_++;
+    inFlight_++;
+}
+
+uint32_t SimEchoSource::waitPulseUs(uint32_t timeoutUs)
+{
+    lastTrueCm_ = distanceFn_ ? distanceFn_(armUs_, ctx_) : 100.0f;
+
+    float cm = -1.0f;
+    if (uniform() >= dropoutRate_)
+    {
+        cm = lastTrueCm_ + sigmaCm_ * gaussian();
+        if (uniform() < spikeRate_)
+            cm = 20.0f + uniform() * 30.0f; // écho parasite (paroi, condensation)
+    }
+
+    if (cm > 0.0f)
+    {
+        const uint64_t rise = armUs_ + SIM_TRIGGER_LATENCY_US;
+        const uint64_t fall = rise + (uint64_t)(cm * SIM_US_PER_CM);
+        if (fall - armUs_ < timeoutUs)
+        {
+            capture_.onEdge(true, rise);
+            capture_.onEdge(false, fall);
+        }
+    }
+
+    // Le temps de vol (ou la fenêtre complète) s'écoule sur l'horloge virtuelle
+    const uint64_t end = (capture_.state() == EchoCapture::State::Done)
+                             ? armUs_ + SIM_TRIGGER_LATENCY_US + capture_.pulseUs()
+                             : armUs_ + timeoutUs;
+    const uint64_t now = halMicros();
+    if (end > now)
+        halClockAdvanceUs(end - now);
+
+    capture_.poll(halMicros(), timeoutUs);
+    const uint32_t pulse = (capture_.state() == EchoCapture::State::Done) ? capture_.pulseUs() : 0;
+    capture_.reset();
+    if (inFlight_ > 0)
+        inFlight_--;
+    return pulse;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "../../echo_source.h"
+
+/**
+ * Source d'écho simulée pour [env:native].
+ * Génère les fronts montant/descendant d'un JSN-SR04T (latence, bruit
+ * gaussien, échos manqués, échos parasites) et les injecte dans EchoCapture,
+ * comme le ferait l'ISR GPIO. Le temps de vol fait avancer l'horloge
+ * virtuelle. Générateur pseudo-aléatoire à graine fixe : runs reproductibles.
+ */
+class SimEchoSource : public EchoSource
+{
+public:
+    // Distance vraie (cm) à l'instant tUs
+    typedef float (*DistanceFn)(uint64_t tUs, void *ctx);
+
+    void setDistance(DistanceFn fn, void *ctx)
+    {
+        distanceFn_ = fn;
+        ctx_ = ctx;
+    }
+    void setNoise(float sigmaCm, float dropoutRate, float spikeRate);
+    void seed(uint32_t s) { rng_ = s ? s : 1; }
+
+    bool begin() override { return true; }
+    void startPing() override;
+    uint32_t waitPulseUs(uint32_t timeoutUs) override;
+
+    uint32_t pings() const { return pings_; }
+    float lastTrueCm() const { return lastTrueCm_; }
+    // Plus petit écart entre les déclenchements de deux sources différentes
+    // (UINT64_MAX si une seule source a servi) : contrôle anti-diaphonie
+    static uint64_t minCrossGapUs() { return minCrossGapUs_; }
+    static void resetCrossGap()
+    {
+        lastArmed_ = nullptr;
+        minCrossGapUs_ = UINT64_MAX;
+    }
+    // Un ping déclenché et pas encore collecté (flash/réseau interdits)
+    static bool anyInFlight() { return inFlight_ > 0; }
+
+private:
+    float uniform();
+    float gaussian();
+
+    EchoCapture capture_;
+    DistanceFn distanceFn_ = nullptr;
+    void *ctx_ = nullptr;
+    float sigmaCm_ = 0.3f;
+    float dropoutRate_ = 0.02f;
+    float spikeRate_ = 0.01f;
+    uint32_t rng_ = 0x12345678u;
+    uint64_t armUs_ = 0;
+    uint32_t pings_ = 0;
+    float lastTrueCm_ = 0.0f;
+
+    static uint64_t lastArmUs_;
+    static const SimEchoSource *lastArmed_;
+    static uint64_t minCrossGapUs_;
+    static uint32_t inFlight_;
+};
+
+// Instances utilisées par sensorEchoSource() en natif (une par canal)
+SimEchoSource &simEchoSource(uint8_t ch = 0);
@@ -0,0 +1,161 @@
+#pragma once
+
+/**
+ * Substitut minimal d'Arduino.h pour l'environnement [env:native].
+ * Fournit uniquement ce qu'utilisent les modules portables : String,
+ * Serial vers stdout,
+ * millis()/delay() sur l'horloge virtuelle et les quelques primitives
+ * FreeRTOS appelées hors des modules matériels.
+ */
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "../../hal_time.h"
+
+#define RTC_DATA_ATTR
+#define IRAM_ATTR
+#define PROGMEM
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+// glibc < 2.38 : pas de strlcpy
+size_t halStrlcpy(char *dst, const char *src, size_t size);
+#define strlcpy halStrlcpy
+
+inline uint32_t millis() { return halMillis(); }
+inline uint32_t micros() { return (uint32_t)halMicros(); }
+inline void delay(uint32_t ms) { halDelayMs(ms); }
+
+// ---------- String ----------
+class String
+{
+public:
+    String(const char *s = "") { assign(s); }
+    String(const std::string &s) : s_(s) {}
+    String(const String &) = default;
+    String &operator=(const String &) = default;
+    String &operator=(const char *s)
+    {
+        assign(s);
+        return *this;
+    }
+
+    const char *c_str() const { return s_.c_str(); }
+    unsigned int length() const { return (unsigned int)s_.size(); }
+    bool isEmpty() const { return s_.empty(); }
+    char operator[](unsigned int i) const { return i < s_.size() ? s_[i] : '\0'; }
+
+    bool concat(const char *s)
+    {
+        if (s)
+            s_ += s;
+        return true;
+    }
+    bool concat(char c)
+    {
+        s_ += c;
+        return true;
+    }
+    String &operator+=(const String &o)
+    {
+        s_ += o.s_;
+        return *this;
+    }
+    String &operator+=(const char *s)
+    {
+        concat(s);
+        return *this;
+    }
+
+    String substring(unsigned int from, unsigned int to = 0xFFFFFFFFu) const
+    {
+        if (from >= s_.size() || to <= from)
+            return String();
+        return String(s_.substr(from, to - from));
+    }
+    int indexOf(char c) const
+    {
+        const size_t p = s_.find(c);
+        return p == std::string::npos ? -1 : (int)p;
+    }
+    int toInt() const { return atoi(s_.c_str()); }
+    float toFloat() const { return (float)atof(s_.c_str()); }
+
+    bool operator==(const String &o) const { return s_ == o.s_; }
+    bool operator==(const char *s) const { return s && s_ == s; }
+    bool operator!=(const String &o) const { return s_ != o.s_; }
+
+private:
+    void assign(const char *s) { s_ = s ? s : ""; }
+    std::string s_;
+};
+
+// Type de retour de String + String, comme sur Arduino
+class StringSumHelper : public String
+{
+public:
+    StringSumHelper(const String &s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String &a, const String &b)
+{
+    StringSumHelper r(a);
+    r += b;
+    return r;
+}
+inline StringSumHelper operator+(const String &a, const char *b)
+{
+    StringSumHelper r(a);
+    r += b;
+    return r;
+}
+
+// ---------- Serial ----------
+class NativeSerial
+{
+public:
+    void begin(unsigned long) {}
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char *s) { return fputs(s, stdout) >= 0 ? strlen(s) : 0; }
+    size_t write(const uint8_t *buf, size_t n) { return fwrite(buf, 1, n, stdout); }
+    size_t print(const String &s) { return print(s.c_str()); }
+    size_t print(int v) { return printf("%d", v); }
+    size_t print(unsigned int v) { return printf("%u", v); }
+    size_t print(long v) { return printf("%ld", v); }
+    size_t print(unsigned long v) { return printf("%lu", v); }
+    size_t print(double v) { return printf("%.2f", v); }
+    size_t println() { return print("\n"); }
+    template <typename T>
+    size_t println(const T &v)
+    {
+        const size_t n = print(v);
+        return n + println();
+    }
+};
+extern NativeSerial Serial;
+
+// ---------- FreeRTOS (sous-ensemble) ----------
+typedef void *TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void (*TaskFunction_t)(void *);
+#define pdPASS 1
+#define pdFAIL 0
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+inline void vTaskDelay(TickType_t ticks) { halDelayMs(ticks); }
+// Tâche exécutée sur un thread hôte détaché
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t prio, TaskHandle_t *handle);
+inline void vTaskDelete(TaskHandle_t) {}
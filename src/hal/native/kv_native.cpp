@@ -0,0 +1,183 @@
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../hal_kv.h"
+
+// Espaces de noms -> clés -> octets bruts (partagés par toutes les instances,
+// comme la partition NVS)
+using KvNamespace = std::map<std::string, std::vector<uint8_t>>;
+static std::map<std::string, KvNamespace> kvData;
+static std::mutex kvMutex;
+static uint32_t kvWrites = 0;
+
+void kvStoreNativeReset()
+{
+    std::lock_guard<std::mutex> lk(kvMutex);
+    kvData.clear();
+}
+
+uint32_t kvStoreNativeWrites()
+{
+    std::lock_guard<std::mutex> lk(kvMutex);
+    return kvWrites;
+}
+
+bool KvStore::begin(const char *name, bool readOnly)
+{
+    if (!name || strlen(name) >= sizeof(ns_))
+        return false;
+    strcpy(ns_, name);
+    readOnly_ = readOnly;
+    open_ = true;
+    return true;
+}
+
+void KvStore::end()
+{
+    open_ = false;
+}
+
+bool KvStore::isKey(const char *key)
+{
+    std::lock_guard<std::mutex> lk(kvMutex);
+    if (!open_)
+        return false;
+    const KvNamespace &ns = kvData[ns_];
+    return ns.find(key) != ns.end();
+}
+
+bool KvStore::remove(const char *key)
+{
+    std::lock_guard<std::mutex> lk(kvMutex);
+    if (!open_ || readOnly_)
+        return false;
+    if (kvData[ns_].erase(key) == 0)
+        return false;
+    kvWrites++; // effacement d'une entrée : écriture flash sur cible
+    return true;
+}
+
+bool KvStore::clear()
+{
+    std::lock_guard<std::mutex> lk(kvMutex);
+    if (!open_ || readOnly_)
+        return false;
+    kvData[ns_].clear();
+    return true;
+}
+
+size_t KvStore::put(const char *key, const void *value, size_t len)
+{
+    std::lock_guard<std::mutex> lk(kvMutex);
+    if (!open_ || readOnly_ || !key)
+        return 0;
+    const uint8_t *p = static_cast<const uint8_t *>(value);
+    kvData[ns_][key].assign(p, p + len);
+    kvWrites++;
+    return len;
+}
+
+bool KvStore::get(const char *key, void *value, size_t len)
+{
+    std::lock_guard<std::mutex> lk(kvMutex);
+    if (!open_ || !key)
+        return false;
+    const KvNamespace &ns = kvData[ns_];
+    auto it = ns.find(key);
+    if (it == ns.end() || it->second.size() != len)
+        return false;
+    memcpy(value, it->second.data(), len);
+    return true;
+}
+
+size_t KvStore::putBool(const char *key, bool value)
+{
+    const uint8_t v = value ? 1 : 0;
+    return put(key, &v, sizeof(v));
+}
+
+size_t KvStore::putUChar(const char *key, uint8_t value) { return put(key, &value, sizeof(value)); }
+size_t KvStore::putUShort(const char *key, uint16_t value) { return put(key, &value, sizeof(value)); }
+size_t KvStore::putUInt(const char *key, uint32_t value) { return put(key, &value, sizeof(value)); }
+size_t KvStore::putFloat(const char *key, float value) { return put(key, &value, sizeof(value)); }
+
+size_t KvStore::putString(const char *key, const char *value)
+{
+    if (!value)
+        return 0;
+    return put(key, value, strlen(value) + 1);
+}
+
+size_t KvStore::putBytes(const char *key, const void *value, size_t len)
+{
+    return put(key, value, len);
+}
+
+bool KvStore::getBool(const char *key, bool defaultValue)
+{
+    uint8_t v;
+    return get(key, &v, sizeof(v)) ? v != 0 : defaultValue;
+}
+
+uint8_t KvStore::getUChar(const char *key, uint8_t defaultValue)
+{
+    uint8_t v;
+    return get(key, &v, sizeof(v)) ? v : defaultValue;
+}
+
+uint16_t KvStore::getUShort(const char *key, uint16_t defaultValue)
+{
+    uint16_t v;
+    return get(key, &v, sizeof(v)) ? v : defaultValue;
+}
+
+uint32_t KvStore::getUInt(const char *key, uint32_t defaultValue)
+{
+    uint32_t v;
+    return get(key, &v, sizeof(v)) ? v : defaultValue;
+}
+
+float KvStore::getFloat(const char *key, float defaultValue)
+{
+    float v;
+    return get(key, &v, sizeof(v)) ? v : defaultValue;
+}
+
+size_t KvStore::getString(const char *key, char *value, size_t maxLen)
+{
+    std::lock_guard<std::mutex> lk(kvMutex);
+    if (!open_ || !key || !value || maxLen == 0)
+        return 0;
+    const KvNamespace &ns = kvData[ns_];
+    auto it = ns.find(key);
+    // Comme Preferences : échec (0) si le tampon est trop petit
+    if (it == ns.end() || it->second.size() > maxLen)
+        return 0;
+    memcpy(value, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+size_t KvStore::getBytesLength(const char *key)
+{
+    std::lock_guard<std::mutex> lk(kvMutex);
+    if (!open_ || !key)
+        return 0;
+    const KvNamespace &ns = kvData[ns_];
+    auto it = ns.find(key);
+    return it == ns.end() ? 0 : it->second.size();
+}
+
+size_t KvStore::getBytes(const char *key, void *buf, size_t maxLen)
+{
+    std::lock_guard<std::mutex> lk(kvMutex);
+    if (!open_ || !key || !buf)
+        return 0;
+    const KvNamespace &ns = kvData[ns_];
+    auto it = ns.find(key);
+    if (it == ns.end() || it->second.size() > maxLen)
+        return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+}
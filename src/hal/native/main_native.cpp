@@ -0,0 +1,1936 @@
+#include <Arduino.h>
+#include <chrono>
+#include "../../config.h"
+#include "../../config_manager.h"
+#include "../../history_store.h"
+#include "../../level_kalman.h"
+#include "../../http_negotiation.h"
+#include "../../logger.h"
+#include "../../measurement.h"
+#include "../../measurement_store.h"
+#include "../../median_filter.h"
+#include "../../metrics.h"
+#include "../../mqtt_session.h"
+#include "../../rtc_batch.h"
+#include "../../rtc_config_cache.h"
+#include "../../seqlock.h"
+#include "../../tank_geometry.h"
+#include "../../wake_profile.h"
+#include "../../web_assets.h"
+#include "../hal_fs.h"
+#include "../hal_kv.h"
+#include "broker_native.h"
+#include "echo_sim.h"
+#include "net_native.h"
+#include <atomic>
+#include <condition_variable>
+#include <fcntl.h>
+#include <mutex>
+#include <new>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+
+// Compteur d'allocations du programme (banc JSON : allocations par requête)
+static std::atomic<uint32_t> heapAllocs{0};
+
+void *operator new(size_t n)
+{
+    heapAllocs++;
+    void *p = malloc(n ? n : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+/**
+ * Simulation hôte du pipeline de mesure ([env:native]) :
+ *   .pio/build/native/program [durée_s] [steady|drain|fill]
+ * sensorStep() tourne sur l'horloge virtuelle avec la source d'écho simulée ;
+ * le résumé (pings, erreur de suivi, coût CPU hôte par cycle, trafic MQTT)
+ * sert de référence pour les régressions de performance.
+ */
+
+struct Scenario
+{
+    const char *name;
+    float startCm;
+    float endCm;
+    uint64_t durationUs;
+};
+
+static float scenarioDistance(uint64_t tUs, void *ctx)
+{
+    const Scenario &sc = *static_cast<const Scenario *>(ctx);
+    if (strcmp(sc.name, "steady") == 0)
+        return sc.startCm;
+
+    // Rampe sur le premier tiers, palier ensuite (remplissage/vidange puis repos)
+    const float k = (float)tUs / (float)(sc.durationUs / 3);
+    if (k >= 1.0f)
+        return sc.endCm;
+    return sc.startCm + (sc.endCm - sc.startCm) * k;
+}
+
+// Migration de l'ancien format par clés, relecture du blob et sauvegarde sans
+// changement (qui ne doit rien écrire)
+static bool configRoundTrip()
+{
+    ConfigManager &cm = ConfigManager::instance();
+    KvStore kv;
+    kv.begin("config", false);
+    kv.putString("wifi_ssid", "maison");
+    kv.putString("mqtt_pass", "secret");
+    kv.putUShort("mqtt_port", 1884);
+    kv.putFloat("kf_r_cm", 0.8f);
+    kv.putUChar("tank_shape", 2);
+    kv.end();
+
+    cm.begin();
+    logFlush(); // pas de tâche logDrain sur l'hôte : vidage explicite
+    const AppConfig migrated = cm.getConfig();
+    kv.begin("config", true);
+    const bool legacyGone = !kv.isKey("wifi_ssid") && !kv.isKey("mqtt_port") && kv.isKey("cfg_blob");
+    kv.end();
+    const bool migOk = legacyGone && strcmp(migrated.wifi_ssid, "maison") == 0 &&
+                       strcmp(migrated.mqtt_pass, "secret") == 0 && migrated.mqtt_port == 1884 &&
+                       migrated.kalman_r_cm == 0.8f && migrated.tank_shape == 2 &&
+                       migrated.median_delay_ms == 50 && migrated.batch_threshold_cm == 5.0f;
+
+    const uint32_t writes = kvStoreNativeWrites();
+    cm.save();
+    const bool diffOk = kvStoreNativeWrites() == writes;
+
+    cm.begin(); // relecture depuis le blob seul
+    logFlush();
+    const bool reloadOk = ConfigManager::countChangedFields(cm.getConfig(), migrated) == 0 &&
+                          kvStoreNativeWrites() == writes;
+
+    // Écriture différée : deux modifications rapprochées, une seule écriture
+    cm.updateFromJson("{\"mqtt_port\":1885}");
+    cm.updateFromJson("{\"mqtt_port\":1886}");
+    const uint32_t t0 = halMillis();
+    const bool deferred = kvStoreNativeWrites() == writes && cm.savePending() && !cm.flushIfDue(t0 + 500);
+    const bool flushed = cm.flushIfDue(t0 + 2500) && !cm.savePending() && kvStoreNativeWrites() == writes + 1;
+    cm.begin();
+    logFlush();
+    const bool wbOk = deferred && flushed && cm.getConfig().mqtt_port == 1886;
+
+    printf("config: migration %s, sauvegarde sans changement %s, relecture %s, écriture différée %s\n",
+           migOk ? "ok" : "ÉCHEC", diffOk ? "ok" : "ÉCHEC", reloadOk ? "ok" : "ÉCHEC", wbOk ? "ok" : "ÉCHEC");
+    return migOk && diffOk && reloadOk && wbOk;
+}
+
+// Analyse incrémentale de POST /api/config : cas refusés, découpage
+// arbitraire en blocs (même verdict qu'en un bloc) et corps mutés
+struct ParseCase
+{
+    const char *body;
+    const char *err; // nullptr : accepté
+};
+
+static void feedChunks(ConfigUpdate &u, const char *body, size_t len, uint32_t &rng)
+{
+    size_t pos = 0;
+    while (pos < len)
+    {
+        rng = rng * 1664525u + 1013904223u;
+        size_t n = 1 + (rng >> 8) % 97;
+        if (n > len - pos)
+            n = len - pos;
+        u.feed((const uint8_t *)body + pos, n);
+        pos += n;
+    }
+}
+
+static bool sameVerdict(const ConfigUpdate &a, const ConfigUpdate &b)
+{
+    return a.done() == b.done() && a.error() == b.error() && a.errorField() == b.errorField();
+}
+
+static bool configParseChecks(const char *getBody)
+{
+    static const ParseCase cases[] = {
+        {"{\"device_name\":\"cuve \\u00e9t\\u00e9 \\ud83d\\udca7\",\"unknown\":[1]}", "nested value not supported"},
+        {"{\"device_name\":\"cuve \\u00e9t\\u00e9 \\ud83d\\udca7\",\"unknown\":-1.5e2} ", nullptr},
+        {"{\"mqtt_port\":70000}", "integer out of range"},
+        {"{\"mqtt_port\":\"1883\"}", "integer expected"},
+        {"{\"median_n\":2.5}", "integer out of range"},
+        {"{\"mqtt_enabled\":1}", "boolean expected"},
+        {"{\"tank_shape\":\"cube\"}", "unknown tank shape"},
+        {"{\"device_name\":\"0123456789012345678901234567890123\"}", "string too long"},
+        {"{\"device_name\":\"\\ud83d\"}", "unpaired surrogate"},
+        {"{\"kalman_q\":1e-4,}", "key expected"},
+        {"{\"kalman_q\":nul}", "invalid literal"},
+        {"{\"kalman_q\":1}x", "trailing data"},
+        {"[]", "object expected"},
+    };
+    bool ok = true;
+    for (const ParseCase &c : cases)
+    {
+        ConfigUpdate u;
+        u.feed((const uint8_t *)c.body, strlen(c.body));
+        const bool pass = c.err ? (u.error() && strcmp(u.error(), c.err) == 0) : (u.done() && !u.error());
+        if (!pass)
+        {
+            printf("  parse %s -> %s (attendu %s)\n", c.body, u.error() ? u.error() : "ok", c.err ? c.err : "ok");
+            ok = false;
+        }
+    }
+
+    // Aller-retour : le JSON de GET (secrets masqués, version en lecture seule)
+    // renvoyé tel quel ne change rien
+    const AppConfig before = ConfigManager::instance().getConfig();
+    {
+        ConfigUpdate u;
+        u.feed((const uint8_t *)getBody, strlen(getBody));
+        ok = ok && ConfigManager::instance().applyUpdate(u) &&
+             ConfigManager::countChangedFields(before, ConfigManager::instance().getConfig()) == 0;
+    }
+
+    uint32_t rng = 12345;
+    const size_t len = strlen(getBody);
+    static char mutated[CONFIG_BODY_MAX];
+    int rejected = 0;
+    const int N = 20000;
+    for (int i = 0; i < N && ok; i++)
+    {
+        memcpy(mutated, getBody, len);
+        size_t mlen = len;
+        for (int m = 0; m < 1 + i % 4; m++)
+        {
+            rng = rng * 1664525u + 1013904223u;
+            const size_t at = (rng >> 8) % mlen;
+            const uint32_t op = rng & 3;
+            if (op == 0)
+                mutated[at] = (char)(rng >> 24); // octet quelconque
+            else if (op == 1)
+                mutated[at] = "{}[]\",:\\0e-."[(rng >> 24) % 12];
+            else if (op == 2 && mlen > 1)
+                memmove(mutated + at, mutated + at + 1, --mlen - at); // suppression
+            else if (mlen < sizeof(mutated))
+            {
+                memmove(mutated + at + 1, mutated + at, mlen++ - at); // doublon
+            }
+        }
+        ConfigUpdate whole, split;
+        whole.feed((const uint8_t *)mutated, mlen);
+        feedChunks(split, mutated, mlen, rng);
+        if (!sameVerdict(whole, split))
+        {
+            printf("  fuzz #%d : verdict dépendant du découpage\n", i);
+            ok = false;
+        }
+        if (!whole.done() || whole.error())
+            rejected++;
+    }
+    printf("config POST: cas %s, aller-retour GET->POST %s, fuzz %d corps mutés (%d refusés) %s\n",
+           ok ? "ok" : "ÉCHEC", ok ? "ok" : "ÉCHEC", N, rejected, ok ? "ok" : "ÉCHEC");
+    return ok;
+}
+
+// Banc de l'analyse POST /api/config : corps complet de GET découpé en
+// segments TCP, débit, allocations et mémoire par requête (zone fixe)
+static void configParseBench(const char *body)
+{
+    const int N = 20000;
+    const size_t len = strlen(body);
+    const size_t mss = 536;
+    const uint32_t a0 = heapAllocs.load();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++)
+    {
+        ConfigUpdate u;
+        for (size_t pos = 0; pos < len; pos += mss)
+            u.feed((const uint8_t *)body + pos, len - pos < mss ? len - pos : mss);
+        if (!u.done())
+            break;
+    }
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    printf("  %-17s %5u o/req  %6.1f o/us  %.2f alloc/req  %u o de mémoire/req\n", "post cfg", (unsigned)len,
+           len * (double)N / us, (double)(heapAllocs.load() - a0) / N, (unsigned)sizeof(ConfigUpdate));
+}
+
+// Banc des charges JSON : octets par requête, débit (octets/us) et
+// allocations par requête, chaque charge sérialisée N fois
+template <typename Fn>
+static void jsonBench(const char *name, Fn fn)
+{
+    const int N = 20000;
+    static char buf[2048];
+    size_t bytes = 0;
+    const uint32_t a0 = heapAllocs.load();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++)
+    {
+        JsonWriter w(buf, sizeof(buf));
+        fn(w);
+        bytes += w.length();
+    }
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    printf("  %-17s %5u o/req  %6.1f o/us  %.2f alloc/req\n", name, (unsigned)(bytes / N), bytes / us,
+           (double)(heapAllocs.load() - a0) / N);
+}
+
+// Anciens constructeurs, rejoués tels quels dans le même banc : la chaîne est
+// recopiée dans le tampon comme request->send(String) la recopiait dans la
+// réponse. Le String hôte (std::string) a un petit tampon interne et une
+// croissance géométrique : ses allocations sont une borne basse de celles du
+// String Arduino. L'ancien GET /api/config (JsonDocument puis String) n'est
+// pas rejouable ici : ArduinoJson ne fait pas partie du build hôte.
+static String legacyCalibsJson(uint8_t ch)
+{
+    const CalibrationPtr t = calibrationSnapshot(ch);
+    char tmp[128];
+    snprintf(tmp, sizeof(tmp), "{\"model\":\"%s\",\"degree\":%u,\"valid\":%s,\"max\":%d,\"calibs\":[",
+             CalibrationTable::modelName(t ? t->model() : CalibModel::Poly), t ? t->polyDegree() : 2,
+             (t && t->valid()) ? "true" : "false", CALIB_MAX_POINTS);
+    String s = tmp;
+    const size_t n = t ? t->count() : 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        const CalibPoint &p = t->point(i);
+        snprintf(tmp, sizeof(tmp), "%s{\"index\":%u,\"measured\":%.2f,\"height\":%.2f}", (i ? "," : ""),
+                 (unsigned)i, p.measuredCm, p.heightCm);
+        s += tmp;
+    }
+    s += "]}";
+    return s;
+}
+
+static void jsonBenchmarks(const MeasurementSet &set)
+{
+    const MeasurementRecord &rec = set.ch[0];
+    static RtcBatch batch;
+    batchEnsureValid(batch);
+    MeasurementSet reading = set;
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+        {
+            reading.ch[ch].measuredCm = 100.0f + i + ch;
+            reading.ch[ch].estimatedCm = 50.0f + i + ch;
+        }
+        batchPush(batch, 1000 + i * 30, reading);
+    }
+    static WakeProfileRing ring;
+    wakeRingEnsureValid(ring);
+    SystemStats sys{};
+
+    printf("JSON (JsonWriter, tampon fixe):\n");
+    jsonBench("distance", [&](JsonWriter &w)
+              { writeDistanceJson(w, rec, 200.0f, 20.0f); });
+    jsonBench("measure", [&](JsonWriter &w)
+              { w.beginObject(); writeMeasureFields(w, rec); w.endObject(); });
+    jsonBench("batch10", [&](JsonWriter &w)
+              {
+        w.beginObject();
+        batchWriteJson(w, batch, set, 1400);
+        w.field("wifi_ms", 120u);
+        wakeProfileWriteJson(w, ring);
+        w.endObject(); });
+    // Lot plein : dimensionne le tampon du réveil (RTC_BATCH_PAYLOAD_LEN, rtc_batch.h)
+    for (uint32_t i = 10; i < RTC_BATCH_CAPACITY; i++)
+        batchPush(batch, 1000 + i * 30, reading);
+    jsonBench("batchmax", [&](JsonWriter &w)
+              {
+        w.beginObject();
+        batchWriteJson(w, batch, set, 1400 + RTC_BATCH_CAPACITY * 30);
+        w.field("wifi_ms", 120u);
+        wakeProfileWriteJson(w, ring);
+        w.endObject(); });
+    jsonBench("diag", [&](JsonWriter &w)
+              { char d[640]; metricsFormatJson(sys, d, sizeof(d)); w.raw(d); });
+    jsonBench("config", [](JsonWriter &w)
+              { ConfigManager::instance().writeJson(w); });
+    const CalibrationPtr calib = calibrationSnapshot(0);
+    printf("JSON, constructeur actuel contre ancien (calibs : %u points) :\n", (unsigned)(calib ? calib->count() : 0));
+    jsonBench("calibs", [](JsonWriter &w)
+              { writeCalibsJson(w, 0); });
+    jsonBench("calibs String+=", [](JsonWriter &w)
+              { w.raw(legacyCalibsJson(0).c_str()); });
+    volatile bool published = true;
+    jsonBench("send_mqtt", [&](JsonWriter &w)
+              { w.raw(published ? "{\"ok\":true}" : "{\"ok\":false}"); });
+    jsonBench("send_mqtt String+", [&](JsonWriter &w)
+              { w.raw((String("{\"ok\":") + (published ? "true" : "false") + "}").c_str()); });
+
+    char body[CONFIG_BODY_MAX];
+    JsonWriter w(body, sizeof(body));
+    ConfigManager::instance().writeJson(w);
+    configParseBench(body);
+}
+
+// Banc du journal : coût par appel côté producteur, comparé à l'ancien
+// DEBUG_PRINTF (Serial.printf synchrone, ici vers /dev/null : borne basse,
+// l'USB CDC de la carte bloque quand son tampon est plein)
+static size_t logSinkBytes = 0;
+
+static void countingSink(void *, const char *, size_t len)
+{
+    logSinkBytes += len;
+}
+
+static void logBenchmarks()
+{
+    const int N = 100000;
+    const int BATCH = LOG_RING_SLOTS / 2;
+    typedef std::chrono::steady_clock Clock;
+
+    logFlush();
+    fflush(stdout);
+    const int savedOut = dup(1);
+    const int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, 1);
+    auto t0 = Clock::now();
+    for (int i = 0; i < N; i++)
+        Serial.printf("[WEB] GET %s (%u o gzip)\n", "/script.js", (unsigned)i);
+    fflush(stdout);
+    const double oldNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / N;
+    dup2(savedOut, 1);
+    close(devNull);
+    close(savedOut);
+
+    // Producteurs par lots d'une demi-file, vidage (tâche logDrain) mesuré à part
+    logSetSink(countingSink, nullptr);
+    const uint8_t webLevel = logLevel(LogModule::Web);
+    logSetLevel(LogModule::Web, LOG_LEVEL_INFO);
+    const uint32_t a0 = heapAllocs.load();
+    double prodNs = 0.0, drainNs = 0.0;
+    for (int i = 0; i < N; i += BATCH)
+    {
+        t0 = Clock::now();
+        for (int j = 0; j < BATCH; j++)
+            LOG_I(Web, "GET %s (%u o gzip)", "/script.js", (unsigned)(i + j));
+        const auto t1 = Clock::now();
+        logFlush();
+        prodNs += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        drainNs += std::chrono::duration<double, std::nano>(Clock::now() - t1).count();
+    }
+    const uint32_t allocs = heapAllocs.load() - a0;
+
+    t0 = Clock::now();
+    for (int i = 0; i < N; i++)
+        LOG_D(Web, "GET %s (%u o gzip)", "/script.js", (unsigned)i);
+    const double filteredNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / N;
+    const bool filteredOk = logFlush() == 0;
+
+    logSetLevel(LogModule::Web, webLevel);
+    logSetSink(nullptr, nullptr);
+    printf("journal (ns/appel): DEBUG_PRINTF %.0f ; LOG_I %.0f (+ vidage %.0f hors chemin chaud, %.2f alloc) ;"
+           " LOG_D filtré %.1f%s ; sous LOG_LEVEL_MAX : absent du binaire\n",
+           oldNs, prodNs / N, drainNs / N, (double)allocs / N, filteredNs, filteredOk ? "" : " (ÉCHEC)");
+}
+
+// Publication MQTT face à un broker local (NativeBroker, TCP sur la boucle
+// locale). Ancien chemin : connexion, CONNECT, PUBLISH, delay(50) et
+// DISCONNECT à chaque message, appelant bloqué tout du long. Nouveau : la
+// boucle de la tâche MQTT (MqttSession::step, mqtt_session.cpp) vidant une
+// file de MQTT_QUEUE_LEN mesures remplie sans attente. Latence = appel ->
+// réception par le broker.
+class BrokerSessionIo : public MqttSessionIo
+{
+public:
+    static const uint32_t LEN = 8; // MQTT_QUEUE_LEN (mqtt.cpp)
+
+    BrokerSessionIo(const NativeBroker &broker, const MeasurementSet &set) : broker_(broker), set_(set) {}
+
+    bool tryPush(uint32_t n) // xQueueSend(..., 0)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (count_ == LEN)
+                return false;
+            items_[(head_ + count_++) % LEN] = n;
+        }
+        cv_.notify_one();
+        return true;
+    }
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+    }
+    bool stopped()
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        return stop_;
+    }
+    void disconnect()
+    {
+        if (fd_ >= 0)
+            mqttHostDisconnect(fd_);
+        fd_ = -1;
+    }
+    uint32_t connectAttempts() const { return attempts_; }
+
+    bool connected() override { return fd_ >= 0; }
+    bool connect() override
+    {
+        attempts_++;
+        fd_ = mqttHostConnect(broker_.port(), "M5CoreS3-bench");
+        return fd_ >= 0;
+    }
+    // Le numéro de message voyage à côté de la mesure : publish() le remet
+    // en tête de la charge formatée par la session
+    bool receive(MeasurementSet &set, uint32_t waitMs) override
+    {
+        std::unique_lock<std::mutex> lk(m_);
+        if (!cv_.wait_for(lk, std::chrono::milliseconds(waitMs), [this]()
+                          { return count_ > 0 || stop_; }) ||
+            count_ == 0)
+            return false;
+        pending_ = items_[head_];
+        head_ = (head_ + 1) % LEN;
+        count_--;
+        set = set_;
+        return true;
+    }
+    bool publish(const char *payload) override
+    {
+        snprintf(buf_, sizeof(buf_), "%u|%s", (unsigned)pending_, payload);
+        if (mqttHostPublish(fd_, "m5/puits", buf_))
+            return true;
+        close(fd_); // PubSubClient : échec d'écriture = session perdue
+        fd_ = -1;
+        return false;
+    }
+    void loop() override
+    {
+        if (fd_ >= 0 && !mqttHostPoll(fd_))
+        {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+private:
+    const NativeBroker &broker_;
+    const MeasurementSet &set_;
+    int fd_ = -1;
+    uint32_t attempts_ = 0;
+    std::mutex m_;
+    std::condition_variable cv_;
+    uint32_t items_[LEN];
+    uint32_t head_ = 0, count_ = 0, pending_ = 0;
+    bool stop_ = false;
+    char buf_[MQTT_MEASURE_PAYLOAD_LEN + 16];
+};
+
+static bool waitPublished(const NativeBroker &broker, uint32_t n)
+{
+    const uint64_t deadline = brokerNowNs() + 5000000000ULL;
+    while (broker.published() < n)
+    {
+        if (brokerNowNs() > deadline)
+            return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+// Passages de la tâche jusqu'à ce que la coupure soit vue (loop()), sur
+// l'horloge simulée nowMs
+static bool waitSessionLost(MqttSession &session, BrokerSessionIo &io, uint32_t &nowMs)
+{
+    for (int i = 0; i < 100 && io.connected(); i++)
+        nowMs += session.step(io, nowMs);
+    return !io.connected();
+}
+
+// Broker arrêté puis relancé sur le même port, horloge simulée (la tâche
+// attend ce que step() retourne) : intervalles entre tentatives 1, 2, 4 ...
+// 32 s puis plafond MQTT_BACKOFF_MAX_MS, retour au minimum après la
+// reconnexion, mesures gardées en file pendant la panne puis publiées.
+static bool mqttBackoffCheck(NativeBroker &broker, const MeasurementSet &set)
+{
+    BrokerSessionIo io(broker, set);
+    MqttSession session;
+    uint32_t nowMs = 0;
+    const uint16_t port = broker.port();
+    broker.clear();
+
+    bool ok = io.tryPush(0) && session.step(io, nowMs) == 0 && waitPublished(broker, 1);
+    broker.stop();
+    ok = ok && waitSessionLost(session, io, nowMs);
+    for (uint32_t i = 1; i <= 3; i++)
+        ok = ok && io.tryPush(i);
+
+    static const uint32_t EXPECTED[] = {1000, 2000, 4000, 8000, 16000, 32000, 60000, 60000};
+    const uint32_t N = sizeof(EXPECTED) / sizeof(EXPECTED[0]);
+    uint32_t intervals[N] = {};
+    uint32_t lastAttempt = 0, seen = io.connectAttempts(), k = 0;
+    while (ok && k <= N)
+    {
+        const uint32_t wait = session.step(io, nowMs);
+        ok = wait > 0 && wait <= MQTT_RETRY_POLL_MS;
+        if (io.connectAttempts() != seen)
+        {
+            seen = io.connectAttempts();
+            if (k > 0)
+                intervals[k - 1] = nowMs - lastAttempt;
+            lastAttempt = nowMs;
+            k++;
+        }
+        nowMs += wait;
+    }
+    for (uint32_t i = 0; i < N; i++)
+        ok = ok && intervals[i] == EXPECTED[i];
+    ok = ok && session.backoffMs() == MQTT_BACKOFF_MAX_MS;
+    const uint32_t capped = session.backoffMs();
+
+    // Relance : connexion à l'échéance suivante, backoff remis au minimum,
+    // file vidée
+    ok = ok && broker.start(port);
+    broker.clear();
+    for (int i = 0; i < 1000 && ok && !io.connected(); i++)
+        nowMs += session.step(io, nowMs);
+    ok = ok && io.connected() && nowMs - lastAttempt == MQTT_BACKOFF_MAX_MS &&
+         session.backoffMs() == MQTT_BACKOFF_MIN_MS;
+    for (int i = 0; i < 3 && ok; i++)
+        ok = session.step(io, nowMs) == 0;
+    ok = ok && waitPublished(broker, 3) && broker.connects() == 1;
+    for (uint32_t i = 1; i <= 3 && ok; i++)
+        ok = broker.receivedNs(i) != 0;
+
+    // Nouvelle panne : première tentative immédiate, la suivante après le minimum
+    broker.stop();
+    ok = ok && waitSessionLost(session, io, nowMs);
+    const uint32_t before = io.connectAttempts();
+    session.step(io, nowMs);
+    ok = ok && io.connectAttempts() == before + 1 && session.nextAttemptMs() - nowMs == MQTT_BACKOFF_MIN_MS;
+    const bool restarted = broker.start(port);
+    io.disconnect();
+
+    printf("MQTT backoff (broker arrêté/relancé): tentatives après %u, %u, %u ... %u ms, plafond %u ms,"
+           " %u mesures en file publiées à la reprise, backoff remis à %u ms %s\n",
+           (unsigned)intervals[0], (unsigned)intervals[1], (unsigned)intervals[2], (unsigned)intervals[N - 1],
+           (unsigned)capped, 3u, (unsigned)MQTT_BACKOFF_MIN_MS, ok ? "ok" : "ÉCHEC");
+    return ok && restarted;
+}
+
+static bool mqttSessionBench(const MeasurementSet &set)
+{
+    static NativeBroker broker;
+    if (!broker.start())
+    {
+        printf("MQTT (broker local): socket indisponible, banc ignoré\n");
+        return true;
+    }
+    static const char *TOPIC = "m5/puits";
+    static char json[MQTT_MEASURE_PAYLOAD_LEN];
+    formatMeasureSetJson(set, json, sizeof(json));
+    static uint64_t sentNs[NativeBroker::MAX_TRACKED];
+    char payload[MQTT_MEASURE_PAYLOAD_LEN + 16];
+
+    // Ancien chemin : une connexion par message
+    const uint32_t OLD_N = 20;
+    double oldCallNs = 0.0, oldLatNs = 0.0;
+    uint64_t t0 = brokerNowNs();
+    for (uint32_t i = 0; i < OLD_N; i++)
+    {
+        sentNs[i] = brokerNowNs();
+        const int fd = mqttHostConnect(broker.port(), "M5CoreS3-bench");
+        if (fd < 0)
+            break;
+        snprintf(payload, sizeof(payload), "%u|%s", (unsigned)i, json);
+        mqttHostPublish(fd, TOPIC, payload);
+        usleep(50000); // delay(50) avant DISCONNECT
+        mqttHostDisconnect(fd);
+        oldCallNs += brokerNowNs() - sentNs[i];
+    }
+    bool ok = waitPublished(broker, OLD_N);
+    const double oldRate = OLD_N * 1e9 / (brokerNowNs() - t0);
+    for (uint32_t i = 0; i < OLD_N && ok; i++)
+        oldLatNs += broker.receivedNs(i) - sentNs[i];
+    ok = ok && broker.connects() == OLD_N;
+
+    // Session persistante : la boucle de mqttTask, attente réelle
+    broker.clear();
+    BrokerSessionIo io(broker, set);
+    std::thread task([&]()
+                     {
+        MqttSession session;
+        while (!io.stopped())
+        {
+            const uint32_t waitMs = session.step(io, (uint32_t)(brokerNowNs() / 1000000ULL));
+            if (waitMs > 0)
+                usleep(waitMs * 1000);
+        }
+        io.disconnect(); });
+
+    // Latence : un message à la fois
+    const uint32_t LAT_N = 2000;
+    double callNs = 0.0, latNs = 0.0, latMaxNs = 0.0;
+    for (uint32_t i = 0; i < LAT_N && ok; i++)
+    {
+        sentNs[i] = brokerNowNs();
+        ok = io.tryPush(i);
+        callNs += brokerNowNs() - sentNs[i];
+        ok = ok && waitPublished(broker, i + 1);
+        const double lat = ok ? (double)(broker.receivedNs(i) - sentNs[i]) : 0.0;
+        latNs += lat;
+        if (lat > latMaxNs)
+            latMaxNs = lat;
+    }
+    // Débit : l'appelant réessaie quand la file est pleine (sur cible, la
+    // mesure serait ignorée) ; refus comptés
+    const uint32_t TP_N = 20000;
+    uint32_t full = 0;
+    t0 = brokerNowNs();
+    for (uint32_t i = LAT_N; i < LAT_N + TP_N && ok; i++)
+    {
+        while (!io.tryPush(i))
+        {
+            full++;
+            std::this_thread::yield();
+        }
+    }
+    ok = ok && waitPublished(broker, LAT_N + TP_N);
+    const double rate = TP_N * 1e9 / (brokerNowNs() - t0);
+    io.stop();
+    task.join();
+    ok = ok && broker.connects() == 1;
+
+    printf("MQTT (broker local): connexion par message : appel bloquant %.1f ms, latence %.2f ms, %.1f msg/s ;"
+           " session persistante : appel %.2f us, latence %.1f us (max %.0f us), %.0f msg/s (file pleine %u fois) %s\n",
+           oldCallNs / OLD_N / 1e6, oldLatNs / OLD_N / 1e6, oldRate, callNs / LAT_N / 1e3, latNs / LAT_N / 1e3,
+           latMaxNs / 1e3, rate, (unsigned)full, ok ? "ok" : "ÉCHEC");
+
+    ok = mqttBackoffCheck(broker, set) && ok;
+    broker.stop();
+    return ok;
+}
+
+// Médiane glissante comparée à la référence "tri de la fenêtre" (l'ancien
+// code de measureDistanceStable) : valeurs en double, rejets min/max,
+// fenêtres 1..15 rebouclées de nombreuses fois ; puis coût par valeur émise
+// face à l'ancienne rafale de N pings triée
+static float medianTestValue(uint32_t &rng)
+{
+    rng = rng * 1664525u + 1013904223u;
+    const uint32_t r = rng >> 8;
+    if (r % 16 == 0)
+        return (r & 16) ? -1.0f : 450.0f; // pas d'écho / hors filtre
+    return 100.0f + (float)(r % 21) * 0.5f; // peu de valeurs distinctes : nombreux doublons
+}
+
+static float sortedWindowMedian(const float *pings, int n, float minCm, float maxCm, uint8_t &valid)
+{
+    float values[MEDIAN_MAX_SAMPLES];
+    int count = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (pings[i] > 0 && pings[i] >= minCm && pings[i] <= maxCm)
+            values[count++] = pings[i];
+    }
+    valid = (uint8_t)count;
+    if (count == 0)
+        return -1.0f;
+    // Tri par insertion (std::sort de l'ancien code : même ordre, mais GCC 12
+    // y voit à tort un dépassement sur un tableau de 15)
+    for (int i = 1; i < count; i++)
+    {
+        const float v = values[i];
+        int j = i;
+        for (; j > 0 && values[j - 1] > v; j--)
+            values[j] = values[j - 1];
+        values[j] = v;
+    }
+    return values[count / 2];
+}
+
+static bool medianChecks()
+{
+    const float minCm = 2.0f, maxCm = 400.0f;
+    uint32_t rng = 777;
+    bool ok = true;
+    long compared = 0;
+    SlidingMedian m;
+    for (uint16_t window = 1; window <= MEDIAN_MAX_SAMPLES && ok; window++)
+    {
+        m.configure(window, minCm, maxCm);
+        float last[MEDIAN_MAX_SAMPLES];
+        int n = 0;
+        for (int i = 0; i < 5000 && ok; i++)
+        {
+            const float v = medianTestValue(rng);
+            m.push(v);
+            if (n == window)
+                memmove(last, last + 1, (window - 1) * sizeof(float));
+            else
+                n++;
+            last[n - 1] = v;
+            uint8_t valid;
+            const float ref = sortedWindowMedian(last, n, minCm, maxCm, valid);
+            if (m.median() != ref || m.validCount() != valid)
+            {
+                printf("  médiane fenêtre %u, ping %d : %.2f/%u au lieu de %.2f/%u\n", window, i, m.median(),
+                       m.validCount(), ref, valid);
+                ok = false;
+            }
+            compared++;
+        }
+    }
+    // Changement de fenêtre : repart de zéro ; bornes seules : fenêtre gardée
+    m.configure(5, minCm, maxCm);
+    m.push(10.0f);
+    m.configure(5, minCm, 300.0f);
+    ok = ok && m.validCount() == 1;
+    m.configure(7, minCm, maxCm);
+    ok = ok && m.validCount() == 0 && m.median() == -1.0f;
+
+    // Bornes resserrées : les valeurs déjà dans la fenêtre et désormais hors
+    // plage sont rejetées (référence : fenêtre où elles valent -1), y compris
+    // pendant le renouvellement de la fenêtre ; élargir ne les réintègre pas
+    bool boundsOk = true;
+    for (int round = 0; round < 200 && boundsOk; round++)
+    {
+        const uint16_t window = (uint16_t)(1 + round % MEDIAN_MAX_SAMPLES);
+        float lo = minCm, hi = maxCm;
+        m.configure(window, lo, hi);
+        m.reset();
+        float last[MEDIAN_MAX_SAMPLES];
+        int n = 0;
+        for (int i = 0; i < 3 * window && boundsOk; i++)
+        {
+            if (i == window)
+            {
+                lo = 20.0f + (float)(rng % 100);
+                hi = lo + 50.0f + (float)(rng % 200);
+                m.configure(window, lo, hi);
+                for (int k = 0; k < n; k++)
+                    if (!(last[k] >= lo && last[k] <= hi))
+                        last[k] = -1.0f;
+            }
+            else if (i == 2 * window)
+            {
+                lo = minCm;
+                hi = maxCm;
+                m.configure(window, lo, hi);
+            }
+            const float v = medianTestValue(rng);
+            m.push(v);
+            if (n == window)
+                memmove(last, last + 1, (window - 1) * sizeof(float));
+            else
+                n++;
+            last[n - 1] = (v >= lo && v <= hi) ? v : -1.0f;
+            uint8_t valid;
+            const float ref = sortedWindowMedian(last, n, lo, hi, valid);
+            boundsOk = m.median() == ref && m.validCount() == valid;
+        }
+    }
+    ok = ok && boundsOk;
+
+    // Banc : même flux de pings, une valeur émise par ping (glissante) ou
+    // par rafale de N pings (tri)
+    const int PINGS = 1500000;
+    const uint16_t N = 5;
+    static float pings[PINGS];
+    for (float &p : pings)
+        p = medianTestValue(rng);
+    volatile float sink = 0.0f;
+    m.configure(N, minCm, maxCm);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < PINGS; i++)
+    {
+        m.push(pings[i]);
+        sink = sink + m.median();
+    }
+    const double slideNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i + N <= PINGS; i += N)
+    {
+        uint8_t valid;
+        sink = sink + sortedWindowMedian(pings + i, N, minCm, maxCm, valid);
+    }
+    const double sortNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    printf("médiane glissante: %ld comparaisons au tri, fenêtres 1..%d, changement de bornes %s %s ; N=%u : "
+           "%.1f ns et 1 ping par valeur (tri par rafale : %.1f ns et %u pings)\n",
+           compared, MEDIAN_MAX_SAMPLES, boundsOk ? "ok" : "ÉCHEC", ok ? "ok" : "ÉCHEC", N, slideNs / PINGS,
+           sortNs / (PINGS / N), N);
+    return ok;
+}
+
+// Lecture de config par cycle de mesure (six champs) : getters d'origine
+// (mutex + copie de travail, reproduits ici), copie complète getConfig(),
+// instantané pris à chaque cycle, et ConfigView mise en cache
+template <typename Fn>
+static void configBench(const char *name, Fn cycle)
+{
+    const int N = 2000000;
+    volatile float sink = 0.0f;
+    const uint32_t a0 = heapAllocs.load();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++)
+        sink = sink + cycle();
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / N;
+    printf("  %-10s %6.1f ns/cycle  %.2f alloc/cycle\n", name, ns, (double)(heapAllocs.load() - a0) / N);
+}
+
+static std::mutex legacyMutex;
+static AppConfig legacyConfig;
+
+static float lockedGet(float AppConfig::*field)
+{
+    std::lock_guard<std::mutex> lk(legacyMutex);
+    return legacyConfig.*field;
+}
+
+static void configReadBench()
+{
+    legacyConfig = ConfigManager::instance().getConfig();
+    printf("config, 6 champs par cycle de mesure:\n");
+    configBench("mutex", []()
+                { return lockedGet(&AppConfig::measure_offset_cm) + lockedGet(&AppConfig::filter_min_cm) +
+                         lockedGet(&AppConfig::filter_max_cm) + lockedGet(&AppConfig::kalman_q) +
+                         lockedGet(&AppConfig::kalman_r_cm) + lockedGet(&AppConfig::adaptive_rate_cm_min); });
+    configBench("getConfig", []()
+                {
+        AppConfig c;
+        {
+            std::lock_guard<std::mutex> lk(legacyMutex);
+            c = legacyConfig;
+        }
+        return c.measure_offset_cm + c.filter_min_cm + c.filter_max_cm + c.kalman_q + c.kalman_r_cm +
+               c.adaptive_rate_cm_min; });
+    configBench("snapshot", []()
+                {
+        const ConfigPtr c = ConfigManager::instance().snapshot();
+        return c->measure_offset_cm + c->filter_min_cm + c->filter_max_cm + c->kalman_q + c->kalman_r_cm +
+               c->adaptive_rate_cm_min; });
+    ConfigView view;
+    configBench("ConfigView", [&]()
+                {
+        const AppConfig &c = view.get();
+        return c.measure_offset_cm + c.filter_min_cm + c.filter_max_cm + c.kalman_q + c.kalman_r_cm +
+               c.adaptive_rate_cm_min; });
+}
+
+// Seqlock sous contention : un écrivain, plusieurs lecteurs sur des threads
+// hôtes. Chaque valeur écrite a tous ses mots égaux : une copie mélangeant
+// deux écritures (lecture déchirée) est détectée ; les versions lues par un
+// lecteur ne doivent jamais reculer. Latence de lecture moyenne et max, et
+// lectures abandonnées (écrivain ayant doublé le lecteur à chaque tentative).
+// Enregistrement volontairement gros : la copie dure assez longtemps pour
+// être interrompue même sur un hôte mono-cœur (préemption en pleine copie).
+struct StressRecord
+{
+    uint32_t words[1024];
+};
+
+static bool seqlockStress()
+{
+    const int READERS = 3;
+    const uint32_t WRITES = 300000;
+    static SeqLock<StressRecord> lock;
+    std::atomic<bool> done{false};
+    struct ReaderStats
+    {
+        uint64_t reads = 0, torn = 0, backwards = 0, abandoned = 0;
+        double ns = 0.0, maxNs = 0.0;
+    } stats[READERS];
+
+    std::thread readers[READERS];
+    for (int r = 0; r < READERS; r++)
+    {
+        readers[r] = std::thread([&, r]()
+                                 {
+            ReaderStats &st = stats[r];
+            uint32_t lastVersion = 0;
+            StressRecord v;
+            while (!done.load(std::memory_order_relaxed))
+            {
+                const auto t0 = std::chrono::steady_clock::now();
+                const uint32_t version = lock.read(v);
+                const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+                st.ns += ns;
+                if (ns > st.maxNs)
+                    st.maxNs = ns;
+                st.reads++;
+                if (version == 0 && lastVersion > 0)
+                {
+                    st.abandoned++;
+                    continue;
+                }
+                for (uint32_t w : v.words)
+                {
+                    if (w != v.words[0])
+                    {
+                        st.torn++;
+                        break;
+                    }
+                }
+                if (version < lastVersion || v.words[0] != version)
+                    st.backwards++;
+                lastVersion = version;
+            } });
+    }
+
+    static StressRecord rec;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 1; i <= WRITES; i++)
+    {
+        for (uint32_t &w : rec.words)
+            w = i;
+        lock.write(rec);
+    }
+    const double writeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / WRITES;
+    done = true;
+    ReaderStats total;
+    for (int r = 0; r < READERS; r++)
+    {
+        readers[r].join();
+        total.reads += stats[r].reads;
+        total.torn += stats[r].torn;
+        total.backwards += stats[r].backwards;
+        total.abandoned += stats[r].abandoned;
+        total.ns += stats[r].ns;
+        if (stats[r].maxNs > total.maxNs)
+            total.maxNs = stats[r].maxNs;
+    }
+    const bool ok = total.torn == 0 && total.backwards == 0 && total.reads > 0 && lock.version() == WRITES;
+    printf("seqlock: %u écritures (%.0f ns), %d lecteurs %llu lectures, déchirées %llu, versions en recul %llu %s ;"
+           " lecture moyenne %.0f ns, max %.1f us, abandonnées %llu (%d tentatives max)\n",
+           (unsigned)WRITES, writeNs, READERS, (unsigned long long)total.reads, (unsigned long long)total.torn,
+           (unsigned long long)total.backwards, ok ? "ok" : "ÉCHEC", total.reads ? total.ns / total.reads : 0.0,
+           total.maxNs / 1000.0, (unsigned long long)total.abandoned, SEQLOCK_READ_RETRIES);
+    return ok;
+}
+
+// Capture d'écho : séquences de fronts (parasites, hors fenêtre, rebouclage
+// des horodatages 32 bits), puis largeur rendue par la source simulée sans
+// bruit comparée à la distance vraie, et coût CPU d'une capture
+static float fixedDistance(uint64_t, void *ctx)
+{
+    return *static_cast<const float *>(ctx);
+}
+
+static bool captureChecks()
+{
+    typedef EchoCapture::State St;
+    EchoCapture c;
+    bool seqOk = true;
+    c.arm(1000);
+    seqOk = seqOk && !c.onEdge(false, 1100);                  // descente avant la montée : ignorée
+    seqOk = seqOk && !c.onEdge(true, 1450) && c.onEdge(false, 7280);
+    seqOk = seqOk && c.poll(40000, ECHO_TIMEOUT_US) == St::Done && c.pulseUs() == 5830;
+    seqOk = seqOk && !c.onEdge(true, 9000) && c.state() == St::Done; // après la fin : ignoré
+    c.reset();
+    seqOk = seqOk && !c.onEdge(true, 10000) && c.state() == St::Idle; // non armée
+    c.arm(0);
+    seqOk = seqOk && c.poll(ECHO_TIMEOUT_US - 1, ECHO_TIMEOUT_US) == St::Armed &&
+            c.poll(ECHO_TIMEOUT_US, ECHO_TIMEOUT_US) == St::Timeout;
+    c.arm(0);
+    c.onEdge(true, 500);
+    seqOk = seqOk && c.poll(ECHO_TIMEOUT_US, ECHO_TIMEOUT_US) == St::Timeout && !c.onEdge(false, 30100) &&
+            c.pulseUs() == 0;
+
+    // Horodatages de part et d'autre de 2^32 µs
+    const uint64_t wrap = 0xFFFFFF00ull;
+    c.arm(wrap);
+    c.onEdge(true, wrap + 0x80);
+    seqOk = seqOk && c.onEdge(false, wrap + 0x80 + 4000) && c.pulseUs() == 4000 &&
+            c.poll(wrap + 5000, ECHO_TIMEOUT_US) == St::Done;
+    c.arm(wrap);
+    seqOk = seqOk && c.poll(wrap + 1000, ECHO_TIMEOUT_US) == St::Armed &&
+            c.poll(wrap + ECHO_TIMEOUT_US, ECHO_TIMEOUT_US) == St::Timeout;
+
+    // Source simulée sans bruit : conversion identique à measureDistanceCmOnce()
+    SimEchoSource sim;
+    float trueCm = 0.0f;
+    sim.setDistance(fixedDistance, &trueCm);
+    sim.setNoise(0.0f, 0.0f, 0.0f);
+    double errMax = 0.0, flightUs = 0.0;
+    int n = 0;
+    bool simOk = true;
+    for (trueCm = 20.0f; trueCm <= 600.0f; trueCm += 7.3f)
+    {
+        const uint64_t t0 = halMicros();
+        const uint32_t pulse = sim.pingUs(ECHO_TIMEOUT_US);
+        const uint64_t spent = halMicros() - t0;
+        if (pulse == 0)
+        {
+            // Hors portée : rien de capturé, fenêtre complète écoulée
+            simOk = simOk && spent >= ECHO_TIMEOUT_US && trueCm * 58.3f > ECHO_TIMEOUT_US - 1000;
+            continue;
+        }
+        const double err = fabs(pulse * 0.01715 - trueCm);
+        if (err > errMax)
+            errMax = err;
+        flightUs += pulse;
+        n++;
+    }
+    simOk = simOk && n > 0 && errMax < 0.02;
+    SimEchoSource::resetCrossGap(); // pings de test hors contrôle anti-diaphonie
+
+    // Coût d'une capture complète (armement, deux fronts, fin, remise à zéro)
+    const int N = 1000000;
+    volatile uint32_t sink = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++)
+    {
+        const uint64_t t = (uint64_t)i * 40000u;
+        c.arm(t);
+        c.onEdge(true, t + 450);
+        c.onEdge(false, t + 450 + (i & 0x3FFF));
+        c.poll(t + 20000, ECHO_TIMEOUT_US);
+        sink += c.pulseUs();
+        c.reset();
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / N;
+    printf("capture écho: séquences %s, source simulée %s (%d pings, erreur max %.4f cm) ; "
+           "CPU %.1f ns/ping contre %.0f us d'attente active (pulseInLong)\n",
+           seqOk ? "ok" : "ÉCHEC", simOk ? "ok" : "ÉCHEC", n, errMax, ns, n ? flightUs / n : 0.0);
+    return seqOk && simOk;
+}
+
+// Historique : intervalle minute/heure ouvert repris après flush() + redémarrage,
+// plafond commun somme/compte (anneaux dédiés sous HAL_FS_ROOT "/hchk")
+static bool lastRecord(HistoryStore &h, HistoryTier tier, HistoryRecord &r, size_t &n)
+{
+    HistoryRecord recs[4];
+    n = h.readLatest(tier, recs, 4);
+    if (n)
+        r = recs[n - 1];
+    return n > 0;
+}
+
+static bool historyChecks()
+{
+    static const char *dir = HAL_FS_ROOT "/hchk";
+    mkdir(dir, 0755);
+    const char *files[] = {"hist_raw.bin", "hist_min.bin", "hist_hour.bin"};
+    char path[64];
+    for (const char *f : files)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, f);
+        unlink(path);
+    }
+
+    const uint32_t t0 = 1700000000u - 1700000000u % 3600;
+    HistoryRecord r{};
+    size_t n = 0;
+    bool resumeOk;
+    {
+        HistoryStore a(dir);
+        a.begin();
+        for (uint32_t i = 0; i < 10; i++)
+            a.append(t0 + i, 100.0f);
+        a.flush(); // veille : intervalles ouverts écrits
+    }
+    {
+        HistoryStore b(dir);
+        b.begin();
+        resumeOk = b.readLatest(HistoryTier::Minute, &r, 1) == 0; // ouvert : invisible
+        for (uint32_t i = 10; i < 20; i++)
+            b.append(t0 + i, 200.0f);
+        b.append(t0 + 60, 150.0f); // clôt la minute 0
+        resumeOk = resumeOk && lastRecord(b, HistoryTier::Minute, r, n) && n == 1 && r.tS == t0 &&
+                   r.count == 20 && r.meanMm == 1500 && r.minMm == 1000 && r.maxMm == 2000;
+        b.flush();
+    }
+    {
+        HistoryStore c(dir);
+        c.begin();
+        c.append(t0 + 3600, 100.0f); // clôt l'heure 0
+        resumeOk = resumeOk && lastRecord(c, HistoryTier::Hour, r, n) && n == 1 && r.count == 21 &&
+                   r.meanMm == 1500 && lastRecord(c, HistoryTier::Minute, r, n) && n == 2 && r.count == 1;
+    }
+
+    // Saturation : au-delà de HISTORY_COUNT_MAX, min/max suivis mais la
+    // moyenne reste celle des mesures comptées
+    bool capOk;
+    {
+        for (const char *f : files)
+        {
+            snprintf(path, sizeof(path), "%s/%s", dir, f);
+            unlink(path);
+        }
+        HistoryStore d(dir);
+        d.begin();
+        for (uint32_t i = 0; i < HISTORY_COUNT_MAX + 5000u; i++)
+            d.append(t0 + 7, i < HISTORY_COUNT_MAX ? 100.0f : 300.0f);
+        d.append(t0 + 3600, 100.0f);
+        capOk = lastRecord(d, HistoryTier::Minute, r, n) && r.count == HISTORY_COUNT_MAX && r.meanMm == 1000 &&
+                r.maxMm == 3000 && lastRecord(d, HistoryTier::Hour, r, n) && r.count == HISTORY_COUNT_MAX &&
+                r.meanMm == 1000;
+    }
+    printf("historique: reprise après flush/redémarrage %s, plafond somme/compte %s\n", resumeOk ? "ok" : "ÉCHEC",
+           capOk ? "ok" : "ÉCHEC");
+    return resumeOk && capOk;
+}
+
+// Lot RTC des réveils timer : politique d'envoi (tous les N réveils, anneau
+// plein, variation depuis le dernier envoi), écrasement du plus ancien une
+// fois l'anneau bouclé, remise à zéro après envoi et contenu RTC corrompu
+// (démarrage à froid : la RTC RAM contient n'importe quoi)
+static MeasurementSet batchSet(float cm)
+{
+    MeasurementSet set{};
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+    {
+        set.ch[ch].measuredCm = cm;
+        set.ch[ch].estimatedCm = cm;
+        set.ch[ch].channel = ch;
+    }
+    return set;
+}
+
+static bool batchChecks()
+{
+    static RtcBatch b;
+    const MeasurementSet at100 = batchSet(100.0f);
+
+    memset(&b, 0, sizeof(b));
+    batchEnsureValid(b);
+    bool everyOk = !batchShouldFlush(b, 3, 0.0f, at100);
+    for (uint32_t i = 1; i <= 3; i++)
+    {
+        batchPush(b, i, at100);
+        everyOk = everyOk && batchShouldFlush(b, 3, 0.0f, at100) == (i == 3) && batchShouldFlush(b, 1, 0.0f, at100);
+    }
+
+    batchMarkUploaded(b, at100);
+    bool fullOk = true;
+    for (uint32_t i = 1; i <= RTC_BATCH_CAPACITY; i++)
+    {
+        batchPush(b, i, at100);
+        fullOk = fullOk && batchShouldFlush(b, 1000, 0.0f, at100) == (i == RTC_BATCH_CAPACITY);
+    }
+
+    // Seuil 5 cm sur le dernier canal seulement ; un canal sans mesure ne compte pas
+    batchMarkUploaded(b, at100);
+    batchPush(b, 1, at100);
+    MeasurementSet moved = at100;
+    moved.ch[SENSOR_CHANNELS - 1].measuredCm = 104.9f;
+    bool thresholdOk = !batchShouldFlush(b, 1000, 5.0f, moved);
+    moved.ch[SENSOR_CHANNELS - 1].measuredCm = 105.0f;
+    thresholdOk = thresholdOk && batchShouldFlush(b, 1000, 5.0f, moved) && !batchShouldFlush(b, 1000, 0.0f, moved);
+    moved.ch[SENSOR_CHANNELS - 1].measuredCm = 95.0f;
+    thresholdOk = thresholdOk && batchShouldFlush(b, 1000, 5.0f, moved);
+    moved.ch[SENSOR_CHANNELS - 1].measuredCm = -1.0f;
+    thresholdOk = thresholdOk && !batchShouldFlush(b, 1000, 5.0f, moved);
+
+    // Anneau bouclé : les 48 dernières lectures, de la plus ancienne à la plus récente
+    batchMarkUploaded(b, at100);
+    const uint32_t pushes = RTC_BATCH_CAPACITY + 10;
+    for (uint32_t i = 1; i <= pushes; i++)
+        batchPush(b, i, batchSet((float)i));
+    bool wrapOk = b.count == RTC_BATCH_CAPACITY && b.wakesSinceUpload == pushes;
+    const uint16_t start = (uint16_t)((b.head + RTC_BATCH_CAPACITY - b.count) % RTC_BATCH_CAPACITY);
+    for (uint16_t i = 0; i < b.count; i++)
+    {
+        const BatchReading &r = b.items[(start + i) % RTC_BATCH_CAPACITY];
+        const uint32_t expect = pushes - RTC_BATCH_CAPACITY + 1 + i;
+        wrapOk = wrapOk && r.tS == expect && r.measuredMm[0] == (int16_t)(expect * 10);
+    }
+
+    // Envoi réussi : anneau vide, référence du seuil sur la mesure envoyée,
+    // gardée pour un canal sans mesure valide
+    const MeasurementSet sent = batchSet(120.0f);
+    batchMarkUploaded(b, sent);
+    bool resetOk = b.count == 0 && b.head == 0 && b.wakesSinceUpload == 0 && !batchShouldFlush(b, 3, 5.0f, sent);
+    batchMarkUploaded(b, batchSet(-1.0f));
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+        resetOk = resetOk && b.lastUploadedMm[ch] == 1200;
+    batchPush(b, 1, sent);
+    resetOk = resetOk && b.count == 1 && b.items[0].tS == 1;
+
+    // Contenu valide conservé ; magic, compte ou tête incohérents : lot vidé
+    batchEnsureValid(b);
+    bool corruptOk = b.count == 1;
+    for (int k = 0; k < 4; k++)
+    {
+        memset(&b, 0xA5, sizeof(b));
+        batchEnsureValid(b);
+        batchPush(b, 5, at100);
+        batchMarkUploaded(b, at100);
+        batchPush(b, 6, at100);
+        batchPush(b, 7, at100);
+        if (k == 1)
+            b.count = RTC_BATCH_CAPACITY + 1;
+        else if (k == 2)
+            b.head = RTC_BATCH_CAPACITY;
+        else if (k == 3)
+            b.head = 5; // tête incompatible avec un anneau non bouclé
+        else
+            b.magic ^= 1;
+        batchEnsureValid(b);
+        corruptOk = corruptOk && b.count == 0 && b.head == 0 && b.wakesSinceUpload == 0 &&
+                    b.lastUploadedMm[0] == RTC_BATCH_NO_VALUE && !batchShouldFlush(b, 1, 5.0f, at100);
+    }
+
+    printf("lot RTC: tous les N %s, plein %s, seuil %s, anneau bouclé %s, remise à zéro %s, RTC corrompue %s\n",
+           everyOk ? "ok" : "ÉCHEC", fullOk ? "ok" : "ÉCHEC", thresholdOk ? "ok" : "ÉCHEC", wrapOk ? "ok" : "ÉCHEC",
+           resetOk ? "ok" : "ÉCHEC", corruptOk ? "ok" : "ÉCHEC");
+    return everyOk && fullOk && thresholdOk && wrapOk && resetOk && corruptOk;
+}
+
+// Ancienne EMA (alpha 0.25, rafale de median_n pings toutes les
+// measure_interval_ms) contre Kalman + médiane glissante + période adaptative,
+// rejouées sur les trois scénarios avec le même bruit d'écho. Erreur relevée
+// chaque seconde sur la dernière valeur publiée (celle que voit l'utilisateur).
+struct ReplayCtx
+{
+    Scenario sc;
+    uint64_t t0Us;
+};
+
+static float replayDistance(uint64_t tUs, void *ctx)
+{
+    const ReplayCtx &r = *static_cast<const ReplayCtx *>(ctx);
+    return scenarioDistance(tUs - r.t0Us, (void *)&r.sc);
+}
+
+struct ReplayResult
+{
+    double errMean;
+    double errMax;
+    uint32_t pings;
+};
+
+static ReplayResult replayEstimator(const char *scenario, uint32_t durationS, bool kalman)
+{
+    const ConfigPtr cfg = ConfigManager::instance().snapshot();
+    ReplayCtx ctx{{scenario, 80.0f, 200.0f, (uint64_t)durationS * 1000000ULL}, halMicros()};
+    if (strcmp(scenario, "fill") == 0)
+    {
+        ctx.sc.startCm = 200.0f;
+        ctx.sc.endCm = 80.0f;
+    }
+    SimEchoSource src;
+    src.seed(7);
+    src.setDistance(replayDistance, &ctx);
+
+    SlidingMedian median;
+    median.configure(cfg->median_n, cfg->filter_min_cm, cfg->filter_max_cm);
+    LevelKalman kf;
+    kf.configure(cfg->kalman_q, cfg->kalman_r_cm);
+    AdaptiveScheduler sched;
+    sched.configure(cfg->measure_interval_ms / cfg->median_n, cfg->measure_interval_max_ms,
+                    cfg->adaptive_rate_cm_min / 60.0f);
+    auto ping = [&]()
+    {
+        src.startPing();
+        const uint32_t us = src.waitPulseUs(ECHO_TIMEOUT_US);
+        return us ? us * 0.01715f : -1.0f;
+    };
+
+    float estimate = NAN, ema = NAN;
+    uint64_t lastUs = 0, nextUs = 0;
+    double errSum = 0.0, errMax = 0.0;
+    for (uint32_t g = 1; g <= durationS; g++)
+    {
+        while (nextUs <= (uint64_t)g * 1000000ULL)
+        {
+            const uint64_t now = halMicros() - ctx.t0Us;
+            if (nextUs > now)
+                halDelayMs((uint32_t)((nextUs - now + 999) / 1000));
+            const uint64_t cycleUs = halMicros() - ctx.t0Us;
+            uint32_t periodMs;
+            if (kalman)
+            {
+                median.push(ping());
+                const float m = median.median();
+                const float dt = lastUs ? (cycleUs - lastUs) / 1e6f : 0.0f;
+                if (m > 0)
+                    kf.update(m, dt);
+                else
+                    kf.predict(dt);
+                if (kf.initialized())
+                    estimate = kf.level();
+                periodMs = sched.next(kf);
+            }
+            else
+            {
+                median.reset();
+                for (uint16_t i = 0; i < cfg->median_n; i++)
+                {
+                    median.push(ping());
+                    halDelayMs(cfg->median_delay_ms);
+                }
+                const float m = median.median();
+                if (m > 0)
+                    ema = isfinite(ema) ? ema * 0.75f + m * 0.25f : m;
+                estimate = ema;
+                periodMs = cfg->measure_interval_ms;
+            }
+            lastUs = cycleUs;
+            nextUs = (halMicros() - ctx.t0Us) + (uint64_t)periodMs * 1000u;
+        }
+        if (!isfinite(estimate))
+            continue;
+        const double err = fabs(estimate - scenarioDistance((uint64_t)g * 1000000ULL, &ctx.sc));
+        errSum += err;
+        errMax = fmax(errMax, err);
+    }
+    SimEchoSource::resetCrossGap();
+    return ReplayResult{errSum / durationS, errMax, src.pings()};
+}
+
+static bool estimatorReplay()
+{
+    const uint32_t D = 1800;
+    const char *scenarios[] = {"steady", "drain", "fill"};
+    bool ok = true;
+    printf("EMA contre Kalman (%lu s par scénario, erreur moyenne / max, pings/min) :\n", (unsigned long)D);
+    for (const char *s : scenarios)
+    {
+        const ReplayResult ema = replayEstimator(s, D, false);
+        const ReplayResult kal = replayEstimator(s, D, true);
+        // Erreur moyenne et max au plus égales, avec moins de pings
+        const bool better = kal.pings < ema.pings && kal.errMean <= ema.errMean && kal.errMax <= ema.errMax;
+        ok = ok && better;
+        printf("  %-6s EMA %.3f / %.3f cm, %.1f ; Kalman %.3f / %.3f cm, %.1f%s\n", s, ema.errMean, ema.errMax,
+               ema.pings * 60.0 / D, kal.errMean, kal.errMax, kal.pings * 60.0 / D, better ? "" : " (ÉCHEC)");
+    }
+    return ok;
+}
+
+// Calibration : ajustements contre des courbes connues, écart LUT / modèle,
+// doublons de mesure pondérés, coût d'une conversion contre l'ancienne
+// parabole à 3 points (coefficients double, recalculés à chaque saisie)
+static float maxFitError(const CalibrationTable &t, float (*curve)(float), float x0, float x1, bool lut)
+{
+    float err = 0.0f;
+    for (float x = x0; x <= x1; x += 0.013f)
+        err = fmaxf(err, fabsf((lut ? t.evaluate(x) : t.evaluateModel(x)) - curve(x)));
+    return err;
+}
+
+static float lineCurve(float x) { return 200.0f - 0.8f * x; }
+static float cubicCurve(float x) { return 150.0f - 0.5f * x + 2e-3f * x * x - 1e-5f * x * x * x; }
+static float cosineCurve(float x) { return 180.0f * cosf((x - 20.0f) / 200.0f * (float)M_PI * 0.5f); }
+
+template <typename Fn>
+static double calibBench(Fn eval)
+{
+    const int N = 2000000;
+    volatile float sink = 0.0f;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++)
+        sink = sink + eval(20.0f + (float)(i % 2000) * 0.1f);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / N;
+}
+
+static bool calibChecks()
+{
+    CalibrationTable lin, spl, poly, parab;
+    lin.setModel(CalibModel::Linear, 1);
+    spl.setModel(CalibModel::Spline, 1);
+    poly.setModel(CalibModel::Poly, 3);
+    for (int i = 0; i <= 8; i++)
+    {
+        const float x = 20.0f + 25.0f * i;
+        lin.setPoint(lin.count(), x, lineCurve(x));
+        spl.setPoint(spl.count(), x, cosineCurve(x));
+        poly.setPoint(poly.count(), x, cubicCurve(x));
+    }
+    lin.build(20.0f, 220.0f);
+    spl.build(20.0f, 220.0f);
+    poly.build(20.0f, 220.0f);
+    const float linErr = maxFitError(lin, lineCurve, 20.0f, 220.0f, false);
+    const float splErr = maxFitError(spl, cosineCurve, 20.0f, 220.0f, false);
+    const float polyErr = maxFitError(poly, cubicCurve, 20.0f, 220.0f, false);
+    const float lutErr = fmaxf(fmaxf(maxFitError(lin, lineCurve, 20.0f, 220.0f, true) - linErr,
+                                     maxFitError(spl, cosineCurve, 20.0f, 220.0f, true) - splErr),
+                               maxFitError(poly, cubicCurve, 20.0f, 220.0f, true) - polyErr);
+    bool ok = lin.valid() && spl.valid() && poly.valid() && linErr < 1e-3f && splErr < 0.6f && polyErr < 0.01f &&
+              lutErr < 0.02f;
+
+    // Spline monotone : aucune valeur hors de l'intervalle des deux noeuds voisins
+    for (float x = 20.0f; x < 220.0f; x += 0.1f)
+    {
+        const float xa = 20.0f + 25.0f * floorf((x - 20.0f) / 25.0f);
+        const float y = spl.evaluateModel(x);
+        ok = ok && y <= cosineCurve(xa) + 1e-3f && y >= cosineCurve(xa + 25.0f) - 1e-3f;
+    }
+
+    // Doublons de mesure : même droite que les moindres carrés sur les 5 points saisis
+    const float dx[] = {50.0f, 50.0f, 100.0f, 150.0f, 150.0f};
+    const float dy[] = {100.0f, 104.0f, 50.0f, 20.0f, 22.0f};
+    CalibrationTable dup;
+    dup.setModel(CalibModel::Poly, 1);
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        dup.setPoint(i, dx[i], dy[i]);
+        sx += dx[i];
+        sy += dy[i];
+        sxx += (double)dx[i] * dx[i];
+        sxy += (double)dx[i] * dy[i];
+    }
+    dup.build(20.0f, 220.0f);
+    const double slope = (5 * sxy - sx * sy) / (5 * sxx - sx * sx), icpt = (sy - slope * sx) / 5;
+    float dupErr = 0.0f;
+    for (float x = 20.0f; x <= 220.0f; x += 10.0f)
+        dupErr = fmaxf(dupErr, fabsf(dup.evaluateModel(x) - (float)(icpt + slope * x)));
+    ok = ok && dupErr < 1e-3f;
+
+    // Ancienne parabole (computePolynomialFrom3Points) contre Poly degré 2 sur 3 points
+    const double x1 = 30, x2 = 120, x3 = 200, y1 = 170, y2 = 80, y3 = 0;
+    const double denom = (x1 - x2) * (x1 - x3) * (x2 - x3);
+    const double a = (x3 * (y2 - y1) + x2 * (y1 - y3) + x1 * (y3 - y2)) / denom;
+    const double b = (x3 * x3 * (y1 - y2) + x2 * x2 * (y3 - y1) + x1 * x1 * (y2 - y3)) / denom;
+    const double c = (x2 * x3 * (x2 - x3) * y1 + x3 * x1 * (x3 - x1) * y2 + x1 * x2 * (x1 - x2) * y3) / denom;
+    parab.setModel(CalibModel::Poly, 2);
+    parab.setPoint(0, (float)x1, (float)y1);
+    parab.setPoint(1, (float)x2, (float)y2);
+    parab.setPoint(2, (float)x3, (float)y3);
+    parab.build(20.0f, 220.0f);
+    float parabErr = 0.0f;
+    for (float x = 20.0f; x <= 220.0f; x += 0.5f)
+        parabErr = fmaxf(parabErr, fabsf(parab.evaluate(x) - (float)(a * x * x + b * x + c)));
+    ok = ok && parabErr < 0.01f;
+
+    const double oldNs = calibBench([&](float x)
+                                    { return (float)(a * x * x + b * x + c); });
+    const double lutNs = calibBench([&](float x)
+                                    { return parab.evaluate(x); });
+    const double polyNs = calibBench([&](float x)
+                                     { return poly.evaluateModel(x); });
+    const double splNs = calibBench([&](float x)
+                                    { return spl.evaluateModel(x); });
+    const double splLutNs = calibBench([&](float x)
+                                       { return spl.evaluate(x); });
+    printf("calibration: %s ; erreur max linéaire %.5f, spline %.3f, poly3 %.5f, LUT/modèle %.4f, doublons %.5f, "
+           "ancienne parabole %.4f cm\n",
+           ok ? "ok" : "ÉCHEC", linErr, splErr, polyErr, lutErr, dupErr, parabErr);
+    printf("  conversion : ancienne parabole %.1f ns, LUT %.1f ns (poly3 direct %.1f ns, spline 9 points "
+           "directe %.1f ns / LUT %.1f ns)\n",
+           oldNs, lutNs, polyNs, splNs, splLutNs);
+    return ok;
+}
+
+// Géométrie de cuve : volume LUT contre des formules calculées ici
+// indépendamment (cylindre vertical, segment circulaire intégré par Simpson,
+// cône pointe en bas décrit par une table de profil)
+static double hcylSimpsonL(double r, double lengthCm, double h)
+{
+    const int N = 2000; // pair
+    const double dy = h / N;
+    double s = 0.0;
+    for (int i = 0; i <= N; i++)
+    {
+        const double y = i * dy, half = r * r - (r - y) * (r - y);
+        const double w = 2.0 * sqrt(half > 0.0 ? half : 0.0);
+        s += w * ((i == 0 || i == N) ? 1.0 : (i % 2 ? 4.0 : 2.0));
+    }
+    return s * dy / 3.0 * lengthCm / 1000.0;
+}
+
+static double coneL(double radiusCm, double heightCm, double h)
+{
+    const double r = radiusCm * h / heightCm;
+    return M_PI / 3.0 * r * r * h / 1000.0;
+}
+
+static bool tankChecks()
+{
+    TankModel m;
+    TankParams p{};
+
+    p.shape = TankShape::VerticalCylinder;
+    p.diameterCm = 100.0f;
+    p.fullLevelCm = 200.0f;
+    bool ok = m.build(p) && fabs(m.capacityL() - M_PI * 50.0 * 50.0 * 200.0 / 1000.0) < 0.1;
+    double vErr = 0.0;
+    for (float h = 0.0f; h <= 200.0f; h += 0.37f)
+        vErr = fmax(vErr, fabs(m.volumeL(h) - M_PI * 2500.0 * h / 1000.0));
+
+    p.shape = TankShape::HorizontalCylinder;
+    p.diameterCm = 120.0f;
+    p.lengthCm = 250.0f;
+    p.fullLevelCm = 120.0f;
+    const double hcylFull = M_PI * 60.0 * 60.0 * 250.0 / 1000.0;
+    ok = ok && m.build(p) && fabs(m.capacityL() - hcylFull) < 0.1 && fabs(m.volumeL(60.0f) - hcylFull / 2) < 0.1;
+    double hErr = 0.0;
+    for (float h = 0.0f; h <= 120.0f; h += 0.37f)
+        hErr = fmax(hErr, fabs(m.volumeL(h) - hcylSimpsonL(60.0, 250.0, h)) / hcylFull);
+
+    // Cône (rayon 80 cm en haut, 150 cm de haut) : profil de 31 points
+    char profile[512];
+    size_t len = 0;
+    for (int i = 0; i <= 30; i++)
+        len += snprintf(profile + len, sizeof(profile) - len, "%s%d:%.2f", i ? "," : "", i * 5,
+                        coneL(80.0, 150.0, i * 5.0));
+    p.shape = TankShape::Profile;
+    p.profile = profile;
+    p.fullLevelCm = 150.0f;
+    const double coneFull = coneL(80.0, 150.0, 150.0);
+    ok = ok && m.build(p) && fabs(m.capacityL() - coneFull) < 0.1;
+    double cErr = 0.0;
+    for (float h = 0.0f; h <= 150.0f; h += 0.37f)
+        cErr = fmax(cErr, fabs(m.volumeL(h) - coneL(80.0, 150.0, h)) / coneFull);
+
+    ok = ok && vErr < 0.05 && hErr < 1e-3 && cErr < 5e-3;
+    printf("volume cuve: %s ; cylindre vertical %.3f L, horizontal %.4f %%, cône (profil 31 points) %.3f %% "
+           "de la capacité\n",
+           ok ? "ok" : "ÉCHEC", vErr, hErr * 100.0, cErr * 100.0);
+    return ok;
+}
+
+// Migration des anciennes clés m0..h2 : écrite une seule fois, puis démarrages
+// en lecture seule (aucune écriture NVS)
+static bool calibMigrationCheck()
+{
+    KvStore kv;
+    kv.begin("calib", false);
+    kv.putFloat("m0", 30.0f);
+    kv.putFloat("h0", 170.0f);
+    kv.putFloat("m1", 120.0f);
+    kv.putFloat("h1", 80.0f);
+    kv.putFloat("m2", 200.0f);
+    kv.putFloat("h2", 0.0f);
+    kv.end();
+
+    const uint32_t w0 = kvStoreNativeWrites();
+    loadCalibrations();
+    const uint32_t migrationWrites = kvStoreNativeWrites() - w0;
+    kv.begin("calib", true);
+    bool ok = !kv.isKey("m0") && !kv.isKey("h2") && kv.getBytesLength("pts") == CalibrationTable::blobSize(3);
+    kv.end();
+    const CalibrationPtr t = calibrationSnapshot();
+    ok = ok && t && t->count() == 3 && t->model() == CalibModel::Poly && fabsf(t->evaluate(120.0f) - 80.0f) < 0.05f;
+
+    const uint32_t w1 = kvStoreNativeWrites();
+    loadCalibrations();
+    loadCalibrations();
+    const uint32_t bootWrites = kvStoreNativeWrites() - w1;
+    ok = ok && migrationWrites == 7 && bootWrites == 0; // blob + 6 clés effacées
+    printf("calibration NVS: migration %u écriture(s), démarrages suivants %u %s\n", (unsigned)migrationWrites,
+           (unsigned)bootWrites, ok ? "ok" : "ÉCHEC");
+    clearCalibrations();
+    return ok;
+}
+
+// Fichiers statiques : négociation Accept-Encoding / If-None-Match, puis octets
+// sur le fil d'une visite du tableau de bord (page + CSS + JS), en-têtes compris
+static size_t responseBytes(const WebAsset &a, int code, const char *encoding, size_t bodyLen)
+{
+    const char *cacheControl = a.immutable ? "public, max-age=31536000, immutable" : "no-cache";
+    const char *reason = code == 304 ? "Not Modified" : "OK";
+    if (!encoding) // ancien service LittleFS : fichier brut, sans validateur
+        return snprintf(nullptr, 0, "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n"
+                                    "Connection: close\r\n\r\n",
+                        code, reason, a.mime, (unsigned)bodyLen) +
+               bodyLen;
+    return snprintf(nullptr, 0, "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n"
+                                "Content-Encoding: %s\r\nETag: %s\r\nCache-Control: %s\r\n"
+                                "Vary: Accept-Encoding\r\nConnection: close\r\n\r\n",
+                    code, reason, a.mime, (unsigned)bodyLen, encoding, a.etag, cacheControl) +
+           bodyLen;
+}
+
+// Temps de handler d'un chargement de page : réponse remplie par segments
+// TCP (MSS lwIP) comme AsyncAbstractResponse. Fichier brut lu sous
+// HAL_FS_ROOT (ancien chemin LittleFS, repli des clients sans gzip), gzip
+// copié depuis la flash, ou 304 (en-têtes seuls). Sur l'hôte le fichier est
+// dans le cache de pages : l'écart réel sur LittleFS est plus grand.
+// Retour : octets de contenu (en-têtes seuls pour le 304).
+static const size_t WEB_SEGMENT = 1436;
+static volatile uint32_t webSink;
+
+static size_t handlerFs(const WebAsset &a)
+{
+    char path[64], seg[WEB_SEGMENT];
+    snprintf(path, sizeof(path), HAL_FS_ROOT "%s", a.path);
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    webSink += snprintf(seg, sizeof(seg), "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nVary: Accept-Encoding\r\n\r\n", a.mime);
+    size_t total = 0, n;
+    while ((n = fread(seg, 1, sizeof(seg), f)) > 0)
+    {
+        webSink += (uint8_t)seg[n - 1];
+        total += n;
+    }
+    fclose(f);
+    return total;
+}
+
+static size_t handlerFlash(const WebAsset &a)
+{
+    char seg[WEB_SEGMENT];
+    webSink += snprintf(seg, sizeof(seg), "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Encoding: gzip\r\n"
+                                          "ETag: %s\r\nVary: Accept-Encoding\r\n\r\n",
+                        a.mime, a.etag);
+    size_t total = 0;
+    for (size_t off = 0; off < a.gzLen; off += sizeof(seg))
+    {
+        const size_t n = a.gzLen - off < sizeof(seg) ? a.gzLen - off : sizeof(seg);
+        memcpy(seg, a.gz + off, n);
+        webSink += (uint8_t)seg[n - 1];
+        total += n;
+    }
+    return total;
+}
+
+static size_t handlerNotModified(const WebAsset &a)
+{
+    char hdr[256];
+    if (!httpEtagMatches(a.etag, a.etag))
+        return 0;
+    return snprintf(hdr, sizeof(hdr), "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nVary: Accept-Encoding\r\n\r\n",
+                    a.etag);
+}
+
+// Image LittleFS de data/ sous HAL_FS_ROOT (équivalent de `pio run -t uploadfs`) ;
+// false si data/ n'est pas accessible depuis le répertoire courant
+static bool stageWebFs(const char *const *paths, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        char src[64], dst[64], buf[4096];
+        snprintf(src, sizeof(src), "data%s", paths[i]);
+        snprintf(dst, sizeof(dst), HAL_FS_ROOT "%s", paths[i]);
+        FILE *in = fopen(src, "rb");
+        FILE *out = in ? fopen(dst, "wb") : nullptr;
+        size_t n;
+        while (out && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+            fwrite(buf, 1, n, out);
+        if (in)
+            fclose(in);
+        if (!out)
+            return false;
+        fclose(out);
+    }
+    return true;
+}
+
+static bool webAssetChecks()
+{
+    const struct
+    {
+        const char *header;
+        bool gzip;
+    } ae[] = {
+        {nullptr, true}, {"gzip, deflate, br", true}, {"br;q=1.0, gzip;q=0.8", true}, {"GZIP", true},
+        {"x-gzip", true}, {"*", true}, {"deflate, *;q=0.1", true}, {"gzip;level=9;q=0.5", true},
+        {"gzip;q=0", false}, {"gzip; q=0.000", false}, {"identity", false}, {"", false}, {"*;q=0", false},
+        {"gzip;q=0, *", false}, {"gzipx, br", false}, {"br", false},
+    };
+    bool ok = true;
+    for (const auto &c : ae)
+        if (httpAcceptsGzip(c.header) != c.gzip)
+        {
+            printf("Accept-Encoding \"%s\": attendu %d\n", c.header ? c.header : "(absent)", c.gzip);
+            ok = false;
+        }
+
+    const char *etag = "\"039ef79409cc46d4\"";
+    const struct
+    {
+        const char *header;
+        bool match;
+    } inm[] = {
+        {"\"039ef79409cc46d4\"", true}, {"W/\"039ef79409cc46d4\"", true},
+        {"\"0000\", \"039ef79409cc46d4\"", true}, {" \"a,b\" ,W/\"039ef79409cc46d4\"", true}, {"*", true},
+        {"\"039ef79409cc46d\"", false}, {"\"039ef79409cc46d4x\"", false}, {"\"0000\", \"1111\"", false},
+        {"\"a,\"039ef79409cc46d4\"\"", false}, {"", false},
+    };
+    for (const auto &c : inm)
+        if (httpEtagMatches(c.header, etag) != c.match)
+        {
+            printf("If-None-Match %s: attendu %d\n", c.header, c.match);
+            ok = false;
+        }
+
+    // Visite du tableau de bord ; revisite : seule la page HTML est revalidée,
+    // CSS/JS (URL ?v=<hash>, immutable) restent dans le cache du navigateur
+    const char *page[] = {"/index.html", "/style.css", "/script.js"};
+    size_t oldBytes = 0, firstBytes = 0, repeatBytes = 0;
+    for (const char *path : page)
+    {
+        const WebAsset *a = findWebAsset(path);
+        if (!a)
+            return false;
+        oldBytes += responseBytes(*a, 200, nullptr, a->rawLen);
+        firstBytes += responseBytes(*a, 200, "gzip", a->gzLen);
+        if (!a->immutable)
+            repeatBytes += responseBytes(*a, 304, "gzip", 0);
+    }
+    ok = ok && firstBytes < oldBytes && repeatBytes < 512;
+    printf("fichiers statiques: négociation %s ; octets sur le fil (tableau de bord, en-têtes compris) : "
+           "%u avant (brut, à chaque visite), %u première visite (gzip), %u revisite (304)\n",
+           ok ? "ok" : "ÉCHEC", (unsigned)oldBytes, (unsigned)firstBytes, (unsigned)repeatBytes);
+
+    // Temps de handler par chargement du tableau de bord ; le fichier brut
+    // doit être lu en entier (CSS/JS : taille de data/ = rawLen de l'asset
+    // embarqué ; HTML : version de data/, sans les suffixes ?v=<hash>)
+    if (!halFsBegin() || !stageWebFs(page, sizeof(page) / sizeof(page[0])))
+    {
+        printf("  handlers : data/ introuvable depuis le répertoire courant, banc ignoré\n");
+        return ok;
+    }
+    const uint32_t LOADS = 2000;
+    bool fsOk = true;
+    auto perLoadUs = [&](size_t (*handler)(const WebAsset &), bool revisit)
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < LOADS; i++)
+            for (const char *path : page)
+            {
+                const WebAsset *a = findWebAsset(path);
+                if (revisit && a->immutable)
+                    continue;
+                fsOk = fsOk && handler(*a) > 0;
+            }
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / LOADS;
+    };
+    for (const char *path : page)
+    {
+        const WebAsset *a = findWebAsset(path);
+        const size_t fsLen = handlerFs(*a);
+        fsOk = fsOk && fsLen > 0 && (!a->immutable || fsLen == a->rawLen) && handlerFlash(*a) == a->gzLen;
+    }
+    const double fsUs = perLoadUs(handlerFs, false);
+    const double flashUs = perLoadUs(handlerFlash, false);
+    const double notModUs = perLoadUs(handlerNotModified, true);
+    ok = ok && fsOk && flashUs < fsUs && notModUs < flashUs;
+    printf("  handlers par chargement : LittleFS brut %.2f us (ancien chemin, repli sans gzip), "
+           "flash gzip %.2f us, revisite 304 %.2f us %s\n",
+           fsUs, flashUs, notModUs, fsOk ? "ok" : "ÉCHEC");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t durationS = (argc > 1) ? (uint32_t)atoi(argv[1]) : 3600;
+    Scenario sc{(argc > 2) ? argv[2] : "drain", 80.0f, 200.0f, (uint64_t)durationS * 1000000ULL};
+    if (strcmp(sc.name, "fill") == 0)
+    {
+        sc.startCm = 200.0f;
+        sc.endCm = 80.0f;
+    }
+
+    metricsBegin(halCyclesPerUs());
+    const uint32_t recordNs = metricsBenchmark(100000);
+    kvStoreNativeReset();
+    halFsBegin();
+    bool configOk = configRoundTrip();
+    ConfigManager::instance().updateFromJson("{\"mqtt_enabled\":true}");
+    {
+        char body[CONFIG_BODY_MAX];
+        JsonWriter w(body, sizeof(body));
+        ConfigManager::instance().writeJson(w);
+        configOk = configParseChecks(body) && configOk;
+    }
+    historyStore.begin();
+    const bool migrationOk = calibMigrationCheck();
+    loadCalibrations();
+    saveCalibrationToNVS(-1, 30.0f, 170.0f);
+    saveCalibrationToNVS(-1, 120.0f, 80.0f);
+    saveCalibrationToNVS(-1, 200.0f, 0.0f);
+    rtcCacheCapture();
+    const bool cacheOk = rtcCacheRestore(); // aller-retour du cache RTC (réveil timer)
+
+    // Canaux suivants : même scénario décalé de 10 cm par canal
+    Scenario chSc[SENSOR_CHANNELS];
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+    {
+        chSc[ch] = sc;
+        chSc[ch].startCm += 10.0f * ch;
+        chSc[ch].endCm += 10.0f * ch;
+        simEchoSource(ch).setDistance(scenarioDistance, &chSc[ch]);
+        simEchoSource(ch).seed(42 + ch);
+    }
+    SimEchoSource &sim = simEchoSource();
+    initSensor();
+
+    uint32_t steps = 0;
+    double hostNsSum = 0.0, hostNsMax = 0.0;
+    double chErrSum[SENSOR_CHANNELS] = {}, chErrMax[SENSOR_CHANNELS] = {};
+    while (halMicros() < sc.durationUs)
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        const uint32_t periodMs = sensorStep();
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        hostNsSum += ns;
+        if (ns > hostNsMax)
+            hostNsMax = ns;
+
+        for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+        {
+            MeasurementRecord rec;
+            readMeasurement(rec, ch);
+            if (rec.measuredCm <= 0.0f)
+                continue;
+            const double err = fabs(rec.measuredCm - simEchoSource(ch).lastTrueCm());
+            chErrSum[ch] += err;
+            if (err > chErrMax[ch])
+                chErrMax[ch] = err;
+        }
+        steps++;
+        logFlush();
+        halDelayMs(periodMs);
+    }
+    historyStore.flush();
+    logFlush();
+
+    MeasurementSet set;
+    readMeasurementSet(set);
+    char distance[320 * SENSOR_CHANNELS];
+    {
+        JsonWriter w(distance, sizeof(distance));
+        writeDistanceSetJson(w, set);
+    }
+    const NativeNetStats &net = nativeNetStats();
+
+    printf("\n=== Simulation %s, %lu s ===\n", sc.name, (unsigned long)durationS);
+    printf("cycles: %lu, pings: %lu (%.2f/min)\n", (unsigned long)steps, (unsigned long)sim.pings(),
+           sim.pings() * 60.0 / durationS);
+    printf("erreur de suivi: moyenne %.3f cm, max %.3f cm\n", steps ? chErrSum[0] / steps : 0.0, chErrMax[0]);
+    printf("coût hôte sensorStep: moyenne %.1f us, max %.1f us\n", steps ? hostNsSum / steps / 1000.0 : 0.0,
+           hostNsMax / 1000.0);
+    // Diaphonie : deux déclenchements de capteurs différents jamais plus
+    // proches que le délai d'écho maximal + garde
+    bool channelsOk = true;
+    if (SENSOR_CHANNELS > 1)
+    {
+        for (uint8_t ch = 1; ch < SENSOR_CHANNELS; ch++)
+            printf("canal %u: pings %lu, erreur moyenne %.3f cm, max %.3f cm\n", ch,
+                   (unsigned long)simEchoSource(ch).pings(), steps ? chErrSum[ch] / steps : 0.0, chErrMax[ch]);
+        const uint64_t gap = SimEchoSource::minCrossGapUs();
+        channelsOk = gap >= SENSOR_STAGGER_US;
+        printf("écart min entre capteurs: %llu us (>= %lu requis)%s\n", (unsigned long long)gap,
+               (unsigned long)SENSOR_STAGGER_US, channelsOk ? "" : " (ÉCHEC)");
+    }
+    channelsOk = channelsOk && net.truncated == 0 && net.sseInFlight == 0;
+    printf("MQTT: %lu messages, %llu octets ; SSE: %lu (%lu pendant un vol) ; affichage: %lu ; tronqués: %lu\n",
+           (unsigned long)net.mqttMessages, (unsigned long long)net.mqttBytes, (unsigned long)net.sseEvents,
+           (unsigned long)net.sseInFlight, (unsigned long)net.displayWakes, (unsigned long)net.truncated);
+    printf("/distance: %s\n", distance);
+    bool unitOk = captureChecks();
+    unitOk = seqlockStress() && unitOk;
+    unitOk = medianChecks() && unitOk;
+    unitOk = historyChecks() && unitOk;
+    unitOk = batchChecks() && unitOk;
+    unitOk = webAssetChecks() && unitOk;
+    unitOk = calibChecks() && migrationOk && unitOk;
+    unitOk = tankChecks() && unitOk;
+    unitOk = estimatorReplay() && unitOk;
+    configReadBench();
+    unitOk = mqttSessionBench(set) && unitOk;
+    jsonBenchmarks(set);
+    logBenchmarks();
+
+    // Histogrammes des étapes (temps CPU hôte) et coût de l'instrumentation
+    SystemStats sys{};
+    sys.uptimeS = durationS;
+    char diag[640];
+    if (metricsFormatJson(sys, diag, sizeof(diag)) > 0)
+        printf("étapes [n, moy us, max us]: %s\n", diag);
+    printf("metrics record(): %lu ns ; cache RTC: %s\n", (unsigned long)recordNs, cacheOk ? "ok" : "invalide");
+    return configOk && channelsOk && unitOk ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#include <string.h>
+#include "net_native.h"
+#include "echo_sim.h"
+#include "../../mqtt.h"
+#include "../../web_server.h"
+#include "../../display.h"
+#include "../../measurement_store.h"
+#include "../../config.h"
+
+/**
+ * Faux réseau pour [env:native] : MQTT, SSE et affichage enregistrent ce qui
+ * serait envoyé (charges utiles produites par les vrais formateurs JSON).
+ */
+static NativeNetStats stats = {};
+
+const NativeNetStats &nativeNetStats()
+{
+    return stats;
+}
+
+void setupMQTT()
+{
+}
+
+bool publishMQTT_payload(const char *payload)
+{
+    const size_t n = strlen(payload);
+    stats.mqttMessages++;
+    stats.mqttBytes += n;
+    strncpy(stats.lastMqttPayload, payload, sizeof(stats.lastMqttPayload) - 1);
+    return true;
+}
+
+bool publishMQTT_measure()
+{
+    MeasurementSet set;
+    readMeasurementSet(set);
+    char payload[MQTT_MEASURE_PAYLOAD_LEN];
+    formatMeasureSetJson(set, payload, sizeof(payload));
+    return publishMQTT_payload(payload);
+}
+
+void startMQTTTask()
+{
+}
+
+bool mqttEnqueueMeasure(const MeasurementSet &set)
+{
+    char payload[MQTT_MEASURE_PAYLOAD_LEN];
+    if (formatMeasureSetJson(set, payload, sizeof(payload)) < 0)
+        stats.truncated++;
+    return publishMQTT_payload(payload);
+}
+
+void startWebServer()
+{
+}
+
+void webNotifyMeasurement(const MeasurementRecord &rec)
+{
+    char buf[320];
+    if (formatDistanceJson(rec, cuveVideCh[rec.channel].load(), cuvePleineCh[rec.channel].load(), buf, sizeof(buf)) < 0)
+        stats.truncated++;
+    stats.sseEvents++;
+    if (SimEchoSource::anyInFlight())
+        stats.sseInFlight++;
+}
+
+void displayNotify()
+{
+    stats.displayWakes++;
+}
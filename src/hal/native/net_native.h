@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "../../mqtt.h"
+
+// Compteurs des faux réseau / affichage de [env:native]
+struct NativeNetStats
+{
+    uint32_t mqttMessages;
+    uint64_t mqttBytes;
+    uint32_t sseEvents;
+    uint32_t sseInFlight; // événements émis pendant le temps de vol d'un ping
+    uint32_t displayWakes;
+    uint32_t truncated; // charges JSON tronquées (tampon MQTT / SSE trop petit)
+    char lastMqttPayload[MQTT_MEASURE_PAYLOAD_LEN];
+};
+
+const NativeNetStats &nativeNetStats();
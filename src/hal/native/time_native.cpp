@@ -0,0 +1,62 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "../hal_time.h"
+
+// Horloge virtuelle : démarre à 0 (millis) et au 1er janvier 2025 (horloge murale)
+static std::atomic<uint64_t> nowUs{0};
+static std::atomic<int64_t> wallOffsetMs{1735689600000LL};
+static std::recursive_mutex schedulerLock;
+
+uint32_t halMillis()
+{
+    return (uint32_t)(nowUs.load() / 1000);
+}
+
+uint64_t halMicros()
+{
+    return nowUs.load();
+}
+
+void halDelayMs(uint32_t ms)
+{
+    halClockAdvanceUs((uint64_t)ms * 1000);
+}
+
+uint32_t halCycles()
+{
+    // Coûts CPU : temps réel de l'hôte, indépendant de l'horloge virtuelle
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+uint32_t halCyclesPerUs()
+{
+    return 1000;
+}
+
+int64_t halWallClockMs()
+{
+    return wallOffsetMs.load() + (int64_t)(nowUs.load() / 1000);
+}
+
+void halSchedulerLock()
+{
+    schedulerLock.lock();
+}
+
+void halSchedulerUnlock()
+{
+    schedulerLock.unlock();
+}
+
+void halClockAdvanceUs(uint64_t us)
+{
+    nowUs.fetch_add(us);
+}
+
+void halClockSetWallMs(int64_t epochMs)
+{
+    wallOffsetMs.store(epochMs - (int64_t)(nowUs.load() / 1000));
+}
@@ -0,0 +1,272 @@
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include "history_store.h"
+#include "crc32.h"
+#include "hal/hal_fs.h"
+
+HistoryStore historyStore(HAL_FS_ROOT);
+
+static const uint32_t HISTORY_FLUSH_PERIOD_S = 60;
+static const size_t HISTORY_RECORD_CRC_LEN = offsetof(HistoryRecord, crc);
+
+static uint32_t recordCrc(const HistoryRecord &r)
+{
+    return crc32Update(0, &r, HISTORY_RECORD_CRC_LEN);
+}
+
+HistoryStore::HistoryStore(const char *basePath)
+{
+    strncpy(basePath_, basePath, sizeof(basePath_) - 1);
+    basePath_[sizeof(basePath_) - 1] = '\0';
+
+    // Raw : ~48 min à 1 Hz ; Minute : 24 h ; Hour : 30 jours (≈ 100 Ko au total)
+    const struct
+    {
+        const char *file;
+        uint32_t capacity;
+        uint32_t periodS;
+    } layout[HISTORY_TIER_COUNT] = {
+        {"hist_raw.bin", 2880, 0},
+        {"hist_min.bin", 1440, 60},
+        {"hist_hour.bin", 720, 3600},
+    };
+
+    for (int i = 0; i < HISTORY_TIER_COUNT; i++)
+    {
+        Tier &t = tiers_[i];
+        memset(&t, 0, sizeof(t));
+        t.file = layout[i].file;
+        t.capacity = layout[i].capacity;
+        t.periodS = layout[i].periodS;
+    }
+}
+
+const char *HistoryStore::tierName(HistoryTier tier)
+{
+    switch (tier)
+    {
+    case HistoryTier::Minute:
+        return "minute";
+    case HistoryTier::Hour:
+        return "hour";
+    default:
+        return "raw";
+    }
+}
+
+void HistoryStore::filePath(const Tier &t, char *buf, size_t len) const
+{
+    snprintf(buf, len, "%s/%s", basePath_, t.file);
+}
+
+bool HistoryStore::begin()
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (Tier &t : tiers_)
+        recover(t);
+    return true;
+}
+
+void HistoryStore::recover(Tier &t)
+{
+    t.nextSeq = 0;
+    HistoryRecord open = {};
+    char path[64];
+    filePath(t, path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (f)
+    {
+        // Tête de l'anneau = plus grand seq valide (les cases déchirées sont ignorées)
+        HistoryRecord chunk[32];
+        uint32_t slot = 0;
+        size_t n;
+        while (slot < t.capacity && (n = fread(chunk, sizeof(HistoryRecord), 32, f)) > 0)
+        {
+            for (size_t i = 0; i < n && slot < t.capacity; i++, slot++)
+            {
+                const HistoryRecord &r = chunk[i];
+                if (r.crc == recordCrc(r) && r.seq % t.capacity == slot && r.seq + 1 > t.nextSeq)
+                {
+                    t.nextSeq = r.seq + 1;
+                    open = r;
+                }
+            }
+        }
+        fclose(f);
+    }
+    t.accCount = 0;
+    if (t.nextSeq > 0 && t.periodS > 0 && (open.count & HISTORY_COUNT_OPEN))
+    {
+        // Intervalle ouvert écrit par flush() : on reprend l'accumulateur,
+        // sa case sera réécrite à la clôture (somme à < 1 mm/mesure près)
+        t.nextSeq = open.seq;
+        t.accStartS = open.tS;
+        t.accMin = open.minMm;
+        t.accMax = open.maxMm;
+        t.accCount = open.count & HISTORY_COUNT_MAX;
+        t.accSumMm = (int32_t)open.meanMm * t.accCount;
+    }
+    t.flushedSeq = t.nextSeq;
+    t.pendingCount = 0;
+}
+
+void HistoryStore::append(uint32_t tS, float cm)
+{
+    if (!(cm > 0.0f) || cm * 10.0f > 32767.0f)
+        return;
+    const int16_t mm = (int16_t)lroundf(cm * 10.0f);
+
+    std::lock_guard<std::mutex> lk(mutex_);
+    push(tiers_[(int)HistoryTier::Raw], tS, mm, mm, mm, 1);
+    accumulate(tiers_[(int)HistoryTier::Minute], tS, mm);
+    accumulate(tiers_[(int)HistoryTier::Hour], tS, mm);
+
+    if (lastFlushS_ == 0)
+        lastFlushS_ = tS;
+    if (tiers_[(int)HistoryTier::Raw].pendingCount >= HISTORY_PENDING ||
+        (tS - lastFlushS_) >= HISTORY_FLUSH_PERIOD_S)
+    {
+        for (Tier &t : tiers_)
+            flushTier(t);
+        lastFlushS_ = tS;
+    }
+}
+
+void HistoryStore::accumulate(Tier &t, uint32_t tS, int16_t mm)
+{
+    const uint32_t start = tS - (tS % t.periodS);
+    if (t.accCount > 0 && start != t.accStartS)
+    {
+        push(t, t.accStartS, t.accMin, t.accMax, (int16_t)(t.accSumMm / t.accCount), t.accCount);
+        t.accCount = 0;
+    }
+    if (t.accCount == 0)
+    {
+        t.accStartS = start;
+        t.accSumMm = 0;
+        t.accMin = mm;
+        t.accMax = mm;
+    }
+    if (mm < t.accMin)
+        t.accMin = mm;
+    if (mm > t.accMax)
+        t.accMax = mm;
+    // Somme et compte plafonnés ensemble : la moyenne reste celle des mesures comptées
+    if (t.accCount < HISTORY_COUNT_MAX)
+    {
+        t.accSumMm += mm;
+        t.accCount++;
+    }
+}
+
+void HistoryStore::push(Tier &t, uint32_t tS, int16_t mn, int16_t mx, int16_t mean, uint16_t count)
+{
+    if (t.pendingCount >= HISTORY_PENDING && !flushTier(t))
+    {
+        // Flash indisponible : on garde les plus récents
+        memmove(&t.pending[0], &t.pending[1], (HISTORY_PENDING - 1) * sizeof(HistoryRecord));
+        t.pendingCount--;
+        t.flushedSeq++;
+    }
+
+    HistoryRecord &r = t.pending[t.pendingCount++];
+    r.seq = t.nextSeq++;
+    r.tS = tS;
+    r.minMm = mn;
+    r.maxMm = mx;
+    r.meanMm = mean;
+    r.count = count;
+    r.crc = recordCrc(r);
+}
+
+bool HistoryStore::flushTier(Tier &t, bool withOpen)
+{
+    const bool open = withOpen && t.periodS > 0 && t.accCount > 0;
+    if (t.pendingCount == 0 && !open)
+        return true;
+
+    char path[64];
+    filePath(t, path, sizeof(path));
+    FILE *f = fopen(path, "r+b");
+    if (!f)
+        f = fopen(path, "w+b");
+    if (!f)
+        return false;
+
+    bool ok = true;
+    for (uint8_t i = 0; i < t.pendingCount && ok; i++)
+    {
+        const HistoryRecord &r = t.pending[i];
+        ok = fseek(f, (long)((r.seq % t.capacity) * sizeof(HistoryRecord)), SEEK_SET) == 0 &&
+             fwrite(&r, sizeof(HistoryRecord), 1, f) == 1;
+    }
+    if (open && ok)
+    {
+        HistoryRecord r;
+        r.seq = t.nextSeq;
+        r.tS = t.accStartS;
+        r.minMm = t.accMin;
+        r.maxMm = t.accMax;
+        r.meanMm = (int16_t)(t.accSumMm / t.accCount);
+        r.count = t.accCount | HISTORY_COUNT_OPEN;
+        r.crc = recordCrc(r);
+        ok = fseek(f, (long)((r.seq % t.capacity) * sizeof(HistoryRecord)), SEEK_SET) == 0 &&
+             fwrite(&r, sizeof(HistoryRecord), 1, f) == 1;
+    }
+    ok = (fflush(f) == 0) && ok;
+    fsync(fileno(f));
+    fclose(f);
+
+    if (ok)
+    {
+        t.flushedSeq = t.nextSeq;
+        t.pendingCount = 0;
+    }
+    return ok;
+}
+
+void HistoryStore::flush()
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (Tier &t : tiers_)
+        flushTier(t, true);
+}
+
+bool HistoryStore::readSlot(FILE *f, const Tier &t, uint32_t seq, HistoryRecord &out)
+{
+    if (seq >= t.flushedSeq)
+    {
+        out = t.pending[seq - t.flushedSeq];
+        return true;
+    }
+    if (!f || fseek(f, (long)((seq % t.capacity) * sizeof(HistoryRecord)), SEEK_SET) != 0 ||
+        fread(&out, sizeof(HistoryRecord), 1, f) != 1)
+        return false;
+    return out.crc == recordCrc(out) && out.seq == seq;
+}
+
+size_t HistoryStore::readLatest(HistoryTier tier, HistoryRecord *out, size_t maxRecords)
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    const Tier &t = tiers_[(int)tier];
+
+    uint32_t available = t.nextSeq < t.capacity ? t.nextSeq : t.capacity;
+    if (maxRecords > available)
+        maxRecords = available;
+
+    char path[64];
+    filePath(t, path, sizeof(path));
+    FILE *f = (t.flushedSeq > 0) ? fopen(path, "rb") : nullptr;
+
+    // Lecture à rebours depuis la tête ; arrêt au premier trou
+    size_t n = 0;
+    while (n < maxRecords && readSlot(f, t, t.nextSeq - 1 - n, out[maxRecords - 1 - n]))
+        n++;
+    if (f)
+        fclose(f);
+
+    if (n < maxRecords)
+        memmove(out, out + (maxRecords - n), n * sizeof(HistoryRecord));
+    return n;
+}
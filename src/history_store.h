@@ -0,0 +1,88 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <mutex>
+
+enum class HistoryTier : uint8_t
+{
+    Raw = 0,    // une entrée par mesure
+    Minute = 1, // agrégat min/max/moyenne par minute
+    Hour = 2    // agrégat min/max/moyenne par heure
+};
+#define HISTORY_TIER_COUNT 3
+#define HISTORY_PENDING 16 // enregistrements bufferisés en RAM par tier
+#define HISTORY_COUNT_MAX 0x7FFF  // plafond commun somme/compte d'un intervalle
+#define HISTORY_COUNT_OPEN 0x8000 // bit de count : intervalle encore ouvert (flush)
+
+// Enregistrement fixe de 20 octets ; seq détermine la case du fichier anneau.
+struct HistoryRecord
+{
+    uint32_t seq;
+    uint32_t tS;     // début de l'intervalle (time(nullptr))
+    int16_t minMm;
+    int16_t maxMm;
+    int16_t meanMm;
+    uint16_t count;  // mesures agrégées
+    uint32_t crc;    // CRC-32 des 16 octets précédents
+};
+
+/**
+ * Historique binaire en fichiers anneau de taille fixe (un fichier par tier).
+ * - Écriture par lots (HISTORY_PENDING enregistrements ou 60 s) pour limiter
+ *   l'usure flash ; chaque enregistrement porte seq + CRC, une écriture
+ *   interrompue ne corrompt que la case en cours.
+ * - Au démarrage, la case de plus grand seq valide donne la tête de l'anneau.
+ * - flush() (avant veille/arrêt) écrit aussi l'intervalle minute/heure en
+ *   cours, marqué HISTORY_COUNT_OPEN, dans la case seq = nextSeq : invisible
+ *   en lecture, il est repris par begin() puis remplacé à sa clôture.
+ * - API stdio/POSIX uniquement : fonctionne sur le VFS LittleFS (/littlefs)
+ *   comme sur un système de fichiers hôte.
+ */
+class HistoryStore
+{
+public:
+    explicit HistoryStore(const char *basePath);
+
+    bool begin();
+    void append(uint32_t tS, float cm); // cm <= 0 ignoré
+    void flush(); // lots en attente + intervalles ouverts (avant veille)
+
+    // Derniers enregistrements (du plus ancien au plus récent), tampons RAM compris.
+    size_t readLatest(HistoryTier tier, HistoryRecord *out, size_t maxRecords);
+
+    static const char *tierName(HistoryTier tier);
+
+private:
+    struct Tier
+    {
+        const char *file;
+        uint32_t capacity; // cases du fichier anneau
+        uint32_t periodS;  // 0 = brut
+        uint32_t nextSeq;  // prochain seq à attribuer
+        uint32_t flushedSeq; // seq < flushedSeq : sur flash
+        HistoryRecord pending[HISTORY_PENDING];
+        uint8_t pendingCount;
+        // Accumulateur de l'intervalle courant (tiers agrégés)
+        uint32_t accStartS;
+        int32_t accSumMm;
+        int16_t accMin;
+        int16_t accMax;
+        uint16_t accCount;
+    };
+
+    void recover(Tier &t);
+    void push(Tier &t, uint32_t tS, int16_t mn, int16_t mx, int16_t mean, uint16_t count);
+    void accumulate(Tier &t, uint32_t tS, int16_t mm);
+    bool flushTier(Tier &t, bool withOpen = false);
+    bool readSlot(FILE *f, const Tier &t, uint32_t seq, HistoryRecord &out);
+    void filePath(const Tier &t, char *buf, size_t len) const;
+
+    char basePath_[32];
+    Tier tiers_[HISTORY_TIER_COUNT];
+    uint32_t lastFlushS_ = 0;
+    std::mutex mutex_;
+};
+
+// Historique de l'appareil sous HAL_FS_ROOT (FS monté par startWebServer via halFsBegin)
+extern HistoryStore historyStore;
@@ -0,0 +1,101 @@
+#include <string.h>
+#include <strings.h>
+#include "http_negotiation.h"
+
+static const char *skipSpaces(const char *p)
+{
+    while (*p == ' ' || *p == '\t')
+        p++;
+    return p;
+}
+
+// Poids "q=" d'un élément (jusqu'à la virgule) : false si q vaut 0
+static bool qualityNonZero(const char *p)
+{
+    while (*p && *p != ',')
+    {
+        if (*p == ';')
+        {
+            p = skipSpaces(p + 1);
+            if ((*p == 'q' || *p == 'Q') && p[1] == '=')
+            {
+                bool nonZero = false;
+                for (p += 2; (*p >= '0' && *p <= '9') || *p == '.'; p++)
+                    nonZero = nonZero || (*p >= '1' && *p <= '9');
+                return nonZero;
+            }
+            continue;
+        }
+        p++;
+    }
+    return true;
+}
+
+static bool tokenIs(const char *p, size_t len, const char *name)
+{
+    return strlen(name) == len && strncasecmp(p, name, len) == 0;
+}
+
+bool httpAcceptsGzip(const char *acceptEncoding)
+{
+    if (!acceptEncoding)
+        return true;
+    int gzip = -1, any = -1;
+    const char *p = acceptEncoding;
+    while (*p)
+    {
+        p = skipSpaces(p);
+        const char *name = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t')
+            p++;
+        const size_t len = (size_t)(p - name);
+        if (tokenIs(name, len, "gzip") || tokenIs(name, len, "x-gzip"))
+            gzip = qualityNonZero(p);
+        else if (tokenIs(name, len, "*"))
+            any = qualityNonZero(p);
+        while (*p && *p != ',')
+            p++;
+        if (*p == ',')
+            p++;
+    }
+    return gzip >= 0 ? gzip == 1 : any == 1;
+}
+
+bool httpEtagMatches(const char *ifNoneMatch, const char *etag)
+{
+    if (!ifNoneMatch || !etag)
+        return false;
+    // Comparaison faible : préfixe W/ ignoré des deux côtés
+    if (strncmp(etag, "W/", 2) == 0)
+        etag += 2;
+    const size_t etagLen = strlen(etag);
+
+    const char *p = ifNoneMatch;
+    while (*p)
+    {
+        p = skipSpaces(p);
+        if (*p == '*')
+            return true;
+        if (strncmp(p, "W/", 2) == 0)
+            p += 2;
+        const char *tag = p;
+        if (*p == '"')
+        {
+            // Étiquette entre guillemets : peut contenir des virgules
+            const char *end = strchr(p + 1, '"');
+            p = end ? end + 1 : p + strlen(p);
+        }
+        else
+        {
+            while (*p && *p != ',' && *p != ' ' && *p != '\t')
+                p++;
+        }
+        if ((size_t)(p - tag) == etagLen && strncmp(tag, etag, etagLen) == 0)
+            return true;
+        while (*p && *p != ',')
+            p++;
+        if (*p == ',')
+            p++;
+    }
+    return false;
+}
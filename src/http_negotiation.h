@@ -0,0 +1,13 @@
+#pragma once
+
+/**
+ * En-têtes de négociation HTTP des fichiers statiques (sans dépendance au
+ * serveur, testés par [env:native]).
+ * - Accept-Encoding : liste "codage;q=x" ; gzip acceptable s'il est cité
+ *   avec q > 0, ou via "*" s'il n'est pas cité. En-tête absent (nullptr) :
+ *   tout codage est acceptable (RFC 9110 §12.5.3) ; en-tête vide : identity seul.
+ * - If-None-Match : liste de validateurs séparés par des virgules, "*" ou
+ *   étiquettes éventuellement faibles (W/"..."), comparaison faible.
+ */
+bool httpAcceptsGzip(const char *acceptEncoding);
+bool httpEtagMatches(const char *ifNoneMatch, const char *etag);
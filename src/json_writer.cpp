@@ -0,0 +1,292 @@
+#include "json_writer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+JsonWriter::JsonWriter(char *buf, size_t cap) : buf_(buf), cap_(cap)
+{
+    if (cap_ > 0)
+        buf_[0] = '\0';
+    else
+        ok_ = false;
+}
+
+JsonWriter::JsonWriter(JsonSinkFn sink, void *ctx)
+    : buf_(chunk_), cap_(sizeof(chunk_)), sink_(sink), ctx_(ctx)
+{
+}
+
+void JsonWriter::flush()
+{
+    if (sink_ && pos_ > 0)
+    {
+        sink_(ctx_, chunk_, pos_);
+        pos_ = 0;
+    }
+}
+
+void JsonWriter::put(char c)
+{
+    put(&c, 1);
+}
+
+void JsonWriter::put(const char *s, size_t n)
+{
+    total_ += n;
+    if (sink_)
+    {
+        while (n > 0)
+        {
+            if (pos_ == cap_)
+                flush();
+            size_t k = cap_ - pos_;
+            if (k > n)
+                k = n;
+            memcpy(chunk_ + pos_, s, k);
+            pos_ += k;
+            s += k;
+            n -= k;
+        }
+        return;
+    }
+
+    // Tampon fourni : garde toujours une place pour le NUL
+    if (!ok_ || pos_ + n >= cap_)
+    {
+        ok_ = false;
+        return;
+    }
+    memcpy(buf_ + pos_, s, n);
+    pos_ += n;
+    buf_[pos_] = '\0';
+}
+
+void JsonWriter::separator()
+{
+    if (afterKey_)
+    {
+        afterKey_ = false;
+        return;
+    }
+    if (depth_ == 0)
+        return;
+    const uint8_t bit = (uint8_t)(1u << (depth_ - 1));
+    if (hasItems_ & bit)
+        put(',');
+    hasItems_ |= bit;
+}
+
+void JsonWriter::open(char c)
+{
+    separator();
+    put(c);
+    if (depth_ >= JSON_WRITER_DEPTH)
+    {
+        ok_ = false;
+        return;
+    }
+    depth_++;
+    hasItems_ &= (uint8_t)~(1u << (depth_ - 1));
+}
+
+void JsonWriter::close(char c)
+{
+    if (depth_ > 0)
+        depth_--;
+    afterKey_ = false;
+    put(c);
+}
+
+JsonWriter &JsonWriter::beginObject()
+{
+    open('{');
+    return *this;
+}
+
+JsonWriter &JsonWriter::endObject()
+{
+    close('}');
+    return *this;
+}
+
+JsonWriter &JsonWriter::beginArray()
+{
+    open('[');
+    return *this;
+}
+
+JsonWriter &JsonWriter::endArray()
+{
+    close(']');
+    return *this;
+}
+
+void JsonWriter::putString(const char *s)
+{
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    put('"');
+    const char *run = s;
+    for (; *s; ++s)
+    {
+        const unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        put(run, (size_t)(s - run));
+        run = s + 1;
+        switch (c)
+        {
+        case '"':
+            put("\\\"", 2);
+            break;
+        case '\\':
+            put("\\\\", 2);
+            break;
+        case '\n':
+            put("\\n", 2);
+            break;
+        case '\r':
+            put("\\r", 2);
+            break;
+        case '\t':
+            put("\\t", 2);
+            break;
+        default:
+        {
+            const char esc[6] = {'\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0xF]};
+            put(esc, sizeof(esc));
+        }
+        }
+    }
+    put(run, (size_t)(s - run));
+    put('"');
+}
+
+JsonWriter &JsonWriter::key(const char *k)
+{
+    separator();
+    putString(k);
+    put(':');
+    afterKey_ = true;
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(const char *s)
+{
+    if (!s)
+        return null();
+    separator();
+    putString(s);
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(bool b)
+{
+    separator();
+    if (b)
+        put("true", 4);
+    else
+        put("false", 5);
+    return *this;
+}
+
+// Entier non signé, chiffres écrits à l'envers dans un petit tampon
+static size_t formatU32(uint32_t v, char *out)
+{
+    char tmp[10];
+    size_t n = 0;
+    do
+    {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    for (size_t i = 0; i < n; i++)
+        out[i] = tmp[n - 1 - i];
+    return n;
+}
+
+JsonWriter &JsonWriter::valueUnsigned(uint32_t v)
+{
+    separator();
+    char s[10];
+    put(s, formatU32(v, s));
+    return *this;
+}
+
+JsonWriter &JsonWriter::valueSigned(int32_t v)
+{
+    separator();
+    char s[11];
+    size_t n = 0;
+    uint32_t u = (uint32_t)v;
+    if (v < 0)
+    {
+        s[n++] = '-';
+        u = 0u - u;
+    }
+    n += formatU32(u, s + n);
+    put(s, n);
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(float v, uint8_t decimals)
+{
+    if (!isfinite(v))
+        return null();
+    if (decimals > 6)
+        decimals = 6;
+
+    if (fabs((double)v) >= 4.0e9)
+        return value(v); // hors de la plage virgule fixe
+
+    const double scaled = fabs((double)v) * POW10[decimals];
+
+    separator();
+    const uint64_t r = (uint64_t)llround(scaled);
+    const uint32_t ip = (uint32_t)(r / POW10[decimals]);
+    uint32_t fp = (uint32_t)(r % POW10[decimals]);
+
+    char s[24];
+    size_t n = 0;
+    if (v < 0.0f && r != 0)
+        s[n++] = '-';
+    n += formatU32(ip, s + n);
+    if (decimals > 0)
+    {
+        s[n++] = '.';
+        for (int i = decimals - 1; i >= 0; --i)
+        {
+            s[n + i] = (char)('0' + fp % 10);
+            fp /= 10;
+        }
+        n += decimals;
+    }
+    put(s, n);
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(float v)
+{
+    if (!isfinite(v))
+        return null();
+    separator();
+    char s[24]; // printf sur la pile, sans tas
+    const int n = snprintf(s, sizeof(s), "%.7g", (double)v);
+    put(s, n > 0 ? (size_t)n : 0);
+    return *this;
+}
+
+JsonWriter &JsonWriter::null()
+{
+    separator();
+    put("null", 4);
+    return *this;
+}
+
+JsonWriter &JsonWriter::raw(const char *fragment)
+{
+    separator();
+    put(fragment, strlen(fragment));
+    return *this;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+/**
+ * Écrivain JSON en flux, sans allocation.
+ * - Tampon fourni : le texte est écrit en place, toujours terminé par NUL ;
+ *   un dépassement est signalé par ok() == false (jamais de débordement).
+ * - Puits (JsonSinkFn) : le texte est poussé par blocs de JSON_WRITER_CHUNK
+ *   octets (AsyncResponseStream, client MQTT, ...) ; flush() au destructeur.
+ * Les virgules sont gérées par niveau d'imbrication ; les nombres flottants
+ * sont formatés en virgule fixe sans printf, NaN/inf deviennent null.
+ */
+#define JSON_WRITER_CHUNK 128
+#define JSON_WRITER_DEPTH 8
+
+// Même signature que MetricsWriteFn : reçoit des morceaux contigus
+typedef void (*JsonSinkFn)(void *ctx, const char *data, size_t len);
+
+class JsonWriter
+{
+public:
+    JsonWriter(char *buf, size_t cap);
+    JsonWriter(JsonSinkFn sink, void *ctx);
+    ~JsonWriter() { flush(); }
+
+    JsonWriter &beginObject();
+    JsonWriter &endObject();
+    JsonWriter &beginArray();
+    JsonWriter &endArray();
+    JsonWriter &key(const char *k); // clé d'objet, la valeur suit
+
+    JsonWriter &value(const char *s); // chaîne échappée ; nullptr -> null
+    JsonWriter &value(bool b);
+    JsonWriter &value(float v, uint8_t decimals); // NaN/inf -> null
+    JsonWriter &value(float v);                   // 7 chiffres significatifs (%g)
+    // Entiers de toute largeur (int32_t est long sur ESP32, int sur l'hôte)
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, JsonWriter &>::type
+    value(T v)
+    {
+        return std::is_signed<T>::value ? valueSigned((int32_t)v) : valueUnsigned((uint32_t)v);
+    }
+    JsonWriter &null();
+    JsonWriter &raw(const char *fragment); // valeur déjà sérialisée
+
+    // Raccourcis clé + valeur
+    JsonWriter &field(const char *k, const char *s) { return key(k).value(s); }
+    JsonWriter &field(const char *k, bool b) { return key(k).value(b); }
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, JsonWriter &>::type
+    field(const char *k, T v)
+    {
+        return key(k).value(v);
+    }
+    JsonWriter &field(const char *k, float v, uint8_t decimals) { return key(k).value(v, decimals); }
+    // Convention du projet : valeur négative = inconnue -> null
+    JsonWriter &fieldOrNull(const char *k, float v, uint8_t decimals)
+    {
+        return v < 0.0f ? key(k).null() : key(k).value(v, decimals);
+    }
+
+    void flush();
+    bool ok() const { return ok_; }
+    size_t length() const { return total_; } // octets produits (hors NUL)
+
+private:
+    JsonWriter &valueSigned(int32_t v);
+    JsonWriter &valueUnsigned(uint32_t v);
+    void separator();
+    void put(char c);
+    void put(const char *s, size_t n);
+    void putString(const char *s);
+    void open(char c);
+    void close(char c);
+
+    char *buf_;
+    size_t cap_;
+    size_t pos_ = 0;
+    size_t total_ = 0;
+    JsonSinkFn sink_ = nullptr;
+    void *ctx_ = nullptr;
+    char chunk_[JSON_WRITER_CHUNK];
+
+    uint8_t depth_ = 0;
+    uint8_t hasItems_ = 0; // bit d : le niveau d a déjà un élément
+    bool afterKey_ = false;
+    bool ok_ = true;
+};
@@ -0,0 +1,130 @@
+#include "level_kalman.h"
+#include <math.h>
+
+// Rejets consécutifs avant de considérer la mesure comme un vrai saut
+#define KALMAN_MAX_REJECTS 3
+// Innovation normalisée au-delà de laquelle on accélère les mesures (3 sigmas)
+#define SCHED_NIS_ACTIVE 9.0f
+// Innovation normalisée au-delà de laquelle la covariance est gonflée (1 sigma)
+#define KALMAN_FADE_NIS 1.0f
+
+void LevelKalman::configure(float q, float measNoiseCm, float gateSigma)
+{
+    q_ = (q > 0.0f) ? q : 1e-4f;
+    r2_ = (measNoiseCm > 0.0f) ? measNoiseCm * measNoiseCm : 1.0f;
+    gate2_ = (gateSigma > 0.0f) ? gateSigma * gateSigma : 25.0f;
+}
+
+void LevelKalman::reset()
+{
+    s_ = KalmanState{};
+    nis_ = 0.0f;
+}
+
+void LevelKalman::initAt(float z)
+{
+    s_.x = z;
+    s_.v = 0.0f;
+    s_.p00 = r2_;
+    s_.p01 = 0.0f;
+    s_.p11 = 1e-3f; // vitesse inconnue : ~2 cm/min d'écart-type
+    s_.initialized = 1;
+    s_.rejects = 0;
+    nis_ = 0.0f;
+}
+
+void LevelKalman::predict(float dt)
+{
+    if (!s_.initialized || !(dt > 0.0f))
+        return;
+
+    // x' = x + v dt ; P' = F P F^T + Q
+    s_.x += s_.v * dt;
+    const float dt2 = dt * dt;
+    const float p00 = s_.p00 + 2.0f * dt * s_.p01 + dt2 * s_.p11 + q_ * dt2 * dt / 3.0f;
+    const float p01 = s_.p01 + dt * s_.p11 + q_ * dt2 / 2.0f;
+    const float p11 = s_.p11 + q_ * dt;
+    s_.p00 = p00;
+    s_.p01 = p01;
+    s_.p11 = p11;
+}
+
+float LevelKalman::update(float z, float dt)
+{
+    if (!isfinite(z) || z <= 0.0f)
+    {
+        predict(dt);
+        return s_.x;
+    }
+    if (!s_.initialized)
+    {
+        initAt(z);
+        return s_.x;
+    }
+
+    predict(dt);
+
+    const float y = z - s_.x;
+    float S = s_.p00 + r2_;
+    nis_ = y * y / S;
+
+    if (nis_ > gate2_)
+    {
+        if (++s_.rejects >= KALMAN_MAX_REJECTS)
+            initAt(z);
+        return s_.x;
+    }
+    s_.rejects = 0;
+
+    // Innovation plus forte que prévu : le modèle ne suit plus (début ou fin
+    // de pompage), on oublie une partie du passé en proportion
+    if (nis_ > KALMAN_FADE_NIS)
+    {
+        const float lambda = nis_ / KALMAN_FADE_NIS;
+        s_.p00 *= lambda;
+        s_.p01 *= lambda;
+        s_.p11 *= lambda;
+        S = s_.p00 + r2_;
+    }
+
+    const float k0 = s_.p00 / S;
+    const float k1 = s_.p01 / S;
+    s_.x += k0 * y;
+    s_.v += k1 * y;
+
+    const float p00 = (1.0f - k0) * s_.p00;
+    const float p01 = (1.0f - k0) * s_.p01;
+    const float p11 = s_.p11 - k1 * s_.p01;
+    s_.p00 = p00;
+    s_.p01 = p01;
+    s_.p11 = p11;
+    return s_.x;
+}
+
+void AdaptiveScheduler::configure(uint32_t minMs, uint32_t maxMs, float rateThresholdCmPerS)
+{
+    if (maxMs < minMs)
+        maxMs = minMs;
+    minMs_ = minMs;
+    maxMs_ = maxMs;
+    rateThr_ = rateThresholdCmPerS;
+    if (currentMs_ < minMs_ || currentMs_ > maxMs_)
+        currentMs_ = minMs_;
+}
+
+uint32_t AdaptiveScheduler::next(const LevelKalman &kf)
+{
+    const bool active = fabsf(kf.rate()) >= rateThr_ || kf.lastNis() > SCHED_NIS_ACTIVE ||
+                        sqrtf(kf.rateVariance()) >= rateThr_;
+    if (active)
+    {
+        currentMs_ = minMs_;
+    }
+    else
+    {
+        // Retour progressif (x1.5) vers la période de repos
+        const uint32_t grown = currentMs_ + currentMs_ / 2;
+        currentMs_ = (grown > maxMs_) ? maxMs_ : grown;
+    }
+    return currentMs_;
+}
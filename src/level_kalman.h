@@ -0,0 +1,80 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * État du filtre, persistable tel quel en RTC RAM entre deux deep sleep.
+ * x : distance filtrée (cm), v : vitesse (cm/s, > 0 = le niveau baisse),
+ * p00/p01/p11 : covariance.
+ */
+struct KalmanState
+{
+    float x;
+    float v;
+    float p00;
+    float p01;
+    float p11;
+    uint8_t initialized;
+    uint8_t rejects; // innovations rejetées consécutives
+};
+
+/**
+ * Kalman niveau/vitesse (modèle à vitesse constante, accélération bruitée).
+ * - update() prédit sur dt puis corrige avec la mesure z.
+ * - q faible : au repos, l'estimation moyenne un grand nombre de pings. Une
+ *   innovation supérieure à son écart-type attendu gonfle la covariance
+ *   (mémoire évanescente) : le filtre suit alors un remplissage ou une vidange.
+ * - Innovation hors porte (> gate sigmas) : mesure ignorée ; après
+ *   plusieurs rejets consécutifs, le filtre repart sur la mesure (vrai saut).
+ * - Indépendant du matériel (testable hors cible).
+ */
+class LevelKalman
+{
+public:
+    // q : densité spectrale de l'accélération (cm²/s³), r : écart-type mesure (cm)
+    void configure(float q, float measNoiseCm, float gateSigma = 5.0f);
+    void reset();
+
+    float update(float z, float dtS);
+    void predict(float dtS);
+
+    bool initialized() const { return s_.initialized != 0; }
+    float level() const { return s_.x; }
+    float rate() const { return s_.v; }
+    float variance() const { return s_.p00; }
+    float rateVariance() const { return s_.p11; }
+    // Innovation normalisée (y² / S) de la dernière mesure
+    float lastNis() const { return nis_; }
+
+    const KalmanState &state() const { return s_; }
+    void restore(const KalmanState &s) { s_ = s; }
+
+private:
+    void initAt(float z);
+
+    KalmanState s_ = {};
+    float q_ = 1e-4f;
+    float r2_ = 1.0f;
+    float gate2_ = 25.0f;
+    float nis_ = 0.0f;
+};
+
+/**
+ * Période de mesure adaptative : courte quand le niveau bouge (vitesse ou
+ * innovation élevée) ou tant que la vitesse n'est pas connue à mieux que le
+ * seuil près, puis allongée progressivement jusqu'à maxMs au repos.
+ */
+class AdaptiveScheduler
+{
+public:
+    void configure(uint32_t minMs, uint32_t maxMs, float rateThresholdCmPerS);
+    uint32_t next(const LevelKalman &kf);
+
+    uint32_t current() const { return currentMs_; }
+    void setCurrent(uint32_t ms) { currentMs_ = ms; }
+
+private:
+    uint32_t minMs_ = 250;
+    uint32_t maxMs_ = 1000;
+    float rateThr_ = 0.03f;
+    uint32_t currentMs_ = 0;
+};
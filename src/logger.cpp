@@ -0,0 +1,257 @@
+#include "logger.h"
+#include <Arduino.h>
+#include <mutex>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "hal/hal_time.h"
+
+static_assert((LOG_RING_SLOTS & (LOG_RING_SLOTS - 1)) == 0, "LOG_RING_SLOTS : puissance de 2");
+
+std::atomic<uint8_t> logLevels[LOG_MODULE_COUNT] = {
+    {LOG_LEVEL_DEFAULT}, {LOG_LEVEL_DEFAULT}, {LOG_LEVEL_DEFAULT}, {LOG_LEVEL_DEFAULT},
+    {LOG_LEVEL_DEFAULT}, {LOG_LEVEL_DEFAULT}, {LOG_LEVEL_DEFAULT}, {LOG_LEVEL_DEFAULT}};
+
+static const char *const MODULE_NAMES[LOG_MODULE_COUNT] = {
+    "main", "config", "web", "mqtt", "wifi", "sensor", "power", "display"};
+static const char *const LEVEL_NAMES[] = {"none", "error", "warn", "info", "debug"};
+static const char LEVEL_TAGS[] = "-EWID";
+
+/**
+ * File bornée multi-producteurs / un consommateur (schéma de D. Vyukov).
+ * Pour la position p, l'emplacement p % N est libre quand seq == base(p)
+ * et prêt à lire quand seq == base(p) + 1 ; le consommateur le rend pour le
+ * tour suivant (base(p) + N). base(p) = p arrondi au multiple de N : un
+ * anneau à zéro (.bss) est donc valide avant tout constructeur, et le
+ * rebouclage 32 bits reste cohérent (N divise 2^32).
+ */
+struct LogSlot
+{
+    std::atomic<uint32_t> seq;
+    LogLine line;
+};
+
+static LogSlot ring[LOG_RING_SLOTS];
+static std::atomic<uint32_t> ringHead{0}; // prochaine position à réserver
+static std::atomic<uint32_t> dropped{0};
+
+// Côté consommateur : sérialisé par drainMutex (tâche logDrain ou logFlush),
+// tenu pendant l'écriture Serial ; la traîne a son propre verrou, bref, pour
+// que /api/logs n'attende jamais l'USB
+static std::mutex drainMutex;
+static uint32_t ringTail = 0;
+static uint32_t droppedReported = 0;
+static std::mutex tailMutex;
+static uint32_t lineSeq = 0;
+#if LOG_TAIL_LINES > 0
+static LogLine tailLines[LOG_TAIL_LINES];
+#endif
+
+static void serialSink(void *, const char *line, size_t len)
+{
+    Serial.write((const uint8_t *)line, len);
+}
+
+static LogSinkFn sinkFn = serialSink;
+static void *sinkCtx = nullptr;
+
+static inline uint32_t slotBase(uint32_t pos)
+{
+    return pos & ~(uint32_t)(LOG_RING_SLOTS - 1);
+}
+
+void logSetLevel(LogModule module, uint8_t level)
+{
+    if (module < LogModule::Count)
+        logLevels[(size_t)module].store(level > LOG_LEVEL_DEBUG ? LOG_LEVEL_DEBUG : level, std::memory_order_relaxed);
+}
+
+uint8_t logLevel(LogModule module)
+{
+    return module < LogModule::Count ? logLevels[(size_t)module].load(std::memory_order_relaxed) : LOG_LEVEL_NONE;
+}
+
+const char *logModuleName(LogModule module)
+{
+    return module < LogModule::Count ? MODULE_NAMES[(size_t)module] : "?";
+}
+
+const char *logLevelName(uint8_t level)
+{
+    return level <= LOG_LEVEL_DEBUG ? LEVEL_NAMES[level] : "?";
+}
+
+bool logParseModule(const char *name, LogModule &out)
+{
+    for (size_t i = 0; i < LOG_MODULE_COUNT; i++)
+    {
+        if (strcmp(name, MODULE_NAMES[i]) == 0)
+        {
+            out = (LogModule)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool logParseLevel(const char *name, uint8_t &out)
+{
+    for (uint8_t i = 0; i <= LOG_LEVEL_DEBUG; i++)
+    {
+        if (strcmp(name, LEVEL_NAMES[i]) == 0)
+        {
+            out = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void logWrite(LogModule module, uint8_t level, const char *fmt, ...)
+{
+    // Réservation : jamais d'attente, l'anneau plein fait perdre la ligne
+    uint32_t pos = ringHead.load(std::memory_order_relaxed);
+    LogSlot *slot;
+    for (;;)
+    {
+        slot = &ring[pos & (LOG_RING_SLOTS - 1)];
+        const int32_t dif = (int32_t)(slot->seq.load(std::memory_order_acquire) - slotBase(pos));
+        if (dif == 0)
+        {
+            if (ringHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = ringHead.load(std::memory_order_relaxed);
+        }
+    }
+
+    LogLine &line = slot->line;
+    line.ms = halMillis();
+    line.module = module;
+    line.level = level;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line.text, sizeof(line.text), fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        n = 0;
+    else if (n >= (int)sizeof(line.text))
+        n = sizeof(line.text) - 1;
+    // Les anciens messages finissaient souvent par '\n' : la mise en forme l'ajoute
+    while (n > 0 && (line.text[n - 1] == '\n' || line.text[n - 1] == '\r'))
+        n--;
+    line.text[n] = '\0';
+    line.len = (uint8_t)n;
+    slot->seq.store(slotBase(pos) + 1, std::memory_order_release);
+}
+
+uint32_t logDropped()
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+size_t logFormatLine(const LogLine &line, char *out, size_t cap)
+{
+    const int n = snprintf(out, cap, "%lu %c [%s] %s\n", (unsigned long)line.ms,
+                           LEVEL_TAGS[line.level <= LOG_LEVEL_DEBUG ? line.level : 0],
+                           logModuleName(line.module), line.text);
+    if (n < 0)
+        return 0;
+    return (size_t)n < cap ? (size_t)n : cap - 1;
+}
+
+// Appelé avec drainMutex tenu
+static void emitLocked(LogLine &line)
+{
+    {
+        std::lock_guard<std::mutex> lk(tailMutex);
+        line.seq = ++lineSeq;
+#if LOG_TAIL_LINES > 0
+        tailLines[line.seq % LOG_TAIL_LINES] = line;
+#endif
+    }
+    char out[LOG_LINE_MAX + 32];
+    const size_t n = logFormatLine(line, out, sizeof(out));
+    if (sinkFn && n > 0)
+        sinkFn(sinkCtx, out, n);
+}
+
+size_t logFlush()
+{
+    std::lock_guard<std::mutex> lk(drainMutex);
+    size_t count = 0;
+    for (;;)
+    {
+        LogSlot &slot = ring[ringTail & (LOG_RING_SLOTS - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != slotBase(ringTail) + 1)
+            break; // vide, ou producteur encore en train d'écrire
+        LogLine line = slot.line;
+        slot.seq.store(slotBase(ringTail) + LOG_RING_SLOTS, std::memory_order_release);
+        ringTail++;
+        emitLocked(line);
+        count++;
+    }
+
+    const uint32_t lost = dropped.load(std::memory_order_relaxed);
+    if (lost != droppedReported)
+    {
+        LogLine line{};
+        line.ms = halMillis();
+        line.module = LogModule::Main;
+        line.level = LOG_LEVEL_WARN;
+        line.len = (uint8_t)snprintf(line.text, sizeof(line.text), "[LOG] %lu ligne(s) perdue(s) (anneau plein)",
+                                     (unsigned long)(lost - droppedReported));
+        droppedReported = lost;
+        emitLocked(line);
+        count++;
+    }
+    return count;
+}
+
+void logSetSink(LogSinkFn sink, void *ctx)
+{
+    std::lock_guard<std::mutex> lk(drainMutex);
+    sinkFn = sink ? sink : serialSink;
+    sinkCtx = sink ? ctx : nullptr;
+}
+
+uint32_t logTail(uint32_t since, LogTailFn fn, void *ctx)
+{
+    std::lock_guard<std::mutex> lk(tailMutex);
+#if LOG_TAIL_LINES > 0
+    uint32_t first = since + 1;
+    if (lineSeq >= LOG_TAIL_LINES && first < lineSeq - LOG_TAIL_LINES + 1)
+        first = lineSeq - LOG_TAIL_LINES + 1;
+    for (uint32_t s = first; s <= lineSeq && s != 0; s++)
+        fn(ctx, tailLines[s % LOG_TAIL_LINES]);
+#else
+    (void)since;
+    (void)fn;
+    (void)ctx;
+#endif
+    return lineSeq;
+}
+
+static void logDrainTask(void *)
+{
+    for (;;)
+    {
+        logFlush();
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_POLL_MS));
+    }
+}
+
+TaskHandle_t logBegin()
+{
+    static TaskHandle_t handle = nullptr;
+    if (!handle)
+        xTaskCreate(logDrainTask, "logDrain", 3072, nullptr, 1, &handle);
+    return handle;
+}
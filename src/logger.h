@@ -0,0 +1,123 @@
+#pragma once
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * Journal asynchrone.
+ * - Producteurs (toutes tâches) : LOG_E/W/I/D formatent dans un emplacement
+ *   d'un anneau fixe réservé par compare-and-swap, sans verrou ni
+ *   allocation ; anneau plein -> ligne perdue et comptée, jamais d'attente.
+ * - Consommateur : la tâche basse priorité "logDrain" (logBegin) vide
+ *   l'anneau vers Serial ; logFlush() vide sur place (avant deep sleep,
+ *   build hôte). Les dernières lignes restent lisibles via /api/logs.
+ * - Niveaux : LOG_LEVEL_MAX (option de compilation) retire les appels plus
+ *   bavards du binaire, chaînes de format comprises ; au-dessous, un niveau
+ *   par module réglable à chaud (une lecture atomique par appel filtré).
+ */
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL_MAX
+#define LOG_LEVEL_MAX LOG_LEVEL_DEBUG // niveau le plus bavard compilé
+#endif
+#ifndef LOG_LEVEL_DEFAULT
+#define LOG_LEVEL_DEFAULT LOG_LEVEL_INFO // niveau de départ de chaque module
+#endif
+
+#define LOG_LINE_MAX 120   // texte d'une ligne (tronqué au-delà)
+#define LOG_RING_SLOTS 32  // puissance de 2
+#define LOG_TAIL_LINES 32  // lignes gardées pour /api/logs (0 = désactivé)
+#define LOG_DRAIN_POLL_MS 20
+
+enum class LogModule : uint8_t
+{
+    Main = 0,
+    Config,
+    Web,
+    Mqtt,
+    Wifi,
+    Sensor, // mesure, calibration, cuve
+    Power,
+    Display,
+    Count
+};
+
+#define LOG_MODULE_COUNT ((size_t)LogModule::Count)
+
+// Sortie du consommateur (Serial par défaut) : reçoit une ligne complète
+typedef void (*LogSinkFn)(void *ctx, const char *line, size_t len);
+
+// Ligne déjà sortie de l'anneau (copie gardée pour /api/logs)
+struct LogLine
+{
+    uint32_t seq; // numéro croissant, pour les lectures incrémentales
+    uint32_t ms;
+    LogModule module;
+    uint8_t level;
+    uint8_t len;
+    char text[LOG_LINE_MAX];
+};
+
+// Démarre la tâche de vidage (les lignes émises avant restent dans l'anneau) ;
+// retourne son handle pour le suivi de pile
+TaskHandle_t logBegin();
+// Vide l'anneau dans la tâche appelante ; retourne le nombre de lignes sorties
+size_t logFlush();
+void logSetSink(LogSinkFn sink, void *ctx); // nullptr : retour à Serial
+
+// Niveau courant de chaque module (lecture relâchée sur le chemin chaud)
+extern std::atomic<uint8_t> logLevels[LOG_MODULE_COUNT];
+
+inline bool logEnabled(LogModule module, uint8_t level)
+{
+    return level <= logLevels[(size_t)module].load(std::memory_order_relaxed);
+}
+void logSetLevel(LogModule module, uint8_t level);
+uint8_t logLevel(LogModule module);
+const char *logModuleName(LogModule module);
+bool logParseModule(const char *name, LogModule &out);
+bool logParseLevel(const char *name, uint8_t &out);
+const char *logLevelName(uint8_t level);
+
+void logWrite(LogModule module, uint8_t level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+uint32_t logDropped(); // lignes perdues (anneau plein) depuis le démarrage
+
+// Parcourt les lignes de la traîne de numéro > since, de la plus ancienne
+// à la plus récente ; retourne le numéro de la dernière ligne disponible
+typedef void (*LogTailFn)(void *ctx, const LogLine &line);
+uint32_t logTail(uint32_t since, LogTailFn fn, void *ctx);
+// Mise en forme commune (Serial, /api/logs) : "ms L [MODULE] texte\n"
+size_t logFormatLine(const LogLine &line, char *out, size_t cap);
+
+#define LOG_AT(level, module, ...)                               \
+    do                                                           \
+    {                                                            \
+        if (logEnabled(LogModule::module, level))                \
+            logWrite(LogModule::module, level, __VA_ARGS__);     \
+    } while (0)
+
+#if LOG_LEVEL_MAX >= LOG_LEVEL_ERROR
+#define LOG_E(module, ...) LOG_AT(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+#else
+#define LOG_E(module, ...) do { } while (0)
+#endif
+#if LOG_LEVEL_MAX >= LOG_LEVEL_WARN
+#define LOG_W(module, ...) LOG_AT(LOG_LEVEL_WARN, module, __VA_ARGS__)
+#else
+#define LOG_W(module, ...) do { } while (0)
+#endif
+#if LOG_LEVEL_MAX >= LOG_LEVEL_INFO
+#define LOG_I(module, ...) LOG_AT(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#else
+#define LOG_I(module, ...) do { } while (0)
+#endif
+#if LOG_LEVEL_MAX >= LOG_LEVEL_DEBUG
+#define LOG_D(module, ...) LOG_AT(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+#else
+#define LOG_D(module, ...) do { } while (0)
+#endif
@@ -3,82 +3,157 @@
 #include "config.h"
 #include "config_manager.h"
 #include "measurement.h"
+#include "measurement_store.h"
 #include "display.h"
 #include "mqtt.h"
 #include "web_server.h"
 #include "power.h"
 #include "utils.h"
+#include "metrics.h"
+#include "rtc_config_cache.h"
+#include "logger.h"
 #include <math.h> // isfinite
+#include <time.h>
 
 bool interactiveMode = false;
 
 void setup()
 {
     Serial.begin(115200);
-    DEBUG_PRINT("Booting M5CoreS3 JSN_SR04T...");
+    wakeProfiler.start(halMicros());
+    // Journal vidé vers Serial par une tâche basse priorité : les
+    // producteurs (web, MQTT, config) n'attendent jamais l'USB CDC
+    registerMonitoredTask("logDrain", logBegin());
+    LOG_I(Main, "Booting M5CoreS3 JSN_SR04T...");
 
-    // Initialisation du gestionnaire de configuration
-    if (!ConfigManager::instance().begin())
+    const bool timerWake = (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER);
+    metricsBegin(halCyclesPerUs());
+
+    // Réveil timer : config effective et calibration ajustée depuis la RTC (ni NVS ni ajustement)
+    if (timerWake && rtcCacheRestore())
+    {
+        LOG_I(Main, "[CACHE] Config et calibration restaurées depuis la RTC");
+        wakeProfiler.mark(WakePhase::Config, halMicros());
+        loadCalibrations(1); // canaux suivants : hors cache RTC
+    }
+    else
     {
-        Serial.println("[WEB][WARN] ConfigManager n’a pas pu charger la configuration, utilisation des valeurs par défaut.");
-        ConfigManager::instance().save();
+        // Initialisation du gestionnaire de configuration
+        if (!ConfigManager::instance().begin())
+        {
+            LOG_W(Main, "ConfigManager n’a pas pu charger la configuration, utilisation des valeurs par défaut.");
+            ConfigManager::instance().save();
+        }
+        wakeProfiler.mark(WakePhase::Config, halMicros());
+
+        loadCalibrations();
+        rtcCacheCapture();
     }
 
     initSensor();
-    loadCalibrations();
-    computePolynomialFrom3Points();
     setupMQTT();
+    wakeProfiler.mark(WakePhase::Calibration, halMicros());
 
-    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER)
+    if (timerWake)
     {
-        float avg = (isfinite(emaStateCm) ? emaStateCm : NAN);
-
-        float alpha = ConfigManager::instance().getRunningAverageAlpha();
-        if (alpha <= 0.0f || alpha > 1.0f)
-            alpha = 0.25f;
-
+        // Kalman repris depuis la RTC : dt = durée du sommeil.
+        // Canaux entrelacés : les déclenchements restent espacés (SENSOR_STAGGER_US)
+        float level[SENSOR_CHANNELS];
+        uint8_t valid[SENSOR_CHANNELS] = {};
+        for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+            level[ch] = NAN;
         for (int i = 0; i < 3; i++)
         {
-            float m = measureDistanceStable();
-            if (m > 0)
+            for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
             {
-                m += ConfigManager::instance().getMeasureOffsetCm();
-
-                if (!isfinite(avg))
-                {
-                    avg = m;
-                }
-                else
-                {
-                    avg = runningAverage(m, avg, alpha);
-                }
+                float m = measureDistanceStable(&valid[ch], ch);
+                if (m > 0)
+                    m += ConfigManager::instance().getMeasureOffsetCm();
+                const float f = filterLevel(m, ch);
+                if (isfinite(f))
+                    level[ch] = f;
             }
             delay(30);
         }
 
-        lastEstimatedHeight = (isfinite(avg) ? estimateHeightFromMeasured(avg) : -1.0f);
-        lastMeasuredCm = (isfinite(avg) ? avg : -1.0f);
-
-        if (isfinite(avg))
+        MeasurementSet set;
+        for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
         {
-            emaStateCm = avg;
+            MeasurementRecord &rec = set.ch[ch];
+            rec = MeasurementRecord{};
+            rec.channel = ch;
+            rec.measuredCm = (isfinite(level[ch]) ? level[ch] : -1.0f);
+            const float est = (isfinite(level[ch]) ? estimateHeightFromMeasured(level[ch], ch) : NAN);
+            rec.estimatedCm = (isfinite(est) ? est : -1.0f);
+            rec.durationUs = lastEchoDurationUs(ch);
+            rec.validSamples = valid[ch];
+            rec.totalSamples = (uint8_t)ConfigManager::instance().getMedianSamples();
+            rec.rateCmMin = filteredRateCmMin(ch);
+            applyTankVolume(rec);
+            publishMeasurement(rec);
         }
+        wakeProfiler.mark(WakePhase::Measure, halMicros());
 
-        if (connectWiFiShort(6000))
-            publishMQTT_measure();
+        // Envoi groupé : le Wi-Fi n'est réveillé que lorsque la politique le demande
+        const ConfigPtr cfg = ConfigManager::instance().snapshot();
+        batchEnsureValid(rtcBatch);
+        batchPush(rtcBatch, (uint32_t)time(nullptr), set);
 
-        goDeepSleep();
+        if (!cfg->mqtt_enabled)
+        {
+            batchMarkUploaded(rtcBatch, set); // rien à envoyer : pas de Wi-Fi
+        }
+        else if (batchShouldFlush(rtcBatch, cfg->batch_upload_every, cfg->batch_threshold_cm, set))
+        {
+            const bool wifiOk = connectWiFiShort(6000);
+            wakeProfiler.mark(WakePhase::Wifi, halMicros());
+            if (wifiOk)
+            {
+                wakeProfiler.setFlag(WAKE_FLAG_WIFI);
+
+                // Lot + profil des réveils précédents (référence du temps d'éveil)
+                static char payload[RTC_BATCH_PAYLOAD_LEN];
+                JsonWriter w(payload, sizeof(payload));
+                w.beginObject();
+                batchWriteJson(w, rtcBatch, set, (uint32_t)time(nullptr));
+                w.field("wifi_ms", getLastWifiConnectMs()).field("wifi_fast", wasLastWifiConnectFast());
+                wakeProfileWriteJson(w, wakeRing);
+                w.endObject();
+                if (w.ok() && publishMQTT_payload(payload))
+                {
+                    batchMarkUploaded(rtcBatch, set);
+                    wakeProfiler.setFlag(WAKE_FLAG_PUBLISHED);
+                }
+                wakeProfiler.mark(WakePhase::Mqtt, halMicros());
+            }
+        }
+        else
+        {
+            LOG_I(Main, "[BATCH] %u lecture(s) en attente, pas de Wi-Fi", rtcBatch.count);
+        }
+
+        goDeepSleep(nextDeepSleepS());
     }
     else
     {
-        Serial.println("interactive mode");
+        LOG_I(Main, "interactive mode");
+        wakeProfiler.cancel();
+
+        // Coût d'un enregistrement de métrique (exporté par /api/metrics)
+        LOG_I(Main, "[METRICS] record() = %lu cycles", (unsigned long)metricsBenchmark(1000));
 
         initDisplay();
 
+        ConfigManager::instance().startWriteBehind();
         startWebServer();
+        startMQTTTask();
 
-        xTaskCreatePinnedToCore(sensorTask, "sensorTask", 4096, NULL, 2, NULL, 1);
-        xTaskCreatePinnedToCore(displayTask, "displayTask", 8192, NULL, 1, NULL, 1);
+        TaskHandle_t sensorHandle = nullptr, displayHandle = nullptr;
+        xTaskCreatePinnedToCore(sensorTask, "sensorTask", 4096, NULL, 2, &sensorHandle, 1);
+        xTaskCreatePinnedToCore(displayTask, "displayTask", 8192, NULL, 1, &displayHandle, 1);
+        registerMonitoredTask("sensorTask", sensorHandle);
+        registerMonitoredTask("displayTask", displayHandle);
+        registerMonitoredTask("loopTask", xTaskGetCurrentTaskHandle());
 
         interactiveMode = true;
         interactiveLastTouchMs = millis();
@@ -87,9 +162,16 @@ void setup()
 
 void loop()
 {
+    static uint32_t lastHeapLogMs = 0;
     if (interactiveMode)
     {
-        const uint32_t timeout = ConfigManager::instance().getConfig().interactive_timeout_ms;
+        if (logEnabled(LogModule::Main, LOG_LEVEL_DEBUG) && (uint32_t)(millis() - lastHeapLogMs) >= 300000)
+        {
+            lastHeapLogMs = millis();
+            printLogHeapStack();
+        }
+
+        const uint32_t timeout = ConfigManager::instance().snapshot()->interactive_timeout_ms;
         if ((uint32_t)(millis() - interactiveLastTouchMs.load()) > timeout)
         {
             if (isApModeActive())
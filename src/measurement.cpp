@@ -1,234 +1,611 @@
-#include <M5CoreS3.h>
-#include <Preferences.h>
-#include <algorithm> // std::sort
+#include <Arduino.h>
 #include <math.h>    // isnan, isfinite
 #include "measurement.h"
 #include "config.h"
 #include "config_manager.h"
+#include "echo_source.h"
+#include "measurement_store.h"
+#include "median_filter.h"
+#include "mqtt.h"
+#include "history_store.h"
+#include "web_server.h"
+#include "display.h"
+#include "calibration.h"
+#include "tank_geometry.h"
+#include "level_kalman.h"
+#include "metrics.h"
+#include "logger.h"
+#include "rtc_config_cache.h"
+#include "hal/hal_time.h"
+#include "hal/hal_kv.h"
+#include <mutex>
+#include <memory>
 
 // ---------- Globals ----------
 RTC_DATA_ATTR bool wokeFromTimer = false;
 
 /**
- * État de la moyenne exponentielle (EMA) persistant en RTC RAM.
- * - NAN = non initialisé (premier démarrage).
- * - Conserve la dernière moyenne pour supprimer le biais d'init à 0.
+ * État du Kalman niveau/vitesse de chaque canal, persistant en RTC RAM.
+ * - initialized = 0 au premier démarrage.
+ * - kalmanStampMs : horloge murale de la dernière mise à jour (dt entre réveils).
+ * - sleepScheduleMs : période de deep sleep adaptative courante.
  */
-RTC_DATA_ATTR float emaStateCm = NAN;
+RTC_DATA_ATTR KalmanState kalmanState[SENSOR_CHANNELS] = {};
+RTC_DATA_ATTR int64_t kalmanStampMs[SENSOR_CHANNELS] = {};
+RTC_DATA_ATTR uint32_t sleepScheduleMs = 0;
 
-float lastMeasuredCm = -1.0f;
-float lastEstimatedHeight = -1.0f;
-unsigned long lastDurationUs = 0;
+// Lectures accumulées entre deux envois MQTT groupés (réveils timer)
+RTC_DATA_ATTR RtcBatch rtcBatch;
 
-// Calibration
-float calib_m[3] = {0.0f, 0.0f, 0.0f};
-float calib_h[3] = {50.0f, 100.0f, 150.0f};
+// Cuve levels (valeurs par défaut appliquées au chargement de la calibration)
+static const float CUVE_VIDE_DEFAULT_CM = 123.0f;
+static const float CUVE_PLEINE_DEFAULT_CM = 42.0f;
+std::atomic<float> cuveVideCh[SENSOR_CHANNELS] = {};
+std::atomic<float> cuvePleineCh[SENSOR_CHANNELS] = {};
+std::atomic<float> &cuveVide = cuveVideCh[0];
+std::atomic<float> &cuvePleine = cuvePleineCh[0];
 
-// Cuve levels
-float cuveVide = 123.0f;
-float cuvePleine = 42.0f;
+KvStore preferences;
 
-// Polynomial coeffs
-double a_coef = 0, b_coef = 0, c_coef = 0;
-static bool polyValid = false;
+/**
+ * État propre à un canal. Tout sauf la calibration appartient au chemin de
+ * mesure (tâche capteur ou chemin de réveil, jamais les deux).
+ */
+struct SensorChannel
+{
+    // Durée brute du dernier écho
+    uint32_t lastPingDurationUs = 0;
+
+    // Médiane glissante persistante de la tâche capteur (un ping par cycle)
+    SlidingMedian streamMedian;
+
+    // Filtre niveau/vitesse et période adaptative propre au canal
+    LevelKalman levelFilter;
+    AdaptiveScheduler scheduler;
+
+    // Calibration : points de travail (sous calibMutex) et table publiée (LUT prête),
+    // lue sans verrou par le chemin de mesure
+    std::mutex calibMutex;
+    CalibrationTable calibWorking;
+    CalibrationPtr calibCurrent;
+    std::atomic<uint32_t> calibCfgGeneration{0};
+
+    // Modèle de volume : reconstruit quand la config ou les niveaux de cuve changent
+    TankModel tankModel;
+    uint32_t tankCfgGeneration = 0;
+    float tankBuiltVide = NAN, tankBuiltPleine = NAN;
+};
+
+static SensorChannel channels[SENSOR_CHANNELS];
+
+// Dernier déclenchement, tous canaux confondus (espacement anti-diaphonie)
+static uint64_t lastTriggerUs = 0;
+static int lastTriggerCh = -1;
 
-Preferences preferences;
+// Instantané de config du pipeline de mesure (rafraîchi sur changement de génération)
+static ConfigView measureCfg;
 
-bool isPolynomialValid()
+// Espace NVS de la calibration et des niveaux de cuve : "calib", "calib1", ...
+#define CALIB_NS_LEN 12 // "calib" + uint8_t en décimal + NUL
+static void calibNamespace(uint8_t ch, char *out, size_t len)
 {
-    return polyValid;
+    if (ch == 0)
+        snprintf(out, len, "calib");
+    else
+        snprintf(out, len, "calib%hhu", ch);
 }
 
-void sensorTask(void *pv)
+bool isCalibrationValid(uint8_t ch)
 {
-    // Démarre sur l'état persistant si disponible (sinon NaN).
-    float avg = (isfinite(emaStateCm) ? emaStateCm : NAN);
+    const CalibrationPtr t = std::atomic_load(&channels[ch].calibCurrent);
+    return t && t->valid();
+}
 
-    for (;;)
+CalibrationPtr calibrationSnapshot(uint8_t ch)
+{
+    return std::atomic_load(&channels[ch].calibCurrent);
+}
+
+void writeCalibsJson(JsonWriter &w, uint8_t ch)
+{
+    const CalibrationPtr t = calibrationSnapshot(ch);
+    w.beginObject();
+    if (SENSOR_CHANNELS > 1)
+        w.field("ch", ch);
+    w.field("model", CalibrationTable::modelName(t ? t->model() : CalibModel::Poly))
+        .field("degree", t ? t->polyDegree() : 2)
+        .field("valid", t && t->valid())
+        .field("max", CALIB_MAX_POINTS);
+    w.key("calibs").beginArray();
+    const size_t n = t ? t->count() : 0;
+    for (size_t i = 0; i < n; i++)
     {
-        float m = measureDistanceStable();
+        const CalibPoint &p = t->point(i);
+        w.beginObject()
+            .field("index", (uint32_t)i)
+            .field("measured", p.measuredCm, 2)
+            .field("height", p.heightCm, 2)
+            .endObject();
+    }
+    w.endArray().endObject();
+}
 
-        // Offset dynamique
-        float offset = ConfigManager::instance().getMeasureOffsetCm();
-        if (m > 0)
-            m += offset;
+/**
+ * Déclenche le capteur ch. Passer d'un capteur à un autre attend que
+ * SENSOR_STAGGER_US se soit écoulé depuis le déclenchement précédent : la
+ * fenêtre d'écho du précédent est close et ses réflexions éteintes, un
+ * capteur ne peut donc jamais recevoir le burst d'un autre.
+ */
+static void triggerPing(uint8_t ch)
+{
+    if (lastTriggerCh >= 0 && lastTriggerCh != ch)
+    {
+        const uint64_t earliest = lastTriggerUs + SENSOR_STAGGER_US;
+        const uint64_t now = halMicros();
+        if (now < earliest)
+            halDelayMs((uint32_t)((earliest - now + 999) / 1000));
+    }
+    lastTriggerUs = halMicros();
+    lastTriggerCh = ch;
+    sensorEchoSource(ch).startPing();
+}
 
-        // Alpha dynamique depuis la config (fallback 0.25 si invalide)
-        float alpha = ConfigManager::instance().getRunningAverageAlpha();
-        if (alpha <= 0.0f || alpha > 1.0f)
-            alpha = 0.25f;
+// Fin du ping en cours sur ch : distance brute (cm), -1 sans écho
+static float collectPing(uint8_t ch)
+{
+    // La tâche est bloquée (pas d'attente active) pendant le temps de vol
+    uint32_t duration;
+    {
+        StageTimer timer(MetricStage::EchoWait);
+        duration = sensorEchoSource(ch).waitPulseUs(ECHO_TIMEOUT_US);
+    }
+    channels[ch].lastPingDurationUs = duration;
+    if (duration == 0)
+        return -1.0f;
+    return duration * 0.01715f;
+}
 
-        // Initialisation "première mesure" pour éviter le biais à 0
-        if (m > 0)
-        {
-            if (!isfinite(avg))
-            {
-                avg = m; // amorçage propre de l’EMA
-            }
-            else
-            {
-                avg = runningAverage(m, avg, alpha);
-            }
-        }
-        // Pas de mise à jour de avg si mesure invalide (m <= 0)
+// Médiane, Kalman, calibration et volume d'un ping du flux. Calcul en RAM
+// seulement : s'exécute pendant le temps de vol du canal suivant
+static void processPing(uint8_t ch, float cm, MeasurementRecord &rec)
+{
+    SensorChannel &c = channels[ch];
+    const AppConfig &cfg = measureCfg.get();
+    float m;
+    {
+        StageTimer timer(MetricStage::Median);
+        c.streamMedian.configure(cfg.median_n, cfg.filter_min_cm, cfg.filter_max_cm);
+        c.streamMedian.push(cm);
+        m = c.streamMedian.median();
+    }
 
-        float est = NAN;
-        if (isfinite(avg) && avg > 0.0f && isPolynomialValid())
-        {
-            est = estimateHeightFromMeasured(avg);
-        }
+    // Offset dynamique
+    if (m > 0)
+        m += cfg.measure_offset_cm;
 
-        {
-            std::lock_guard<std::mutex> lock(distMutex);
-            lastMeasuredCm = (isfinite(avg) ? avg : -1.0f);
-            lastEstimatedHeight = (isfinite(est) ? est : -1.0f);
-        }
+    rec = MeasurementRecord{};
+    rec.channel = ch;
+    {
+        StageTimer timer(MetricStage::Estimator);
+
+        // Kalman niveau/vitesse (mesure invalide : prédiction seule)
+        const float level = filterLevel(m, ch);
 
-        // Sauvegarder l'état EMA courant en RTC pour la reprise après deep sleep
-        if (isfinite(avg))
+        float est = NAN;
+        if (isfinite(level) && level > 0.0f)
         {
-            emaStateCm = avg;
+            est = estimateHeightFromMeasured(level, ch);
         }
 
-        // Période de mesure dynamique (garde-fou à 50 ms)
-        uint32_t periodMs = ConfigManager::instance().getMeasureIntervalMs();
-        if (periodMs < 50)
-            periodMs = 50;
+        rec.measuredCm = (isfinite(level) ? level : -1.0f);
+        rec.estimatedCm = (isfinite(est) ? est : -1.0f);
+        rec.durationUs = c.lastPingDurationUs;
+        rec.validSamples = c.streamMedian.validCount();
+        rec.totalSamples = (uint8_t)cfg.median_n;
+        rec.rateCmMin = filteredRateCmMin(ch);
+        applyTankVolume(rec);
+    }
+}
+
+// Publication, historique (flash) et SSE, une fois tous les échos reçus :
+// une écriture flash coupe le cache et retarderait la notification de fin
+// d'écho (l'horodatage des fronts, lui, est figé par la capture MCPWM)
+static void commitMeasurement(MeasurementRecord &rec)
+{
+    publishMeasurement(rec);
+    if (rec.channel == 0)
+        historyStore.append((uint32_t)(halWallClockMs() / 1000), rec.measuredCm);
+    webNotifyMeasurement(rec);
+}
 
-        vTaskDelay(pdMS_TO_TICKS(periodMs));
+uint32_t sensorStep()
+{
+    // Pipeline : le canal suivant est déclenché avant le traitement du
+    // précédent, dont le calcul s'exécute pendant ce temps de vol ;
+    // publication, historique et SSE attendent le dernier écho
+    MeasurementSet set;
+    float pendingCm = -1.0f;
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ++ch)
+    {
+        triggerPing(ch);
+        if (ch > 0)
+            processPing(ch - 1, pendingCm, set.ch[ch - 1]);
+        pendingCm = collectPing(ch);
+    }
+    processPing(SENSOR_CHANNELS - 1, pendingCm, set.ch[SENSOR_CHANNELS - 1]);
+    for (MeasurementRecord &rec : set.ch)
+        commitMeasurement(rec);
+
+    const AppConfig &cfg = measureCfg.get();
+    if (cfg.mqtt_enabled)
+        mqttEnqueueMeasure(set); // un message pour tous les canaux
+    displayNotify();
+
+    // Période adaptative : si un niveau bouge, median_n pings par
+    // measure_interval_ms (le débit de l'ancienne rafale), jusqu'à
+    // measure_interval_max_ms au repos (garde-fou à 50 ms)
+    uint32_t periodMs = UINT32_MAX;
+    for (SensorChannel &c : channels)
+    {
+        c.scheduler.configure(cfg.measure_interval_ms / cfg.median_n, cfg.measure_interval_max_ms,
+                              cfg.adaptive_rate_cm_min / 60.0f);
+        const uint32_t p = c.scheduler.next(c.levelFilter);
+        if (p < periodMs)
+            periodMs = p;
     }
+    if (periodMs < 50)
+        periodMs = 50;
+    return periodMs;
+}
+
+void sensorTask(void *)
+{
+    for (;;)
+        halDelayMs(sensorStep());
 }
 
 void initSensor()
 {
-    pinMode(trigPin, OUTPUT);
-    pinMode(echoPin, INPUT);
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ++ch)
+        sensorEchoSource(ch).begin();
 }
 
-float measureDistanceCmOnce()
+float measureDistanceCmOnce(uint8_t ch)
 {
-    digitalWrite(trigPin, LOW);
-    delayMicroseconds(4);
-    digitalWrite(trigPin, HIGH);
-    delayMicroseconds(10);
-    digitalWrite(trigPin, LOW);
-    unsigned long duration = pulseInLong(echoPin, HIGH, 30000UL);
-    lastDurationUs = duration;
-    if (duration == 0)
-        return -1.0f;
-    return duration * 0.01715f;
+    triggerPing(ch);
+    return collectPing(ch);
 }
 
-float measureDistanceStable()
+uint32_t lastEchoDurationUs(uint8_t ch)
 {
-    // paramètres dynamiques
-    const uint16_t N = ConfigManager::instance().getMedianSamples();
-    const uint16_t dlyMs = ConfigManager::instance().getMedianSampleDelayMs();
-    const float minCm = ConfigManager::instance().getFilterMinCm();
-    const float maxCm = ConfigManager::instance().getFilterMaxCm();
+    return channels[ch].lastPingDurationUs;
+}
 
-    const uint16_t Ns = (N == 0 ? 1 : (N > 15 ? 15 : N));
+float measureDistanceStable(uint8_t *validCount, uint8_t ch)
+{
+    // paramètres dynamiques
+    const AppConfig &cfg = measureCfg.get();
+    const uint16_t dlyMs = cfg.median_delay_ms;
 
-    float values[15];
-    int count = 0;
+    // Rafale de N pings neufs (chemin de réveil : pas d'historique)
+    SlidingMedian batch;
+    batch.configure(cfg.median_n, cfg.filter_min_cm, cfg.filter_max_cm);
 
-    for (uint16_t i = 0; i < Ns; ++i)
+    for (uint16_t i = 0; i < batch.window(); ++i)
     {
-        float d = measureDistanceCmOnce();
-        if (d > 0 && d >= minCm && d <= maxCm)
-        {
-            values[count++] = d; // filtre bruit
-        }
+        batch.push(measureDistanceCmOnce(ch));
         if (dlyMs > 0)
-            delay(dlyMs);
+            halDelayMs(dlyMs);
     }
-    if (count == 0)
-        return -1.0f;
+    if (validCount)
+        *validCount = batch.validCount();
 
-    std::sort(values, values + count);
     // médiane robuste
-    return values[count / 2];
+    return batch.median();
 }
 
-float runningAverage(float newVal, float prevAvg, float alpha)
+float measureDistanceStreaming(uint8_t *validCount, uint8_t ch)
 {
-    if (newVal < 0)
-        return prevAvg;
-    return prevAvg * (1.0f - alpha) + newVal * alpha;
+    // Un seul ping : la médiane porte sur les median_n derniers pings
+    const AppConfig &cfg = measureCfg.get();
+    const float cm = measureDistanceCmOnce(ch);
+    SensorChannel &c = channels[ch];
+
+    StageTimer timer(MetricStage::Median);
+    c.streamMedian.configure(cfg.median_n, cfg.filter_min_cm, cfg.filter_max_cm);
+    c.streamMedian.push(cm);
+
+    if (validCount)
+        *validCount = c.streamMedian.validCount();
+    return c.streamMedian.median();
 }
 
-bool computePolynomialFrom3Points()
+float filterLevel(float measuredCm, uint8_t ch)
 {
-    double x1 = calib_m[0], x2 = calib_m[1], x3 = calib_m[2];
-    double y1 = calib_h[0], y2 = calib_h[1], y3 = calib_h[2];
-    polyValid = false;
-
-    if (x1 == 0 || x2 == 0 || x3 == 0)
-        return false;
-    if ((x1 == x2) || (x1 == x3) || (x2 == x3))
-        return false;
-    double denom = (x1 - x2) * (x1 - x3) * (x2 - x3);
-    if (denom == 0)
-        return false;
+    const AppConfig &cfg = measureCfg.get();
+    LevelKalman &levelFilter = channels[ch].levelFilter;
+    levelFilter.configure(cfg.kalman_q, cfg.kalman_r_cm);
+    if (!levelFilter.initialized() && kalmanState[ch].initialized)
+        levelFilter.restore(kalmanState[ch]);
+
+    // Horloge murale : continue de tourner pendant le deep sleep
+    const int64_t now = halWallClockMs();
+    float dt = (kalmanStampMs[ch] != 0) ? (now - kalmanStampMs[ch]) / 1000.0f : 0.0f;
+    if (dt < 0.0f || dt > 86400.0f)
+    {
+        // Horloge recalée (NTP) ou arrêt prolongé : l'ancien état ne vaut plus rien
+        levelFilter.reset();
+        dt = 0.0f;
+    }
 
-    a_coef = (x3 * (y2 - y1) + x2 * (y1 - y3) + x1 * (y3 - y2)) / denom;
-    b_coef = (x3 * x3 * (y1 - y2) + x2 * x2 * (y3 - y1) + x1 * x1 * (y2 - y3)) / denom;
-    c_coef = (x2 * x3 * (x2 - x3) * y1 + x3 * x1 * (x3 - x1) * y2 + x1 * x2 * (x1 - x2) * y3) / denom;
+    levelFilter.update(measuredCm, dt);
+    kalmanStampMs[ch] = now;
+    kalmanState[ch] = levelFilter.state();
+    return levelFilter.initialized() ? levelFilter.level() : NAN;
+}
 
-    polyValid = true;
-    return true;
+float filteredRateCmMin(uint8_t ch)
+{
+    const LevelKalman &levelFilter = channels[ch].levelFilter;
+    return levelFilter.initialized() ? levelFilter.rate() * 60.0f : 0.0f;
 }
 
-float estimateHeightFromMeasured(float x)
+uint32_t nextDeepSleepS()
 {
-    return (float)(a_coef * x * x + b_coef * x + c_coef);
+    // Même politique que la tâche capteur, à l'échelle des réveils timer :
+    // le canal qui bouge le plus fixe la période
+    const uint32_t maxS = ConfigManager::instance().snapshot()->deepsleep_interval_s;
+    uint32_t minS = maxS / 4;
+    if (minS < 10)
+        minS = (maxS < 10) ? maxS : 10;
+
+    uint32_t next = UINT32_MAX;
+    for (const SensorChannel &c : channels)
+    {
+        AdaptiveScheduler sched;
+        sched.setCurrent(sleepScheduleMs);
+        sched.configure(minS * 1000, maxS * 1000, measureCfg->adaptive_rate_cm_min / 60.0f);
+        const uint32_t ms = sched.next(c.levelFilter);
+        if (ms < next)
+            next = ms;
+    }
+    sleepScheduleMs = next;
+    return sleepScheduleMs / 1000;
 }
 
-void loadCalibrations()
+// Géométrie du canal : tank_* pour le canal 0, ch_tank[] ensuite (sans profil)
+static TankParams channelTankParams(const AppConfig &cfg, uint8_t ch, float fullLevelCm)
 {
-    preferences.begin("calib", true);
-    for (int i = 0; i < 3; i++)
+#if SENSOR_CHANNELS > 1
+    if (ch > 0)
     {
-        char kM[8], kH[8];
-        sprintf(kM, "m%d", i);
-        sprintf(kH, "h%d", i);
-        calib_m[i] = preferences.getFloat(kM, calib_m[i]);
-        calib_h[i] = preferences.getFloat(kH, calib_h[i]);
+        const ChannelTankConfig &t = cfg.ch_tank[ch - 1];
+        return TankParams{(TankShape)t.shape, t.diameter_cm, t.length_cm, t.width_cm, "", fullLevelCm};
     }
-    cuveVide = preferences.getFloat("cuveVide", cuveVide);
-    cuvePleine = preferences.getFloat("cuvePleine", cuvePleine);
-    preferences.end();
+
+#else
+    (void)ch;
+#endif
+    return TankParams{(TankShape)cfg.tank_shape, cfg.tank_diameter_cm, cfg.tank_length_cm,
+                      cfg.tank_width_cm, cfg.tank_profile, fullLevelCm};
 }
 
-void saveCalibrationToNVS(int idx, float measured, float height)
+void applyTankVolume(MeasurementRecord &rec)
 {
-    if (idx < 0 || idx > 2)
+    const AppConfig &cfg = measureCfg.get();
+    const uint8_t ch = rec.channel;
+    SensorChannel &c = channels[ch];
+    const float vide = cuveVideCh[ch].load();
+    const float pleine = cuvePleineCh[ch].load();
+    if (measureCfg.generation() != c.tankCfgGeneration || vide != c.tankBuiltVide || pleine != c.tankBuiltPleine)
+    {
+        const TankParams params = channelTankParams(cfg, ch, vide - pleine);
+        if (c.tankModel.build(params))
+        {
+            LOG_I(Sensor, "[TANK] Canal %u : %s, capacité %.1f L", (unsigned)ch, TankModel::shapeName(params.shape),
+                  c.tankModel.capacityL());
+        }
+        else
+        {
+            LOG_W(Sensor, "[TANK] Canal %u : géométrie invalide, volume indisponible", (unsigned)ch);
+        }
+        c.tankCfgGeneration = measureCfg.generation();
+        c.tankBuiltVide = vide;
+        c.tankBuiltPleine = pleine;
+    }
+
+    const TankModel &tankModel = c.tankModel;
+    rec.levelCm = rec.volumeL = rec.percent = rec.freeL = -1.0f;
+    if (rec.measuredCm <= 0.0f || !tankModel.valid())
         return;
-    preferences.begin("calib", false);
-    char kM[8], kH[8];
-    sprintf(kM, "m%d", idx);
-    sprintf(kH, "h%d", idx);
-    preferences.putFloat(kM, measured);
-    preferences.putFloat(kH, height);
+
+    float level = vide - rec.measuredCm;
+    level = constrain(level, 0.0f, tankModel.fullLevelCm());
+    const float volume = tankModel.volumeL(level);
+    const float capacity = tankModel.capacityL();
+    rec.levelCm = level;
+    rec.volumeL = volume;
+    rec.percent = 100.0f * volume / capacity;
+    rec.freeL = capacity - volume;
+}
+
+// Ajuste le modèle et précalcule la LUT sur la plage de filtrage courante
+static bool publishCalibrationLocked(SensorChannel &c)
+{
+    const ConfigPtr cfg = ConfigManager::instance().snapshot();
+    std::shared_ptr<CalibrationTable> t = std::make_shared<CalibrationTable>(c.calibWorking);
+    const bool ok = t->build(cfg->filter_min_cm, cfg->filter_max_cm);
+    c.calibCfgGeneration.store(ConfigManager::instance().generation());
+    std::atomic_store(&c.calibCurrent, CalibrationPtr(t));
+    return ok;
+}
+
+static void persistCalibrationLocked(uint8_t ch)
+{
+    rtcCacheInvalidate();
+    char ns[CALIB_NS_LEN];
+    calibNamespace(ch, ns, sizeof(ns));
+    uint8_t blob[CalibrationTable::blobSize(CALIB_MAX_POINTS)];
+    const size_t n = channels[ch].calibWorking.serialize(blob, sizeof(blob));
+    preferences.begin(ns, false);
+    preferences.putBytes("pts", blob, n);
     preferences.end();
-    calib_m[idx] = measured;
-    calib_h[idx] = height;
 }
 
-void saveCuveLevels()
+bool rebuildCalibration(uint8_t ch)
 {
-    preferences.begin("calib", false);
-    preferences.putFloat("cuveVide", cuveVide);
-    preferences.putFloat("cuvePleine", cuvePleine);
+    SensorChannel &c = channels[ch];
+    std::lock_guard<std::mutex> lk(c.calibMutex);
+    return publishCalibrationLocked(c);
+}
+
+float estimateHeightFromMeasured(float x, uint8_t ch)
+{
+    // Plage de filtrage modifiée : la LUT doit être rééchantillonnée
+    SensorChannel &c = channels[ch];
+    const uint32_t gen = ConfigManager::instance().generation();
+    if (gen != c.calibCfgGeneration.load())
+    {
+        const ConfigPtr cfg = ConfigManager::instance().snapshot();
+        const CalibrationPtr t = std::atomic_load(&c.calibCurrent);
+        if (!t || t->lutMinCm() != cfg->filter_min_cm || t->lutMaxCm() != cfg->filter_max_cm)
+            rebuildCalibration(ch);
+        else
+            c.calibCfgGeneration.store(gen);
+    }
+
+    const CalibrationPtr t = std::atomic_load(&c.calibCurrent);
+    return t ? t->evaluate(x) : NAN;
+}
+
+static void loadChannelCalibration(uint8_t ch)
+{
+    SensorChannel &c = channels[ch];
+    std::lock_guard<std::mutex> lk(c.calibMutex);
+    c.calibWorking.clear();
+
+    char ns[CALIB_NS_LEN];
+    calibNamespace(ch, ns, sizeof(ns));
+    preferences.begin(ns, true); // lecture seule : aucune écriture NVS au démarrage
+    const size_t len = preferences.getBytesLength("pts");
+    bool loaded = false;
+    bool legacy = false;
+    if (len > 0 && len <= CalibrationTable::blobSize(CALIB_MAX_POINTS))
+    {
+        uint8_t blob[CalibrationTable::blobSize(CALIB_MAX_POINTS)];
+        preferences.getBytes("pts", blob, len);
+        loaded = c.calibWorking.deserialize(blob, len);
+    }
+
+    if (!loaded)
+    {
+        // Migration de l'ancien format 3 points (m0..m2 / h0..h2) : parabole exacte conservée
+        c.calibWorking.setModel(CalibModel::Poly, 2);
+        for (int i = 0; i < 3; i++)
+        {
+            char kM[8], kH[8];
+            sprintf(kM, "m%d", i);
+            sprintf(kH, "h%d", i);
+            if (!preferences.isKey(kM) && !preferences.isKey(kH))
+                continue;
+            legacy = true;
+            const float m = preferences.getFloat(kM, 0.0f);
+            if (m > 0.0f)
+                c.calibWorking.setPoint(c.calibWorking.count(), m, preferences.getFloat(kH, 0.0f));
+        }
+    }
+
+    cuveVideCh[ch] = preferences.getFloat("cuveVide", CUVE_VIDE_DEFAULT_CM);
+    cuvePleineCh[ch] = preferences.getFloat("cuvePleine", CUVE_PLEINE_DEFAULT_CM);
     preferences.end();
+
+    if (legacy)
+    {
+        // Une seule fois : blob "pts" écrit avant de retirer les anciennes clés
+        LOG_I(Sensor, "[CALIB] Migration de %u point(s) vers le format N points", (unsigned)c.calibWorking.count());
+        persistCalibrationLocked(ch);
+        preferences.begin(ns, false);
+        for (int i = 0; i < 3; i++)
+        {
+            char k[8];
+            sprintf(k, "m%d", i);
+            preferences.remove(k);
+            sprintf(k, "h%d", i);
+            preferences.remove(k);
+        }
+        preferences.end();
+    }
+    publishCalibrationLocked(c);
+}
+
+void loadCalibrations(uint8_t firstCh)
+{
+    for (uint8_t ch = firstCh; ch < SENSOR_CHANNELS; ch++)
+        loadChannelCalibration(ch);
+}
+
+bool saveCalibrationToNVS(int idx, float measured, float height, uint8_t ch)
+{
+    SensorChannel &c = channels[ch];
+    std::lock_guard<std::mutex> lk(c.calibMutex);
+    if (idx < 0)
+        idx = (int)c.calibWorking.count();
+    if (!c.calibWorking.setPoint((size_t)idx, measured, height))
+        return false;
+    persistCalibrationLocked(ch);
+    publishCalibrationLocked(c);
+    return true;
 }
 
-void clearCalibrations()
+bool removeCalibrationPoint(int idx, uint8_t ch)
 {
-    preferences.begin("calib", false);
-    preferences.clear();
+    SensorChannel &c = channels[ch];
+    std::lock_guard<std::mutex> lk(c.calibMutex);
+    if (idx < 0 || !c.calibWorking.removePoint((size_t)idx))
+        return false;
+    persistCalibrationLocked(ch);
+    publishCalibrationLocked(c);
+    return true;
+}
+
+void setCalibrationModel(CalibModel model, uint8_t polyDegree, uint8_t ch)
+{
+    SensorChannel &c = channels[ch];
+    std::lock_guard<std::mutex> lk(c.calibMutex);
+    c.calibWorking.setModel(model, polyDegree);
+    persistCalibrationLocked(ch);
+    publishCalibrationLocked(c);
+}
+
+void saveCuveLevels(uint8_t ch)
+{
+    rtcCacheInvalidate();
+    char ns[CALIB_NS_LEN];
+    calibNamespace(ch, ns, sizeof(ns));
+    preferences.begin(ns, false);
+    preferences.putFloat("cuveVide", cuveVideCh[ch].load());
+    preferences.putFloat("cuvePleine", cuvePleineCh[ch].load());
     preferences.end();
-    for (int i = 0; i < 3; i++)
-        calib_m[i] = 0;
-    polyValid = false;
+}
+
+void restoreCalibration(const CalibrationTable &table, float vide, float pleine)
+{
+    SensorChannel &c = channels[0];
+    std::lock_guard<std::mutex> lk(c.calibMutex);
+    c.calibWorking = table;
+    cuveVide = vide;
+    cuvePleine = pleine;
+    // Table construite sur la plage de la config restaurée : pas de rééchantillonnage
+    c.calibCfgGeneration.store(ConfigManager::instance().generation());
+    std::atomic_store(&c.calibCurrent, CalibrationPtr(std::make_shared<CalibrationTable>(table)));
+}
+
+void clearCalibrations(uint8_t ch)
+{
+    SensorChannel &c = channels[ch];
+    std::lock_guard<std::mutex> lk(c.calibMutex);
+    // Seuls les points sont effacés : modèle choisi et niveaux de cuve conservés
+    c.calibWorking.clear();
+    persistCalibrationLocked(ch);
+    publishCalibrationLocked(c);
 }
@@ -1,21 +1,60 @@
 #pragma once
 #include <Arduino.h>
+#include "rtc_batch.h"
+#include "calibration.h"
+#include "level_kalman.h"
 
 /**
- * État EMA persistant entre les deep sleep.
+ * État du Kalman niveau/vitesse de chaque canal, persistant entre les deep sleep.
  * Déclaré en extern ici, défini dans measurement.cpp (RTC_DATA_ATTR).
  */
-extern float emaStateCm;
+extern KalmanState kalmanState[SENSOR_CHANNELS];
 
+// Anneau de lectures des réveils timer (RTC_DATA_ATTR, défini dans measurement.cpp)
+extern RtcBatch rtcBatch;
+
+/**
+ * Canaux de mesure (SENSOR_CHANNELS) : chacun a son capteur, sa médiane, son
+ * Kalman, sa calibration (espace NVS "calib", puis "calib1", "calib2"...), ses
+ * niveaux de cuve et sa géométrie. Les paramètres ch vont de 0 à
+ * SENSOR_CHANNELS - 1 ; le canal 0 est le défaut de l'API historique.
+ */
 void sensorTask(void *pv);
+// Un cycle de la tâche capteur : un ping par canal, déclenchements espacés
+// d'au moins SENSOR_STAGGER_US (un seul écho en vol), le traitement d'un
+// canal s'exécutant pendant le temps de vol du suivant. Retourne la période
+// avant le cycle suivant. Utilisé tel quel par la simulation native.
+uint32_t sensorStep();
 void initSensor();
-float measureDistanceStable();
-float measureDistanceCmOnce();
-float runningAverage(float newVal, float prevAvg, float alpha = 0.25f);
-float estimateHeightFromMeasured(float x);
-bool computePolynomialFrom3Points();
-bool isPolynomialValid();
-void loadCalibrations();
-void saveCalibrationToNVS(int idx, float measured, float height);
-void saveCuveLevels();
-void clearCalibrations();
+float measureDistanceStable(uint8_t *validCount = nullptr, uint8_t ch = 0);
+float measureDistanceStreaming(uint8_t *validCount = nullptr, uint8_t ch = 0);
+float measureDistanceCmOnce(uint8_t ch = 0);
+uint32_t lastEchoDurationUs(uint8_t ch = 0);
+
+// Kalman niveau/vitesse : distance filtrée (NAN tant que non amorcé).
+// measuredCm <= 0 : prédiction seule.
+float filterLevel(float measuredCm, uint8_t ch = 0);
+float filteredRateCmMin(uint8_t ch = 0); // > 0 : le niveau baisse (la distance augmente)
+// Période du prochain deep sleep : raccourcie tant qu'un niveau bouge
+uint32_t nextDeepSleepS();
+
+// Niveau, volume, remplissage et capacité libre selon la géométrie de cuve
+// du canal rec.channel
+void applyTankVolume(MeasurementRecord &rec);
+
+// Calibration à N points : hauteur via LUT précalculée (NAN si non calibré)
+float estimateHeightFromMeasured(float x, uint8_t ch = 0);
+bool isCalibrationValid(uint8_t ch = 0);
+CalibrationPtr calibrationSnapshot(uint8_t ch = 0);
+// Objet /calibs et événement SSE "calibs" : modèle et points du canal
+void writeCalibsJson(JsonWriter &w, uint8_t ch = 0);
+bool rebuildCalibration(uint8_t ch = 0);
+// Canaux firstCh.. : charge (ou migre l'ancien format 3 points) puis construit la LUT
+void loadCalibrations(uint8_t firstCh = 0);
+bool saveCalibrationToNVS(int idx, float measured, float height, uint8_t ch = 0); // idx < 0 : ajout
+bool removeCalibrationPoint(int idx, uint8_t ch = 0);
+void setCalibrationModel(CalibModel model, uint8_t polyDegree, uint8_t ch = 0);
+void saveCuveLevels(uint8_t ch = 0);
+void clearCalibrations(uint8_t ch = 0);
+// Canal 0 : adopte une table déjà ajustée (cache RTC du réveil timer), ni NVS ni ajustement
+void restoreCalibration(const CalibrationTable &table, float vide, float pleine);
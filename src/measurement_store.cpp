@@ -0,0 +1,136 @@
+#include "measurement_store.h"
+#include "seqlock.h"
+#include "hal/hal_time.h"
+
+static SeqLock<MeasurementRecord> store[SENSOR_CHANNELS];
+
+void publishMeasurement(MeasurementRecord &rec)
+{
+    SeqLock<MeasurementRecord> &s = store[rec.channel < SENSOR_CHANNELS ? rec.channel : 0];
+    rec.seq = s.version() + 1;
+    rec.timestampMs = halMillis();
+    s.write(rec);
+}
+
+uint32_t readMeasurement(MeasurementRecord &out, uint8_t ch)
+{
+    const uint32_t seq = ch < SENSOR_CHANNELS && store[ch].version() ? store[ch].read(out) : 0;
+    if (seq)
+        return seq;
+
+    // Aucune mesure publiée, ou lecteur doublé par l'écrivain : "pas de mesure"
+    out = MeasurementRecord{};
+    out.measuredCm = -1.0f;
+    out.estimatedCm = -1.0f;
+    out.levelCm = -1.0f;
+    out.volumeL = -1.0f;
+    out.percent = -1.0f;
+    out.freeL = -1.0f;
+    out.channel = ch;
+    return 0;
+}
+
+void readMeasurementSet(MeasurementSet &out)
+{
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+        readMeasurement(out.ch[ch], ch);
+}
+
+uint32_t measurementSeq(uint8_t ch)
+{
+    return ch < SENSOR_CHANNELS ? store[ch].version() : 0;
+}
+
+void writeMeasureFields(JsonWriter &w, const MeasurementRecord &rec)
+{
+    // Sans écho, /distance publie null ; la charge MQTT garde -1 (format historique)
+    w.field("measured_cm", rec.measuredCm, 2)
+        .field("estimated_cm", rec.estimatedCm, 2)
+        .field("duration_us", rec.durationUs)
+        .field("seq", rec.seq)
+        .field("rate_cm_min", rec.rateCmMin, 2)
+        .fieldOrNull("level_cm", rec.levelCm, 1)
+        .fieldOrNull("volume_l", rec.volumeL, 1)
+        .fieldOrNull("percent", rec.percent, 1)
+        .fieldOrNull("free_l", rec.freeL, 1);
+}
+
+void writeMeasureSetFields(JsonWriter &w, const MeasurementSet &set)
+{
+    writeMeasureFields(w, set.ch[0]);
+    if (SENSOR_CHANNELS < 2)
+        return;
+    w.key("channels").beginArray();
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+    {
+        w.beginObject().field("ch", ch);
+        writeMeasureFields(w, set.ch[ch]);
+        w.endObject();
+    }
+    w.endArray();
+}
+
+static void writeDistanceFields(JsonWriter &w, const MeasurementRecord &rec, float cuveVide, float cuvePleine)
+{
+    if (SENSOR_CHANNELS > 1)
+        w.field("ch", rec.channel);
+    if (rec.measuredCm < 0)
+        w.key("measured_cm").null().key("estimated_cm").null();
+    else
+        w.field("measured_cm", rec.measuredCm, 2).field("estimated_cm", rec.estimatedCm, 2);
+    w.field("duration_us", rec.durationUs)
+        .field("seq", rec.seq)
+        .field("rate_cm_min", rec.rateCmMin, 2)
+        .field("cuveVide", cuveVide, 1)
+        .field("cuvePleine", cuvePleine, 1)
+        .fieldOrNull("level_cm", rec.levelCm, 1)
+        .fieldOrNull("volume_l", rec.volumeL, 1)
+        .fieldOrNull("percent", rec.percent, 1)
+        .fieldOrNull("free_l", rec.freeL, 1);
+}
+
+void writeDistanceJson(JsonWriter &w, const MeasurementRecord &rec, float cuveVide, float cuvePleine)
+{
+    w.beginObject();
+    writeDistanceFields(w, rec, cuveVide, cuvePleine);
+    w.endObject();
+}
+
+void writeDistanceSetJson(JsonWriter &w, const MeasurementSet &set)
+{
+    w.beginObject();
+    writeDistanceFields(w, set.ch[0], cuveVideCh[0].load(), cuvePleineCh[0].load());
+    if (SENSOR_CHANNELS > 1)
+    {
+        w.key("channels").beginArray();
+        for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+            writeDistanceJson(w, set.ch[ch], cuveVideCh[ch].load(), cuvePleineCh[ch].load());
+        w.endArray();
+    }
+    w.endObject();
+}
+
+int formatMeasureJson(const MeasurementRecord &rec, char *buf, size_t len)
+{
+    JsonWriter w(buf, len);
+    w.beginObject();
+    writeMeasureFields(w, rec);
+    w.endObject();
+    return w.ok() ? (int)w.length() : -1;
+}
+
+int formatMeasureSetJson(const MeasurementSet &set, char *buf, size_t len)
+{
+    JsonWriter w(buf, len);
+    w.beginObject();
+    writeMeasureSetFields(w, set);
+    w.endObject();
+    return w.ok() ? (int)w.length() : -1;
+}
+
+int formatDistanceJson(const MeasurementRecord &rec, float cuveVide, float cuvePleine, char *buf, size_t len)
+{
+    JsonWriter w(buf, len);
+    writeDistanceJson(w, rec, cuveVide, cuvePleine);
+    return w.ok() ? (int)w.length() : -1;
+}
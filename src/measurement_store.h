@@ -0,0 +1,67 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include "config.h"
+#include "json_writer.h"
+
+/**
+ * Dernière mesure publiée par la tâche capteur.
+ * Publiée via un seqlock : les lecteurs (affichage, web, MQTT) ne bloquent
+ * jamais la tâche capteur ni n'attendent une écriture en cours, et peuvent
+ * tester seq pour ignorer une mesure déjà vue.
+ */
+struct MeasurementRecord
+{
+    float measuredCm;      // -1 si pas de mesure valide
+    float estimatedCm;     // -1 si pas d'estimation
+    uint32_t durationUs;   // durée brute du dernier écho
+    uint8_t validSamples;  // échantillons retenus par le filtre
+    uint8_t totalSamples;  // échantillons demandés
+    uint32_t seq;          // 0 = aucune mesure publiée
+    uint32_t timestampMs;  // millis() à la publication
+    float rateCmMin;       // vitesse estimée (Kalman), > 0 : le niveau baisse
+
+    // Volume (géométrie de cuve) : -1 si inconnu
+    float levelCm;         // hauteur d'eau = cuveVide - distance mesurée
+    float volumeL;
+    float percent;         // volume / capacité
+    float freeL;           // capacité restante
+
+    uint8_t channel;       // capteur (0..SENSOR_CHANNELS-1)
+};
+
+// Un cycle du planificateur : la dernière mesure de chaque canal
+struct MeasurementSet
+{
+    MeasurementRecord ch[SENSOR_CHANNELS];
+};
+
+// Champs de la mesure et du volume dans l'objet ouvert (null si inconnu).
+void writeMeasureFields(JsonWriter &w, const MeasurementRecord &rec);
+// Objet complet de /distance et de l'événement SSE "measure" (avec les niveaux de cuve).
+// Avec plusieurs canaux, l'objet porte aussi "ch".
+void writeDistanceJson(JsonWriter &w, const MeasurementRecord &rec, float cuveVide, float cuvePleine);
+// Charge MQTT d'un cycle : champs du canal 0 (format historique) puis, avec
+// plusieurs canaux, "channels":[{"ch":0,...},...] dans l'objet ouvert.
+void writeMeasureSetFields(JsonWriter &w, const MeasurementSet &set);
+// /distance : objet du canal 0, plus "channels" (objets /distance de chaque
+// canal, niveaux de cuve compris) avec plusieurs canaux.
+void writeDistanceSetJson(JsonWriter &w, const MeasurementSet &set);
+
+// Variantes tampon fixe (MQTT, SSE). Retournent la longueur, -1 si tronqué.
+int formatMeasureJson(const MeasurementRecord &rec, char *buf, size_t len);
+int formatDistanceJson(const MeasurementRecord &rec, float cuveVide, float cuvePleine, char *buf, size_t len);
+int formatMeasureSetJson(const MeasurementSet &set, char *buf, size_t len);
+
+// Publie une mesure sur son canal (rec.channel) ; écrivain unique par canal :
+// tâche capteur ou chemin de réveil. Renseigne seq et timestampMs.
+void publishMeasurement(MeasurementRecord &rec);
+
+// Copie cohérente de la dernière mesure du canal ; retourne son numéro de séquence,
+// ou 0 (et un enregistrement "pas de mesure") si aucune n'est lisible.
+uint32_t readMeasurement(MeasurementRecord &out, uint8_t ch = 0);
+// Dernière mesure de chaque canal
+void readMeasurementSet(MeasurementSet &out);
+
+// Numéro de séquence courant du canal, sans copie.
+uint32_t measurementSeq(uint8_t ch = 0);
@@ -0,0 +1,102 @@
+#include <math.h>
+#include <string.h>
+#include "median_filter.h"
+
+void SlidingMedian::configure(uint16_t window, float minCm, float maxCm)
+{
+    const uint8_t w = (uint8_t)(window == 0 ? 1 : (window > MEDIAN_MAX_SAMPLES ? MEDIAN_MAX_SAMPLES : window));
+    const bool boundsChanged = (minCm != minCm_ || maxCm != maxCm_);
+    minCm_ = minCm;
+    maxCm_ = maxCm;
+    if (w != window_)
+    {
+        window_ = w;
+        reset();
+        return;
+    }
+    if (!boundsChanged || valid_ == 0)
+        return;
+
+    // Nouvelles bornes : les valeurs de la fenêtre désormais hors plage
+    // deviennent des rejets (place gardée), comme si elles arrivaient maintenant
+    valid_ = 0;
+    for (uint8_t i = 0; i < count_; i++)
+    {
+        const float v = ring_[i];
+        if (isnan(v))
+            continue;
+        if (v >= minCm_ && v <= maxCm_)
+            insertSorted(v);
+        else
+            ring_[i] = NAN;
+    }
+}
+
+void SlidingMedian::reset()
+{
+    head_ = 0;
+    count_ = 0;
+    valid_ = 0;
+}
+
+bool SlidingMedian::push(float cm)
+{
+    const bool ok = (cm > 0 && cm >= minCm_ && cm <= maxCm_);
+
+    if (count_ == window_)
+    {
+        const float oldest = ring_[head_];
+        if (!isnan(oldest))
+            removeSorted(oldest);
+    }
+    else
+    {
+        count_++;
+    }
+
+    ring_[head_] = ok ? cm : NAN;
+    head_ = (uint8_t)((head_ + 1) % window_);
+    if (ok)
+        insertSorted(cm);
+    return ok;
+}
+
+float SlidingMedian::median() const
+{
+    if (valid_ == 0)
+        return -1.0f;
+    return sorted_[valid_ / 2];
+}
+
+void SlidingMedian::removeSorted(float v)
+{
+    // lower_bound : v est forcément présent
+    uint8_t lo = 0, hi = valid_;
+    while (lo < hi)
+    {
+        const uint8_t mid = (uint8_t)((lo + hi) / 2);
+        if (sorted_[mid] < v)
+            lo = (uint8_t)(mid + 1);
+        else
+            hi = mid;
+    }
+    memmove(&sorted_[lo], &sorted_[lo + 1], (valid_ - lo - 1) * sizeof(float));
+    valid_--;
+}
+
+void SlidingMedian::insertSorted(float v)
+{
+    // upper_bound : les égalités gardent l'ordre d'arrivée
+    uint8_t lo = 0, hi = valid_;
+    while (lo < hi)
+    {
+        const uint8_t mid = (uint8_t)((lo + hi) / 2);
+        if (sorted_[mid] <= v)
+            lo = (uint8_t)(mid + 1);
+        else
+            hi = mid;
+    }
+    memmove(&sorted_[lo + 1], &sorted_[lo], (valid_ - lo) * sizeof(float));
+    sorted_[lo] = v;
+    valid_++;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+
+#define MEDIAN_MAX_SAMPLES 15
+
+/**
+ * Médiane glissante sur les N derniers pings (N <= MEDIAN_MAX_SAMPLES).
+ * - Chaque ping entre dans la fenêtre ; les valeurs hors [minCm, maxCm]
+ *   occupent une place vide (elles font vieillir la fenêtre sans compter).
+ * - Un tableau trié des valeurs valides est maintenu par recherche
+ *   dichotomique + décalage : O(log N) comparaisons, médiane en O(1).
+ */
+class SlidingMedian
+{
+public:
+    // Change la fenêtre / les bornes ; vide la fenêtre si sa taille change,
+    // rejette les valeurs devenues hors bornes sinon.
+    void configure(uint16_t window, float minCm, float maxCm);
+    void reset();
+
+    // Ajoute un ping ; retourne true s'il passe le filtre min/max.
+    bool push(float cm);
+
+    // Médiane des valeurs valides de la fenêtre, -1 si aucune.
+    float median() const;
+
+    uint8_t validCount() const { return valid_; }
+    uint8_t window() const { return window_; }
+
+private:
+    void removeSorted(float v);
+    void insertSorted(float v);
+
+    float ring_[MEDIAN_MAX_SAMPLES];   // ordre d'arrivée (NAN = rejet)
+    float sorted_[MEDIAN_MAX_SAMPLES]; // valeurs valides triées
+    uint8_t window_ = 1;
+    uint8_t head_ = 0;  // prochaine case à écrire = plus ancienne si pleine
+    uint8_t count_ = 0; // pings dans la fenêtre
+    uint8_t valid_ = 0; // valeurs valides dans la fenêtre
+    float minCm_ = 0.0f;
+    float maxCm_ = 0.0f;
+};
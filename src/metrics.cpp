@@ -0,0 +1,203 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include "metrics.h"
+#include "json_writer.h"
+
+static StageHistogram stages[METRICS_STAGE_COUNT];
+static std::atomic<uint32_t> cyclesPerUs{240};
+static uint32_t recordCostCycles = 0;
+
+static const char *const STAGE_NAMES[METRICS_STAGE_COUNT] = {
+    "echo_wait", "median", "estimator", "display_frame",
+    "http_handler", "mqtt_connect", "mqtt_publish", "wifi_connect"};
+
+void StageHistogram::record(uint32_t us)
+{
+    buckets_[bucketFor(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    const uint32_t lo = sumLoUs_.fetch_add(us, std::memory_order_relaxed);
+    if ((uint32_t)(lo + us) < lo)
+        sumHiUs_.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t prev = maxUs_.load(std::memory_order_relaxed);
+    while (us > prev && !maxUs_.compare_exchange_weak(prev, us, std::memory_order_relaxed))
+    {
+    }
+}
+
+void StageHistogram::snapshot(StageSnapshot &out) const
+{
+    // Lecture non atomique dans son ensemble : écarts d'un échantillon
+    // possibles entre count et les seaux, sans conséquence pour un export.
+    for (size_t i = 0; i <= METRICS_BUCKETS; ++i)
+        out.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    out.count = count_.load(std::memory_order_relaxed);
+    uint32_t hi, lo;
+    do
+    {
+        hi = sumHiUs_.load(std::memory_order_relaxed);
+        lo = sumLoUs_.load(std::memory_order_relaxed);
+    } while (hi != sumHiUs_.load(std::memory_order_relaxed));
+    out.sumUs = ((uint64_t)hi << 32) | lo;
+    out.maxUs = maxUs_.load(std::memory_order_relaxed);
+}
+
+void metricsBegin(uint32_t perUs)
+{
+    if (perUs > 0)
+        cyclesPerUs.store(perUs);
+}
+
+void metricsRecordUs(MetricStage stage, uint32_t us)
+{
+    if (stage < MetricStage::Count)
+        stages[(size_t)stage].record(us);
+}
+
+void metricsRecordCycles(MetricStage stage, uint32_t cycles)
+{
+    metricsRecordUs(stage, cycles / cyclesPerUs.load(std::memory_order_relaxed));
+}
+
+void metricsSnapshot(MetricStage stage, StageSnapshot &out)
+{
+    stages[(size_t)stage].snapshot(out);
+}
+
+const char *metricsStageName(MetricStage stage)
+{
+    return (stage < MetricStage::Count) ? STAGE_NAMES[(size_t)stage] : "?";
+}
+
+uint32_t metricsBenchmark(uint32_t iterations)
+{
+    if (iterations == 0)
+        return 0;
+    // Même chemin que StageTimer : deux lectures du compteur + conversion + record
+    static StageHistogram scratch;
+    const uint32_t div = cyclesPerUs.load(std::memory_order_relaxed);
+    const uint32_t t0 = halCycles();
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        const uint32_t c0 = halCycles();
+        scratch.record((halCycles() - c0 + i) / div);
+    }
+    recordCostCycles = (halCycles() - t0) / iterations;
+    return recordCostCycles;
+}
+
+uint32_t metricsRecordCostCycles()
+{
+    return recordCostCycles;
+}
+
+// ---------- Exposition ----------
+
+namespace
+{
+    struct Out
+    {
+        MetricsWriteFn write;
+        void *ctx;
+
+        void printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+        {
+            char line[160];
+            va_list ap;
+            va_start(ap, fmt);
+            int n = vsnprintf(line, sizeof(line), fmt, ap);
+            va_end(ap);
+            if (n <= 0)
+                return;
+            if ((size_t)n >= sizeof(line))
+                n = sizeof(line) - 1;
+            write(ctx, line, (size_t)n);
+        }
+    };
+}
+
+void metricsWritePrometheus(const SystemStats &sys, MetricsWriteFn write, void *ctx)
+{
+    Out o{write, ctx};
+
+    o.printf("# HELP wlm_stage_duration_seconds Durée des étapes instrumentées.\n");
+    o.printf("# TYPE wlm_stage_duration_seconds histogram\n");
+    StageSnapshot s;
+    for (size_t st = 0; st < METRICS_STAGE_COUNT; ++st)
+    {
+        metricsSnapshot((MetricStage)st, s);
+        const char *name = STAGE_NAMES[st];
+        uint32_t cumul = 0;
+        for (size_t i = 0; i < METRICS_BUCKETS; ++i)
+        {
+            cumul += s.buckets[i];
+            o.printf("wlm_stage_duration_seconds_bucket{stage=\"%s\",le=\"%.6f\"} %lu\n",
+                     name, (double)(1UL << i) * 1e-6, (unsigned long)cumul);
+        }
+        cumul += s.buckets[METRICS_BUCKETS];
+        o.printf("wlm_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %lu\n", name, (unsigned long)cumul);
+        o.printf("wlm_stage_duration_seconds_sum{stage=\"%s\"} %.6f\n", name, (double)s.sumUs * 1e-6);
+        o.printf("wlm_stage_duration_seconds_count{stage=\"%s\"} %lu\n", name, (unsigned long)s.count);
+    }
+
+    o.printf("# TYPE wlm_stage_duration_max_seconds gauge\n");
+    for (size_t st = 0; st < METRICS_STAGE_COUNT; ++st)
+    {
+        metricsSnapshot((MetricStage)st, s);
+        o.printf("wlm_stage_duration_max_seconds{stage=\"%s\"} %.6f\n", STAGE_NAMES[st], (double)s.maxUs * 1e-6);
+    }
+
+    o.printf("# TYPE wlm_metrics_record_cycles gauge\n");
+    o.printf("wlm_metrics_record_cycles %lu\n", (unsigned long)recordCostCycles);
+    o.printf("# TYPE wlm_uptime_seconds counter\n");
+    o.printf("wlm_uptime_seconds %lu\n", (unsigned long)sys.uptimeS);
+
+    o.printf("# TYPE wlm_heap_bytes gauge\n");
+    o.printf("wlm_heap_bytes{kind=\"size\"} %lu\n", (unsigned long)sys.heapSize);
+    o.printf("wlm_heap_bytes{kind=\"free\"} %lu\n", (unsigned long)sys.heapFree);
+    o.printf("wlm_heap_bytes{kind=\"min_free\"} %lu\n", (unsigned long)sys.heapMinFree);
+    o.printf("wlm_heap_bytes{kind=\"max_alloc\"} %lu\n", (unsigned long)sys.heapMaxAlloc);
+    o.printf("# TYPE wlm_psram_bytes gauge\n");
+    o.printf("wlm_psram_bytes{kind=\"size\"} %lu\n", (unsigned long)sys.psramSize);
+    o.printf("wlm_psram_bytes{kind=\"free\"} %lu\n", (unsigned long)sys.psramFree);
+    o.printf("wlm_psram_bytes{kind=\"min_free\"} %lu\n", (unsigned long)sys.psramMinFree);
+
+    o.printf("# TYPE wlm_task_stack_free_min_bytes gauge\n");
+    for (uint8_t i = 0; i < sys.taskCount && i < METRICS_MAX_TASKS; ++i)
+        o.printf("wlm_task_stack_free_min_bytes{task=\"%s\"} %lu\n", sys.tasks[i].name,
+                 (unsigned long)sys.tasks[i].freeStackMin);
+
+    o.printf("# TYPE wlm_display_frames_total counter\n");
+    o.printf("wlm_display_frames_total{kind=\"all\"} %lu\n", (unsigned long)sys.displayFrames);
+    o.printf("wlm_display_frames_total{kind=\"idle\"} %lu\n", (unsigned long)sys.displayIdleFrames);
+    o.printf("# TYPE wlm_display_pushed_bytes_total counter\n");
+    o.printf("wlm_display_pushed_bytes_total %llu\n", (unsigned long long)sys.displayBytesPushed);
+}
+
+int metricsFormatJson(const SystemStats &sys, char *buf, size_t len)
+{
+    JsonWriter w(buf, len);
+    w.beginObject()
+        .field("uptime_s", sys.uptimeS)
+        .field("heap_free", sys.heapFree)
+        .field("heap_min", sys.heapMinFree)
+        .field("psram_free", sys.psramFree);
+
+    w.key("stages").beginObject();
+    StageSnapshot s;
+    for (size_t st = 0; st < METRICS_STAGE_COUNT; ++st)
+    {
+        metricsSnapshot((MetricStage)st, s);
+        // [nombre, moyenne µs, max µs]
+        const uint32_t mean = s.count ? (uint32_t)(s.sumUs / s.count) : 0;
+        w.key(STAGE_NAMES[st]).beginArray().value(s.count).value(mean).value(s.maxUs).endArray();
+    }
+    w.endObject();
+
+    w.key("stack_free").beginObject();
+    for (uint8_t i = 0; i < sys.taskCount && i < METRICS_MAX_TASKS; ++i)
+        w.field(sys.tasks[i].name, sys.tasks[i].freeStackMin);
+    w.endObject().endObject();
+    return w.ok() ? (int)w.length() : -1;
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "hal/hal_time.h"
+
+/**
+ * Instrumentation permanente des chemins chauds.
+ * - Un histogramme par étape, alimenté par le compteur de cycles CPU
+ *   (halCycles) : seaux en puissances de 2 de 1 µs à 2^23 µs (~8,4 s) + "+Inf".
+ * - record() = quelques incréments atomiques relâchés, sans verrou ni
+ *   allocation ; coût mesuré au démarrage par metricsBenchmark() et exporté
+ *   (wlm_metrics_record_cycles).
+ * - Compteur de cycles propre à chaque cœur : une étape doit commencer et se
+ *   terminer dans une tâche épinglée. Cœur 1 : sensorTask, displayTask,
+ *   loopTask (setup, Wi-Fi, envoi du mode veille) et async_tcp (handlers HTTP
+ *   et /send_mqtt, CONFIG_ASYNC_TCP_RUNNING_CORE dans platformio.ini) ;
+ *   cœur 0 : mqttTask.
+ */
+
+enum class MetricStage : uint8_t
+{
+    EchoWait = 0,  // trig + attente de l'écho
+    Median,        // médiane glissante
+    Estimator,     // Kalman + calibration + volume
+    DisplayFrame,  // rendu d'une image
+    HttpHandler,   // handler HTTP (API)
+    MqttConnect,
+    MqttPublish,
+    WifiConnect,
+    Count
+};
+
+#define METRICS_STAGE_COUNT ((size_t)MetricStage::Count)
+#define METRICS_BUCKETS 24 // bornes 2^0 .. 2^23 µs, + seau +Inf
+
+struct StageSnapshot
+{
+    uint32_t count;
+    uint64_t sumUs;
+    uint32_t maxUs;
+    uint32_t buckets[METRICS_BUCKETS + 1]; // non cumulés, dernier = +Inf
+};
+
+class StageHistogram
+{
+public:
+    void record(uint32_t us);
+    void snapshot(StageSnapshot &out) const;
+
+    // Indice du premier seau dont la borne (2^i µs) contient us
+    static uint8_t bucketFor(uint32_t us)
+    {
+        if (us <= 1)
+            return 0;
+        const uint8_t b = (uint8_t)(32 - __builtin_clz(us - 1));
+        return b > METRICS_BUCKETS ? METRICS_BUCKETS : b;
+    }
+
+private:
+    std::atomic<uint32_t> buckets_[METRICS_BUCKETS + 1] = {};
+    std::atomic<uint32_t> count_{0};
+    std::atomic<uint32_t> sumLoUs_{0}; // somme 64 bits en deux mots 32 bits
+    std::atomic<uint32_t> sumHiUs_{0}; // (atomiques 64 bits émulés sur Xtensa)
+    std::atomic<uint32_t> maxUs_{0};
+};
+
+// Cycles par µs (halCyclesPerUs()) ; à appeler une fois au démarrage.
+void metricsBegin(uint32_t cyclesPerUs);
+void metricsRecordUs(MetricStage stage, uint32_t us);
+void metricsRecordCycles(MetricStage stage, uint32_t cycles);
+void metricsSnapshot(MetricStage stage, StageSnapshot &out);
+const char *metricsStageName(MetricStage stage);
+
+// Microbenchmark : coût moyen (cycles) d'un record() sur un histogramme jetable
+uint32_t metricsBenchmark(uint32_t iterations);
+uint32_t metricsRecordCostCycles(); // dernier résultat de metricsBenchmark
+
+// Chronomètre de portée : enregistre la durée de la portée dans l'étape
+class StageTimer
+{
+public:
+    explicit StageTimer(MetricStage stage) : stage_(stage), t0_(halCycles()) {}
+    ~StageTimer() { metricsRecordCycles(stage_, halCycles() - t0_); }
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+    const MetricStage stage_;
+    const uint32_t t0_;
+};
+
+// ---------- État système (rempli par la plateforme, cf. utils.cpp) ----------
+#define METRICS_MAX_TASKS 4
+
+struct TaskStackStat
+{
+    const char *name;
+    uint32_t freeStackMin; // plus petit espace de pile libre observé (octets)
+};
+
+struct SystemStats
+{
+    uint32_t uptimeS;
+    uint32_t heapSize, heapFree, heapMinFree, heapMaxAlloc;
+    uint32_t psramSize, psramFree, psramMinFree;
+    TaskStackStat tasks[METRICS_MAX_TASKS];
+    uint8_t taskCount;
+    // Rendu de l'affichage (DisplayStats)
+    uint32_t displayFrames, displayIdleFrames;
+    uint64_t displayBytesPushed;
+};
+
+// Sortie texte par morceaux (réponse HTTP en flux, tampon, stdout...)
+typedef void (*MetricsWriteFn)(void *ctx, const char *data, size_t len);
+
+// Format d'exposition Prometheus (text/plain; version=0.0.4)
+void metricsWritePrometheus(const SystemStats &sys, MetricsWriteFn write, void *ctx);
+// Message de diagnostic compact (MQTT) : [nombre, moyenne µs, max µs] par étape,
+// mémoire et piles. Retourne la longueur, -1 si le tampon est trop petit.
+int metricsFormatJson(const SystemStats &sys, char *buf, size_t len);
@@ -1,9 +1,14 @@
 #include <WiFi.h>
 #include <PubSubClient.h>
 #include "mqtt.h"
+#include "mqtt_session.h"
 #include "measurement.h"
+#include "measurement_store.h"
 #include "config.h"
 #include "config_manager.h"
+#include "metrics.h"
+#include "utils.h"
+#include "logger.h"
 #include <atomic>
 
 // ---------- MQTT client ----------
@@ -11,29 +16,83 @@ WiFiClient wifiClient;
 PubSubClient mqttClient(wifiClient);
 std::atomic<bool> mqttBusy{false};
 
+// ---------- Session persistante (mode interactif) ----------
+static TaskHandle_t mqttTaskHandle = nullptr;
+static QueueHandle_t mqttQueue = nullptr;
+static const UBaseType_t MQTT_QUEUE_LEN = 8;
+static const size_t MQTT_DIAG_PAYLOAD_LEN = 640;
+
+static bool mqttConnect(const AppConfig &cfg)
+{
+  StageTimer timer(MetricStage::MqttConnect);
+  mqttClient.setServer(cfg.mqtt_host, cfg.mqtt_port);
+
+  char clientId[DEVICE_NAME_LEN + 16];
+  if (strlen(cfg.device_name) > 0)
+    strlcpy(clientId, cfg.device_name, sizeof(clientId));
+  else
+    snprintf(clientId, sizeof(clientId), "M5CoreS3-%lX", (unsigned long)(uint32_t)ESP.getEfuseMac());
+
+  LOG_I(Mqtt, "Connecting to %s:%d as %s",
+              cfg.mqtt_host, cfg.mqtt_port, clientId);
+
+  bool connected = false;
+  if (strlen(cfg.mqtt_user) == 0)
+    connected = mqttClient.connect(clientId);
+  else
+    connected = mqttClient.connect(clientId, cfg.mqtt_user, cfg.mqtt_pass);
+
+  if (!connected)
+    LOG_W(Mqtt, "Connection failed, state=%d", mqttClient.state());
+  return connected;
+}
+
 void setupMQTT()
 {
-  const auto cfg = ConfigManager::instance().getConfig();
+  const ConfigPtr cfgPtr = ConfigManager::instance().snapshot();
+  const AppConfig &cfg = *cfgPtr;
   mqttClient.setServer(cfg.mqtt_host, cfg.mqtt_port);
 }
 
 bool publishMQTT_measure()
 {
+  MeasurementSet set;
+  readMeasurementSet(set);
+
+  // Mode interactif : la session persistante publie, on ne bloque pas l'appelant
+  if (mqttTaskHandle)
+    return mqttEnqueueMeasure(set);
+
+  char payload[MQTT_MEASURE_PAYLOAD_LEN];
+  formatMeasureSetJson(set, payload, sizeof(payload));
+  return publishMQTT_payload(payload);
+}
+
+bool publishMQTT_payload(const char *payload)
+{
+  // Connexion courte réservée au chemin de réveil : le client appartient à la tâche MQTT sinon
+  if (mqttTaskHandle)
+  {
+    LOG_D(Mqtt, "Session task active - short publish refused");
+    return false;
+  }
+
   // Vérifie et réserve le flag atomiquement
   bool expected = false;
   if (!mqttBusy.compare_exchange_strong(expected, true))
   {
-    DEBUG_PRINT("[MQTT] Busy - skipping publish");
+    LOG_D(Mqtt, "Busy - skipping publish");
     return false;
   }
 
   bool ok = false;
-  const auto cfg = ConfigManager::instance().getConfig();
+  const ConfigPtr cfgPtr = ConfigManager::instance().snapshot();
+  const AppConfig &cfg = *cfgPtr;
 
   // --- Vérifie si MQTT est activé ---
   if (!cfg.mqtt_enabled)
   {
-    DEBUG_PRINT("[MQTT] MQTT disabled -> skip publish");
+    LOG_D(Mqtt, "MQTT disabled -> skip publish");
     mqttBusy.store(false);
     return true;
   }
@@ -41,58 +100,138 @@ bool publishMQTT_measure()
   // --- Vérifie le Wi-Fi ---
   if (WiFi.status() != WL_CONNECTED)
   {
-    DEBUG_PRINT("[MQTT] WiFi not connected!");
+    LOG_W(Mqtt, "WiFi not connected!");
     mqttBusy.store(false);
     return false;
   }
 
-  mqttClient.setServer(cfg.mqtt_host, cfg.mqtt_port);
-
   // --- Connexion MQTT ---
-  String clientId = String(cfg.device_name);
-  if (clientId.isEmpty())
-    clientId = String("M5CoreS3-") + String((uint32_t)ESP.getEfuseMac(), HEX);
-
-  DEBUG_PRINTF("[MQTT] Connecting to %s:%d as %s\n",
-               cfg.mqtt_host, cfg.mqtt_port, clientId.c_str());
-
-  bool connected = false;
-  if (strlen(cfg.mqtt_user) == 0)
-    connected = mqttClient.connect(clientId.c_str());
-  else
-    connected = mqttClient.connect(clientId.c_str(), cfg.mqtt_user, cfg.mqtt_pass);
-
-  if (!connected)
+  if (!mqttConnect(cfg))
   {
-    DEBUG_PRINTF("[MQTT] Connection failed, state=%d\n", mqttClient.state());
     mqttBusy.store(false);
     return false;
   }
 
-  // --- Données à publier ---
-  float m, h;
-  unsigned long dur;
-  {
-    std::lock_guard<std::mutex> lock(distMutex);
-    m = lastMeasuredCm;
-    h = lastEstimatedHeight;
-    dur = lastDurationUs;
-  }
+  // Le buffer PubSubClient (256 o par défaut) doit contenir en-tête + payload
+  const size_t needed = strlen(payload) + strlen(cfg.mqtt_topic) + 16;
+  if (needed > mqttClient.getBufferSize())
+    mqttClient.setBufferSize((uint16_t)needed);
 
-  char payload[256];
-  snprintf(payload, sizeof(payload),
-           "{\"measured_cm\":%.2f,\"estimated_cm\":%.2f,\"duration_us\":%lu}",
-           m, h, dur);
+  LOG_D(Mqtt, "Publishing to topic %s: %s", cfg.mqtt_topic, payload);
 
-  DEBUG_PRINTF("[MQTT] Publishing to topic %s: %s\n", cfg.mqtt_topic, payload);
-
-  ok = mqttClient.publish(cfg.mqtt_topic, payload);
+  {
+    StageTimer timer(MetricStage::MqttPublish);
+    ok = mqttClient.publish(cfg.mqtt_topic, payload);
+  }
   mqttClient.loop();
   delay(50);
   mqttClient.disconnect();
 
   mqttBusy.store(false);
 
-  DEBUG_PRINT(ok ? "[MQTT] Publish success!" : "[MQTT] Publish failed!");
+  if (ok)
+    LOG_D(Mqtt, "Publish success!");
+  else
+    LOG_W(Mqtt, "Publish failed!");
   return ok;
-}
\ No newline at end of file
+}
+
+bool mqttEnqueueMeasure(const MeasurementSet &set)
+{
+  if (!mqttQueue)
+    return false;
+  // Non bloquant : si la file est pleine (broker injoignable), la mesure est ignorée
+  return xQueueSend(mqttQueue, &set, 0) == pdTRUE;
+}
+
+static void publishDiagnostics(const AppConfig &cfg)
+{
+  SystemStats sys;
+  collectSystemStats(sys);
+  static char payload[MQTT_DIAG_PAYLOAD_LEN]; // tâche MQTT uniquement
+  if (metricsFormatJson(sys, payload, sizeof(payload)) < 0)
+    return;
+
+  char topic[MQTT_TOPIC_LEN + 8];
+  snprintf(topic, sizeof(topic), "%s/diag", cfg.mqtt_topic);
+  const size_t needed = strlen(payload) + strlen(topic) + 16;
+  if (needed > mqttClient.getBufferSize())
+    mqttClient.setBufferSize((uint16_t)needed);
+
+  StageTimer timer(MetricStage::MqttPublish);
+  if (!mqttClient.publish(topic, payload))
+    LOG_W(Mqtt, "Diagnostics publish failed!");
+}
+
+// Session persistante sur PubSubClient et la file FreeRTOS (tâche MQTT uniquement)
+class TaskSessionIo : public MqttSessionIo
+{
+public:
+  explicit TaskSessionIo(ConfigView &cfg) : cfg_(cfg) {}
+
+  bool connected() override { return mqttClient.connected(); }
+  bool connect() override { return mqttConnect(cfg_.get()); }
+  bool receive(MeasurementSet &set, uint32_t waitMs) override
+  {
+    return xQueueReceive(mqttQueue, &set, pdMS_TO_TICKS(waitMs)) == pdTRUE;
+  }
+  bool publish(const char *payload) override
+  {
+    const size_t needed = strlen(payload) + strlen(cfg_->mqtt_topic) + 16;
+    if (needed > mqttClient.getBufferSize())
+      mqttClient.setBufferSize((uint16_t)needed);
+    return mqttClient.publish(cfg_->mqtt_topic, payload);
+  }
+  void loop() override { mqttClient.loop(); }
+
+private:
+  ConfigView &cfg_;
+};
+
+static void mqttTask(void *pv)
+{
+  ConfigView cfg;
+  TaskSessionIo io(cfg);
+  MqttSession session;
+  uint32_t lastDiagMs = millis();
+
+  for (;;)
+  {
+    // Changement de config : on repart sur une session neuve
+    if (cfg.refresh() && mqttClient.connected())
+      mqttClient.disconnect();
+
+    if (!cfg->mqtt_enabled || WiFi.status() != WL_CONNECTED)
+    {
+      if (mqttClient.connected())
+        mqttClient.disconnect();
+      xQueueReset(mqttQueue);
+      vTaskDelay(pdMS_TO_TICKS(500));
+      continue;
+    }
+
+    // Reconnexion avec backoff, une mesure de la file, keep-alive (mqtt_session.cpp)
+    const uint32_t waitMs = session.step(io, millis());
+    if (waitMs > 0)
+    {
+      vTaskDelay(pdMS_TO_TICKS(waitMs));
+      continue;
+    }
+
+    // Diagnostics périodiques optionnels sur <topic>/diag
+    if (cfg->mqtt_diag_s > 0 && (uint32_t)(millis() - lastDiagMs) >= cfg->mqtt_diag_s * 1000UL)
+    {
+      lastDiagMs = millis();
+      publishDiagnostics(cfg.get());
+    }
+  }
+}
+
+void startMQTTTask()
+{
+  if (mqttTaskHandle)
+    return;
+  mqttQueue = xQueueCreate(MQTT_QUEUE_LEN, sizeof(MeasurementSet));
+  xTaskCreatePinnedToCore(mqttTask, "mqttTask", 4096, NULL, 1, &mqttTaskHandle, 0);
+  registerMonitoredTask("mqttTask", mqttTaskHandle);
+}
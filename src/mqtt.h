@@ -1,5 +1,18 @@
 #pragma once
 #include <Arduino.h>
+#include "measurement_store.h"
 
 void setupMQTT();
-bool publishMQTT_measure();
\ No newline at end of file
+bool publishMQTT_measure();
+// Publie un payload JSON déjà construit sur le topic configuré (connexion courte)
+bool publishMQTT_payload(const char *payload);
+
+// Charge d'un cycle de mesure : champs du canal 0, "channels" avec plusieurs canaux
+#define MQTT_MEASURE_PAYLOAD_LEN (256 + (SENSOR_CHANNELS > 1 ? 256 * SENSOR_CHANNELS : 0))
+
+// Mode interactif : tâche MQTT à session persistante (keep-alive, reconnexion
+// avec backoff exponentiel) alimentée par une file de cycles de mesure.
+void startMQTTTask();
+// Un message pour tous les canaux. Non bloquant ; false si la tâche
+// n'existe pas ou si la file est pleine.
+bool mqttEnqueueMeasure(const MeasurementSet &set);
\ No newline at end of file
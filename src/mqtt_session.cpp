@@ -0,0 +1,38 @@
+#include "mqtt_session.h"
+#include "logger.h"
+#include "metrics.h"
+
+uint32_t MqttSession::step(MqttSessionIo &io, uint32_t nowMs)
+{
+    if (!io.connected())
+    {
+        const bool due = (int32_t)(nowMs - nextAttemptMs_) >= 0;
+        if (due && io.connect())
+        {
+            backoffMs_ = MQTT_BACKOFF_MIN_MS;
+        }
+        else
+        {
+            if (due)
+            {
+                // Backoff exponentiel, les mesures restent en file (les plus récentes sont perdues si pleine)
+                nextAttemptMs_ = nowMs + backoffMs_;
+                backoffMs_ = (backoffMs_ * 2 > MQTT_BACKOFF_MAX_MS) ? MQTT_BACKOFF_MAX_MS : backoffMs_ * 2;
+            }
+            const uint32_t left = nextAttemptMs_ - nowMs;
+            return left < MQTT_RETRY_POLL_MS ? left : MQTT_RETRY_POLL_MS;
+        }
+    }
+    // Session établie : une coupure ultérieure est retentée sans attendre
+    nextAttemptMs_ = nowMs;
+
+    if (io.receive(set_, MQTT_QUEUE_WAIT_MS))
+    {
+        formatMeasureSetJson(set_, payload_, sizeof(payload_));
+        StageTimer timer(MetricStage::MqttPublish);
+        if (!io.publish(payload_))
+            LOG_W(Mqtt, "Publish failed!");
+    }
+    io.loop();
+    return 0;
+}
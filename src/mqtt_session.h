@@ -0,0 +1,51 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "measurement_store.h"
+#include "mqtt.h"
+
+static const uint32_t MQTT_BACKOFF_MIN_MS = 1000;
+static const uint32_t MQTT_BACKOFF_MAX_MS = 60000;
+static const uint32_t MQTT_QUEUE_WAIT_MS = 100; // attente d'une mesure en file
+static const uint32_t MQTT_RETRY_POLL_MS = 100; // réveil pendant le backoff (config, Wi-Fi)
+
+/**
+ * Client MQTT et file de mesures vus par la session : PubSubClient et file
+ * FreeRTOS sur cible (mqtt.cpp), socket vers NativeBroker sur l'hôte.
+ */
+class MqttSessionIo
+{
+public:
+    virtual ~MqttSessionIo() = default;
+    virtual bool connected() = 0;
+    virtual bool connect() = 0;
+    // Prochaine mesure de la file, attendue au plus waitMs ; false si vide
+    virtual bool receive(MeasurementSet &set, uint32_t waitMs) = 0;
+    virtual bool publish(const char *payload) = 0;
+    virtual void loop() = 0; // keep-alive et détection de coupure
+};
+
+/**
+ * Un passage de la boucle de la tâche MQTT, indépendant du matériel :
+ * - déconnecté : nouvelle tentative à l'échéance du backoff exponentiel
+ *   (MQTT_BACKOFF_MIN_MS doublé à chaque échec jusqu'à MQTT_BACKOFF_MAX_MS,
+ *   remis au minimum après une connexion réussie) ; les mesures restent en
+ *   file (les plus récentes sont perdues si elle est pleine) ;
+ * - connecté : publie au plus une mesure de la file, puis keep-alive.
+ */
+class MqttSession
+{
+public:
+    // Retourne l'attente avant le passage suivant (ms) : 0 si la session est
+    // établie, <= MQTT_RETRY_POLL_MS sinon.
+    uint32_t step(MqttSessionIo &io, uint32_t nowMs);
+
+    uint32_t backoffMs() const { return backoffMs_; }
+    uint32_t nextAttemptMs() const { return nextAttemptMs_; }
+
+private:
+    uint32_t backoffMs_ = MQTT_BACKOFF_MIN_MS;
+    uint32_t nextAttemptMs_ = 0;
+    MeasurementSet set_;
+    char payload_[MQTT_MEASURE_PAYLOAD_LEN];
+};
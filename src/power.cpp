@@ -2,6 +2,14 @@
 #include <WiFi.h>
 #include "power.h"
 #include "config_manager.h"
+#include "history_store.h"
+#include "config.h"
+#include "logger.h"
+#include <esp_timer.h>
+#include <time.h>
+
+WakeProfiler wakeProfiler;
+RTC_DATA_ATTR WakeProfileRing wakeRing;
 
 static inline bool modeIsAp(wifi_mode_t mode)
 {
@@ -19,20 +27,37 @@ bool isApModeActive()
     return modeIsAp(mode);
 }
 
-void goDeepSleep()
+void goDeepSleep(uint32_t seconds)
 {
     // Filet de sécurité : jamais de deep sleep si AP actif
     if (isApModeActive())
     {
-        Serial.println("[POWER] AP actif : deep sleep desactive.");
+        LOG_I(Power, "AP actif : deep sleep desactive.");
         return;
     }
 
+    // Écrit la configuration encore en attente (écriture différée), puis
+    // vide les tampons de l'historique (no-op hors mode interactif)
+    ConfigManager::instance().save();
+    historyStore.flush();
+
     M5.Display.sleep();
     M5.Display.setBrightness(0);
 
-    const uint64_t us = (uint64_t)ConfigManager::instance().getConfig().deepsleep_interval_s * 1000000ULL;
+    if (seconds == 0)
+        seconds = ConfigManager::instance().snapshot()->deepsleep_interval_s;
+    const uint64_t us = (uint64_t)seconds * 1000000ULL;
     esp_sleep_enable_timer_wakeup(us);
     delay(20);
+
+    if (wakeProfiler.active())
+    {
+        wakeProfiler.finish(wakeRing, (uint64_t)esp_timer_get_time(), (uint32_t)time(nullptr));
+        const WakeCycle &c = wakeRing.cycles[(wakeRing.head + WAKE_PROFILE_DEPTH - 1) % WAKE_PROFILE_DEPTH];
+        LOG_I(Power, "Éveillé %u ms (mesure %u, Wi-Fi %u, MQTT %u)", c.awakeMs,
+                     c.phaseMs[(size_t)WakePhase::Measure], c.phaseMs[(size_t)WakePhase::Wifi],
+                     c.phaseMs[(size_t)WakePhase::Mqtt]);
+    }
+    logFlush(); // lignes encore dans l'anneau (perdues au réveil sinon)
     esp_deep_sleep_start();
 }
@@ -1,7 +1,14 @@
 #pragma once
+#include <stdint.h>
+#include "wake_profile.h"
+
+// Profil du réveil en cours et anneau des derniers réveils (RTC_DATA_ATTR)
+extern WakeProfiler wakeProfiler;
+extern WakeProfileRing wakeRing;
 
 // Renvoie true si le point d'accès (AP) est actif (AP ou AP+STA)
 bool isApModeActive();
 
-// Tente d'entrer en deep sleep (refusé si AP actif)
-void goDeepSleep();
+// Tente d'entrer en deep sleep (refusé si AP actif). Clôture le profil de réveil.
+// seconds = 0 : période deepsleep_interval_s de la config.
+void goDeepSleep(uint32_t seconds = 0);
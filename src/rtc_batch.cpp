@@ -0,0 +1,107 @@
+#include <math.h>
+#include "rtc_batch.h"
+
+// "BAT1" avec un canal, "BAT2"... : un lot d'un build à autre nombre de canaux est écarté
+static const uint32_t RTC_BATCH_MAGIC = 0x42415430 + SENSOR_CHANNELS;
+
+static int16_t toMm(float cm)
+{
+    if (!isfinite(cm) || cm < 0 || cm * 10.0f > 32767.0f)
+        return RTC_BATCH_NO_VALUE;
+    return (int16_t)lroundf(cm * 10.0f);
+}
+
+void batchEnsureValid(RtcBatch &b)
+{
+    // Tant que l'anneau n'a pas bouclé, la tête suit le compte
+    if (b.magic == RTC_BATCH_MAGIC && b.head < RTC_BATCH_CAPACITY && b.count <= RTC_BATCH_CAPACITY &&
+        (b.count == RTC_BATCH_CAPACITY || b.head == b.count))
+        return;
+    b.magic = RTC_BATCH_MAGIC;
+    b.head = 0;
+    b.count = 0;
+    b.wakesSinceUpload = 0;
+    for (size_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+        b.lastUploadedMm[ch] = RTC_BATCH_NO_VALUE;
+}
+
+void batchPush(RtcBatch &b, uint32_t tS, const MeasurementSet &set)
+{
+    BatchReading &r = b.items[b.head];
+    r.tS = tS;
+    for (size_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+    {
+        r.measuredMm[ch] = toMm(set.ch[ch].measuredCm);
+        r.estimatedMm[ch] = toMm(set.ch[ch].estimatedCm);
+    }
+
+    b.head = (uint16_t)((b.head + 1) % RTC_BATCH_CAPACITY);
+    if (b.count < RTC_BATCH_CAPACITY)
+        b.count++; // sinon la plus ancienne est écrasée
+    b.wakesSinceUpload++;
+}
+
+bool batchShouldFlush(const RtcBatch &b, uint16_t everyN, float thresholdCm, const MeasurementSet &current)
+{
+    if (b.count == 0)
+        return false;
+    if (b.count >= RTC_BATCH_CAPACITY)
+        return true;
+    if (everyN <= 1 || b.wakesSinceUpload >= everyN)
+        return true;
+
+    if (thresholdCm <= 0)
+        return false;
+    for (size_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+    {
+        const int16_t cur = toMm(current.ch[ch].measuredCm);
+        if (cur == RTC_BATCH_NO_VALUE || b.lastUploadedMm[ch] == RTC_BATCH_NO_VALUE)
+            continue;
+        const int delta = cur - b.lastUploadedMm[ch];
+        if ((float)(delta < 0 ? -delta : delta) >= thresholdCm * 10.0f)
+            return true;
+    }
+    return false;
+}
+
+void batchMarkUploaded(RtcBatch &b, const MeasurementSet &current)
+{
+    b.head = 0;
+    b.count = 0;
+    b.wakesSinceUpload = 0;
+    for (size_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+    {
+        const int16_t cur = toMm(current.ch[ch].measuredCm);
+        if (cur != RTC_BATCH_NO_VALUE)
+            b.lastUploadedMm[ch] = cur;
+    }
+}
+
+static void writeMm(JsonWriter &w, int16_t mm)
+{
+    if (mm == RTC_BATCH_NO_VALUE)
+        w.null();
+    else
+        w.value(mm / 10.0f, 1);
+}
+
+void batchWriteJson(JsonWriter &w, const RtcBatch &b, const MeasurementSet &latest, uint32_t nowS)
+{
+    writeMeasureSetFields(w, latest);
+
+    w.key("readings").beginArray();
+    const uint16_t start = (uint16_t)((b.head + RTC_BATCH_CAPACITY - b.count) % RTC_BATCH_CAPACITY);
+    for (uint16_t i = 0; i < b.count; ++i)
+    {
+        const BatchReading &r = b.items[(start + i) % RTC_BATCH_CAPACITY];
+        const uint32_t age = (nowS >= r.tS) ? nowS - r.tS : 0;
+        w.beginArray().value(age);
+        for (size_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+        {
+            writeMm(w, r.measuredMm[ch]);
+            writeMm(w, r.estimatedMm[ch]);
+        }
+        w.endArray();
+    }
+    w.endArray();
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "measurement_store.h"
+
+#define RTC_BATCH_CAPACITY 48
+#define RTC_BATCH_NO_VALUE INT16_MIN
+// Charge MQTT du réveil (lot plein + profil) : ~1 Ko pour un canal, ~0,8 Ko par canal en plus
+#define RTC_BATCH_PAYLOAD_LEN (2048 + 1024 * (SENSOR_CHANNELS - 1))
+
+// Lecture compacte (4 + 4 octets par canal) conservée en RTC RAM entre deux deep sleep
+struct BatchReading
+{
+    uint32_t tS;                          // time(nullptr) à la mesure (horloge RTC, survit au deep sleep)
+    int16_t measuredMm[SENSOR_CHANNELS];  // RTC_BATCH_NO_VALUE si invalide
+    int16_t estimatedMm[SENSOR_CHANNELS]; // RTC_BATCH_NO_VALUE si invalide
+};
+
+/**
+ * Anneau de lectures accumulées au fil des réveils timer, envoyé en un seul
+ * message MQTT quand la politique d'envoi le demande.
+ * Structure POD : placée en RTC_DATA_ATTR, validée par magic.
+ */
+struct RtcBatch
+{
+    uint32_t magic;
+    uint16_t head;             // prochaine case à écrire
+    uint16_t count;
+    uint16_t wakesSinceUpload;
+    int16_t lastUploadedMm[SENSOR_CHANNELS]; // mesure au dernier envoi réussi
+    BatchReading items[RTC_BATCH_CAPACITY];
+};
+
+void batchEnsureValid(RtcBatch &b);
+void batchPush(RtcBatch &b, uint32_t tS, const MeasurementSet &set);
+
+// Politique d'envoi : tous les everyN réveils, anneau plein, ou variation
+// >= thresholdCm d'un canal depuis le dernier envoi (0 = désactivé).
+bool batchShouldFlush(const RtcBatch &b, uint16_t everyN, float thresholdCm, const MeasurementSet &current);
+
+// Vide l'anneau après un envoi réussi.
+void batchMarkUploaded(RtcBatch &b, const MeasurementSet &current);
+
+/**
+ * Écrit le lot dans l'objet JSON ouvert par l'appelant : champs de la dernière
+ * mesure (compatibles avec le message unitaire, "channels" avec plusieurs
+ * canaux) puis "readings":[[age_s,measured_cm,estimated_cm,...],...] du plus
+ * ancien au plus récent, un couple mesuré/estimé par canal. L'appelant peut
+ * ajouter ses propres champs avant de fermer l'objet.
+ */
+void batchWriteJson(JsonWriter &w, const RtcBatch &b, const MeasurementSet &latest, uint32_t nowS);
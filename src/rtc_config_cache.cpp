@@ -0,0 +1,71 @@
+#include <Arduino.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+#include "rtc_config_cache.h"
+#include "config.h"
+#include "crc32.h"
+#include "measurement.h"
+
+static const uint32_t RTC_CACHE_MAGIC = 0x43464743; // "CFGC"
+static const uint32_t RTC_CACHE_LAYOUT = (uint32_t)(sizeof(AppConfig) << 16) ^ (uint32_t)sizeof(CalibrationTable);
+
+/**
+ * CalibrationTable est copiée octet par octet : un objet avec constructeur en
+ * RTC_DATA_ATTR serait réinitialisé à chaque démarrage, réveil compris.
+ */
+struct RtcConfigCache
+{
+    uint32_t magic;
+    uint32_t layout;
+    AppConfig config;
+    float cuveVide;
+    float cuvePleine;
+    alignas(8) uint8_t calib[sizeof(CalibrationTable)];
+    uint32_t crc; // sur tous les champs précédents
+};
+
+static_assert(std::is_trivially_copyable<CalibrationTable>::value, "CalibrationTable doit rester copiable par memcpy");
+
+RTC_DATA_ATTR static RtcConfigCache rtcCache;
+
+static uint32_t cacheCrc(const RtcConfigCache &c)
+{
+    return crc32Update(0, &c, offsetof(RtcConfigCache, crc));
+}
+
+void rtcCacheCapture()
+{
+    const CalibrationPtr calib = calibrationSnapshot();
+    if (!calib)
+        return;
+    const ConfigPtr cfg = ConfigManager::instance().snapshot();
+
+    // Remplissage complet (bourrage compris) : le CRC couvre des octets déterministes
+    memset(&rtcCache, 0, sizeof(rtcCache));
+    rtcCache.magic = RTC_CACHE_MAGIC;
+    rtcCache.layout = RTC_CACHE_LAYOUT;
+    memcpy(&rtcCache.config, cfg.get(), sizeof(AppConfig));
+    rtcCache.cuveVide = cuveVide.load();
+    rtcCache.cuvePleine = cuvePleine.load();
+    memcpy(rtcCache.calib, calib.get(), sizeof(CalibrationTable));
+    rtcCache.crc = cacheCrc(rtcCache);
+}
+
+bool rtcCacheRestore()
+{
+    if (rtcCache.magic != RTC_CACHE_MAGIC || rtcCache.layout != RTC_CACHE_LAYOUT ||
+        rtcCache.crc != cacheCrc(rtcCache))
+        return false;
+
+    CalibrationTable calib;
+    memcpy(&calib, rtcCache.calib, sizeof(CalibrationTable));
+    ConfigManager::instance().restore(rtcCache.config);
+    restoreCalibration(calib, rtcCache.cuveVide, rtcCache.cuvePleine);
+    return true;
+}
+
+void rtcCacheInvalidate()
+{
+    rtcCache.magic = 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+#include "config_manager.h"
+#include "calibration.h"
+
+/**
+ * Copie en RTC RAM de la configuration effective et de la calibration déjà
+ * ajustée du canal 0 (coefficients, pentes et LUT compris), protégée par
+ * CRC-32. Les canaux suivants relisent la NVS : une LUT par canal ne tiendrait
+ * pas en RTC RAM.
+ * - Réveil timer : restaurée telle quelle, sans ouvrir la NVS ni refaire
+ *   l'ajustement.
+ * - Invalidée par toute écriture NVS (config, points, modèle, niveaux de
+ *   cuve) ; le réveil suivant relit la NVS puis la reconstitue.
+ * - L'empreinte de disposition (tailles des structures) écarte une copie
+ *   laissée par un autre firmware.
+ * Empreinte : ~3,2 Ko de RTC RAM, LUT de calibration comprise.
+ */
+
+// Capture l'état courant (config publiée, calibration publiée et niveaux de cuve du canal 0)
+void rtcCacheCapture();
+// Restaure config + calibration ; false si absente, invalidée ou corrompue.
+bool rtcCacheRestore();
+void rtcCacheInvalidate();
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Seqlock mono-écrivain / multi-lecteurs à double tampon.
+ * - L'écrivain ne bloque jamais et écrit dans le tampon qui ne porte pas la
+ *   dernière valeur publiée.
+ * - Un lecteur n'attend jamais une écriture en cours : il copie la dernière
+ *   valeur complète. Il ne recommence que si l'écrivain a publié deux valeurs
+ *   pendant sa copie, et abandonne après SEQLOCK_READ_RETRIES tentatives
+ *   (read() retourne alors 0 et le contenu de out n'est pas garanti).
+ * - version() permet de savoir sans copie si une nouvelle valeur existe.
+ * T doit être trivialement copiable.
+ */
+#ifndef SEQLOCK_READ_RETRIES
+#define SEQLOCK_READ_RETRIES 8
+#endif
+
+template <typename T>
+class SeqLock
+{
+public:
+    void write(const T &value)
+    {
+        const uint32_t s = seq_.load(std::memory_order_relaxed);
+        seq_.store(s + 1, std::memory_order_relaxed); // impair = écriture en cours
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&data_[((s >> 1) + 1) & 1u], &value, sizeof(T));
+        seq_.store(s + 2, std::memory_order_release);
+    }
+
+    // Copie cohérente de la dernière valeur publiée ; retourne sa version,
+    // ou 0 si l'écrivain a doublé le lecteur SEQLOCK_READ_RETRIES fois.
+    uint32_t read(T &out) const
+    {
+        for (uint32_t attempt = 0; attempt < SEQLOCK_READ_RETRIES; attempt++)
+        {
+            // Version v complète dans data_[v & 1] ; l'écrivain ne réécrit ce
+            // tampon qu'à partir de seq = 2v + 3 (publication de v + 2).
+            const uint32_t v = seq_.load(std::memory_order_acquire) >> 1;
+            memcpy(&out, &data_[v & 1u], sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) - (v << 1) <= 2u)
+                return v;
+        }
+        return 0;
+    }
+
+    uint32_t version() const { return seq_.load(std::memory_order_acquire) >> 1; }
+
+private:
+    std::atomic<uint32_t> seq_{0};
+    T data_[2]{};
+};
@@ -0,0 +1,180 @@
+#include "tank_geometry.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+bool TankModel::build(const TankParams &p)
+{
+    valid_ = false;
+    shape_ = p.shape;
+    diameterCm_ = p.diameterCm;
+    lengthCm_ = p.lengthCm;
+    widthCm_ = p.widthCm;
+    fullLevelCm_ = p.fullLevelCm;
+    profCount_ = 0;
+
+    if (!(fullLevelCm_ > 0.0f))
+        return false;
+
+    switch (shape_)
+    {
+    case TankShape::VerticalCylinder:
+        if (!(diameterCm_ > 0.0f))
+            return false;
+        break;
+    case TankShape::HorizontalCylinder:
+        if (!(diameterCm_ > 0.0f) || !(lengthCm_ > 0.0f))
+            return false;
+        // L'eau ne peut dépasser le diamètre
+        if (fullLevelCm_ > diameterCm_)
+            fullLevelCm_ = diameterCm_;
+        break;
+    case TankShape::Rectangular:
+        if (!(lengthCm_ > 0.0f) || !(widthCm_ > 0.0f))
+            return false;
+        break;
+    case TankShape::Profile:
+        if (!parseProfile(p.profile, profLevel_, profVolume_, TANK_PROFILE_MAX_POINTS, profCount_) || profCount_ < 2)
+            return false;
+        break;
+    default:
+        return false;
+    }
+
+    const float step = fullLevelCm_ / (TANK_LUT_SIZE - 1);
+    for (int i = 0; i < TANK_LUT_SIZE; ++i)
+        lut_[i] = analyticVolumeL(step * i);
+    invStep_ = 1.0f / step;
+    capacityL_ = lut_[TANK_LUT_SIZE - 1];
+    valid_ = capacityL_ > 0.0f;
+    return valid_;
+}
+
+float TankModel::volumeL(float levelCm) const
+{
+    if (!valid_ || isnan(levelCm))
+        return NAN;
+    if (levelCm <= 0.0f)
+        return lut_[0];
+    const float f = levelCm * invStep_;
+    const int i = (int)f;
+    if (i >= TANK_LUT_SIZE - 1)
+        return capacityL_;
+    return lut_[i] + (lut_[i + 1] - lut_[i]) * (f - i);
+}
+
+float TankModel::analyticVolumeL(float levelCm) const
+{
+    double h = levelCm;
+    if (h < 0.0)
+        h = 0.0;
+    if (h > fullLevelCm_)
+        h = fullLevelCm_;
+
+    double cm3 = 0.0;
+    switch (shape_)
+    {
+    case TankShape::VerticalCylinder:
+    {
+        const double r = diameterCm_ * 0.5;
+        cm3 = M_PI * r * r * h;
+        break;
+    }
+    case TankShape::HorizontalCylinder:
+    {
+        // Segment circulaire : r² acos((r-h)/r) - (r-h) sqrt(2rh - h²)
+        const double r = diameterCm_ * 0.5;
+        const double d = r - h;
+        double c = d / r;
+        c = c < -1.0 ? -1.0 : (c > 1.0 ? 1.0 : c);
+        const double s = 2.0 * r * h - h * h;
+        cm3 = (r * r * acos(c) - d * sqrt(s > 0.0 ? s : 0.0)) * lengthCm_;
+        break;
+    }
+    case TankShape::Rectangular:
+        cm3 = (double)lengthCm_ * widthCm_ * h;
+        break;
+    case TankShape::Profile:
+    {
+        // Interpolation linéaire, prolongée par le dernier segment au-delà de la table
+        size_t k = 0;
+        while (k + 2 < profCount_ && h > profLevel_[k + 1])
+            ++k;
+        const double h0 = profLevel_[k], h1 = profLevel_[k + 1];
+        const double v0 = profVolume_[k], v1 = profVolume_[k + 1];
+        const double v = v0 + (v1 - v0) * (h - h0) / (h1 - h0);
+        return (float)(v > 0.0 ? v : 0.0);
+    }
+    }
+    return (float)(cm3 / 1000.0);
+}
+
+const char *TankModel::shapeName(TankShape shape)
+{
+    switch (shape)
+    {
+    case TankShape::HorizontalCylinder:
+        return "hcyl";
+    case TankShape::Rectangular:
+        return "rect";
+    case TankShape::Profile:
+        return "profile";
+    default:
+        return "vcyl";
+    }
+}
+
+bool TankModel::parseShape(const char *name, TankShape &out)
+{
+    if (strcmp(name, "vcyl") == 0)
+        out = TankShape::VerticalCylinder;
+    else if (strcmp(name, "hcyl") == 0)
+        out = TankShape::HorizontalCylinder;
+    else if (strcmp(name, "rect") == 0)
+        out = TankShape::Rectangular;
+    else if (strcmp(name, "profile") == 0)
+        out = TankShape::Profile;
+    else
+        return false;
+    return true;
+}
+
+bool TankModel::parseProfile(const char *text, float *levelCm, float *volumeL, size_t maxPoints, size_t &count)
+{
+    count = 0;
+    if (!text)
+        return false;
+
+    const char *p = text;
+    while (*p)
+    {
+        while (*p == ' ' || *p == ',' || *p == ';' || *p == '\n')
+            ++p;
+        if (!*p)
+            break;
+
+        char *end;
+        const float h = strtof(p, &end);
+        if (end == p || *end != ':')
+            return false;
+        p = end + 1;
+        const float v = strtof(p, &end);
+        if (end == p)
+            return false;
+        p = end;
+
+        if (count >= maxPoints || !isfinite(h) || !isfinite(v) || h < 0.0f || v < 0.0f)
+            return false;
+        // Hauteurs strictement croissantes, volume non décroissant
+        if (count > 0 && (h <= levelCm[count - 1] || v < volumeL[count - 1]))
+            return false;
+        levelCm[count] = h;
+        volumeL[count] = v;
+        count++;
+    }
+    return count > 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+
+#define TANK_LUT_SIZE 256
+#define TANK_PROFILE_MAX_POINTS 32
+
+enum class TankShape : uint8_t
+{
+    VerticalCylinder = 0,
+    HorizontalCylinder = 1,
+    Rectangular = 2,
+    Profile = 3 // table hauteur (cm) -> volume (L) fournie par l'utilisateur
+};
+
+struct TankParams
+{
+    TankShape shape;
+    float diameterCm;  // cylindres
+    float lengthCm;    // cylindre horizontal, rectangulaire
+    float widthCm;     // rectangulaire
+    const char *profile; // "h_cm:litres,h_cm:litres,..." (forme Profile)
+    float fullLevelCm; // hauteur d'eau cuve pleine (cuveVide - cuvePleine)
+};
+
+/**
+ * Volume d'eau en fonction de la hauteur d'eau.
+ * - build() précalcule TANK_LUT_SIZE volumes sur [0, fullLevelCm] : volumeL()
+ *   coûte une lecture + interpolation, quelle que soit la forme.
+ * - analyticVolumeL() évalue la formule exacte (construction, tests).
+ * - Indépendant du matériel (testable hors cible).
+ */
+class TankModel
+{
+public:
+    bool build(const TankParams &params);
+    bool valid() const { return valid_; }
+
+    float capacityL() const { return capacityL_; }
+    float fullLevelCm() const { return fullLevelCm_; }
+
+    // Niveau borné à [0, plein]. NAN si modèle invalide.
+    float volumeL(float levelCm) const;
+    float analyticVolumeL(float levelCm) const;
+
+    static const char *shapeName(TankShape shape);
+    static bool parseShape(const char *name, TankShape &out);
+    // Points triés par hauteur croissante, volumes croissants ; false si illisible
+    static bool parseProfile(const char *text, float *levelCm, float *volumeL, size_t maxPoints, size_t &count);
+
+private:
+    TankShape shape_ = TankShape::VerticalCylinder;
+    float diameterCm_ = 0.0f, lengthCm_ = 0.0f, widthCm_ = 0.0f;
+    float profLevel_[TANK_PROFILE_MAX_POINTS] = {};
+    float profVolume_[TANK_PROFILE_MAX_POINTS] = {};
+    size_t profCount_ = 0;
+
+    float lut_[TANK_LUT_SIZE] = {};
+    float fullLevelCm_ = 0.0f, invStep_ = 0.0f, capacityL_ = 0.0f;
+    bool valid_ = false;
+};
+
+using TankModelPtr = std::shared_ptr<const TankModel>;
@@ -2,33 +2,143 @@
 #include "utils.h"
 #include "config.h"
 #include "config_manager.h"
+#include "crc32.h"
+#include "metrics.h"
+#include "logger.h"
+#include "display.h"
+#include <esp_timer.h>
+#include <stddef.h>
+#include <time.h>
+
+// ---------- Cache de reconnexion rapide (RTC RAM) ----------
+// Dernier AP / canal / bail IP valides : au réveil, connexion dirigée sans
+// scan ni DHCP, avec repli sur une connexion complète en cas d'échec.
+struct WifiFastCache
+{
+  uint32_t ssidCrc;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t reserved; // pas d'octet de bourrage non initialisé dans le CRC
+  uint32_t ip, gateway, mask, dns;
+  uint32_t savedAtS; // time(nullptr) à l'enregistrement
+  uint32_t crc;      // sur tous les champs précédents
+};
+
+static const uint32_t WIFI_CACHE_MAX_AGE_S = 12UL * 3600UL; // au-delà : DHCP pour renouveler le bail
+static const uint32_t WIFI_FAST_TIMEOUT_MS = 1500;
+
+RTC_DATA_ATTR static WifiFastCache wifiCache;
+RTC_DATA_ATTR static uint32_t lastWifiConnectMs = 0;
+RTC_DATA_ATTR static bool lastWifiConnectFast = false;
+
+static uint32_t wifiCacheCrc(const WifiFastCache &c)
+{
+  return crc32Update(0, &c, offsetof(WifiFastCache, crc));
+}
+
+static bool wifiCacheValid(const char *ssid)
+{
+  if (wifiCache.crc != wifiCacheCrc(wifiCache) || wifiCache.ip == 0 || wifiCache.channel == 0)
+    return false;
+  if (wifiCache.ssidCrc != crc32Update(0, ssid, strlen(ssid)))
+    return false;
+  const uint32_t now = (uint32_t)time(nullptr);
+  return (now >= wifiCache.savedAtS) && (now - wifiCache.savedAtS < WIFI_CACHE_MAX_AGE_S);
+}
+
+static void wifiCacheStore(const char *ssid)
+{
+  WifiFastCache c{};
+  c.ssidCrc = crc32Update(0, ssid, strlen(ssid));
+  const uint8_t *bssid = WiFi.BSSID();
+  if (bssid)
+    memcpy(c.bssid, bssid, sizeof(c.bssid));
+  c.channel = (uint8_t)WiFi.channel();
+  c.ip = (uint32_t)WiFi.localIP();
+  c.gateway = (uint32_t)WiFi.gatewayIP();
+  c.mask = (uint32_t)WiFi.subnetMask();
+  c.dns = (uint32_t)WiFi.dnsIP();
+  c.savedAtS = (uint32_t)time(nullptr);
+  c.crc = wifiCacheCrc(c);
+  memcpy(&wifiCache, &c, sizeof(c));
+}
+
+static void wifiCacheInvalidate()
+{
+  wifiCache.crc = ~wifiCacheCrc(wifiCache);
+}
+
+static bool waitWiFiConnected(uint32_t timeoutMs)
+{
+  uint32_t t0 = millis();
+  while (millis() - t0 < timeoutMs)
+  {
+    if (WiFi.status() == WL_CONNECTED)
+      return true;
+    delay(10);
+  }
+  return (WiFi.status() == WL_CONNECTED);
+}
 
 bool connectWiFiShort(uint32_t timeoutMs)
 {
   if (WiFi.status() == WL_CONNECTED)
     return true;
 
-  const auto cfg = ConfigManager::instance().getConfig();
+  const ConfigPtr cfgPtr = ConfigManager::instance().snapshot();
+  const AppConfig &cfg = *cfgPtr;
   if (strlen(cfg.wifi_ssid) == 0)
   {
     // Pas de SSID configuré -> pas de STA
     return false;
   }
 
+  const char *pass = (strlen(cfg.wifi_pass) == 0) ? nullptr : cfg.wifi_pass;
+  StageTimer timer(MetricStage::WifiConnect);
+  const uint32_t t0 = millis();
   WiFi.mode(WIFI_STA);
-  if (strlen(cfg.wifi_pass) == 0)
-    WiFi.begin(cfg.wifi_ssid);
-  else
-    WiFi.begin(cfg.wifi_ssid, cfg.wifi_pass);
 
-  uint32_t t0 = millis();
-  while (millis() - t0 < timeoutMs)
+  // 1) Connexion dirigée : BSSID + canal connus, bail IP statique
+  if (wifiCacheValid(cfg.wifi_ssid))
   {
-    if (WiFi.status() == WL_CONNECTED)
+    WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway),
+                IPAddress(wifiCache.mask), IPAddress(wifiCache.dns));
+    WiFi.begin(cfg.wifi_ssid, pass, wifiCache.channel, wifiCache.bssid);
+    if (waitWiFiConnected(min(timeoutMs, WIFI_FAST_TIMEOUT_MS)))
+    {
+      lastWifiConnectMs = millis() - t0;
+      lastWifiConnectFast = true;
+      LOG_I(Wifi, "Connexion rapide en %lu ms", (unsigned long)lastWifiConnectMs);
       return true;
-    delay(200);
+    }
+
+    LOG_I(Wifi, "Connexion rapide échouée -> connexion complète");
+    wifiCacheInvalidate();
+    WiFi.disconnect();
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // retour au DHCP
   }
-  return (WiFi.status() == WL_CONNECTED);
+
+  // 2) Connexion complète : scan + association + DHCP
+  WiFi.begin(cfg.wifi_ssid, pass);
+  const uint32_t elapsed = millis() - t0;
+  if (!waitWiFiConnected(timeoutMs > elapsed ? timeoutMs - elapsed : 0))
+    return false;
+
+  wifiCacheStore(cfg.wifi_ssid);
+  lastWifiConnectMs = millis() - t0;
+  lastWifiConnectFast = false;
+  LOG_I(Wifi, "Connexion complète en %lu ms", (unsigned long)lastWifiConnectMs);
+  return true;
+}
+
+uint32_t getLastWifiConnectMs()
+{
+  return lastWifiConnectMs;
+}
+
+bool wasLastWifiConnectFast()
+{
+  return lastWifiConnectFast;
 }
 
 void disconnectWiFiClean()
@@ -41,26 +151,58 @@ void disconnectWiFiClean()
   }
 }
 
+// Tâches dont la marge de pile est suivie (/api/metrics, diagnostics MQTT)
+static struct
+{
+  const char *name;
+  TaskHandle_t handle;
+} monitoredTasks[METRICS_MAX_TASKS];
+static uint8_t monitoredTaskCount = 0;
+
+void registerMonitoredTask(const char *name, TaskHandle_t handle)
+{
+  if (!handle || monitoredTaskCount >= METRICS_MAX_TASKS)
+    return;
+  monitoredTasks[monitoredTaskCount].name = name;
+  monitoredTasks[monitoredTaskCount].handle = handle;
+  monitoredTaskCount++;
+}
+
+void collectSystemStats(SystemStats &out)
+{
+  out = SystemStats{};
+  out.uptimeS = (uint32_t)(esp_timer_get_time() / 1000000);
+  out.heapSize = ESP.getHeapSize();
+  out.heapFree = ESP.getFreeHeap();
+  out.heapMinFree = ESP.getMinFreeHeap();
+  out.heapMaxAlloc = ESP.getMaxAllocHeap();
+  out.psramSize = ESP.getPsramSize();
+  out.psramFree = ESP.getFreePsram();
+  out.psramMinFree = ESP.getMinFreePsram();
+
+  // Sur ESP32, la marge de pile est en octets (StackType_t = uint8_t)
+  for (uint8_t i = 0; i < monitoredTaskCount; ++i)
+  {
+    out.tasks[i].name = monitoredTasks[i].name;
+    out.tasks[i].freeStackMin = uxTaskGetStackHighWaterMark(monitoredTasks[i].handle);
+  }
+  out.taskCount = monitoredTaskCount;
+
+  DisplayStats ds;
+  getDisplayStats(ds);
+  out.displayFrames = ds.frames;
+  out.displayIdleFrames = ds.idleFrames;
+  out.displayBytesPushed = ds.totalBytesPushed;
+}
+
 void printLogHeapStack()
-{ /*
-   size_t stackUsed = uxTaskGetStackHighWaterMark(task_handle_modbus);
-   log_d("stackUsed task_handle_modbus  = %d", stackUsed);
-   stackUsed = uxTaskGetStackHighWaterMark(task_handle_dbConnect);
-   log_d("stackUsed task_handle_dbConnect  = %d", stackUsed);
-   stackUsed = uxTaskGetStackHighWaterMark(task_handle_led);
-   log_d("stackUsed task_handle_led  = %d", stackUsed);
- */
-
-  uint32_t memory = esp_get_free_heap_size();
-  log_d("memory = %d", memory);
-
-  memory = esp_get_minimum_free_heap_size();
-  log_d("memory mini = %d", memory);
-
-  log_d("Total heap: %d", ESP.getHeapSize());
-  log_d("Free heap: %d", ESP.getFreeHeap());
-  log_d("Total PSRAM: %d", ESP.getPsramSize());
-  log_d("Free PSRAM: %d", ESP.getFreePsram());
+{
+  SystemStats s;
+  collectSystemStats(s);
+  LOG_D(Main, "Heap: %u libres / %u (min %u, bloc max %u)", s.heapFree, s.heapSize, s.heapMinFree, s.heapMaxAlloc);
+  LOG_D(Main, "PSRAM: %u libres / %u (min %u)", s.psramFree, s.psramSize, s.psramMinFree);
+  for (uint8_t i = 0; i < s.taskCount; ++i)
+    LOG_D(Main, "Pile %s: %u octets libres au plus bas", s.tasks[i].name, s.tasks[i].freeStackMin);
 }
 
 void convertUint16ToBooleans(int value, bool bits[16])
@@ -1,8 +1,16 @@
 #pragma once
 #include <Arduino.h>
+#include "metrics.h"
 
 bool connectWiFiShort(uint32_t timeoutMs = 8000);
+// Durée de la dernière connexion STA réussie et type (rapide via cache RTC ou complète)
+uint32_t getLastWifiConnectMs();
+bool wasLastWifiConnectFast();
 void disconnectWiFiClean();
 void printLogHeapStack();
+// Suivi de la marge de pile d'une tâche (METRICS_MAX_TASKS au plus)
+void registerMonitoredTask(const char *name, TaskHandle_t handle);
+// Heap, PSRAM, piles des tâches suivies et compteurs d'affichage
+void collectSystemStats(SystemStats &out);
 void convertUint16ToBooleans(int value, bool bits[16]);
 void updateMinMaxTime(unsigned int startTime, unsigned int &currentTime, unsigned int &minTime, unsigned int &maxTime);
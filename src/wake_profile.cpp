@@ -0,0 +1,116 @@
+#include <string.h>
+#include "wake_profile.h"
+
+static const uint32_t WAKE_RING_MAGIC = 0x57414B31; // "WAK1"
+
+static const char *const PHASE_NAMES[WAKE_PHASE_COUNT] = {
+    "boot", "config", "calib", "measure", "wifi", "mqtt", "sleep"};
+
+static uint16_t satMs(uint64_t us)
+{
+    const uint64_t ms = us / 1000;
+    return (ms > 0xFFFF) ? 0xFFFF : (uint16_t)ms;
+}
+
+static void addMs(uint16_t &acc, uint64_t us)
+{
+    const uint32_t sum = (uint32_t)acc + satMs(us);
+    acc = (sum > 0xFFFF) ? 0xFFFF : (uint16_t)sum;
+}
+
+const char *wakePhaseName(WakePhase phase)
+{
+    return (phase < WakePhase::Count) ? PHASE_NAMES[(size_t)phase] : "?";
+}
+
+void WakeProfiler::start(uint64_t nowUs)
+{
+    memset(&cur_, 0, sizeof(cur_));
+    cur_.phaseMs[(size_t)WakePhase::Boot] = satMs(nowUs);
+    lastUs_ = nowUs;
+    active_ = true;
+}
+
+void WakeProfiler::mark(WakePhase phase, uint64_t nowUs)
+{
+    if (!active_ || phase >= WakePhase::Count)
+        return;
+    if (nowUs > lastUs_)
+        addMs(cur_.phaseMs[(size_t)phase], nowUs - lastUs_);
+    lastUs_ = nowUs;
+}
+
+void WakeProfiler::finish(WakeProfileRing &ring, uint64_t nowUs, uint32_t tS)
+{
+    if (!active_)
+        return;
+    mark(WakePhase::Sleep, nowUs);
+    cur_.awakeMs = satMs(nowUs);
+    cur_.tS = tS;
+
+    wakeRingEnsureValid(ring);
+    ring.cycles[ring.head] = cur_;
+    ring.head = (uint8_t)((ring.head + 1) % WAKE_PROFILE_DEPTH);
+    if (ring.count < WAKE_PROFILE_DEPTH)
+        ring.count++;
+    active_ = false;
+}
+
+void wakeRingEnsureValid(WakeProfileRing &ring)
+{
+    if (ring.magic == WAKE_RING_MAGIC && ring.head < WAKE_PROFILE_DEPTH && ring.count <= WAKE_PROFILE_DEPTH)
+        return;
+    memset(&ring, 0, sizeof(ring));
+    ring.magic = WAKE_RING_MAGIC;
+}
+
+void wakeProfileStats(const WakeProfileRing &ring, WakeStats &out)
+{
+    memset(&out, 0, sizeof(out));
+    if (ring.magic != WAKE_RING_MAGIC || ring.count == 0 || ring.count > WAKE_PROFILE_DEPTH)
+        return;
+
+    uint32_t sum[WAKE_PHASE_COUNT] = {};
+    uint32_t awakeSum = 0;
+    for (uint8_t i = 0; i < ring.count; ++i)
+    {
+        const WakeCycle &c = ring.cycles[i];
+        for (size_t p = 0; p < WAKE_PHASE_COUNT; ++p)
+        {
+            sum[p] += c.phaseMs[p];
+            if (c.phaseMs[p] > out.maxMs[p])
+                out.maxMs[p] = c.phaseMs[p];
+        }
+        awakeSum += c.awakeMs;
+        if (c.awakeMs > out.awakeMaxMs)
+            out.awakeMaxMs = c.awakeMs;
+        if (c.flags & WAKE_FLAG_WIFI)
+            out.wifiWakes++;
+    }
+
+    const WakeCycle &last = ring.cycles[(ring.head + WAKE_PROFILE_DEPTH - 1) % WAKE_PROFILE_DEPTH];
+    out.n = ring.count;
+    for (size_t p = 0; p < WAKE_PHASE_COUNT; ++p)
+    {
+        out.meanMs[p] = (uint16_t)(sum[p] / ring.count);
+        out.lastMs[p] = last.phaseMs[p];
+    }
+    out.awakeMeanMs = (uint16_t)(awakeSum / ring.count);
+    out.awakeLastMs = last.awakeMs;
+}
+
+void wakeProfileWriteJson(JsonWriter &w, const WakeProfileRing &ring)
+{
+    WakeStats st;
+    wakeProfileStats(ring, st);
+    if (st.n == 0)
+        return;
+
+    w.key("wake").beginObject();
+    w.field("n", st.n).field("wifi", st.wifiWakes);
+    w.key("awake_ms").beginArray().value(st.awakeLastMs).value(st.awakeMeanMs).value(st.awakeMaxMs).endArray();
+    w.key("phases_ms").beginObject();
+    for (size_t p = 0; p < WAKE_PHASE_COUNT; ++p)
+        w.key(PHASE_NAMES[p]).beginArray().value(st.lastMs[p]).value(st.meanMs[p]).value(st.maxMs[p]).endArray();
+    w.endObject().endObject();
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "json_writer.h"
+
+/**
+ * Profil des réveils timer (boot -> deep sleep), phase par phase.
+ * - WakeProfiler chronomètre le réveil courant (RAM) ; finish() l'ajoute à
+ *   l'anneau des WAKE_PROFILE_DEPTH derniers réveils (RTC RAM, validé par magic).
+ * - Les statistiques de l'anneau partent avec le prochain envoi MQTT groupé
+ *   (champ "wake" du message groupé) : référence mesurée sur le terrain
+ *   pour réduire le temps d'éveil.
+ */
+enum class WakePhase : uint8_t
+{
+    Boot = 0,    // démarrage de l'application -> setup()
+    Config,      // ConfigManager::begin()
+    Calibration, // capteur, calibration, client MQTT
+    Measure,     // rafales de pings + filtre + volume
+    Wifi,        // connectWiFiShort()
+    Mqtt,        // encodage + publication
+    Sleep,       // vidage de l'historique, écran, entrée en deep sleep
+    Count
+};
+
+#define WAKE_PHASE_COUNT ((size_t)WakePhase::Count)
+#define WAKE_PROFILE_DEPTH 16
+
+#define WAKE_FLAG_WIFI 0x01      // Wi-Fi connecté pendant ce réveil
+#define WAKE_FLAG_PUBLISHED 0x02 // lot MQTT envoyé
+
+struct WakeCycle
+{
+    uint32_t tS;                         // time(nullptr) à l'entrée en sommeil
+    uint16_t phaseMs[WAKE_PHASE_COUNT];  // saturé à 65535
+    uint16_t awakeMs;
+    uint8_t flags;
+    uint8_t reserved;
+};
+
+struct WakeProfileRing
+{
+    uint32_t magic;
+    uint8_t head;  // prochaine case à écrire
+    uint8_t count;
+    uint16_t reserved;
+    WakeCycle cycles[WAKE_PROFILE_DEPTH];
+};
+
+struct WakeStats
+{
+    uint8_t n;
+    uint16_t lastMs[WAKE_PHASE_COUNT];
+    uint16_t meanMs[WAKE_PHASE_COUNT];
+    uint16_t maxMs[WAKE_PHASE_COUNT];
+    uint16_t awakeLastMs, awakeMeanMs, awakeMaxMs;
+    uint8_t wifiWakes; // réveils avec Wi-Fi sur la fenêtre
+};
+
+class WakeProfiler
+{
+public:
+    // nowUs : temps depuis le démarrage (esp_timer) ; la phase Boot vaut nowUs
+    void start(uint64_t nowUs);
+    // Attribue le temps écoulé depuis la marque précédente à la phase
+    void mark(WakePhase phase, uint64_t nowUs);
+    void setFlag(uint8_t flag) { cur_.flags |= flag; }
+    void cancel() { active_ = false; } // démarrage interactif : pas un réveil timer
+    bool active() const { return active_; }
+
+    // Clôture (reste attribué à Sleep) et ajoute le cycle à l'anneau
+    void finish(WakeProfileRing &ring, uint64_t nowUs, uint32_t tS);
+
+private:
+    WakeCycle cur_{};
+    uint64_t lastUs_ = 0;
+    bool active_ = false;
+};
+
+void wakeRingEnsureValid(WakeProfileRing &ring);
+void wakeProfileStats(const WakeProfileRing &ring, WakeStats &out);
+const char *wakePhaseName(WakePhase phase);
+
+// Champ de l'objet JSON ouvert (rien si l'anneau est vide) :
+// "wake":{"n":..,"wifi":..,"awake_ms":[dernier,moyenne,max],"phases_ms":{"boot":[dernier,moyenne,max],...}}
+void wakeProfileWriteJson(JsonWriter &w, const WakeProfileRing &ring);
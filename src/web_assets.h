@@ -0,0 +1,30 @@
+#pragma once
+#include <Arduino.h>
+
+/**
+ * Fichier statique de l'interface web, embarqué en flash déjà compressé (gzip).
+ * - etag : hash du contenu (entre guillemets), change à chaque modification.
+ * - immutable : CSS/JS référencés avec ?v=<hash> depuis les pages HTML,
+ *   donc cachables indéfiniment ; les pages HTML sont revalidées par ETag.
+ */
+struct WebAsset
+{
+    const char *path;
+    const char *mime;
+    const uint8_t *gz;
+    size_t gzLen;
+    size_t rawLen; // taille décompressée (banc octets sur le fil)
+    const char *etag;
+    bool immutable;
+};
+
+// Généré avant chaque build par scripts/embed_web_assets.py depuis data/
+#include "web_assets_gen.h"
+
+inline const WebAsset *findWebAsset(const char *path)
+{
+    for (size_t i = 0; i < WEB_ASSET_COUNT; ++i)
+        if (strcmp(WEB_ASSETS[i].path, path) == 0)
+            return &WEB_ASSETS[i];
+    return nullptr;
+}
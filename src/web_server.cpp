@@ -1,368 +1,739 @@
 #include <ESPAsyncWebServer.h>
 #include "web_server.h"
 #include "measurement.h"
+#include "measurement_store.h"
 #include "mqtt.h"
 #include "config.h"
 #include "utils.h"
 #include "config_manager.h"
+#include "history_store.h"
+#include "web_assets.h"
+#include "http_negotiation.h"
+#include "display.h"
+#include "hal/hal_fs.h"
+#include "metrics.h"
+#include "json_writer.h"
+#include "logger.h"
 
-#include <LittleFS.h>
 #include <Arduino.h>
 #include <WiFi.h>
 #include <mutex>
+#include <memory>
+#include <new>
+#include <time.h>
 #include <M5Unified.h>
 
 AsyncWebServer server(80);
 
+// Push temps réel (Server-Sent Events) : mesures, calibrations, config
+AsyncEventSource events("/events");
+
+#define CALIBS_JSON_LEN 1024
+
+static const char *calibsEventJson(uint8_t ch);
+static void pushCalibsEvent(uint8_t ch);
+static bool requestChannel(AsyncWebServerRequest *request, uint8_t &ch);
+static void serveWebAsset(AsyncWebServerRequest *request, const char *path, bool needsAuth);
+
 // --- Déclarations des handlers existants ---
 void handleDistanceApi(AsyncWebServerRequest *request);
 void handleCalibsApi(AsyncWebServerRequest *request);
 void handleSaveCalib(AsyncWebServerRequest *request);
+void handleDeleteCalib(AsyncWebServerRequest *request);
+void handleCalibModel(AsyncWebServerRequest *request);
 void handleClearCalib(AsyncWebServerRequest *request);
 void handleSetCuve(AsyncWebServerRequest *request);
 void handleSendMQTT(AsyncWebServerRequest *request);
+void handleHistoryApi(AsyncWebServerRequest *request);
+void handleMetricsApi(AsyncWebServerRequest *request);
+void handleLogsApi(AsyncWebServerRequest *request);
+void handleLogLevel(AsyncWebServerRequest *request);
 
 // --- NEW: API config ---
 void handleGetConfig(AsyncWebServerRequest *request);
-void handlePostConfig(AsyncWebServerRequest *request, const String &body);
+void handlePostConfig(AsyncWebServerRequest *request, const ConfigUpdate &update);
+void handleConfigState(AsyncWebServerRequest *request);
 
 // --- Initialisation du serveur ---
 void startWebServer()
 {
-    Serial.println("[WEB] Initialisation du serveur HTTP...");
+    LOG_I(Web, "Initialisation du serveur HTTP...");
 
-    if (!LittleFS.begin(true))
+    if (!halFsBegin())
     {
-        Serial.println("[WEB][ERREUR] Échec du montage LittleFS !");
+        LOG_E(Web, "Échec du montage LittleFS !");
         while (true)
             delay(1000);
     }
+    historyStore.begin();
 
     // Tentative de connexion Wi-Fi (STA si configuré, sinon AP)
     if (!connectWiFiShort(8000))
     {
-        Serial.println("[WEB][WARN] Échec de connexion Wi-Fi. Activation du mode point d’accès...");
+        LOG_W(Web, "Échec de connexion Wi-Fi. Activation du mode point d’accès...");
         WiFi.mode(WIFI_AP);
         WiFi.softAP("M5CoreS3_Puits");
-        Serial.print("[WEB] Point d’accès actif : ");
-        Serial.println(WiFi.softAPIP());
+        LOG_I(Web, "Point d’accès actif : %s", WiFi.softAPIP().toString().c_str());
     }
     else
     {
-        Serial.print("[WEB] Connecté au Wi-Fi : ");
-        Serial.println(WiFi.localIP());
+        LOG_I(Web, "Connecté au Wi-Fi : %s", WiFi.localIP().toString().c_str());
+        configTime(0, 0, "pool.ntp.org"); // horodatage de l'historique
     }
 
-    // --- Routes statiques ---
+    // --- SSE : état courant à la connexion, puis push à chaque nouvelle mesure ---
+    events.onConnect([](AsyncEventSourceClient *client)
+                     {
+        interactiveLastTouchMs.store(millis());
+        LOG_D(Web, "SSE client connecté (%u)", (unsigned)events.count());
+        for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+        {
+            MeasurementRecord rec;
+            readMeasurement(rec, ch);
+            char buf[320];
+            formatDistanceJson(rec, cuveVideCh[ch].load(), cuvePleineCh[ch].load(), buf, sizeof(buf));
+            client->send(buf, "measure", rec.seq);
+            client->send(calibsEventJson(ch), "calibs");
+        } });
+    server.addHandler(&events);
+
+    // --- Routes statiques (gzip embarqué en flash, ETag + Cache-Control) ---
     server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
-              {
-        Serial.println("[WEB] GET /index.html");
-        AsyncWebServerResponse *response = request->beginResponse(LittleFS, "/index.html", "text/html");
-        response->addHeader("Content-Type", "text/html; charset=utf-8");
-        request->send(response); });
-
+              { serveWebAsset(request, "/index.html", false); });
     server.on("/style.css", HTTP_GET, [](AsyncWebServerRequest *request)
-              {
-        Serial.println("[WEB] GET /style.css");
-        AsyncWebServerResponse *response = request->beginResponse(LittleFS, "/style.css", "text/css");
-        response->addHeader("Content-Type", "text/css; charset=utf-8");
-        request->send(response); });
-
+              { serveWebAsset(request, "/style.css", false); });
     server.on("/script.js", HTTP_GET, [](AsyncWebServerRequest *request)
-              {
-        Serial.println("[WEB] GET /script.js");
-        AsyncWebServerResponse *response = request->beginResponse(LittleFS, "/script.js", "application/javascript");
-        response->addHeader("Content-Type", "application/javascript; charset=utf-8");
-        request->send(response); });
+              { serveWebAsset(request, "/script.js", false); });
 
     // --- Page de configuration protégée ---
     server.on("/config.html", HTTP_GET, [](AsyncWebServerRequest *request)
-              {
-        const char *adminUser = ConfigManager::instance().getAdminUser();
-        const char *adminPass = ConfigManager::instance().getAdminPass();
-        if (!request->authenticate(adminUser, adminPass)) {
-            Serial.println("[WEB][AUTH] Authentification requise sur /config.html");
-            return request->requestAuthentication();
-        }
-        Serial.println("[WEB] GET /config.html (auth OK)");
-        AsyncWebServerResponse *response = request->beginResponse(LittleFS, "/config.html", "text/html");
-        response->addHeader("Content-Type", "text/html; charset=utf-8");
-        request->send(response); });
-
+              { serveWebAsset(request, "/config.html", true); });
     // Script JS de la page de config
     server.on("/script_config.js", HTTP_GET, [](AsyncWebServerRequest *request)
-              {
-        const char *adminUser = ConfigManager::instance().getAdminUser();
-        const char *adminPass = ConfigManager::instance().getAdminPass();
-        if (!request->authenticate(adminUser, adminPass)) {
-            Serial.println("[WEB][AUTH] Authentification requise sur /script_config.js");
-            return request->requestAuthentication();
-        }
-        Serial.println("[WEB] GET /script_config.js (auth OK)");
-        AsyncWebServerResponse *response = request->beginResponse(LittleFS, "/script_config.js", "application/javascript");
-        response->addHeader("Content-Type", "application/javascript; charset=utf-8");
-        request->send(response); });
+              { serveWebAsset(request, "/script_config.js", true); });
 
     // --- PING keepalive ---
     server.on("/ping", HTTP_POST, [](AsyncWebServerRequest *request)
               {
         String page = request->arg("page");
         interactiveLastTouchMs.store(millis());
-        Serial.printf("[WEB] POST /ping (%s)\n", page.c_str());
+        LOG_D(Web, "POST /ping (%s)", page.c_str());
         request->send(200, "application/json; charset=utf-8", "{\"ok\":true}"); });
 
     // --- API existantes ---
     server.on("/distance", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-        Serial.println("[WEB] GET /distance");
+        LOG_D(Web, "GET /distance");
+        StageTimer timer(MetricStage::HttpHandler);
         handleDistanceApi(request); });
 
+    server.on("/api/history", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+        LOG_D(Web, "GET /api/history");
+        StageTimer timer(MetricStage::HttpHandler);
+        handleHistoryApi(request); });
+
+    // Métriques Prometheus (étapes instrumentées, mémoire, piles)
+    server.on("/api/metrics", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+        StageTimer timer(MetricStage::HttpHandler);
+        handleMetricsApi(request); });
+
+#if LOG_TAIL_LINES > 0
+    // Dernières lignes du journal (protégé) ; POST : niveau d'un module
+    server.on("/api/logs", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+        StageTimer timer(MetricStage::HttpHandler);
+        handleLogsApi(request); });
+    server.on("/api/logs", HTTP_POST, [](AsyncWebServerRequest *request)
+              {
+        StageTimer timer(MetricStage::HttpHandler);
+        handleLogLevel(request); });
+#endif
+
     server.on("/calibs", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-        Serial.println("[WEB] GET /calibs");
+        LOG_D(Web, "GET /calibs");
+        StageTimer timer(MetricStage::HttpHandler);
         handleCalibsApi(request); });
 
     server.on("/save_calib", HTTP_POST, [](AsyncWebServerRequest *request)
               {
-        Serial.println("[WEB] POST /save_calib");
+        LOG_D(Web, "POST /save_calib");
+        StageTimer timer(MetricStage::HttpHandler);
         handleSaveCalib(request); });
 
+    server.on("/delete_calib", HTTP_POST, [](AsyncWebServerRequest *request)
+              {
+        LOG_D(Web, "POST /delete_calib");
+        StageTimer timer(MetricStage::HttpHandler);
+        handleDeleteCalib(request); });
+
+    server.on("/calib_model", HTTP_POST, [](AsyncWebServerRequest *request)
+              {
+        LOG_D(Web, "POST /calib_model");
+        StageTimer timer(MetricStage::HttpHandler);
+        handleCalibModel(request); });
+
     server.on("/clear_calib", HTTP_POST, [](AsyncWebServerRequest *request)
               {
-        Serial.println("[WEB] POST /clear_calib");
+        LOG_D(Web, "POST /clear_calib");
+        StageTimer timer(MetricStage::HttpHandler);
         handleClearCalib(request); });
 
     server.on("/setCuve", HTTP_POST, [](AsyncWebServerRequest *request)
               {
-        Serial.println("[WEB] POST /setCuve");
+        LOG_D(Web, "POST /setCuve");
+        StageTimer timer(MetricStage::HttpHandler);
         handleSetCuve(request); });
 
     server.on("/send_mqtt", HTTP_POST, [](AsyncWebServerRequest *request)
               {
-        Serial.println("[WEB] POST /send_mqtt");
+        LOG_D(Web, "POST /send_mqtt");
+        StageTimer timer(MetricStage::HttpHandler);
         handleSendMQTT(request); });
 
     // --- NEW: Config API (protected) ---
+    // Avant "/api/config" : ce handler capterait aussi "/api/config/..."
+    server.on("/api/config/state", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+        StageTimer timer(MetricStage::HttpHandler);
+        handleConfigState(request); });
+
     server.on("/api/config", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-        Serial.println("[WEB] GET /api/config");
+        LOG_D(Web, "GET /api/config");
+        StageTimer timer(MetricStage::HttpHandler);
         handleGetConfig(request); });
 
-    // --- Handler POST /api/config : auth + body par requête ---
+    // --- Handler POST /api/config : auth une fois, analyse au fil des blocs ---
     server.on("/api/config", HTTP_POST,
-              // onRequest (vide)
-              [](AsyncWebServerRequest *request) {},
+              // onRequest : seul le corps vide arrive ici sans passer par onBody
+              [](AsyncWebServerRequest *request)
+              {
+                  if (request->contentLength() > 0)
+                      return; // réponse déjà envoyée par onBody
+                  StageTimer timer(MetricStage::HttpHandler);
+                  const ConfigPtr cfg = ConfigManager::instance().snapshot();
+                  if (!request->authenticate(cfg->admin_user, cfg->admin_pass))
+                      return request->requestAuthentication();
+                  LOG_W(Web, "Corps JSON vide !");
+                  request->send(400, "application/json; charset=utf-8", "{\"ok\":false,\"err\":\"empty body\"}");
+              },
               // onUpload (non utilisé)
               NULL,
               // onBody
               [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
               {
-                  // Authentification avant d'accepter le body
-                  const char *adminUser = ConfigManager::instance().getAdminUser();
-                  const char *adminPass = ConfigManager::instance().getAdminPass();
-                  if (!request->authenticate(adminUser, adminPass))
-                  {
-                      Serial.println("[WEB][AUTH] /api/config POST non autorisé");
-                      request->requestAuthentication();
-                      return;
-                  }
-
                   if (index == 0)
                   {
-                      if (total > 4096)
+                      // Refus avant toute copie : taille annoncée puis identité
+                      if (total > CONFIG_BODY_MAX)
                       {
-                          Serial.printf("[WEB] Payload trop gros (%u)\n", (unsigned)total);
+                          LOG_W(Web, "Payload trop gros (%u)", (unsigned)total);
                           request->send(413, "application/json; charset=utf-8", "{\"ok\":false,\"err\":\"payload too large\"}");
                           return;
                       }
-                      request->_tempObject = new String();
-                      ((String *)request->_tempObject)->reserve(total);
-                      Serial.printf("[WEB] Début réception body JSON (%u octets)\n", (unsigned)total);
+                      const ConfigPtr cfg = ConfigManager::instance().snapshot();
+                      if (!request->authenticate(cfg->admin_user, cfg->admin_pass))
+                      {
+                          LOG_W(Web, "[AUTH] /api/config POST non autorisé");
+                          request->requestAuthentication();
+                          return;
+                      }
+                      // Zone fixe réservée une fois ; libérée par free() avec la requête
+                      void *mem = malloc(sizeof(ConfigUpdate));
+                      if (!mem)
+                      {
+                          request->send(503, "application/json; charset=utf-8", "{\"ok\":false,\"err\":\"out of memory\"}");
+                          return;
+                      }
+                      request->_tempObject = new (mem) ConfigUpdate();
+                      LOG_D(Web, "Début réception body JSON (%u octets)", (unsigned)total);
                   }
 
-                  String *body = reinterpret_cast<String *>(request->_tempObject);
-                  if (body)
-                  {
-                      body->concat(String((const char *)data).substring(0, len));
-                  }
+                  // Pas d'objet : requête refusée au premier bloc, le reste est ignoré
+                  ConfigUpdate *update = reinterpret_cast<ConfigUpdate *>(request->_tempObject);
+                  if (!update)
+                      return;
+                  update->feed(data, len);
 
                   if (index + len == total)
                   {
-                      Serial.printf("[WEB] Corps JSON complet reçu (%u octets)\n", (unsigned)total);
-                      if (body)
-                      {
-                          handlePostConfig(request, *body);
-                          delete body;
-                          request->_tempObject = nullptr;
-                      }
+                      LOG_D(Web, "Corps JSON complet reçu (%u octets)", (unsigned)total);
+                      StageTimer timer(MetricStage::HttpHandler);
+                      handlePostConfig(request, *update);
                   } });
 
     // --- Lancement du serveur ---
     server.begin();
-    Serial.println("[WEB] Serveur Web démarré et prêt !");
+    LOG_I(Web, "Serveur Web démarré et prêt !");
 }
 
-String makeJsonDistance()
+// Sortie vers une réponse HTTP en flux (JsonWriter, Prometheus)
+static void streamSink(void *ctx, const char *data, size_t len)
 {
-    float m, h;
-    unsigned long dur;
+    static_cast<AsyncResponseStream *>(ctx)->write((const uint8_t *)data, len);
+}
+
+// Réponse JSON sérialisée directement dans le flux, sans String intermédiaire
+template <typename Fn>
+static void sendJson(AsyncWebServerRequest *request, int code, Fn body)
+{
+    AsyncResponseStream *response = request->beginResponseStream("application/json; charset=utf-8");
+    response->setCode(code);
     {
-        std::lock_guard<std::mutex> lock(distMutex);
-        m = lastMeasuredCm;
-        h = lastEstimatedHeight;
-        dur = lastDurationUs;
+        JsonWriter w(streamSink, response);
+        body(w);
     }
+    request->send(response);
+}
 
-    char buf[256];
-    if (m < 0)
-        snprintf(buf, sizeof(buf), "{\"measured_cm\":null,\"estimated_cm\":null,\"duration_us\":%lu,\"cuveVide\":%.1f,\"cuvePleine\":%.1f}", dur, cuveVide, cuvePleine);
-    else
-        snprintf(buf, sizeof(buf), "{\"measured_cm\":%.2f,\"estimated_cm\":%.2f,\"duration_us\":%lu,\"cuveVide\":%.1f,\"cuvePleine\":%.1f}", m, h, dur, cuveVide, cuvePleine);
-    return String(buf);
+void webNotifyMeasurement(const MeasurementRecord &rec)
+{
+    if (events.count() == 0)
+        return;
+    // Un onglet abonné vaut keepalive : pas de deep sleep pendant la consultation
+    interactiveLastTouchMs.store(millis());
+    char buf[320];
+    formatDistanceJson(rec, cuveVideCh[rec.channel].load(), cuvePleineCh[rec.channel].load(), buf, sizeof(buf));
+    events.send(buf, "measure", rec.seq);
+}
+
+static void pushCalibsEvent(uint8_t ch)
+{
+    if (events.count() > 0)
+        events.send(calibsEventJson(ch), "calibs");
 }
 
-String makeJsonCalibs()
+// Canal visé ("ch" en POST ou en query, 0 par défaut) ; false si hors plage
+static bool requestChannel(AsyncWebServerRequest *request, uint8_t &ch)
 {
-    String s = "{\"calibs\":[";
-    for (int i = 0; i < 3; i++)
+    long v = 0;
+    if (request->hasParam("ch", true))
+        v = request->getParam("ch", true)->value().toInt();
+    else if (request->hasParam("ch"))
+        v = request->getParam("ch")->value().toInt();
+    if (v < 0 || v >= SENSOR_CHANNELS)
     {
-        char tmp[96];
-        snprintf(tmp, sizeof(tmp), "{\"index\":%d,\"measured\":%.2f,\"height\":%.2f}", i, calib_m[i], calib_h[i]);
-        s += tmp;
-        if (i < 2)
-            s += ",";
+        request->send(400, "application/json; charset=utf-8", "{\"ok\":false,\"err\":\"bad channel\"}");
+        return false;
     }
-    s += "]}";
-    return s;
+    ch = (uint8_t)v;
+    return true;
+}
+
+// Événement SSE "calibs" (tâche async_tcp uniquement : tampon statique)
+static const char *calibsEventJson(uint8_t ch)
+{
+    static char buf[CALIBS_JSON_LEN];
+    JsonWriter w(buf, sizeof(buf));
+    writeCalibsJson(w, ch);
+    return buf;
 }
 
 // --- Handlers API existants ---
 
 void handleDistanceApi(AsyncWebServerRequest *request)
 {
-    String json = makeJsonDistance();
-    request->send(200, "application/json; charset=utf-8", json);
+    sendJson(request, 200, [](JsonWriter &w)
+             {
+        MeasurementSet set;
+        readMeasurementSet(set);
+        writeDistanceSetJson(w, set); });
 }
 
 void handleCalibsApi(AsyncWebServerRequest *request)
 {
-    String json = makeJsonCalibs();
-    request->send(200, "application/json; charset=utf-8", json);
+    uint8_t ch = 0;
+    if (!requestChannel(request, ch))
+        return;
+    sendJson(request, 200, [ch](JsonWriter &w)
+             { writeCalibsJson(w, ch); });
+}
+
+void handleMetricsApi(AsyncWebServerRequest *request)
+{
+    SystemStats sys;
+    collectSystemStats(sys);
+    AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4; charset=utf-8");
+    metricsWritePrometheus(sys, streamSink, response);
+    request->send(response);
+}
+
+// Traîne du journal en texte : ?since=<n> ne renvoie que les lignes
+// postérieures ; X-Log-Seq donne le numéro à repasser au prochain appel
+void handleLogsApi(AsyncWebServerRequest *request)
+{
+    const ConfigPtr cfg = ConfigManager::instance().snapshot();
+    if (!request->authenticate(cfg->admin_user, cfg->admin_pass))
+        return request->requestAuthentication();
+
+    const uint32_t since = request->hasParam("since") ? (uint32_t)request->getParam("since")->value().toInt() : 0;
+    AsyncResponseStream *response = request->beginResponseStream("text/plain; charset=utf-8");
+    const uint32_t last = logTail(since, [](void *ctx, const LogLine &line)
+                                  {
+        char out[LOG_LINE_MAX + 32];
+        const size_t n = logFormatLine(line, out, sizeof(out));
+        static_cast<AsyncResponseStream *>(ctx)->write((const uint8_t *)out, n); },
+                                  response);
+    char seq[12];
+    snprintf(seq, sizeof(seq), "%lu", (unsigned long)last);
+    response->addHeader("X-Log-Seq", seq);
+    request->send(response);
+}
+
+// POST /api/logs module=<nom|all> level=<none|error|warn|info|debug>
+// (au-dessus de LOG_LEVEL_MAX, les appels sont absents du binaire)
+void handleLogLevel(AsyncWebServerRequest *request)
+{
+    const ConfigPtr cfg = ConfigManager::instance().snapshot();
+    if (!request->authenticate(cfg->admin_user, cfg->admin_pass))
+        return request->requestAuthentication();
+
+    uint8_t level;
+    if (!request->hasParam("module", true) || !request->hasParam("level", true) ||
+        !logParseLevel(request->getParam("level", true)->value().c_str(), level))
+    {
+        request->send(400, "application/json; charset=utf-8", "{\"ok\":false,\"err\":\"module/level\"}");
+        return;
+    }
+    const String &name = request->getParam("module", true)->value();
+    LogModule module;
+    if (name == "all")
+    {
+        for (size_t i = 0; i < LOG_MODULE_COUNT; i++)
+            logSetLevel((LogModule)i, level);
+    }
+    else if (logParseModule(name.c_str(), module))
+    {
+        logSetLevel(module, level);
+    }
+    else
+    {
+        request->send(400, "application/json; charset=utf-8", "{\"ok\":false,\"err\":\"unknown module\"}");
+        return;
+    }
+    LOG_I(Web, "Niveau de journal %s -> %s", name.c_str(), logLevelName(level));
+
+    sendJson(request, 200, [](JsonWriter &w)
+             {
+        w.beginObject();
+        for (size_t i = 0; i < LOG_MODULE_COUNT; i++)
+            w.field(logModuleName((LogModule)i), logLevelName(logLevel((LogModule)i)));
+        w.endObject(); });
+}
+
+void handleHistoryApi(AsyncWebServerRequest *request)
+{
+    HistoryTier tier = HistoryTier::Raw;
+    if (request->hasParam("tier"))
+    {
+        const String &t = request->getParam("tier")->value();
+        if (t == "minute")
+            tier = HistoryTier::Minute;
+        else if (t == "hour")
+            tier = HistoryTier::Hour;
+    }
+    long n = request->hasParam("n") ? request->getParam("n")->value().toInt() : 120;
+    n = constrain(n, 1L, 360L);
+
+    std::unique_ptr<HistoryRecord[]> recs(new HistoryRecord[n]);
+    const size_t got = historyStore.readLatest(tier, recs.get(), (size_t)n);
+
+    // records : [t_s, min_cm, max_cm, mean_cm, count], du plus ancien au plus récent
+    const HistoryRecord *rs = recs.get();
+    sendJson(request, 200, [tier, rs, got](JsonWriter &w)
+             {
+        w.beginObject()
+            .field("tier", HistoryStore::tierName(tier))
+            .field("now", (uint32_t)time(nullptr));
+        w.key("records").beginArray();
+        for (size_t i = 0; i < got; i++)
+        {
+            const HistoryRecord &r = rs[i];
+            w.beginArray()
+                .value(r.tS)
+                .value(r.minMm / 10.0f, 1)
+                .value(r.maxMm / 10.0f, 1)
+                .value(r.meanMm / 10.0f, 1)
+                .value(r.count)
+                .endArray();
+        }
+        w.endArray().endObject(); });
 }
 
 void handleSaveCalib(AsyncWebServerRequest *request)
 {
     if (!request->hasParam("id", true) || !request->hasParam("height", true))
     {
-        Serial.println("[WEB][ERR] save_calib: paramètres manquants !");
+        LOG_W(Web, "save_calib: paramètres manquants !");
         request->send(400, "application/json; charset=utf-8", "{\"ok\":false}");
         return;
     }
+    uint8_t ch = 0;
+    if (!requestChannel(request, ch))
+        return;
 
+    // id = index existant (remplacement) ou -1 / nombre de points (ajout)
     int id = request->getParam("id", true)->value().toInt();
     float height = request->getParam("height", true)->value().toFloat();
 
+    // Distance saisie à la main, sinon mesure courante
     float measured;
+    if (request->hasParam("measured", true))
     {
-        std::lock_guard<std::mutex> lock(distMutex);
-        measured = lastMeasuredCm;
+        measured = request->getParam("measured", true)->value().toFloat();
+    }
+    else
+    {
+        MeasurementRecord rec;
+        readMeasurement(rec, ch);
+        measured = rec.measuredCm;
     }
 
     if (measured <= 0.0f)
     {
-        Serial.println("[WEB][WARN] save_calib: mesure invalide (no echo)");
+        LOG_W(Web, "save_calib: mesure invalide (no echo)");
         request->send(200, "application/json; charset=utf-8", "{\"ok\":false,\"err\":\"no echo\"}");
         return;
     }
 
-    Serial.printf("[WEB] Sauvegarde calibration #%d -> mesuré=%.2f, hauteur=%.2f\n", id, measured, height);
-    saveCalibrationToNVS(id, measured, height);
-    computePolynomialFrom3Points();
+    LOG_I(Web, "Sauvegarde calibration C%u #%d -> mesuré=%.2f, hauteur=%.2f", ch, id, measured, height);
+    if (!saveCalibrationToNVS(id, measured, height, ch))
+    {
+        request->send(400, "application/json; charset=utf-8", "{\"ok\":false,\"err\":\"bad index\"}");
+        return;
+    }
+    pushCalibsEvent(ch);
+    request->send(200, "application/json; charset=utf-8", "{\"ok\":true}");
+}
+
+void handleDeleteCalib(AsyncWebServerRequest *request)
+{
+    uint8_t ch = 0;
+    if (!requestChannel(request, ch))
+        return;
+    if (!request->hasParam("id", true) || !removeCalibrationPoint(request->getParam("id", true)->value().toInt(), ch))
+    {
+        request->send(400, "application/json; charset=utf-8", "{\"ok\":false}");
+        return;
+    }
+    pushCalibsEvent(ch);
+    request->send(200, "application/json; charset=utf-8", "{\"ok\":true}");
+}
+
+void handleCalibModel(AsyncWebServerRequest *request)
+{
+    uint8_t ch = 0;
+    if (!requestChannel(request, ch))
+        return;
+    CalibModel model;
+    if (!request->hasParam("model", true) ||
+        !CalibrationTable::parseModel(request->getParam("model", true)->value().c_str(), model))
+    {
+        request->send(400, "application/json; charset=utf-8", "{\"ok\":false}");
+        return;
+    }
+    long degree = request->hasParam("degree", true) ? request->getParam("degree", true)->value().toInt() : 2;
+    setCalibrationModel(model, (uint8_t)constrain(degree, 1L, 3L), ch);
+    LOG_I(Web, "Modèle de calibration C%u -> %s", ch, CalibrationTable::modelName(model));
+    pushCalibsEvent(ch);
     request->send(200, "application/json; charset=utf-8", "{\"ok\":true}");
 }
 
 void handleClearCalib(AsyncWebServerRequest *request)
 {
-    Serial.println("[WEB] Effacement des calibrations...");
-    clearCalibrations();
-    computePolynomialFrom3Points();
+    uint8_t ch = 0;
+    if (!requestChannel(request, ch))
+        return;
+    LOG_I(Web, "Effacement des calibrations C%u...", ch);
+    clearCalibrations(ch);
+    pushCalibsEvent(ch);
     request->send(200, "application/json; charset=utf-8", "{\"ok\":true}");
 }
 
 void handleSetCuve(AsyncWebServerRequest *request)
 {
-    Serial.println("[WEB] Mise à jour des niveaux de cuve...");
+    uint8_t ch = 0;
+    if (!requestChannel(request, ch))
+        return;
+    LOG_I(Web, "Mise à jour des niveaux de cuve C%u...", ch);
 
     // Lire d'abord les params POST, sinon fallback sur query
     if (request->hasParam("vide", true))
-        cuveVide = request->getParam("vide", true)->value().toFloat();
+        cuveVideCh[ch] = request->getParam("vide", true)->value().toFloat();
     else if (request->hasParam("vide"))
-        cuveVide = request->getParam("vide")->value().toFloat();
+        cuveVideCh[ch] = request->getParam("vide")->value().toFloat();
 
     if (request->hasParam("pleine", true))
-        cuvePleine = request->getParam("pleine", true)->value().toFloat();
+        cuvePleineCh[ch] = request->getParam("pleine", true)->value().toFloat();
     else if (request->hasParam("pleine"))
-        cuvePleine = request->getParam("pleine")->value().toFloat();
+        cuvePleineCh[ch] = request->getParam("pleine")->value().toFloat();
 
-    Serial.printf("  -> Vide=%.2f, Pleine=%.2f\n", cuveVide, cuvePleine);
-    saveCuveLevels();
+    LOG_I(Web, "  -> Vide=%.2f, Pleine=%.2f", cuveVideCh[ch].load(), cuvePleineCh[ch].load());
+    saveCuveLevels(ch);
+    displayNotify();
+    if (events.count() > 0)
+    {
+        // Événement "cuve" : niveaux et volume recalculés sur la dernière mesure,
+        // sans nouveau point de graphe (ce n'est pas une nouvelle mesure)
+        MeasurementRecord rec;
+        readMeasurement(rec, ch);
+        char buf[320];
+        formatDistanceJson(rec, cuveVideCh[ch].load(), cuvePleineCh[ch].load(), buf, sizeof(buf));
+        events.send(buf, "cuve");
+    }
     request->send(200, "application/json; charset=utf-8", "{\"ok\":true}");
 }
 
 void handleSendMQTT(AsyncWebServerRequest *request)
 {
-    Serial.println("[WEB] Envoi MQTT manuel...");
+    LOG_I(Web, "Envoi MQTT manuel...");
     bool ok = publishMQTT_measure();
 
-    Serial.printf("[WEB] MQTT %s\n", ok ? "OK" : "ÉCHEC");
-    String resp = String("{\"ok\":") + (ok ? "true" : "false") + "}";
-    request->send(200, "application/json; charset=utf-8", resp);
+    LOG_I(Web, "MQTT %s", ok ? "OK" : "ÉCHEC");
+    request->send(200, "application/json; charset=utf-8", ok ? "{\"ok\":true}" : "{\"ok\":false}");
 }
 
 void handleGetConfig(AsyncWebServerRequest *request)
 {
-    const char *adminUser = ConfigManager::instance().getAdminUser();
-    const char *adminPass = ConfigManager::instance().getAdminPass();
+    const ConfigPtr cfg = ConfigManager::instance().snapshot();
+    const char *adminUser = cfg->admin_user;
+    const char *adminPass = cfg->admin_pass;
     if (!request->authenticate(adminUser, adminPass))
     {
-        Serial.println("[WEB][AUTH] /api/config GET non autorisé");
+        LOG_W(Web, "[AUTH] /api/config GET non autorisé");
         return request->requestAuthentication();
     }
 
-    Serial.println("[WEB] GET /api/config (auth OK)");
-    String json = ConfigManager::instance().toJsonString();
-    request->send(200, "application/json; charset=utf-8", json);
+    LOG_D(Web, "GET /api/config (auth OK)");
+    sendJson(request, 200, [](JsonWriter &w)
+             { ConfigManager::instance().writeJson(w); });
 }
 
-void handlePostConfig(AsyncWebServerRequest *request, const String &body)
+// Appelé au dernier bloc du corps (authentifié au premier bloc)
+void handlePostConfig(AsyncWebServerRequest *request, const ConfigUpdate &update)
 {
-    Serial.println("[WEB] POST /api/config reçu");
+    LOG_D(Web, "POST /api/config reçu");
 
-    // Double check auth (déjà fait dans le onBody, on garde le garde-fou)
-    const char *adminUser = ConfigManager::instance().getAdminUser();
-    const char *adminPass = ConfigManager::instance().getAdminPass();
-    if (!request->authenticate(adminUser, adminPass))
+    bool okUpdate = ConfigManager::instance().applyUpdate(update);
+    if (okUpdate)
     {
-        Serial.println("[WEB][AUTH] /api/config POST non autorisé (2nd check)");
+        LOG_I(Web, "Configuration mise à jour (sauvegarde différée).");
+        ConfigManager &cm = ConfigManager::instance();
+        char buf[96];
+        JsonWriter w(buf, sizeof(buf));
+        w.beginObject()
+            .field("ok", true)
+            .field("generation", cm.generation())
+            .field("pending", cm.pendingGeneration())
+            .field("committed", cm.committedGeneration())
+            .endObject();
+        if (events.count() > 0)
+            events.send(buf, "config");
+        sendJson(request, 200, [&buf](JsonWriter &out)
+                 { out.raw(buf); });
+    }
+    else
+    {
+        LOG_W(Web, "Échec de la mise à jour JSON !");
+        sendJson(request, 400, [&update](JsonWriter &w)
+                 {
+            w.beginObject()
+                .field("ok", false)
+                .field("err", update.error() ? update.error() : "incomplete body");
+            if (update.errorField())
+                w.field("field", update.errorField());
+            w.endObject(); });
+    }
+}
+
+// État de l'écriture différée : la page compare pending et committed
+// (lu en RAM, aucun accès NVS)
+void handleConfigState(AsyncWebServerRequest *request)
+{
+    const ConfigPtr cfg = ConfigManager::instance().snapshot();
+    if (!request->authenticate(cfg->admin_user, cfg->admin_pass))
         return request->requestAuthentication();
+
+    sendJson(request, 200, [](JsonWriter &w)
+             {
+        ConfigManager &cm = ConfigManager::instance();
+        w.beginObject()
+            .field("pending", cm.pendingGeneration())
+            .field("committed", cm.committedGeneration())
+            .field("saved", !cm.savePending())
+            .endObject(); });
+}
+
+// ==========================================================
+// === Fichiers statiques embarqués ===
+// ==========================================================
+static void serveWebAsset(AsyncWebServerRequest *request, const char *path, bool needsAuth)
+{
+    if (needsAuth)
+    {
+        const ConfigPtr cfg = ConfigManager::instance().snapshot();
+        if (!request->authenticate(cfg->admin_user, cfg->admin_pass))
+        {
+            LOG_D(Web, "[AUTH] Authentification requise sur %s", path);
+            return request->requestAuthentication();
+        }
     }
 
-    if (body.isEmpty())
+    const WebAsset *asset = findWebAsset(path);
+    if (!asset)
     {
-        Serial.println("[WEB][ERR] Corps JSON vide !");
-        request->send(400, "application/json; charset=utf-8", "{\"ok\":false,\"err\":\"empty body\"}");
+        request->send(404, "text/plain", "Not found");
         return;
     }
 
-    bool okUpdate = ConfigManager::instance().updateFromJson(body);
-    if (okUpdate)
+    // CSS/JS versionnés par ?v=<hash> : cache long ; HTML : revalidation par ETag.
+    // Les pages protégées ne doivent pas finir dans un cache partagé.
+    const char *cacheControl;
+    if (asset->immutable)
+        cacheControl = needsAuth ? "private, max-age=31536000, immutable" : "public, max-age=31536000, immutable";
+    else
+        cacheControl = needsAuth ? "private, no-cache" : "no-cache";
+
+    // Client sans gzip : fichier d'origine de data/ (image LittleFS sous
+    // HAL_FS_ROOT), lu par morceaux pendant l'envoi. Sans ETag : l'image peut
+    // ne pas correspondre au firmware, et ses pages n'ont pas les ?v=<hash>.
+    const bool hasAcceptEncoding = request->hasHeader("Accept-Encoding");
+    if (!httpAcceptsGzip(hasAcceptEncoding ? request->header("Accept-Encoding").c_str() : nullptr))
     {
-        Serial.println("[WEB] Configuration mise à jour (sauvegarde différée).");
-        request->send(200, "application/json; charset=utf-8", "{\"ok\":true}");
+        if (!LittleFS.exists(path))
+        {
+            LOG_W(Web, "GET %s : gzip refusé et fichier absent de LittleFS (406)", path);
+            request->send(406, "text/plain", "gzip required");
+            return;
+        }
+        LOG_D(Web, "GET %s (LittleFS, sans gzip)", path);
+        AsyncWebServerResponse *response = request->beginResponse(LittleFS, path, asset->mime);
+        response->addHeader("Cache-Control", needsAuth ? "private, no-cache" : "no-cache");
+        response->addHeader("Vary", "Accept-Encoding");
+        request->send(response);
+        return;
     }
-    else
+
+    // Revalidation : aucun octet de contenu renvoyé si le navigateur est à jour
+    if (request->hasHeader("If-None-Match") &&
+        httpEtagMatches(request->header("If-None-Match").c_str(), asset->etag))
     {
-        Serial.println("[WEB][ERR] Échec de la mise à jour JSON !");
-        request->send(400, "application/json; charset=utf-8", "{\"ok\":false}");
+        AsyncWebServerResponse *response = request->beginResponse(304);
+        response->addHeader("ETag", asset->etag);
+        response->addHeader("Cache-Control", cacheControl);
+        response->addHeader("Vary", "Accept-Encoding");
+        request->send(response);
+        return;
     }
+
+    LOG_D(Web, "GET %s (%u o gzip)", path, (unsigned)asset->gzLen);
+    AsyncWebServerResponse *response = request->beginResponse(200, asset->mime, asset->gz, asset->gzLen);
+    response->addHeader("Content-Encoding", "gzip");
+    response->addHeader("ETag", asset->etag);
+    response->addHeader("Cache-Control", cacheControl);
+    response->addHeader("Vary", "Accept-Encoding");
+    request->send(response);
 }
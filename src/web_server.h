@@ -1,4 +1,8 @@
 #pragma once
 #include <Arduino.h>
+#include "measurement_store.h"
 
 void startWebServer();
+
+// Pousse une nouvelle mesure aux clients SSE (/events) ; no-op sans abonné.
+void webNotifyMeasurement(const MeasurementRecord &rec);